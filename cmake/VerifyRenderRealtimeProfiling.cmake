@@ -5,6 +5,10 @@ if(NOT DEFINED OUTPUT_DIR)
     message(FATAL_ERROR "OUTPUT_DIR is required")
 endif()
 
+if(NOT DEFINED BACKEND)
+    set(BACKEND optix)
+endif()
+
 file(REMOVE_RECURSE "${OUTPUT_DIR}")
 file(MAKE_DIRECTORY "${OUTPUT_DIR}")
 
@@ -15,6 +19,7 @@ execute_process(
         --warmup-frames 1
         --seed 7
         --profile realtime
+        --backend "${BACKEND}"
         --output-dir "${OUTPUT_DIR}"
     RESULT_VARIABLE run_result
     OUTPUT_VARIABLE run_stdout
@@ -39,6 +44,9 @@ endif()
 if(NOT run_stdout MATCHES "summary profile=realtime warmup_frames=1 frames=2 seed=7")
     message(FATAL_ERROR "stdout missing benchmark workload provenance:\n${run_stdout}")
 endif()
+if(NOT run_stdout MATCHES "backend=${BACKEND} ")
+    message(FATAL_ERROR "stdout missing backend ${BACKEND}:\n${run_stdout}")
+endif()
 if(NOT run_stdout MATCHES "p99_frame_ms=")
     message(FATAL_ERROR "stdout missing p99 timing:\n${run_stdout}")
 endif()
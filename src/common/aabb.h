@@ -62,6 +62,18 @@ struct AABB {
         return true;
     }
 
+    double surface_area() const {
+        // Returns the total area of the six faces, or zero for an empty box
+        if (x.size() <= 0.0 || y.size() <= 0.0 || z.size() <= 0.0) {
+            return 0.0;
+        }
+        return 2.0 * (x.size() * y.size() + y.size() * z.size() + z.size() * x.size());
+    }
+
+    Vec3d centroid() const {
+        return {0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max)};
+    }
+
     int longest_axis() const {
         // Returns the index of the longest axis of the bounding box
         if (x.size() > y.size()) {
@@ -0,0 +1,55 @@
+#include "common/alias_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rt {
+
+std::vector<AliasTableEntry> build_alias_table(std::span<const double> weights) {
+    const std::size_t count = weights.size();
+    std::vector<AliasTableEntry> table(count);
+    if (count == 0) {
+        return table;
+    }
+
+    std::vector<double> scaled(count);
+    double total = 0.0;
+    for (std::size_t i = 0; i < count; ++i) {
+        scaled[i] = std::isfinite(weights[i]) ? std::max(0.0, weights[i]) : 0.0;
+        total += scaled[i];
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        scaled[i] = total > 0.0 ? scaled[i] * static_cast<double>(count) / total : 1.0;
+    }
+
+    std::vector<int> small;
+    std::vector<int> large;
+    small.reserve(count);
+    large.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        const int under = small.back();
+        small.pop_back();
+        const int over = large.back();
+        table[static_cast<std::size_t>(under)] = AliasTableEntry {
+            .probability = scaled[static_cast<std::size_t>(under)],
+            .alias = over,
+        };
+        double& remaining = scaled[static_cast<std::size_t>(over)];
+        remaining -= 1.0 - scaled[static_cast<std::size_t>(under)];
+        if (remaining < 1.0) {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+    // Whatever is left is full up to rounding
+    large.insert(large.end(), small.begin(), small.end());
+    for (const int index : large) {
+        table[static_cast<std::size_t>(index)] = AliasTableEntry {.alias = index};
+    }
+    return table;
+}
+
+} // namespace rt
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+namespace rt {
+
+// One bucket of a Walker alias table: the bucket keeps its own index with `probability` and
+// otherwise hands the sample to `alias`.
+struct AliasTableEntry {
+    double probability = 1.0;
+    int alias = -1;
+};
+
+// Vose's construction over non-negative weights, in O(n). Entry i is bucket i; every alias is a
+// valid index. Non-finite and negative weights count as zero. When no weight is positive the
+// table selects uniformly.
+std::vector<AliasTableEntry> build_alias_table(std::span<const double> weights);
+
+} // namespace rt
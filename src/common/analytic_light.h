@@ -33,11 +33,14 @@ struct AnalyticLightDesc {
     double selection_weight = 0.0;
     double selection_pdf = 0.0;
     double cdf = 0.0;
+    double alias_probability = 1.0; // Alias-table bucket; see sample_light_distribution
+    int alias = -1;
     bool delta = false;
     bool treat_as_point = false;
     bool treat_as_line = false;
 };
 
+// Normalizes selection weights into selection_pdf and builds the CDF and alias table.
 void finalize_analytic_light_distribution(std::vector<AnalyticLightDesc>& lights);
 
 } // namespace rt
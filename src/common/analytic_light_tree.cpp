@@ -0,0 +1,309 @@
+#include "common/analytic_light_tree.h"
+
+#include "common/alias_table.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace rt {
+namespace {
+
+constexpr int kBucketCount = 12;
+// Deeper nodes split at the centroid median, which bounds the depth for any light count
+constexpr int kMaxHeuristicDepth = 24;
+
+struct LightBounds {
+    Eigen::AlignedBox3d box;
+    Eigen::Vector3d axis = Eigen::Vector3d::UnitZ();
+    double cos_theta_o = 1.0;
+    double cos_theta_e = 0.0;
+    double power = 0.0;
+};
+
+struct BuildLight {
+    LightBounds bounds;
+    Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+    int light_index = -1;
+};
+
+bool finite_light(AnalyticLightType type) {
+    return type == AnalyticLightType::sphere || type == AnalyticLightType::disk
+           || type == AnalyticLightType::rect || type == AnalyticLightType::cylinder;
+}
+
+LightBounds light_bounds(const AnalyticLightDesc& light) {
+    const Eigen::Matrix3d& basis = light.local_to_world_linear;
+    LightBounds bounds;
+    Eigen::Vector3d half_extent = Eigen::Vector3d::Zero();
+    if (light.type == AnalyticLightType::sphere) {
+        half_extent = Eigen::Vector3d::Constant(light.radius * basis.col(0).norm());
+        bounds.cos_theta_o = -1.0;
+    } else if (light.type == AnalyticLightType::cylinder) {
+        // Matches the intersection, which scales both radial axes by the first basis length
+        const double scale = std::max(basis.col(0).norm(), 1e-12);
+        half_extent = (basis.col(0).cwiseAbs() + basis.col(1).cwiseAbs()) * light.radius
+                          * std::max(1.0, scale / std::max(basis.col(1).norm(), 1e-12))
+                      + basis.col(2).cwiseAbs() * (0.5 * light.length);
+        bounds.cos_theta_o = -1.0;
+    } else {
+        half_extent = light.type == AnalyticLightType::disk
+                          ? Eigen::Vector3d((basis.col(0).cwiseAbs() + basis.col(1).cwiseAbs())
+                                            * light.radius)
+                          : Eigen::Vector3d(basis.col(0).cwiseAbs() * (0.5 * light.width)
+                                            + basis.col(1).cwiseAbs() * (0.5 * light.height));
+        const Eigen::Vector3d normal = -basis.col(0).cross(basis.col(1));
+        bounds.axis = normal.squaredNorm() > 0.0 ? normal.normalized() : Eigen::Vector3d::UnitZ();
+        bounds.cos_theta_o = 1.0;
+    }
+    bounds.box = Eigen::AlignedBox3d {light.position - half_extent, light.position + half_extent};
+    bounds.power = std::isfinite(light.selection_pdf) ? std::max(0.0, light.selection_pdf) : 0.0;
+    return bounds;
+}
+
+// Smallest cone around both cones
+void merge_cone(Eigen::Vector3d& axis, double& cos_theta, const Eigen::Vector3d& other_axis,
+    double other_cos_theta) {
+    if (cos_theta <= -1.0) {
+        return;
+    }
+    if (other_cos_theta <= -1.0) {
+        axis = other_axis;
+        cos_theta = -1.0;
+        return;
+    }
+    const double theta_a = std::acos(std::clamp(cos_theta, -1.0, 1.0));
+    const double theta_b = std::acos(std::clamp(other_cos_theta, -1.0, 1.0));
+    const double theta_d = std::acos(std::clamp(axis.dot(other_axis), -1.0, 1.0));
+    if (std::min(theta_d + theta_b, std::numbers::pi) <= theta_a) {
+        return;
+    }
+    if (std::min(theta_d + theta_a, std::numbers::pi) <= theta_b) {
+        axis = other_axis;
+        cos_theta = other_cos_theta;
+        return;
+    }
+    const double theta_o = 0.5 * (theta_a + theta_d + theta_b);
+    const Eigen::Vector3d rotation_axis = axis.cross(other_axis);
+    if (theta_o >= std::numbers::pi || rotation_axis.squaredNorm() < 1e-24) {
+        cos_theta = -1.0;
+        return;
+    }
+    axis = (Eigen::AngleAxisd(theta_o - theta_a, rotation_axis.normalized()) * axis).normalized();
+    cos_theta = std::cos(theta_o);
+}
+
+void merge(LightBounds& bounds, const LightBounds& other) {
+    if (bounds.box.isEmpty()) {
+        bounds = other;
+        return;
+    }
+    bounds.box.extend(other.box);
+    merge_cone(bounds.axis, bounds.cos_theta_o, other.axis, other.cos_theta_o);
+    bounds.cos_theta_e = std::min(bounds.cos_theta_e, other.cos_theta_e);
+    bounds.power += other.power;
+}
+
+// Solid angle measure of the directions the cone can emit into, weighted by the cosine falloff
+double orientation_measure(const LightBounds& bounds) {
+    const double theta_o = std::acos(std::clamp(bounds.cos_theta_o, -1.0, 1.0));
+    const double theta_e = std::acos(std::clamp(bounds.cos_theta_e, -1.0, 1.0));
+    const double theta_w = std::min(theta_o + theta_e, std::numbers::pi);
+    const double sin_theta_o = std::sin(theta_o);
+    return 2.0 * std::numbers::pi * (1.0 - bounds.cos_theta_o)
+           + 0.5 * std::numbers::pi
+                 * (2.0 * theta_w * sin_theta_o - std::cos(theta_o - 2.0 * theta_w)
+                     - 2.0 * theta_o * sin_theta_o + bounds.cos_theta_o);
+}
+
+double surface_area(const Eigen::AlignedBox3d& box) {
+    const Eigen::Vector3d size = box.sizes();
+    return 2.0 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+}
+
+double split_cost(const LightBounds& bounds) {
+    return bounds.power * orientation_measure(bounds) * surface_area(bounds.box);
+}
+
+float round_down(double value) {
+    const float rounded = static_cast<float>(value);
+    return static_cast<double>(rounded) > value
+               ? std::nextafter(rounded, -std::numeric_limits<float>::infinity())
+               : rounded;
+}
+
+float round_up(double value) {
+    const float rounded = static_cast<float>(value);
+    return static_cast<double>(rounded) < value
+               ? std::nextafter(rounded, std::numeric_limits<float>::infinity())
+               : rounded;
+}
+
+LightTreeNode pack_node(const LightBounds& bounds) {
+    const Eigen::Vector3d& min = bounds.box.min();
+    const Eigen::Vector3d& max = bounds.box.max();
+    return LightTreeNode {
+        .bounds_min = {round_down(min.x()), round_down(min.y()), round_down(min.z())},
+        .bounds_max = {round_up(max.x()), round_up(max.y()), round_up(max.z())},
+        .axis = {static_cast<float>(bounds.axis.x()), static_cast<float>(bounds.axis.y()),
+            static_cast<float>(bounds.axis.z())},
+        // Rounded towards the wider cone
+        .cos_theta_o = round_down(bounds.cos_theta_o),
+        .cos_theta_e = round_down(bounds.cos_theta_e),
+        .power = static_cast<float>(bounds.power),
+    };
+}
+
+int bucket_of(const BuildLight& light, const Eigen::AlignedBox3d& centroids, int axis) {
+    const double offset =
+        (light.centroid[axis] - centroids.min()[axis]) / centroids.sizes()[axis];
+    return std::min(static_cast<int>(offset * kBucketCount), kBucketCount - 1);
+}
+
+// Reorders the lights so that the first child's come first and returns how many there are
+std::size_t partition_lights(std::span<BuildLight> lights, const LightBounds& bounds) {
+    Eigen::AlignedBox3d centroids;
+    for (const BuildLight& light : lights) {
+        centroids.extend(light.centroid);
+    }
+    const Eigen::Vector3d extent = bounds.box.sizes();
+    const double max_extent = extent.maxCoeff();
+
+    double best_cost = std::numeric_limits<double>::infinity();
+    int best_axis = -1;
+    int best_split = -1;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (centroids.sizes()[axis] <= 0.0) {
+            continue;
+        }
+        std::array<LightBounds, kBucketCount> buckets {};
+        std::array<int, kBucketCount> counts {};
+        for (const BuildLight& light : lights) {
+            const int bucket = bucket_of(light, centroids, axis);
+            merge(buckets[bucket], light.bounds);
+            ++counts[bucket];
+        }
+
+        // Long thin nodes prefer splits across their long axis
+        const double regularization = extent[axis] > 0.0 ? max_extent / extent[axis] : 1.0;
+        for (int split = 0; split + 1 < kBucketCount; ++split) {
+            LightBounds below;
+            LightBounds above;
+            int below_count = 0;
+            int above_count = 0;
+            for (int bucket = 0; bucket < kBucketCount; ++bucket) {
+                if (counts[bucket] == 0) {
+                    continue;
+                }
+                merge(bucket <= split ? below : above, buckets[bucket]);
+                (bucket <= split ? below_count : above_count) += counts[bucket];
+            }
+            if (below_count == 0 || above_count == 0) {
+                continue;
+            }
+            const double cost = regularization * (split_cost(below) + split_cost(above));
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    if (best_axis < 0) {
+        // Every centroid coincides: split the list in half
+        return lights.size() / 2;
+    }
+    const auto middle = std::partition(lights.begin(), lights.end(), [&](const BuildLight& light) {
+        return bucket_of(light, centroids, best_axis) <= best_split;
+    });
+    return static_cast<std::size_t>(middle - lights.begin());
+}
+
+std::size_t partition_at_median(std::span<BuildLight> lights) {
+    Eigen::AlignedBox3d centroids;
+    for (const BuildLight& light : lights) {
+        centroids.extend(light.centroid);
+    }
+    Eigen::Index axis = 0;
+    centroids.sizes().maxCoeff(&axis);
+    const std::size_t middle = lights.size() / 2;
+    std::nth_element(lights.begin(), lights.begin() + static_cast<std::ptrdiff_t>(middle),
+        lights.end(), [axis](const BuildLight& a, const BuildLight& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+    return middle;
+}
+
+int build_node(std::vector<LightTreeNode>& nodes, std::span<BuildLight> lights, int parent,
+    int depth, std::vector<int>& light_leaves) {
+    LightBounds bounds;
+    for (const BuildLight& light : lights) {
+        merge(bounds, light.bounds);
+    }
+    const int index = static_cast<int>(nodes.size());
+    nodes.push_back(pack_node(bounds));
+    nodes[index].parent = parent;
+    if (lights.size() == 1) {
+        nodes[index].light_index = lights.front().light_index;
+        light_leaves[static_cast<std::size_t>(lights.front().light_index)] = index;
+        return index;
+    }
+
+    const std::size_t below = depth < kMaxHeuristicDepth ? partition_lights(lights, bounds)
+                                                         : partition_at_median(lights);
+    build_node(nodes, lights.first(below), index, depth + 1, light_leaves);
+    const int second = build_node(nodes, lights.subspan(below), index, depth + 1, light_leaves);
+    nodes[index].second_child = second;
+    return index;
+}
+
+} // namespace
+
+AnalyticLightTree build_analytic_light_tree(std::span<const AnalyticLightDesc> lights) {
+    AnalyticLightTree tree;
+    tree.light_leaves.assign(lights.size(), -1);
+
+    std::vector<BuildLight> finite;
+    std::vector<double> infinite_weights;
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        const AnalyticLightDesc& light = lights[i];
+        if (finite_light(light.type)) {
+            BuildLight build {.bounds = light_bounds(light), .light_index = static_cast<int>(i)};
+            build.centroid = build.bounds.box.center();
+            finite.push_back(build);
+        } else {
+            tree.infinite.push_back(LightTreeInfiniteEntry {.light_index = static_cast<int>(i)});
+            infinite_weights.push_back(light.selection_pdf);
+        }
+    }
+
+    if (!finite.empty()) {
+        tree.nodes.reserve(2 * finite.size() - 1);
+        build_node(tree.nodes, finite, -1, 0, tree.light_leaves);
+    }
+
+    const std::vector<AliasTableEntry> table = build_alias_table(infinite_weights);
+    double total = 0.0;
+    for (const double weight : infinite_weights) {
+        total += std::isfinite(weight) ? std::max(0.0, weight) : 0.0;
+    }
+    double cumulative = 0.0;
+    for (std::size_t i = 0; i < tree.infinite.size(); ++i) {
+        const double weight = std::isfinite(infinite_weights[i]) ? infinite_weights[i] : 0.0;
+        cumulative += std::max(0.0, weight);
+        tree.infinite[i].cdf = total > 0.0 ? static_cast<float>(cumulative / total) : 0.0f;
+        tree.infinite[i].alias_probability = static_cast<float>(table[i].probability);
+        tree.infinite[i].alias = table[i].alias;
+    }
+    if (!tree.infinite.empty()) {
+        tree.infinite.back().cdf = 1.0f;
+    }
+    return tree;
+}
+
+} // namespace rt
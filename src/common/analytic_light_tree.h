@@ -0,0 +1,24 @@
+#pragma once
+
+#include "common/analytic_light.h"
+#include "common/light_tree.h"
+
+#include <span>
+#include <vector>
+
+namespace rt {
+
+// Light BVH over the finite analytic lights (spheres, disks, rects, cylinders) and the alias table
+// that chooses among the distant and dome lights. Node power is the lights' selection_pdf, so the
+// root carries the tree's share of the global light distribution.
+struct AnalyticLightTree {
+    std::vector<LightTreeNode> nodes;
+    std::vector<int> light_leaves; // Leaf node of every light; -1 for infinite lights
+    std::vector<LightTreeInfiniteEntry> infinite;
+};
+
+// Splits with the surface area orientation heuristic: lights go into twelve centroid buckets per
+// axis and each candidate split costs power x surface area x orientation-cone measure per side.
+AnalyticLightTree build_analytic_light_tree(std::span<const AnalyticLightDesc> lights);
+
+} // namespace rt
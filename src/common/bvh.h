@@ -2,84 +2,151 @@
 
 #include "traits.h"
 
+#include "bvh_builder.h"
 #include "hittable_list.h"
-
-struct BVHNode {
-    BVHNode(HittableList list) : BVHNode(list.m_objects, 0, list.m_objects.size()) {
-        // There's a C++ subtlety here. This constructor (without span indices) creates an
-        // implicit copy of the hittable list, which we will modify. The lifetime of the copied
-        // list only extends until this constructor exits. That's OK, because we only need to
-        // persist the resulting bounding volume hierarchy.
+#include "wide_bvh.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace rt {
+
+// Visits the leaves of `bvh` whose boxes the ray enters before `closest_so_far`, nearest entry
+// first, so farther boxes are usually culled by the shortened interval when they are popped.
+// `visit_leaf(first, count, closest_so_far)` returns whether it recorded a hit and may shrink
+// `closest_so_far`.
+template <typename LeafVisitor>
+bool traverse_wide_bvh(const WideBvh& bvh, const Ray& ray, const Interval& ray_t,
+    LeafVisitor&& visit_leaf) {
+    struct StackEntry {
+        std::int32_t child = 0;
+        std::int32_t count = 0;
+        float t_entry = 0.0f;
+    };
+    // Collapsing never deepens the builder's hierarchy (at most 128 levels), and each level
+    // leaves at most width - 1 siblings behind on the stack.
+    constexpr int kStackSize = (kMaxWideBvhWidth - 1) * 128 + 1;
+
+    if (bvh.empty()) {
+        return false;
     }
 
-    BVHNode(std::vector<pro::proxy<Hittable>>& objects, const size_t start, const size_t end) {
-        // Build the bounding box of the span of source objects.
-        m_bbox = AABB::empty;
-        for (size_t index = start; index < end; ++index) {
-            m_bbox = AABB {m_bbox, objects[index]->bounding_box()};
+    const WideBvhRay wide_ray = make_wide_bvh_ray(ray.origin(), ray.direction());
+    const float t_min = round_down_to_float(ray_t.min);
+    std::array<StackEntry, kStackSize> stack;
+    std::array<float, kMaxWideBvhWidth> t_entry;
+    int stack_size = 0;
+    stack[stack_size++] = StackEntry {.child = 0, .count = 0, .t_entry = t_min};
+
+    bool hit_anything = false;
+    double closest_so_far = ray_t.max;
+
+    while (stack_size > 0) {
+        const StackEntry entry = stack[--stack_size];
+        if (entry.t_entry > closest_so_far) {
+            continue;
+        }
+        if (entry.count > 0) {
+            hit_anything |= visit_leaf(entry.child, entry.count, closest_so_far);
+            continue;
         }
 
-        const int axis = m_bbox.longest_axis();
+        const std::size_t first_lane = static_cast<std::size_t>(entry.child * bvh.width);
+        std::uint32_t mask = bvh.box_test(bvh.node_bounds(entry.child), wide_ray, t_min,
+            round_up_to_float(closest_so_far), t_entry.data());
+
+        // Insert the hit lanes so the stack stays sorted far-to-near above `stack_base`
+        const int stack_base = stack_size;
+        while (mask != 0) {
+            const int lane = std::countr_zero(mask);
+            mask &= mask - 1;
+            const StackEntry child {
+                .child = bvh.children[first_lane + lane],
+                .count = bvh.counts[first_lane + lane],
+                .t_entry = t_entry[static_cast<std::size_t>(lane)],
+            };
+            int slot = stack_size++;
+            while (slot > stack_base && stack[slot - 1].t_entry < child.t_entry) {
+                stack[slot] = stack[slot - 1];
+                --slot;
+            }
+            stack[slot] = child;
+        }
+    }
 
-        const auto comparator = (axis == 0)   ? box_x_compare
-                                : (axis == 1) ? box_y_compare
-                                              : box_z_compare;
+    return hit_anything;
+}
 
-        const size_t object_span = end - start;
+} // namespace rt
 
-        if (object_span == 1) {
-            m_left = m_right = objects[start];
-        } else if (object_span == 2) {
-            m_left = objects[start];
-            m_right = objects[start + 1];
-        } else {
-            std::sort(std::begin(objects) + start, std::begin(objects) + end, comparator);
+struct BVH {
+    explicit BVH(const HittableList& list, const rt::BvhBuildOptions& options = {})
+        : BVH(list.m_objects, options) {}
 
-            const size_t mid = start + object_span / 2;
-            m_left = pro::make_proxy_shared<Hittable, BVHNode>(objects, start, mid);
-            m_right = pro::make_proxy_shared<Hittable, BVHNode>(objects, mid, end);
+    explicit BVH(std::vector<pro::proxy<Hittable>> objects,
+        const rt::BvhBuildOptions& options = {})
+        : m_objects(std::move(objects)) {
+        std::vector<AABB> bounds;
+        bounds.reserve(m_objects.size());
+        for (const auto& object : m_objects) {
+            bounds.push_back(object->bounding_box());
         }
-    }
+        const rt::FlatBvh binary = rt::build_binned_sah_bvh(bounds, options);
 
-    bool hit(const Ray& ray, const Interval& ray_t, HitRecord& hit_rec) const {
-        if (!m_bbox.hit(ray, ray_t)) {
-            return false;
+        // Reorder the objects once so leaves address a contiguous run without an indirection.
+        std::vector<pro::proxy<Hittable>> ordered;
+        ordered.reserve(m_objects.size());
+        for (const int index : binary.primitive_indices) {
+            ordered.push_back(m_objects[static_cast<std::size_t>(index)]);
         }
+        m_objects = std::move(ordered);
+        m_bbox = binary.empty() ? AABB::empty : binary.nodes.front().bbox;
+        m_bvh = rt::collapse_bvh(binary, options);
+    }
 
-        const bool hit_left = m_left->hit(ray, ray_t, hit_rec);
-        const bool hit_right =
-            m_right->hit(ray, Interval {ray_t.min, hit_left ? hit_rec.t : ray_t.max}, hit_rec);
-
-        return hit_left || hit_right;
+    bool hit(const Ray& ray, const Interval& ray_t, HitRecord& hit_rec) const {
+        HitRecord temp_hit_rec;
+        return rt::traverse_wide_bvh(m_bvh, ray, ray_t,
+            [&](const int first, const int count, double& closest_so_far) {
+                bool hit_anything = false;
+                for (int i = first, end = first + count; i < end; ++i) {
+                    if (m_objects[static_cast<std::size_t>(i)]->hit(ray,
+                            Interval {ray_t.min, closest_so_far}, temp_hit_rec)) {
+                        hit_anything = true;
+                        closest_so_far = temp_hit_rec.t;
+                        hit_rec = temp_hit_rec;
+                    }
+                }
+                return hit_anything;
+            });
     }
 
     AABB bounding_box() const { return m_bbox; }
 
-    double pdf_value(const Vec3d& origin, const Vec3d& direction) const { return 0.0; }
-
-    Vec3d random(const Vec3d& origin) const { return {1.0, 0.0, 0.0}; }
-
-
-    pro::proxy<Hittable> m_left;
-    pro::proxy<Hittable> m_right;
-    AABB m_bbox;
+    double pdf_value(const Vec3d& origin, const Vec3d& direction) const {
+        // Matches HittableList: every object is chosen with equal probability
+        const double weight = 1.0 / (double)m_objects.size();
+        double sum = 0.0;
 
+        for (const auto& object : m_objects) {
+            sum += weight * object->pdf_value(origin, direction);
+        }
 
-    static bool box_compare(const pro::proxy<Hittable>& a, const pro::proxy<Hittable>& b,
-        const int axis_index) {
-        return a->bounding_box().axis_interval(axis_index).min
-               < b->bounding_box().axis_interval(axis_index).min;
+        return sum;
     }
 
-    static bool box_x_compare(const pro::proxy<Hittable>& a, const pro::proxy<Hittable>& b) {
-        return box_compare(a, b, 0);
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        const int num_objects = (int)m_objects.size();
+        return m_objects[sampler.next_int(0, num_objects - 1)]->random(origin, sampler);
     }
 
-    static bool box_y_compare(const pro::proxy<Hittable>& a, const pro::proxy<Hittable>& b) {
-        return box_compare(a, b, 1);
-    }
+    std::size_t node_count() const { return m_bvh.node_count(); }
+    rt::BvhTraversalKernel traversal_kernel() const { return m_bvh.kernel; }
 
-    static bool box_z_compare(const pro::proxy<Hittable>& a, const pro::proxy<Hittable>& b) {
-        return box_compare(a, b, 2);
-    }
+private:
+    std::vector<pro::proxy<Hittable>> m_objects;
+    rt::WideBvh m_bvh;
+    AABB m_bbox;
 };
@@ -0,0 +1,444 @@
+#include "common/bvh_builder.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+namespace {
+
+// Past this depth splits fall back to object medians so the traversal stack stays bounded.
+constexpr int kMaxSahDepth = 64;
+constexpr int kMaxBinCount = 64;
+
+struct PrimitiveRef {
+    AABB bbox;
+    Vec3d centroid;
+    int index = -1;
+};
+
+struct BuildNode {
+    AABB bbox;
+    int axis = 0;
+    int begin = 0;
+    int end = 0;
+    std::unique_ptr<BuildNode> left;
+    std::unique_ptr<BuildNode> right;
+};
+
+struct Bin {
+    AABB bbox;
+    int count = 0;
+};
+
+struct RangeBounds {
+    AABB bbox;
+    AABB centroid_bbox;
+};
+
+struct BinGrid {
+    std::array<std::array<Bin, kMaxBinCount>, 3> bins {};
+};
+
+struct SplitChoice {
+    int axis = -1;
+    int bin = -1;
+    double cost = infinity;
+};
+
+AABB point_bounds(const Vec3d& p) {
+    // Assign the intervals directly: the interval constructor would pad the degenerate box.
+    AABB bbox;
+    bbox.x = Interval {p.x(), p.x()};
+    bbox.y = Interval {p.y(), p.y()};
+    bbox.z = Interval {p.z(), p.z()};
+    return bbox;
+}
+
+AABB merge(const AABB& a, const AABB& b) {
+    return AABB {a, b};
+}
+
+RangeBounds compute_range_bounds(const std::vector<PrimitiveRef>& refs, int begin, int end,
+    int parallel_threshold) {
+    const auto accumulate = [&refs](const tbb::blocked_range<int>& range, RangeBounds bounds) {
+        for (int i = range.begin(); i < range.end(); ++i) {
+            bounds.bbox = merge(bounds.bbox, refs[i].bbox);
+            bounds.centroid_bbox = merge(bounds.centroid_bbox, point_bounds(refs[i].centroid));
+        }
+        return bounds;
+    };
+    if (end - begin < parallel_threshold) {
+        return accumulate(tbb::blocked_range<int>(begin, end), RangeBounds {});
+    }
+    return tbb::parallel_reduce(tbb::blocked_range<int>(begin, end), RangeBounds {}, accumulate,
+        [](const RangeBounds& a, const RangeBounds& b) {
+            return RangeBounds {merge(a.bbox, b.bbox), merge(a.centroid_bbox, b.centroid_bbox)};
+        });
+}
+
+int bin_index(const PrimitiveRef& ref, const AABB& centroid_bbox, int axis, int bin_count) {
+    const Interval& extent = centroid_bbox.axis_interval(axis);
+    const double relative = (ref.centroid[axis] - extent.min) / extent.size();
+    return std::clamp(static_cast<int>(relative * bin_count), 0, bin_count - 1);
+}
+
+BinGrid compute_bins(const std::vector<PrimitiveRef>& refs, int begin, int end,
+    const AABB& centroid_bbox, int bin_count, int parallel_threshold) {
+    const auto accumulate = [&](const tbb::blocked_range<int>& range, BinGrid grid) {
+        for (int i = range.begin(); i < range.end(); ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (centroid_bbox.axis_interval(axis).size() <= 0.0) {
+                    continue;
+                }
+                Bin& bin = grid.bins[axis][bin_index(refs[i], centroid_bbox, axis, bin_count)];
+                bin.bbox = merge(bin.bbox, refs[i].bbox);
+                bin.count += 1;
+            }
+        }
+        return grid;
+    };
+    if (end - begin < parallel_threshold) {
+        return accumulate(tbb::blocked_range<int>(begin, end), BinGrid {});
+    }
+    return tbb::parallel_reduce(tbb::blocked_range<int>(begin, end), BinGrid {}, accumulate,
+        [bin_count](BinGrid a, const BinGrid& b) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int i = 0; i < bin_count; ++i) {
+                    a.bins[axis][i].bbox = merge(a.bins[axis][i].bbox, b.bins[axis][i].bbox);
+                    a.bins[axis][i].count += b.bins[axis][i].count;
+                }
+            }
+            return a;
+        });
+}
+
+SplitChoice find_best_split(const BinGrid& grid, const AABB& centroid_bbox, int bin_count,
+    double parent_area, const BvhBuildOptions& options) {
+    SplitChoice best;
+    if (parent_area <= 0.0) {
+        return best;
+    }
+    std::array<double, kMaxBinCount> right_area {};
+    std::array<int, kMaxBinCount> right_count {};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (centroid_bbox.axis_interval(axis).size() <= 0.0) {
+            continue;
+        }
+        const auto& bins = grid.bins[axis];
+
+        // Sweep right-to-left to record the area/count of every suffix, then left-to-right to
+        // evaluate each of the bin_count - 1 candidate planes.
+        AABB accumulated;
+        int count = 0;
+        for (int i = bin_count - 1; i > 0; --i) {
+            accumulated = merge(accumulated, bins[i].bbox);
+            count += bins[i].count;
+            right_area[i] = accumulated.surface_area();
+            right_count[i] = count;
+        }
+
+        accumulated = AABB {};
+        count = 0;
+        for (int i = 0; i < bin_count - 1; ++i) {
+            accumulated = merge(accumulated, bins[i].bbox);
+            count += bins[i].count;
+            if (count == 0 || right_count[i + 1] == 0) {
+                continue;
+            }
+            const double cost = options.traversal_cost
+                                + options.intersection_cost
+                                      * (accumulated.surface_area() * count
+                                          + right_area[i + 1] * right_count[i + 1])
+                                      / parent_area;
+            if (cost < best.cost) {
+                best = SplitChoice {.axis = axis, .bin = i, .cost = cost};
+            }
+        }
+    }
+    return best;
+}
+
+class BinnedSahBuilder {
+public:
+    BinnedSahBuilder(std::vector<PrimitiveRef>& refs, const BvhBuildOptions& options)
+        : refs_(refs),
+          options_(options),
+          bin_count_(std::clamp(options.bin_count, 2, kMaxBinCount)),
+          max_leaf_size_(std::max(1, options.max_leaf_size)),
+          parallel_threshold_(std::max(2, options.parallel_threshold)) {}
+
+    std::unique_ptr<BuildNode> build(int begin, int end, int depth) {
+        auto node = std::make_unique<BuildNode>();
+        node->begin = begin;
+        node->end = end;
+
+        const RangeBounds bounds = compute_range_bounds(refs_, begin, end, parallel_threshold_);
+        node->bbox = bounds.bbox;
+        node->axis = bounds.centroid_bbox.longest_axis();
+
+        const int count = end - begin;
+        if (count <= 1) {
+            return node;
+        }
+
+        int mid = begin;
+        if (depth < kMaxSahDepth) {
+            const BinGrid grid = compute_bins(refs_, begin, end, bounds.centroid_bbox, bin_count_,
+                parallel_threshold_);
+            const SplitChoice split = find_best_split(grid, bounds.centroid_bbox, bin_count_,
+                bounds.bbox.surface_area(), options_);
+            const double leaf_cost = options_.intersection_cost * count;
+            if (count <= max_leaf_size_ && (split.axis < 0 || leaf_cost <= split.cost)) {
+                return node;
+            }
+            if (split.axis >= 0) {
+                node->axis = split.axis;
+                const auto partition_point = std::partition(refs_.begin() + begin,
+                    refs_.begin() + end, [&](const PrimitiveRef& ref) {
+                        return bin_index(ref, bounds.centroid_bbox, split.axis, bin_count_)
+                               <= split.bin;
+                    });
+                mid = static_cast<int>(partition_point - refs_.begin());
+            }
+        } else if (count <= max_leaf_size_) {
+            return node;
+        }
+
+        if (mid <= begin || mid >= end) {
+            // Coincident centroids or an exhausted depth budget: split by object median so that
+            // oversized leaves are never produced.
+            mid = begin + count / 2;
+            const int axis = node->axis;
+            std::nth_element(refs_.begin() + begin, refs_.begin() + mid, refs_.begin() + end,
+                [axis](const PrimitiveRef& a, const PrimitiveRef& b) {
+                    return a.centroid[axis] < b.centroid[axis];
+                });
+        }
+
+        if (count >= parallel_threshold_) {
+            tbb::parallel_invoke([&] { node->left = build(begin, mid, depth + 1); },
+                [&] { node->right = build(mid, end, depth + 1); });
+        } else {
+            node->left = build(begin, mid, depth + 1);
+            node->right = build(mid, end, depth + 1);
+        }
+        return node;
+    }
+
+private:
+    std::vector<PrimitiveRef>& refs_;
+    BvhBuildOptions options_;
+    int bin_count_;
+    int max_leaf_size_;
+    int parallel_threshold_;
+};
+
+constexpr int kMortonBitsPerAxis = 10;
+
+// Spreads the low 10 bits of v so that two zero bits separate each of them.
+std::uint32_t spread_morton_bits(std::uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Interleaves x into the highest bit of each triple, then y, then z.
+std::uint32_t morton_code(const Vec3d& centroid, const AABB& centroid_bbox) {
+    std::array<std::uint32_t, 3> quantized {};
+    constexpr double kScale = static_cast<double>(1 << kMortonBitsPerAxis);
+    for (int axis = 0; axis < 3; ++axis) {
+        const Interval& extent = centroid_bbox.axis_interval(axis);
+        const double relative =
+            extent.size() > 0.0 ? (centroid[axis] - extent.min) / extent.size() : 0.0;
+        quantized[axis] = static_cast<std::uint32_t>(
+            std::clamp(relative * kScale, 0.0, kScale - 1.0));
+    }
+    return (spread_morton_bits(quantized[0]) << 2) | (spread_morton_bits(quantized[1]) << 1)
+           | spread_morton_bits(quantized[2]);
+}
+
+struct MortonRef {
+    std::uint32_t code = 0;
+    int ref = 0;
+};
+
+class LinearBvhBuilder {
+public:
+    LinearBvhBuilder(std::vector<PrimitiveRef>& refs, const std::vector<MortonRef>& sorted,
+        const BvhBuildOptions& options)
+        : refs_(refs),
+          sorted_(sorted),
+          max_leaf_size_(std::max(1, options.max_leaf_size)),
+          parallel_threshold_(std::max(2, options.parallel_threshold)) {}
+
+    std::unique_ptr<BuildNode> build(int begin, int end) {
+        auto node = std::make_unique<BuildNode>();
+        node->begin = begin;
+        node->end = end;
+        const int count = end - begin;
+        if (count <= max_leaf_size_) {
+            for (int i = begin; i < end; ++i) {
+                node->bbox = merge(node->bbox, refs_[i].bbox);
+            }
+            node->axis = node->bbox.longest_axis();
+            return node;
+        }
+
+        // The sorted range shares every code bit above the highest one where its ends differ; the
+        // first code with that bit set splits it. Identical codes split at the object median.
+        const std::uint32_t first_code = sorted_[begin].code;
+        const std::uint32_t last_code = sorted_[end - 1].code;
+        int mid = begin + count / 2;
+        node->axis = 0;
+        if (first_code != last_code) {
+            const int bit = 31 - std::countl_zero(first_code ^ last_code);
+            const std::uint32_t mask = 1u << bit;
+            const auto split = std::partition_point(sorted_.begin() + begin, sorted_.begin() + end,
+                [mask](const MortonRef& ref) { return (ref.code & mask) == 0; });
+            mid = static_cast<int>(split - sorted_.begin());
+            node->axis = 2 - bit % 3;
+        }
+
+        if (count >= parallel_threshold_) {
+            tbb::parallel_invoke([&] { node->left = build(begin, mid); },
+                [&] { node->right = build(mid, end); });
+        } else {
+            node->left = build(begin, mid);
+            node->right = build(mid, end);
+        }
+        node->bbox = merge(node->left->bbox, node->right->bbox);
+        return node;
+    }
+
+private:
+    std::vector<PrimitiveRef>& refs_;
+    const std::vector<MortonRef>& sorted_;
+    int max_leaf_size_;
+    int parallel_threshold_;
+};
+
+std::vector<PrimitiveRef> make_primitive_refs(const std::vector<AABB>& primitive_bounds) {
+    std::vector<PrimitiveRef> refs(primitive_bounds.size());
+    for (std::size_t i = 0; i < primitive_bounds.size(); ++i) {
+        refs[i] = PrimitiveRef {
+            .bbox = primitive_bounds[i],
+            .centroid = primitive_bounds[i].centroid(),
+            .index = static_cast<int>(i),
+        };
+    }
+    return refs;
+}
+
+int flatten(const BuildNode& node, const std::vector<PrimitiveRef>& refs, FlatBvh& bvh) {
+    const int node_index = static_cast<int>(bvh.nodes.size());
+    bvh.nodes.push_back(BvhFlatNode {.bbox = node.bbox, .axis = node.axis});
+    if (!node.left) {
+        bvh.nodes[node_index].first = static_cast<int>(bvh.primitive_indices.size());
+        bvh.nodes[node_index].count = node.end - node.begin;
+        for (int i = node.begin; i < node.end; ++i) {
+            bvh.primitive_indices.push_back(refs[i].index);
+        }
+        return node_index;
+    }
+    flatten(*node.left, refs, bvh);
+    bvh.nodes[node_index].first = flatten(*node.right, refs, bvh);
+    return node_index;
+}
+
+} // namespace
+
+FlatBvh build_binned_sah_bvh(const std::vector<AABB>& primitive_bounds,
+    const BvhBuildOptions& options) {
+    if (options.max_leaf_size <= 0) {
+        throw std::invalid_argument("BVH max_leaf_size must be positive");
+    }
+    FlatBvh bvh;
+    if (primitive_bounds.empty()) {
+        return bvh;
+    }
+
+    std::vector<PrimitiveRef> refs = make_primitive_refs(primitive_bounds);
+    BinnedSahBuilder builder {refs, options};
+    const std::unique_ptr<BuildNode> root = builder.build(0, static_cast<int>(refs.size()), 0);
+
+    bvh.nodes.reserve(2 * refs.size());
+    bvh.primitive_indices.reserve(refs.size());
+    flatten(*root, refs, bvh);
+    return bvh;
+}
+
+FlatBvh build_lbvh(const std::vector<AABB>& primitive_bounds, const BvhBuildOptions& options) {
+    if (options.max_leaf_size <= 0) {
+        throw std::invalid_argument("BVH max_leaf_size must be positive");
+    }
+    FlatBvh bvh;
+    if (primitive_bounds.empty()) {
+        return bvh;
+    }
+
+    std::vector<PrimitiveRef> unsorted = make_primitive_refs(primitive_bounds);
+    const int count = static_cast<int>(unsorted.size());
+    const int parallel_threshold = std::max(2, options.parallel_threshold);
+    const AABB centroid_bbox =
+        compute_range_bounds(unsorted, 0, count, parallel_threshold).centroid_bbox;
+
+    std::vector<MortonRef> sorted(unsorted.size());
+    tbb::parallel_for(tbb::blocked_range<int>(0, count),
+        [&](const tbb::blocked_range<int>& range) {
+            for (int i = range.begin(); i < range.end(); ++i) {
+                sorted[i] = MortonRef {
+                    .code = morton_code(unsorted[i].centroid, centroid_bbox),
+                    .ref = i,
+                };
+            }
+        });
+    // Ties break on the primitive index so the order never depends on the sort's scheduling.
+    tbb::parallel_sort(sorted.begin(), sorted.end(), [](const MortonRef& a, const MortonRef& b) {
+        return a.code != b.code ? a.code < b.code : a.ref < b.ref;
+    });
+
+    std::vector<PrimitiveRef> refs(unsorted.size());
+    for (int i = 0; i < count; ++i) {
+        refs[i] = unsorted[sorted[i].ref];
+    }
+
+    LinearBvhBuilder builder {refs, sorted, options};
+    const std::unique_ptr<BuildNode> root = builder.build(0, count);
+
+    bvh.nodes.reserve(2 * refs.size());
+    bvh.primitive_indices.reserve(refs.size());
+    flatten(*root, refs, bvh);
+    return bvh;
+}
+
+double bvh_sah_cost(const FlatBvh& bvh, const BvhBuildOptions& options) {
+    if (bvh.empty()) {
+        return 0.0;
+    }
+    const double root_area = bvh.nodes.front().bbox.surface_area();
+    if (root_area <= 0.0) {
+        return 0.0;
+    }
+    double cost = 0.0;
+    for (const BvhFlatNode& node : bvh.nodes) {
+        const double area_ratio = node.bbox.surface_area() / root_area;
+        cost += node.is_leaf() ? area_ratio * options.intersection_cost * node.count
+                               : area_ratio * options.traversal_cost;
+    }
+    return cost;
+}
+
+} // namespace rt
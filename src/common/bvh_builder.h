@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common/aabb.h"
+
+#include <vector>
+
+namespace rt {
+
+// Box-test kernels for wide BVH traversal, ordered from the most portable to the widest.
+enum class BvhTraversalKernel {
+    automatic, // Widest kernel the running CPU supports
+    scalar,
+    sse,
+    avx2,
+};
+
+struct BvhBuildOptions {
+    int max_leaf_size = 4;           // Leaves never hold more primitives than this
+    int bin_count = 16;              // Centroid bins evaluated per axis for each split
+    int parallel_threshold = 4096;   // Ranges at least this large are split on TBB tasks
+    double traversal_cost = 1.0;     // Relative cost of visiting an interior node
+    double intersection_cost = 1.0;  // Relative cost of one primitive intersection
+    int width = 8;                   // Children per node once collapsed for traversal (4 or 8)
+    BvhTraversalKernel kernel = BvhTraversalKernel::automatic; // Unsupported kernels fall back
+};
+
+// Nodes are stored depth-first: an interior node's left child immediately follows it and `first`
+// holds the index of the right child. Leaves reference `count` consecutive entries of
+// `primitive_indices` starting at `first`.
+struct BvhFlatNode {
+    AABB bbox;
+    int first = 0;
+    int count = 0;
+    int axis = 0;
+
+    bool is_leaf() const { return count > 0; }
+};
+
+struct FlatBvh {
+    std::vector<BvhFlatNode> nodes;
+    std::vector<int> primitive_indices;
+
+    bool empty() const { return nodes.empty(); }
+};
+
+// Builds a binned-SAH hierarchy over the given primitive bounds. Large ranges are binned and
+// recursed in parallel with TBB; the resulting layout is independent of the thread count.
+FlatBvh build_binned_sah_bvh(const std::vector<AABB>& primitive_bounds,
+    const BvhBuildOptions& options = {});
+
+// Builds a linear BVH: primitives are sorted by the 30-bit Morton code of their centroid and split
+// at the highest differing code bit. Much faster to build than binned SAH at some cost in traversal
+// quality; the node layout is the same, so either result can be collapsed or refitted alike.
+FlatBvh build_lbvh(const std::vector<AABB>& primitive_bounds,
+    const BvhBuildOptions& options = {});
+
+// Expected cost of a ray traversal under the surface area heuristic, normalized by root area.
+double bvh_sah_cost(const FlatBvh& bvh, const BvhBuildOptions& options = {});
+
+} // namespace rt
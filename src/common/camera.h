@@ -7,6 +7,10 @@
 #include "pdf.h"
 #include "material.h"
 #include "realtime/camera_models.h"
+#include "realtime/render_profile.h"
+#include "render_accumulation.h"
+#include "restir_di.h"
+#include "russian_roulette.h"
 
 #include <Eigen/Core>
 #include <fmt/core.h>
@@ -15,9 +19,21 @@
 #include <opencv2/opencv.hpp>
 #include <indicators/block_progress_bar.hpp>
 #include <indicators/cursor_control.hpp>
-#include <optional>
 #include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 class Camera {
 public:
@@ -31,6 +47,67 @@ public:
         rt::Equi62Lut1DParams equi {};
     };
 
+    // Both integrators evaluate the same estimator from the same per-path sample streams. The
+    // wavefront one advances each tile's paths together one bounce at a time, shades hits grouped
+    // by material kind and traces the analytic-light shadow rays of a bounce as one batch.
+    enum class Integrator {
+        recursive,
+        wavefront,
+    };
+
+    // Adaptive sampling stops a pixel once the standard error of its luminance mean falls below
+    // `relative_error` of the mean. The samples a uniform render takes, the stratified grid
+    // samples_per_pixel rounds down to, are then the average budget over the image, and the
+    // samples converged pixels leave unused go to the noisy ones, up to `max_samples_per_pixel`
+    // each.
+    struct AdaptiveSampling {
+        static constexpr int kDefaultMaxSampleFactor = 4;
+
+        bool enabled = false;
+        double relative_error = 0.02;
+        int min_samples = 16;          // Samples every pixel takes before its error is trusted
+        int samples_per_pass = 16;     // Samples an unconverged pixel takes per pass
+        int max_samples_per_pixel = 0; // 0 caps pixels at kDefaultMaxSampleFactor times the spp
+    };
+
+    struct ProgressiveOptions {
+        int samples_per_pass = 16;
+        std::string label; // Recorded in an accumulation this render starts
+        std::optional<std::chrono::steady_clock::time_point> deadline; // Stop starting new tiles
+        std::function<void(const rt::RenderAccumulation&)> on_pass;    // Called after each pass
+    };
+
+    // Reservoir resampling of the analytic-light term at primary hits (ReSTIR DI), with the
+    // RenderProfile knobs. Pixels then take their samples in lockstep rounds: each round draws
+    // `initial_candidates` light samples per pixel and merges the reservoirs the previous round
+    // left at the same pixel and at its neighbours whose surfaces agree. Applies when the scene
+    // has at least `min_analytic_lights` analytic lights.
+    struct RestirDi {
+        bool enabled = false;
+        int initial_candidates = 4;
+        bool temporal_reuse = true;
+        int max_history_age = 20;
+        int max_temporal_candidates = 64;
+        int spatial_neighbors = 1; // Up to 8, taken from the ring around the pixel
+        int max_spatial_candidates = 4;
+        rt::RestirBiasCorrectionMode bias_correction = rt::RestirBiasCorrectionMode::basic;
+        int min_analytic_lights = 16;
+
+        static RestirDi from_profile(const rt::RenderProfile& profile) {
+            return RestirDi {
+                .enabled = profile.enable_restir_di,
+                .initial_candidates = profile.restir_initial_candidates,
+                .temporal_reuse = profile.restir_temporal_reuse,
+                .max_history_age = profile.restir_max_history_age,
+                .max_temporal_candidates = profile.restir_max_temporal_candidates,
+                .spatial_neighbors = profile.restir_spatial_neighbors,
+                .max_spatial_candidates = profile.restir_max_spatial_candidates,
+                .bias_correction = profile.restir_bias_correction,
+                .min_analytic_lights = profile.restir_min_analytic_lights,
+            };
+        }
+    };
+
     double aspect_ratio = 1.0;  // Ratio of image width over height
     int image_width = 100;      // Rendered image width in pixel count
     int samples_per_pixel = 10; // Count of random samples for each pixel
@@ -45,8 +122,19 @@ public:
     double defocus_angle = 0.0; // Variation angle of rays through each pixel
     double focus_dist = 10.0;   // Distance from camera lookfrom point to plane of perfect focus
 
+    std::uint64_t seed = 0; // Key of the counter-based per-pixel sample streams
+    Integrator integrator = Integrator::recursive; // Path integration strategy
+    AdaptiveSampling adaptive;                     // Variance-driven per-pixel sample counts
+    RestirDi restir;                               // Resampled direct light at primary hits
+    // First bounce whose continuation may end by Russian roulette; negative disables roulette
+    int rr_start_bounce = rt::kDefaultRussianRouletteStartBounce;
+
     cv::Mat img; // Rendered image as cv::Mat
 
+    // Progressive state: linear radiance sums and per-pixel sample counts. After an adaptive
+    // render its sample counts are the sample-count AOV.
+    rt::RenderAccumulation accumulation;
+
     std::atomic_int rendered_pixel_count;
     int total_pixel_count;
 
@@ -57,13 +145,26 @@ public:
 
     void clear_shared_camera_ray_config() { shared_camera_ray_config_.reset(); }
 
-    Ray debug_primary_ray(const Eigen::Vector2d& pixel, const bool apply_defocus = true) {
+    Ray debug_primary_ray(const Eigen::Vector2d& pixel, const bool apply_defocus = true,
+        const int sample_index = 0) {
         initialize();
-        return make_primary_ray(pixel, apply_defocus, 0.0);
+        rt::PathSampler sampler {
+            pixel_index(static_cast<int>(pixel.x()), static_cast<int>(pixel.y())),
+            static_cast<std::uint32_t>(sample_index), seed};
+        return make_primary_ray(pixel, apply_defocus, 0.0, sampler);
     }
 
     void render(const pro::proxy<Hittable>& world, const pro::proxy<Hittable>& lights = {},
         const std::vector<rt::AnalyticLightDesc>& analytic_lights = {}) {
+        if (adaptive.enabled) {
+            // Adaptive renders run as progressive passes over a fresh accumulation
+            accumulation = {};
+            ProgressiveOptions options;
+            options.samples_per_pass = adaptive.samples_per_pass;
+            render_progressive(world, lights, analytic_lights, options);
+            return;
+        }
+
         initialize();
 
         const std::optional<rt::CpuAnalyticLightSampler> analytic_sampler =
@@ -83,50 +184,192 @@ public:
             option::BarWidth {40}                                          //
         };
 
-        tbb::parallel_for(tbb::blocked_range2d<int>(0, image_height, 0, image_width),
-            [&, this](const tbb::blocked_range2d<int>& range) {
-                for (int y = range.rows().begin(), y_end = range.rows().end(); y < y_end; ++y) {
-                    for (int x = range.cols().begin(), x_end = range.cols().end(); x < x_end; ++x) {
-                        Vec3d pixel_color = {0.0, 0.0, 0.0};
-                        for (int s_y = 0; s_y < sqrt_spp; ++s_y) {
-                            for (int s_x = 0; s_x < sqrt_spp; ++s_x) {
-                                Ray ray = get_ray(x, y, s_x, s_y);
-                                pixel_color += ray_color(ray, max_depth, world, lights,
-                                    analytic_sampler ? &*analytic_sampler : nullptr, {});
-                            }
-                        }
-                        pixel_color *= pixel_samples_scale;
-
-                        // Apply a linear to gamma transform for gamma 2
-                        pixel_color.x() = linear_to_gamma(pixel_color.x());
-                        pixel_color.y() = linear_to_gamma(pixel_color.y());
-                        pixel_color.z() = linear_to_gamma(pixel_color.z());
+        const rt::CpuAnalyticLightSampler* analytic_lights_ptr =
+            analytic_sampler ? &*analytic_sampler : nullptr;
+        const auto report_progress = [&, this](const tbb::blocked_range2d<int>& range) {
+            // One atomic update per block keeps workers off a shared cache line per pixel
+            const int block_pixel_count =
+                static_cast<int>(range.rows().size() * range.cols().size());
+            const int rendered_pixel_count_val =
+                rendered_pixel_count.fetch_add(block_pixel_count) + block_pixel_count;
+            bar.set_option(option::PostfixText {
+                fmt::format("{}/{}", rendered_pixel_count_val, total_pixel_count)});
+            bar.set_progress(rendered_pixel_count_val);
+        };
 
-                        // Translate the [0,1] component values to the byte range [0,255]
-                        static const Interval intensity(0.000, 0.999);
-                        const int rbyte = int(256 * intensity.clamp(pixel_color.x()));
-                        const int gbyte = int(256 * intensity.clamp(pixel_color.y()));
-                        const int bbyte = int(256 * intensity.clamp(pixel_color.z()));
+        const int grid_samples = sqrt_spp * sqrt_spp;
+        const auto all_samples = [grid_samples](int, int) {
+            return PixelSampleRange {0, grid_samples};
+        };
+        const auto write_mean = [this](const int x, const int y, const PixelEstimate& estimate,
+                                    const PixelSampleRange&) {
+            write_pixel(x, y, estimate.radiance_sum * pixel_samples_scale);
+        };
 
-                        img.at<cv::Vec3b>(y, x) = cv::Vec3b(bbyte, gbyte, rbyte);
-                        rendered_pixel_count += 1;
+        if (begin_restir(analytic_lights_ptr)) {
+            // One sample per pixel and round; the means are written once every round is summed
+            std::vector<Vec3d> radiance_sums(static_cast<std::size_t>(total_pixel_count),
+                Vec3d::Zero());
+            const auto add_sample = [&, this](const int x, const int y,
+                                        const PixelEstimate& estimate, const PixelSampleRange&) {
+                radiance_sums[pixel_index(x, y)] += estimate.radiance_sum;
+            };
+            for (int round = 0; round < grid_samples; ++round) {
+                const auto round_sample = [round](int, int) {
+                    return PixelSampleRange {round, round + 1};
+                };
+                render_restir_round([&, this](const tbb::blocked_range2d<int>& range) {
+                    render_tile(
+                        range, round_sample, add_sample, world, lights, analytic_lights_ptr);
+                    if (round + 1 == grid_samples) {
+                        report_progress(range);
                     }
+                });
+            }
+            for (int y = 0; y < image_height; ++y) {
+                for (int x = 0; x < image_width; ++x) {
+                    write_pixel(x, y, radiance_sums[pixel_index(x, y)] * pixel_samples_scale);
                 }
-                const int rendered_pixel_count_val = rendered_pixel_count.load();
-                bar.set_option(option::PostfixText {
-                    fmt::format("{}/{}", rendered_pixel_count_val, total_pixel_count)});
-                bar.set_progress(rendered_pixel_count_val);
-            });
+            }
+        } else if (integrator == Integrator::wavefront) {
+            // Fixed tiles bound the number of paths in flight per worker
+            tbb::parallel_for(
+                tbb::blocked_range2d<int>(0, image_height, kWavefrontTileSize, 0, image_width,
+                    kWavefrontTileSize),
+                [&, this](const tbb::blocked_range2d<int>& range) {
+                    render_wavefront_tile(
+                        range, all_samples, write_mean, world, lights, analytic_lights_ptr);
+                    report_progress(range);
+                },
+                tbb::simple_partitioner {});
+        } else {
+            tbb::parallel_for(tbb::blocked_range2d<int>(0, image_height, 0, image_width),
+                [&, this](const tbb::blocked_range2d<int>& range) {
+                    render_recursive_range(
+                        range, all_samples, write_mean, world, lights, analytic_lights_ptr);
+                    report_progress(range);
+                });
+        }
 
         bar.mark_as_completed();
         show_console_cursor(true);
     }
 
+    // Adds up to `samples_per_pass` samples to every pixel per pass until each pixel holds the
+    // full stratified grid, or with adaptive sampling until every pixel has converged or the
+    // budget is spent. Passes continue from `accumulation`, which may come from a checkpoint of an
+    // earlier run; once the deadline passes, tiles not yet started are left for a later pass.
+    // `img` shows the running mean after every pass. Returns whether the render completed.
+    bool render_progressive(const pro::proxy<Hittable>& world, const pro::proxy<Hittable>& lights,
+        const std::vector<rt::AnalyticLightDesc>& analytic_lights,
+        const ProgressiveOptions& options) {
+        initialize();
+        if (options.samples_per_pass <= 0) {
+            throw std::invalid_argument("progressive render needs a positive samples per pass");
+        }
+
+        const int grid_samples = sqrt_spp * sqrt_spp;
+        if (accumulation.empty()) {
+            accumulation =
+                rt::make_render_accumulation(image_width, image_height, grid_samples, seed);
+            accumulation.label = options.label;
+        } else if (accumulation.width() != image_width || accumulation.height() != image_height
+                   || accumulation.target_samples_per_pixel != grid_samples
+                   || accumulation.seed != seed) {
+            throw std::invalid_argument("render accumulation does not match the camera settings");
+        }
+
+        const std::optional<rt::CpuAnalyticLightSampler> analytic_sampler =
+            analytic_lights.empty() ? std::nullopt
+                                    : std::optional<rt::CpuAnalyticLightSampler> {analytic_lights};
+        const rt::CpuAnalyticLightSampler* analytic_lights_ptr =
+            analytic_sampler ? &*analytic_sampler : nullptr;
+        const bool restir_enabled = begin_restir(analytic_lights_ptr);
+
+        const auto deadline_passed = [&options] {
+            return options.deadline.has_value()
+                   && std::chrono::steady_clock::now() >= *options.deadline;
+        };
+        std::vector<int> pass_allowance;
+        const auto pass_samples = [&, this](const int x, const int y) {
+            const int first = accumulation.sample_count.at<std::int32_t>(y, x);
+            return PixelSampleRange {first,
+                first + pass_allowance[static_cast<std::size_t>(pixel_index(x, y))]};
+        };
+        const auto accumulate = [this](const int x, const int y, const PixelEstimate& estimate,
+                                    const PixelSampleRange& samples) {
+            const Vec3d& sum = estimate.radiance_sum;
+            accumulation.radiance_sum.at<cv::Vec3f>(y, x) += cv::Vec3f(static_cast<float>(sum.x()),
+                static_cast<float>(sum.y()), static_cast<float>(sum.z()));
+            accumulation.luminance_square_sum.at<float>(y, x) +=
+                static_cast<float>(estimate.luminance_square_sum);
+            accumulation.sample_count.at<std::int32_t>(y, x) += samples.count();
+        };
+
+        bool completed = false;
+        while (true) {
+            if (plan_pass(options.samples_per_pass, pass_allowance) == 0) {
+                completed = true;
+                break;
+            }
+            if (deadline_passed()) {
+                break;
+            }
+
+            if (restir_enabled) {
+                // The pass runs as rounds of one sample per pixel that still has allowance left
+                const int rounds = *std::max_element(pass_allowance.begin(), pass_allowance.end());
+                for (int round = 0; round < rounds; ++round) {
+                    const auto round_sample = [&, this, round](const int x, const int y) {
+                        const int first = accumulation.sample_count.at<std::int32_t>(y, x);
+                        const bool takes_sample =
+                            round < pass_allowance[static_cast<std::size_t>(pixel_index(x, y))];
+                        return PixelSampleRange {first, takes_sample ? first + 1 : first};
+                    };
+                    render_restir_round([&, this](const tbb::blocked_range2d<int>& range) {
+                        if (!deadline_passed()) {
+                            render_tile(range, round_sample, accumulate, world, lights,
+                                analytic_lights_ptr);
+                        }
+                    });
+                }
+                resolve_accumulation();
+                if (options.on_pass) {
+                    options.on_pass(accumulation);
+                }
+                continue;
+            }
+
+            // Tiles are the unit a deadline can cut a pass at
+            tbb::parallel_for(
+                tbb::blocked_range2d<int>(0, image_height, kWavefrontTileSize, 0, image_width,
+                    kWavefrontTileSize),
+                [&, this](const tbb::blocked_range2d<int>& range) {
+                    if (deadline_passed()) {
+                        return;
+                    }
+                    render_tile(
+                        range, pass_samples, accumulate, world, lights, analytic_lights_ptr);
+                },
+                tbb::simple_partitioner {});
+
+            resolve_accumulation();
+            if (options.on_pass) {
+                options.on_pass(accumulation);
+            }
+        }
+
+        resolve_accumulation();
+        return completed;
+    }
+
 private:
     int image_height;               // Rendered image height
     double pixel_samples_scale;     // Color scale factor for a sum of pixel samples
     int sqrt_spp;                   // Square root of number of samples per pixel
+    int budget_samples_per_pixel;   // Average samples per pixel an adaptive render may spend
     double recip_sqrt_spp;          // 1 / sqrt_spp
+    int stratum_stride;             // Step through the strata between consecutive samples
     Vec3d center = {0.0, 0.0, 0.0}; // Camera center
     Vec3d u, v, w;                  // Camera frame basis vectors
     Vec3d pixel_delta_u;            // Offset to pixel to the right
@@ -135,6 +378,28 @@ private:
     Vec3d defocus_disk_u;           // Defocus disk horizontal radius
     Vec3d defocus_disk_v;           // Defocus disk vertical radius
     std::optional<SharedCameraRayConfig> shared_camera_ray_config_;
+    // Angle one pixel subtends; the spread of primary ray cones
+    double pixel_spread_angle = 0.0;
+
+    // Samples [first, last) of a pixel's stratified grid. Each sample draws from its own
+    // counter-based stream and covers the stratum sample_stratum() assigns it.
+    struct PixelSampleRange {
+        int first = 0;
+        int last = 0;
+
+        int count() const { return std::max(last - first, 0); }
+    };
+
+    struct PixelEstimate {
+        Vec3d radiance_sum = Vec3d::Zero();
+        double luminance_square_sum = 0.0;
+
+        void add(const Vec3d& radiance) {
+            radiance_sum += radiance;
+            const double luminance = rec709_luminance(radiance);
+            luminance_square_sum += luminance * luminance;
+        }
+    };
 
     struct PreviousAnalyticScatter {
         bool valid = false;
@@ -143,13 +408,76 @@ private:
         double bsdf_pdf = 0.0;
     };
 
+    struct AnalyticShadowRay {
+        Ray ray;
+        double max_t = 0.0;
+        Vec3d contribution = Vec3d::Zero(); // Light sample weighted by BSDF, MIS and pdf
+    };
+
+    struct WavefrontPath {
+        Ray ray;
+        Vec3d throughput = Vec3d::Ones();
+        PreviousAnalyticScatter previous_scatter;
+        rt::PathSampler sampler;
+        int sample = 0; // Slot of the path's camera sample in the tile radiance buffer
+        std::uint32_t pixel = 0; // Pixel of the camera sample, which owns its primary reservoir
+    };
+
+    struct WavefrontHit {
+        int path = 0;
+        MaterialKind kind = MaterialKind::empty;
+        Vec3d medium_weight = Vec3d::Ones();
+        HitRecord hit_rec;
+    };
+
+    struct WavefrontShadowRay {
+        int sample = 0;
+        AnalyticShadowRay shadow;
+    };
+
+    // A pixel's reservoir with the primary hit it was resampled at, so that later rounds can
+    // validate the surface and evaluate its sample there
+    struct RestirPixel {
+        rt::RestirReservoir reservoir;
+        Ray ray;
+        HitRecord hit_rec {}; // Without its shading cache
+        std::uint64_t round = 0;
+    };
+
+    static constexpr int kWavefrontTileSize = 16;
+    static constexpr int kRestirMaxCandidates = 32;
+    static constexpr int kRestirMaxSpatialNeighbors = 8;
+
+    bool restir_active_ = false;
+    std::uint64_t restir_round_ = 0;
+    std::vector<RestirPixel> restir_history_; // Reservoirs the previous round left
+    std::vector<RestirPixel> restir_current_; // Reservoirs of the round in flight
+
     void initialize() {
         image_height = std::max(int(image_width / aspect_ratio), 1);
 
-        sqrt_spp = int(std::sqrt(samples_per_pixel));
+        // Adaptive renders stratify over the per-pixel cap, which the noisiest pixels may reach,
+        // and spend on average what the uniform grid would take
+        const int uniform_sqrt_spp = int(std::sqrt(samples_per_pixel));
+        budget_samples_per_pixel = uniform_sqrt_spp * uniform_sqrt_spp;
+        const int max_samples = adaptive.max_samples_per_pixel > 0
+                                    ? adaptive.max_samples_per_pixel
+                                    : AdaptiveSampling::kDefaultMaxSampleFactor * samples_per_pixel;
+        const int grid_limit =
+            adaptive.enabled ? std::max(samples_per_pixel, max_samples) : samples_per_pixel;
+        sqrt_spp = int(std::sqrt(grid_limit));
         recip_sqrt_spp = 1.0 / sqrt_spp;
         pixel_samples_scale = recip_sqrt_spp * recip_sqrt_spp;
 
+        // A stride coprime to the grid size near its golden section visits every stratum once
+        // per grid while spreading the strata of any prefix of samples over the whole pixel, so a
+        // pixel stopped early by a deadline or by adaptive sampling is still evenly covered
+        const int grid_samples = sqrt_spp * sqrt_spp;
+        stratum_stride = std::max(1, static_cast<int>(grid_samples * 0.6180339887498949));
+        while (std::gcd(stratum_stride, grid_samples) != 1) {
+            ++stratum_stride;
+        }
+
         if (shared_camera_ray_config_.has_value()) {
             center = shared_camera_ray_config_->origin;
             u = shared_camera_ray_config_->camera_to_world.col(0);
@@ -158,6 +486,11 @@ private:
             pixel_delta_u = Vec3d::Zero();
             pixel_delta_v = Vec3d::Zero();
             pixel00_loc = center;
+            // Both models are within a few percent of 1 / fy near the principal point
+            const double fy = shared_camera_ray_config_->model == rt::CameraModelType::pinhole32
+                                  ? shared_camera_ray_config_->pinhole.fy
+                                  : shared_camera_ray_config_->equi.fy;
+            pixel_spread_angle = fy > 0.0 ? 1.0 / fy : 0.0;
         } else {
             center = lookfrom;
 
@@ -184,6 +517,7 @@ private:
             const Vec3d viewport_upper_left =
                 center - (focus_dist * w) - viewport_u / 2 - viewport_v / 2;
             pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
+            pixel_spread_angle = pixel_delta_v.norm() / focus_dist;
         }
 
         // Calculate the camera focus disk basis vectors.
@@ -196,38 +530,168 @@ private:
         rendered_pixel_count = 0;
     }
 
-    Ray get_ray(const int x, const int y, const int s_x, const int s_y) const {
+    void write_pixel(const int x, const int y, Vec3d pixel_color) {
+        // Apply a linear to gamma transform for gamma 2
+        pixel_color.x() = linear_to_gamma(pixel_color.x());
+        pixel_color.y() = linear_to_gamma(pixel_color.y());
+        pixel_color.z() = linear_to_gamma(pixel_color.z());
+
+        // Translate the [0,1] component values to the byte range [0,255]
+        static const Interval intensity(0.000, 0.999);
+        const int rbyte = int(256 * intensity.clamp(pixel_color.x()));
+        const int gbyte = int(256 * intensity.clamp(pixel_color.y()));
+        const int bbyte = int(256 * intensity.clamp(pixel_color.z()));
+
+        img.at<cv::Vec3b>(y, x) = cv::Vec3b(bbyte, gbyte, rbyte);
+    }
+
+    void resolve_accumulation() {
+        img = cv::Mat(image_height, image_width, CV_8UC3, cv::Scalar::all(0));
+        for (int y = 0; y < image_height; ++y) {
+            for (int x = 0; x < image_width; ++x) {
+                const int count = accumulation.sample_count.at<std::int32_t>(y, x);
+                if (count > 0) {
+                    const cv::Vec3f& sum = accumulation.radiance_sum.at<cv::Vec3f>(y, x);
+                    write_pixel(x, y, Vec3d {sum[0], sum[1], sum[2]} / count);
+                }
+            }
+        }
+    }
+
+    int sample_stratum(const int sample) const {
+        const int grid_samples = sqrt_spp * sqrt_spp;
+        return static_cast<int>(
+            static_cast<std::int64_t>(sample) * stratum_stride % grid_samples);
+    }
+
+    double pixel_relative_error(const int x, const int y) const {
+        // Standard error of the mean luminance over the mean. Dark pixels are measured against a
+        // floor, since their relative error never settles while absolute noise there is invisible
+        constexpr double kLuminanceFloor = 1e-2;
+        const int count = accumulation.sample_count.at<std::int32_t>(y, x);
+        if (count < 2) {
+            return infinity;
+        }
+        const cv::Vec3f& sum = accumulation.radiance_sum.at<cv::Vec3f>(y, x);
+        const double mean = rec709_luminance(Vec3d {sum[0], sum[1], sum[2]}) / count;
+        const double mean_square = accumulation.luminance_square_sum.at<float>(y, x) / count;
+        const double variance = std::max(0.0, mean_square - mean * mean) * count / (count - 1);
+        return std::sqrt(variance / count) / std::max(mean, kLuminanceFloor);
+    }
+
+    int plan_pass(const int samples_per_pass, std::vector<int>& allowance) const {
+        // Sets the samples each pixel takes in the next pass and returns how many pixels take any.
+        // Without adaptive sampling every pixel advances towards the full grid; with it, pixels
+        // past the minimum whose error is below the threshold stop, and when the remaining budget
+        // cannot cover the pass it goes to the noisiest pixels first.
+        const int grid_samples = sqrt_spp * sqrt_spp;
+        const int min_samples = std::min(adaptive.min_samples, grid_samples);
+        allowance.assign(static_cast<std::size_t>(image_width) * image_height, 0);
+
+        struct ActivePixel {
+            double error = 0.0;
+            int x = 0;
+            int y = 0;
+        };
+        std::vector<ActivePixel> active;
+        for (int y = 0; y < image_height; ++y) {
+            for (int x = 0; x < image_width; ++x) {
+                const int count = accumulation.sample_count.at<std::int32_t>(y, x);
+                if (count >= grid_samples) {
+                    continue;
+                }
+                double error = infinity;
+                if (adaptive.enabled && count >= min_samples) {
+                    error = pixel_relative_error(x, y);
+                    if (error <= adaptive.relative_error) {
+                        continue;
+                    }
+                }
+                active.push_back(ActivePixel {error, x, y});
+            }
+        }
+
+        std::uint64_t remaining = std::numeric_limits<std::uint64_t>::max();
+        if (adaptive.enabled) {
+            const std::uint64_t budget = static_cast<std::uint64_t>(budget_samples_per_pixel)
+                                         * static_cast<std::uint64_t>(total_pixel_count);
+            const std::uint64_t spent = accumulation.total_sample_count();
+            remaining = budget > spent ? budget - spent : 0;
+            if (active.size() * static_cast<std::uint64_t>(samples_per_pass) > remaining) {
+                std::stable_sort(active.begin(), active.end(),
+                    [](const ActivePixel& a, const ActivePixel& b) { return a.error > b.error; });
+            }
+        }
+
+        int active_count = 0;
+        for (const ActivePixel& pixel : active) {
+            if (remaining == 0) {
+                break;
+            }
+            const int count = accumulation.sample_count.at<std::int32_t>(pixel.y, pixel.x);
+            const int samples = static_cast<int>(std::min<std::uint64_t>(
+                std::min(samples_per_pass, grid_samples - count), remaining));
+            allowance[static_cast<std::size_t>(pixel_index(pixel.x, pixel.y))] = samples;
+            remaining -= static_cast<std::uint64_t>(samples);
+            ++active_count;
+        }
+        return active_count;
+    }
+
+    std::uint32_t pixel_index(const int x, const int y) const {
+        return static_cast<std::uint32_t>(y) * static_cast<std::uint32_t>(image_width)
+               + static_cast<std::uint32_t>(x);
+    }
+
+    Ray get_ray(const int x, const int y, const int s_x, const int s_y,
+        rt::PathSampler& sampler) const {
         // Construct a camera ray originating from the defocus disk and directed at randomly
         // sampled point around the pixel location x, y for stratified sample square s_x, s_y
 
-        const Vec3d offset = sample_square_stratified(s_x, s_y);
-        return make_primary_ray(Eigen::Vector2d {x + 0.5 + offset.x(), y + 0.5 + offset.y()}, true,
-            random_double());
+        const Vec3d offset = sample_square_stratified(s_x, s_y, sampler);
+        const double ray_time = sampler.next_1d();
+        Ray ray = make_primary_ray(Eigen::Vector2d {x + 0.5 + offset.x(), y + 0.5 + offset.y()},
+            true, ray_time, sampler);
+        ray.set_cone(RayCone {.width = 0.0, .spread = pixel_spread_angle});
+        return ray;
+    }
+
+    static Ray continue_cone(const Ray& ray, const HitRecord& hit_rec, Ray scattered,
+        const double lobe_roughness) {
+        // The cone keeps its spread through smooth bounces and widens with the roughness of the
+        // sampled lobe. A lobe's directions spread in proportion to its GGX alpha, the squared
+        // roughness, reaching kDiffuseConeSpread for a diffuse lobe, so texture lookups after
+        // rough bounces use coarse levels while glossy reflections stay sharp.
+        constexpr double kDiffuseConeSpread = 0.125;
+        const RayCone& cone = ray.cone();
+        if (cone.width <= 0.0 && cone.spread <= 0.0) {
+            return scattered;
+        }
+        const double width = cone.width_at(hit_rec.t * ray.direction().norm());
+        const double lobe_spread = kDiffuseConeSpread * lobe_roughness * lobe_roughness;
+        scattered.set_cone(RayCone {.width = width, .spread = std::max(cone.spread, lobe_spread)});
+        return scattered;
     }
 
-    Vec3d sample_square_stratified(const int s_x, const int s_y) const {
+    Vec3d sample_square_stratified(const int s_x, const int s_y, rt::PathSampler& sampler) const {
         // Returns the vector to a random point in the square sub-pixel specified by grid
         // indices s_i and s_j, for an idealized unit square pixel [-0.5,-0.5] to [+0.5,+0.5]
 
-        const double px = ((s_x + random_double()) * recip_sqrt_spp) - 0.5;
-        const double py = ((s_y + random_double()) * recip_sqrt_spp) - 0.5;
+        const Eigen::Vector2d jitter = sampler.next_2d();
+        const double px = ((s_x + jitter.x()) * recip_sqrt_spp) - 0.5;
+        const double py = ((s_y + jitter.y()) * recip_sqrt_spp) - 0.5;
 
         return {px, py, 0.0};
     }
 
-    Vec3d sample_square() const {
-        // Returns the vector to a random point in the [-0.5,-0.5]-[+0.5,+0.5] unit square.
-        return Vec3d(random_double() - 0.5, random_double() - 0.5, 0.0);
-    }
-
-    Vec3d defocus_disk_sample() const {
+    Vec3d defocus_disk_sample(rt::PathSampler& sampler) const {
         // Returns a random point in the camera focus disk.
-        const Vec3d p = random_in_unit_disk();
+        const Vec3d p = random_in_unit_disk(sampler.next_2d());
         return center + (p.x() * defocus_disk_u) + (p.y() * defocus_disk_v);
     }
 
     Ray make_primary_ray(const Eigen::Vector2d& pixel, const bool apply_defocus,
-        const double ray_time) const {
+        const double ray_time, rt::PathSampler& sampler) const {
         if (shared_camera_ray_config_.has_value()) {
             const SharedCameraRayConfig& config = *shared_camera_ray_config_;
             const Eigen::Vector3d dir_cam = config.model == rt::CameraModelType::pinhole32
@@ -236,7 +700,7 @@ private:
 
             const bool use_defocus = apply_defocus && config.model == rt::CameraModelType::pinhole32
                                      && defocus_angle > 0.0;
-            const Vec3d ray_origin = use_defocus ? defocus_disk_sample() : center;
+            const Vec3d ray_origin = use_defocus ? defocus_disk_sample(sampler) : center;
             if (use_defocus) {
                 const double focus_t = focus_dist / std::max(dir_cam.z(), 1e-12);
                 const Vec3d focus_target = center + config.camera_to_world * (dir_cam * focus_t);
@@ -248,30 +712,86 @@ private:
         const Vec3d pixel_sample =
             pixel00_loc + ((pixel.x() - 0.5) * pixel_delta_u) + ((pixel.y() - 0.5) * pixel_delta_v);
         const Vec3d ray_origin =
-            apply_defocus && defocus_angle > 0.0 ? defocus_disk_sample() : center;
+            apply_defocus && defocus_angle > 0.0 ? defocus_disk_sample(sampler) : center;
         return Ray(ray_origin, pixel_sample - ray_origin, ray_time);
     }
 
-    Vec3d sample_analytic_direct(const Ray& ray, const HitRecord& hit_rec,
-        const pro::proxy<Hittable>& world, const rt::CpuAnalyticLightSampler& analytic_lights,
-        bool bsdf_technique_available) {
-        const rt::CpuAnalyticLightSample light =
-            analytic_lights.sample(hit_rec.p, random_double(), random_double(), random_double());
+    std::optional<AnalyticShadowRay> make_analytic_shadow_ray(const Ray& ray,
+        const HitRecord& hit_rec, const rt::CpuAnalyticLightSampler& analytic_lights,
+        bool bsdf_technique_available, rt::PathSampler& sampler) const {
+        // Draws the light sample and weighs it; only the visibility test is left to the caller
+        const double light_sample = sampler.next_1d();
+        const Eigen::Vector2d shape_sample = sampler.next_2d();
+        const rt::CpuAnalyticLightSample light = analytic_lights.sample(
+            hit_rec.p, light_sample, shape_sample.x(), shape_sample.y());
         if (!light.valid) {
-            return Vec3d::Zero();
+            return std::nullopt;
         }
 
         const Vec3d direction = light.direction.normalized();
-        const Ray shadow_ray {hit_rec.p + direction * 2e-4, direction, ray.time(),
-            ray.subsurface_medium(), ray.subsurface_owner()};
         const double max_t = light.infinite ? infinity : light.distance - 3e-4;
-        HitRecord occluder;
-        if (max_t <= 0.001 || world->hit(shadow_ray, Interval {0.001, max_t}, occluder)) {
-            return Vec3d::Zero();
+        if (max_t <= 0.001) {
+            return std::nullopt;
         }
 
         double bsdf_pdf = 0.0;
         const Vec3d response = hit_rec.mat->evaluate_direct(ray, hit_rec, direction, bsdf_pdf);
+        if (!response.allFinite() || response.maxCoeff() <= 0.0) {
+            return std::nullopt;
+        }
+        const double mis_weight =
+            light.delta || !bsdf_technique_available
+                ? 1.0
+                : static_cast<double>(rt::light_power_heuristic(static_cast<float>(light.pdf),
+                      static_cast<float>(bsdf_pdf)));
+        AnalyticShadowRay shadow {
+            .ray = Ray {hit_rec.p + direction * 2e-4, direction, ray.time(),
+                ray.subsurface_medium(), ray.subsurface_owner()},
+            .max_t = max_t,
+            .contribution = light.radiance.array() * response.array() * (mis_weight / light.pdf),
+        };
+        shadow.ray.set_sampler(&sampler);
+        return shadow;
+    }
+
+    std::optional<AnalyticShadowRay> make_direct_shadow_ray(const Ray& ray,
+        const HitRecord& hit_rec, const rt::CpuAnalyticLightSampler& analytic_lights,
+        bool bsdf_technique_available, const std::uint32_t pixel, rt::PathSampler& sampler) {
+        // Primary hits resample their light sample when ReSTIR is on; deeper vertices draw one
+        if (restir_active_ && sampler.bounce() == 0) {
+            return make_restir_shadow_ray(
+                ray, hit_rec, analytic_lights, bsdf_technique_available, pixel, sampler);
+        }
+        return make_analytic_shadow_ray(
+            ray, hit_rec, analytic_lights, bsdf_technique_available, sampler);
+    }
+
+    static rt::RestirSurface restir_surface(const HitRecord& hit_rec) {
+        // Hit records carry no primitive id; the material kind and facing stand in for it
+        return rt::RestirSurface {
+            .position = {static_cast<float>(hit_rec.p.x()), static_cast<float>(hit_rec.p.y()),
+                static_cast<float>(hit_rec.p.z())},
+            .normal = {static_cast<float>(hit_rec.normal.x()),
+                static_cast<float>(hit_rec.normal.y()), static_cast<float>(hit_rec.normal.z())},
+            .material_type = static_cast<int>(hit_rec.mat->kind()),
+            .primitive_type = hit_rec.front_face ? 1 : 0,
+        };
+    }
+
+    Vec3d restir_integrand(const Ray& ray, const HitRecord& hit_rec,
+        const rt::CpuAnalyticLightSample& light, bool bsdf_technique_available,
+        double& target_density) const {
+        // Unshadowed, MIS-weighted contribution of a light sample over the density of its shape
+        // sample alone. Reservoirs resample (light, shape samples) pairs and replay them at other
+        // surfaces, and in that space a replayed pair needs no Jacobian. The luminance is the
+        // target density.
+        target_density = 0.0;
+        if (!light.valid || (!light.infinite && light.distance - 3e-4 <= 0.001)) {
+            return Vec3d::Zero();
+        }
+        double bsdf_pdf = 0.0;
+        const Vec3d response =
+            hit_rec.mat->evaluate_direct(ray, hit_rec, light.direction.normalized(), bsdf_pdf);
         if (!response.allFinite() || response.maxCoeff() <= 0.0) {
             return Vec3d::Zero();
         }
@@ -280,130 +800,654 @@ private:
                 ? 1.0
                 : static_cast<double>(rt::light_power_heuristic(static_cast<float>(light.pdf),
                       static_cast<float>(bsdf_pdf)));
-        return light.radiance.array() * response.array() * (mis_weight / light.pdf);
+        const Vec3d integrand =
+            light.radiance.cwiseProduct(response) * (mis_weight * light.selection_pdf / light.pdf);
+        target_density = std::max(0.0, rec709_luminance(integrand));
+        return integrand;
     }
 
-    Vec3d ray_color(const Ray& ray, const int depth, const pro::proxy<Hittable>& world,
-        const pro::proxy<Hittable>& lights, const rt::CpuAnalyticLightSampler* analytic_lights,
-        const PreviousAnalyticScatter& previous_scatter) {
-        // If we've exceeded the ray bounce limit, no more light is gathered
-        if (depth <= 0) {
-            return {0.0, 0.0, 0.0};
+    std::optional<AnalyticShadowRay> make_restir_shadow_ray(const Ray& ray,
+        const HitRecord& hit_rec, const rt::CpuAnalyticLightSampler& analytic_lights,
+        bool bsdf_technique_available, const std::uint32_t pixel, rt::PathSampler& sampler) {
+        // Resamples the pixel's light sample from fresh candidates and the reservoirs the
+        // previous round left here and at the neighbours, as the GPU ReSTIR pass does. Stores the
+        // reservoir for the next round and returns the shadow ray of the sample it keeps.
+        rt::RestirReservoir reservoir;
+        const int candidate_count = std::clamp(restir.initial_candidates, 1, kRestirMaxCandidates);
+        for (int candidate = 0; candidate < candidate_count; ++candidate) {
+            const double light_sample = sampler.next_1d();
+            const Eigen::Vector2d shape_sample = sampler.next_2d();
+            const double selection_sample = sampler.next_1d();
+            // Shape samples are stored as floats, so the candidate is drawn from the stored ones
+            const float u0 = static_cast<float>(shape_sample.x());
+            const float u1 = static_cast<float>(shape_sample.y());
+            const rt::CpuAnalyticLightSample light =
+                analytic_lights.sample(hit_rec.p, light_sample, u0, u1);
+            if (light.light_index < 0) {
+                ++reservoir.candidate_count; // A failed draw still counts towards the RIS mean
+                continue;
+            }
+            double target_density = 0.0;
+            restir_integrand(ray, hit_rec, light, bsdf_technique_available, target_density);
+            const double candidate_weight = target_density / light.selection_pdf;
+            rt::restir_update(reservoir,
+                rt::RestirCandidate {
+                    .light_index = light.light_index,
+                    .sample_u0 = u0,
+                    .sample_u1 = u1,
+                },
+                static_cast<float>(target_density), static_cast<float>(candidate_weight), 1,
+                static_cast<float>(selection_sample));
         }
 
-        HitRecord hit_rec;
-        const bool world_hit = world->hit(ray, Interval {0.001, infinity}, hit_rec);
-        rt::CpuAnalyticLightHit analytic_hit;
-        if (analytic_lights != nullptr
-            && analytic_lights->intersect(ray, Interval {0.001, world_hit ? hit_rec.t : infinity},
-                analytic_hit)) {
-            if (ray.subsurface_medium().active != 0) {
-                return Vec3d::Zero();
+        const int canonical_candidate_count = reservoir.candidate_count;
+        const rt::RestirSurface surface = restir_surface(hit_rec);
+        const double hit_distance = (hit_rec.p - ray.origin()).norm();
+        std::array<const RestirPixel*, kRestirMaxSpatialNeighbors + 1> sources {};
+        std::array<int, kRestirMaxSpatialNeighbors + 1> multiplicities {};
+        int source_count = 0;
+        int selected_source = -1;
+        const auto merge_source = [&](const RestirPixel& source, const bool temporal) {
+            const double selection_sample = sampler.next_1d();
+            // A jittered camera sample lands up to a pixel footprint or two from its neighbours'
+            const double relative_tolerance = temporal
+                                                  ? std::max(0.01, 2.0 * pixel_spread_angle)
+                                                  : std::max(0.02, 4.0 * pixel_spread_angle);
+            const double tolerance =
+                std::max(temporal ? 0.005 : 0.01, relative_tolerance * hit_distance);
+            if (!rt::restir_temporal_surface_valid(surface, source.reservoir,
+                    static_cast<float>(tolerance), 0.95f, restir.max_history_age)) {
+                return;
+            }
+            const rt::RestirCandidate& candidate = source.reservoir.selected;
+            const rt::CpuAnalyticLightSample light = analytic_lights.sample_light(
+                candidate.light_index, hit_rec.p, candidate.sample_u0, candidate.sample_u1);
+            double target_density = 0.0;
+            restir_integrand(ray, hit_rec, light, bsdf_technique_available, target_density);
+            const rt::RestirMergeResult merge =
+                temporal ? rt::restir_merge_temporal(reservoir, source.reservoir,
+                               static_cast<float>(target_density), restir.max_temporal_candidates,
+                               static_cast<float>(selection_sample))
+                         : rt::restir_merge_spatial(reservoir, source.reservoir,
+                               static_cast<float>(target_density), restir.max_spatial_candidates,
+                               static_cast<float>(selection_sample));
+            if (merge.multiplicity <= 0) {
+                return;
+            }
+            sources[static_cast<std::size_t>(source_count)] = &source;
+            multiplicities[static_cast<std::size_t>(source_count)] = merge.multiplicity;
+            if (merge.selected != 0) {
+                selected_source = source_count;
+            }
+            ++source_count;
+        };
+
+        if (restir.temporal_reuse) {
+            merge_source(restir_history_[pixel], true);
+        }
+        const int neighbor_count = std::min(restir.spatial_neighbors, kRestirMaxSpatialNeighbors);
+        if (neighbor_count > 0) {
+            static constexpr int kOffsets[kRestirMaxSpatialNeighbors][2] = {
+                {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+            const int x = static_cast<int>(pixel % static_cast<std::uint32_t>(image_width));
+            const int y = static_cast<int>(pixel / static_cast<std::uint32_t>(image_width));
+            const int rotation = static_cast<int>((x * 3 + y * 5 + restir_round_) & 7U);
+            for (int neighbor = 0; neighbor < neighbor_count; ++neighbor) {
+                const int* offset = kOffsets[(rotation + neighbor) & 7];
+                const int neighbor_x = x + offset[0];
+                const int neighbor_y = y + offset[1];
+                if (neighbor_x >= 0 && neighbor_x < image_width && neighbor_y >= 0
+                    && neighbor_y < image_height) {
+                    merge_source(restir_history_[pixel_index(neighbor_x, neighbor_y)], false);
+                }
             }
-            const double weight = analytic_lights->emission_mis_weight(analytic_hit,
-                previous_scatter.position, ray.direction(), previous_scatter.bsdf_pdf,
-                previous_scatter.valid, previous_scatter.delta);
-            return analytic_hit.radiance * weight;
         }
 
-        // If the ray hits nothing, return the background color
-        if (!world_hit) {
-            if (ray.subsurface_medium().active != 0) {
-                return Vec3d::Zero();
+        reservoir.surface = surface;
+        if (restir.bias_correction == rt::RestirBiasCorrectionMode::basic && source_count > 0
+            && reservoir.valid != 0) {
+            // Weighs the kept sample by how likely every contributing surface was to produce it
+            const rt::RestirCandidate& selected = reservoir.selected;
+            float selected_source_target = reservoir.selected_target;
+            float source_target_sum =
+                reservoir.selected_target * static_cast<float>(canonical_candidate_count);
+            for (int index = 0; index < source_count; ++index) {
+                const RestirPixel& source = *sources[static_cast<std::size_t>(index)];
+                const rt::CpuAnalyticLightSample light = analytic_lights.sample_light(
+                    selected.light_index, source.hit_rec.p, selected.sample_u0, selected.sample_u1);
+                double source_target = 0.0;
+                restir_integrand(
+                    source.ray, source.hit_rec, light, bsdf_technique_available, source_target);
+                const int multiplicity = multiplicities[static_cast<std::size_t>(index)];
+                source_target_sum +=
+                    static_cast<float>(source_target) * static_cast<float>(multiplicity);
+                if (selected_source == index) {
+                    selected_source_target = static_cast<float>(source_target);
+                }
             }
-            const Vec3d analytic_radiance =
-                analytic_lights == nullptr
-                    ? Vec3d::Zero()
-                    : analytic_lights->infinite_radiance(ray.direction(), previous_scatter.bsdf_pdf,
-                          previous_scatter.valid, previous_scatter.delta);
-            return background + analytic_radiance;
+            rt::restir_finalize_basic_bias_correction(
+                reservoir, selected_source_target, source_target_sum, source_count);
+        } else {
+            rt::restir_finalize(reservoir);
         }
 
-        Vec3d medium_weight = Vec3d::Ones();
-        if (ray.subsurface_medium().active != 0) {
-            if (hit_rec.front_face) {
-                return Vec3d::Zero();
+        RestirPixel& stored = restir_current_[pixel];
+        stored = RestirPixel {
+            .reservoir = reservoir,
+            .ray = ray,
+            .hit_rec = hit_rec,
+            .round = restir_round_,
+        };
+        stored.ray.set_sampler(nullptr);
+        stored.hit_rec.shading = nullptr;
+        if (reservoir.valid == 0) {
+            return std::nullopt;
+        }
+
+        const rt::CpuAnalyticLightSample light = analytic_lights.sample_light(
+            reservoir.selected.light_index, hit_rec.p, reservoir.selected.sample_u0,
+            reservoir.selected.sample_u1);
+        double target_density = 0.0;
+        const Vec3d integrand =
+            restir_integrand(ray, hit_rec, light, bsdf_technique_available, target_density);
+        if (target_density <= 0.0) {
+            return std::nullopt;
+        }
+        const Vec3d direction = light.direction.normalized();
+        AnalyticShadowRay shadow {
+            .ray = Ray {hit_rec.p + direction * 2e-4, direction, ray.time(),
+                ray.subsurface_medium(), ray.subsurface_owner()},
+            .max_t = light.infinite ? infinity : light.distance - 3e-4,
+            .contribution = integrand * reservoir.estimator_weight,
+        };
+        shadow.ray.set_sampler(&sampler);
+        return shadow;
+    }
+
+    Vec3d sample_analytic_direct(const Ray& ray, const HitRecord& hit_rec,
+        const pro::proxy<Hittable>& world, const rt::CpuAnalyticLightSampler& analytic_lights,
+        bool bsdf_technique_available, const std::uint32_t pixel, rt::PathSampler& sampler) {
+        const std::optional<AnalyticShadowRay> shadow = make_direct_shadow_ray(
+            ray, hit_rec, analytic_lights, bsdf_technique_available, pixel, sampler);
+        HitRecord occluder;
+        if (!shadow || world->hit(shadow->ray, Interval {0.001, shadow->max_t}, occluder)) {
+            return Vec3d::Zero();
+        }
+        return shadow->contribution;
+    }
+
+    bool sample_subsurface_segment(const Ray& ray, const HitRecord& hit_rec,
+        rt::PathSampler& sampler, Vec3d& medium_weight, std::optional<Ray>& scattered) const {
+        // Walks a ray inside a subsurface medium towards its hit. Returns false when the path
+        // carries no light; otherwise sets the segment weight and, if the medium scatters before
+        // the hit, the continuation ray
+        if (hit_rec.front_face) {
+            return false;
+        }
+        const double ray_length = ray.direction().norm();
+        if (ray_length <= 1e-12) {
+            return false;
+        }
+        const rt::OpenPbrSubsurfaceSegment segment = rt::openpbr_sample_subsurface_segment(
+            ray.subsurface_medium(), static_cast<float>(hit_rec.t * ray_length),
+            static_cast<float>(sampler.next_1d()));
+        medium_weight = {segment.weight.x, segment.weight.y, segment.weight.z};
+        if (segment.scattered != 0) {
+            const Eigen::Vector2d phase_sample = sampler.next_2d();
+            const rt::OpenPbrVec3 direction = rt::openpbr_sample_henyey_greenstein(
+                {static_cast<float>(ray.direction().x() / ray_length),
+                    static_cast<float>(ray.direction().y() / ray_length),
+                    static_cast<float>(ray.direction().z() / ray_length)},
+                ray.subsurface_medium().anisotropy, static_cast<float>(phase_sample.x()),
+                static_cast<float>(phase_sample.y()));
+            const Vec3d next_direction {direction.x, direction.y, direction.z};
+            const Vec3d position = ray.at(static_cast<double>(segment.distance) / ray_length);
+            scattered = Ray {position + next_direction * 1e-6, next_direction, ray.time(),
+                ray.subsurface_medium(), ray.subsurface_owner()};
+        }
+        return true;
+    }
+
+    bool survives_russian_roulette(const int bounce, Vec3d& throughput,
+        rt::PathSampler& sampler) const {
+        // Ends the path past rr_start_bounce with the shared survival policy, reweighting the
+        // paths that continue. Draws from the bounce's stream after the continuation is sampled
+        if (!rt::russian_roulette_applies(bounce, rr_start_bounce)) {
+            return true;
+        }
+        const double survival = rt::russian_roulette_survival_probability(throughput.maxCoeff());
+        if (sampler.next_1d() > survival) {
+            return false;
+        }
+        throughput /= survival;
+        return true;
+    }
+
+public:
+    // Radiance along one path from a camera ray. Public so tests and benchmarks can drive the
+    // bounce loop on its own, outside a render.
+    Vec3d ray_color(Ray ray, const pro::proxy<Hittable>& world, const pro::proxy<Hittable>& lights,
+        const rt::CpuAnalyticLightSampler* analytic_lights, const std::uint32_t pixel,
+        rt::PathSampler& sampler) {
+        // Follows one path vertex per iteration, carrying the product of the path weights so far
+        Vec3d radiance = Vec3d::Zero();
+        Vec3d throughput = Vec3d::Ones();
+        PreviousAnalyticScatter previous_scatter;
+        for (int bounce = 0; bounce < max_depth; ++bounce) {
+            sampler.start_bounce(bounce);
+            ray.set_sampler(&sampler);
+            const bool in_medium = ray.subsurface_medium().active != 0;
+
+            HitRecord hit_rec;
+            const bool world_hit = world->hit(ray, Interval {0.001, infinity}, hit_rec);
+            rt::CpuAnalyticLightHit analytic_hit;
+            if (analytic_lights != nullptr
+                && analytic_lights->intersect(ray,
+                    Interval {0.001, world_hit ? hit_rec.t : infinity}, analytic_hit)) {
+                if (!in_medium) {
+                    const double weight = analytic_lights->emission_mis_weight(analytic_hit,
+                        previous_scatter.position, ray.direction(), previous_scatter.bsdf_pdf,
+                        previous_scatter.valid, previous_scatter.delta);
+                    radiance += throughput.cwiseProduct(analytic_hit.radiance * weight);
+                }
+                break;
+            }
+
+            // If the ray hits nothing, the path gathers the background color
+            if (!world_hit) {
+                if (!in_medium) {
+                    const Vec3d analytic_radiance =
+                        analytic_lights == nullptr
+                            ? Vec3d::Zero()
+                            : analytic_lights->infinite_radiance(ray.direction(),
+                                  previous_scatter.bsdf_pdf, previous_scatter.valid,
+                                  previous_scatter.delta);
+                    radiance += throughput.cwiseProduct(background + analytic_radiance);
+                }
+                break;
+            }
+
+            if (in_medium) {
+                Vec3d medium_weight = Vec3d::Ones();
+                std::optional<Ray> scattered;
+                if (!sample_subsurface_segment(ray, hit_rec, sampler, medium_weight, scattered)) {
+                    break;
+                }
+                throughput = throughput.cwiseProduct(medium_weight);
+                if (scattered) {
+                    ray = *scattered;
+                    previous_scatter = {};
+                    continue;
+                }
+            }
+
+            // Every material query below shares one evaluation of the hit's shading inputs
+            ShadingPoint shading;
+            hit_rec.shading = &shading;
+            ScatterRecord scatter_rec;
+            const Vec3d color_from_emission =
+                hit_rec.mat->emitted(ray, hit_rec, hit_rec.u, hit_rec.v, hit_rec.p);
+            const Vec3d color_from_analytic =
+                analytic_lights == nullptr || in_medium
+                    ? Vec3d::Zero()
+                    : sample_analytic_direct(ray, hit_rec, world, *analytic_lights,
+                          bounce + 1 < max_depth, pixel, sampler);
+
+            if (!hit_rec.mat->scatter(ray, hit_rec, scatter_rec, sampler)) {
+                radiance += throughput.cwiseProduct(color_from_emission + color_from_analytic);
+                break;
             }
-            const double ray_length = ray.direction().norm();
-            if (ray_length <= 1e-12) {
-                return Vec3d::Zero();
+
+            if (scatter_rec.skip_pdf) {
+                // Specular continuations carry no emission term
+                radiance += throughput.cwiseProduct(color_from_analytic);
+                const double bsdf_pdf =
+                    hit_rec.mat->scattering_pdf(ray, hit_rec, scatter_rec.skip_pdf_ray);
+                previous_scatter = PreviousAnalyticScatter {
+                    .valid = true,
+                    .delta = bsdf_pdf <= 0.0,
+                    .position = hit_rec.p,
+                    .bsdf_pdf = std::max(0.0, bsdf_pdf),
+                };
+                throughput = throughput.cwiseProduct(scatter_rec.attenuation);
+                ray = continue_cone(
+                    ray, hit_rec, scatter_rec.skip_pdf_ray, scatter_rec.lobe_roughness);
+            } else {
+                radiance += throughput.cwiseProduct(color_from_emission + color_from_analytic);
+
+                const LightMisPdf sampling_pdf = make_light_mis_pdf(
+                    scatter_rec.pdf, lights, hit_rec.p, background.maxCoeff() > 0.0);
+                const Ray scattered = continue_cone(ray, hit_rec,
+                    Ray {hit_rec.p, sampling_pdf.generate(sampler), ray.time(),
+                        ray.subsurface_medium(), ray.subsurface_owner()},
+                    scatter_rec.lobe_roughness);
+                const double pdf_value = sampling_pdf.value(scattered.direction());
+                const double scattering_pdf = hit_rec.mat->scattering_pdf(ray, hit_rec, scattered);
+                previous_scatter = PreviousAnalyticScatter {
+                    .valid = true,
+                    .delta = false,
+                    .position = hit_rec.p,
+                    .bsdf_pdf = std::max(0.0, scattering_pdf),
+                };
+                throughput =
+                    throughput.cwiseProduct(scatter_rec.attenuation) * (scattering_pdf / pdf_value);
+                ray = scattered;
             }
-            const rt::OpenPbrSubsurfaceSegment segment = rt::openpbr_sample_subsurface_segment(
-                ray.subsurface_medium(), static_cast<float>(hit_rec.t * ray_length),
-                static_cast<float>(random_double()));
-            medium_weight = {segment.weight.x, segment.weight.y, segment.weight.z};
-            if (segment.scattered != 0) {
-                const rt::OpenPbrVec3 direction = rt::openpbr_sample_henyey_greenstein(
-                    {static_cast<float>(ray.direction().x() / ray_length),
-                        static_cast<float>(ray.direction().y() / ray_length),
-                        static_cast<float>(ray.direction().z() / ray_length)},
-                    ray.subsurface_medium().anisotropy, static_cast<float>(random_double()),
-                    static_cast<float>(random_double()));
-                const Vec3d next_direction {direction.x, direction.y, direction.z};
-                const Vec3d position = ray.at(static_cast<double>(segment.distance) / ray_length);
-                const Ray scattered {position + next_direction * 1e-6, next_direction, ray.time(),
-                    ray.subsurface_medium(), ray.subsurface_owner()};
-                return medium_weight.array()
-                       * ray_color(scattered, depth - 1, world, lights, analytic_lights, {})
-                             .array();
+
+            if (!survives_russian_roulette(bounce, throughput, sampler)) {
+                break;
             }
         }
+        return radiance;
+    }
 
-        ScatterRecord scatter_rec;
-        const Vec3d color_from_emission =
-            hit_rec.mat->emitted(ray, hit_rec, hit_rec.u, hit_rec.v, hit_rec.p);
-        const Vec3d color_from_analytic =
-            analytic_lights == nullptr || ray.subsurface_medium().active != 0
-                ? Vec3d::Zero()
-                : sample_analytic_direct(ray, hit_rec, world, *analytic_lights, depth > 1);
+private:
+    // Starts a render's reservoir history; ReSTIR only pays off once there are enough analytic
+    // lights that a single light sample is likely to miss the ones that matter
+    bool begin_restir(const rt::CpuAnalyticLightSampler* analytic_lights) {
+        const auto min_lights = static_cast<std::size_t>(std::max(restir.min_analytic_lights, 1));
+        restir_active_ = restir.enabled && analytic_lights != nullptr
+                         && analytic_lights->lights().size() >= min_lights;
+        restir_round_ = 0;
+        restir_history_.clear();
+        restir_current_.clear();
+        if (restir_active_) {
+            restir_history_.resize(static_cast<std::size_t>(total_pixel_count));
+            restir_current_.resize(static_cast<std::size_t>(total_pixel_count));
+        }
+        return restir_active_;
+    }
 
-        if (!hit_rec.mat->scatter(ray, hit_rec, scatter_rec)) {
-            return medium_weight.array() * (color_from_emission + color_from_analytic).array();
+    // Runs `tile(range)` over the image as one ReSTIR round. Tiles read only the reservoirs of the
+    // previous round, so the image does not depend on how TBB schedules them.
+    template <typename TileFn>
+    void render_restir_round(TileFn&& tile) {
+        ++restir_round_;
+        tbb::parallel_for(tbb::blocked_range2d<int>(0, image_height, kWavefrontTileSize, 0,
+                              image_width, kWavefrontTileSize),
+            tile, tbb::simple_partitioner {});
+        // Pixels that took no sample this round keep their reservoir for the next one
+        for (std::size_t pixel = 0; pixel < restir_current_.size(); ++pixel) {
+            if (restir_current_[pixel].round != restir_round_) {
+                restir_current_[pixel] = restir_history_[pixel];
+            }
         }
+        std::swap(restir_history_, restir_current_);
+    }
 
-        if (scatter_rec.skip_pdf) {
-            const double bsdf_pdf =
-                hit_rec.mat->scattering_pdf(ray, hit_rec, scatter_rec.skip_pdf_ray);
-            const PreviousAnalyticScatter next_scatter {
-                .valid = true,
-                .delta = bsdf_pdf <= 0.0,
-                .position = hit_rec.p,
-                .bsdf_pdf = std::max(0.0, bsdf_pdf),
-            };
-            const Vec3d result = scatter_rec.attenuation.array()
-                                 * ray_color(scatter_rec.skip_pdf_ray, depth - 1, world, lights,
-                                     analytic_lights, next_scatter)
-                                       .array();
-            return medium_weight.array() * (color_from_analytic + result).array();
+    template <typename PixelSamplesFn, typename ResolveFn>
+    void render_tile(const tbb::blocked_range2d<int>& range, PixelSamplesFn&& pixel_samples,
+        ResolveFn&& resolve, const pro::proxy<Hittable>& world, const pro::proxy<Hittable>& lights,
+        const rt::CpuAnalyticLightSampler* analytic_lights) {
+        if (integrator == Integrator::wavefront) {
+            render_wavefront_tile(range, pixel_samples, resolve, world, lights, analytic_lights);
+        } else {
+            render_recursive_range(range, pixel_samples, resolve, world, lights, analytic_lights);
         }
+    }
 
-        Ray scattered;
-        double pdf_value;
+    // Traces the samples `pixel_samples(x, y)` names for every pixel of the range and hands their
+    // sums to `resolve(x, y, estimate, samples)`
+    template <typename PixelSamplesFn, typename ResolveFn>
+    void render_recursive_range(const tbb::blocked_range2d<int>& range,
+        PixelSamplesFn&& pixel_samples, ResolveFn&& resolve, const pro::proxy<Hittable>& world,
+        const pro::proxy<Hittable>& lights, const rt::CpuAnalyticLightSampler* analytic_lights) {
+        for (int y = range.rows().begin(), y_end = range.rows().end(); y < y_end; ++y) {
+            for (int x = range.cols().begin(), x_end = range.cols().end(); x < x_end; ++x) {
+                const PixelSampleRange samples = pixel_samples(x, y);
+                PixelEstimate estimate;
+                for (int sample = samples.first; sample < samples.last; ++sample) {
+                    // Every sample owns its stream, so the image does not depend on how TBB
+                    // partitions the pixel range or how samples are split across passes
+                    rt::PathSampler sampler {
+                        pixel_index(x, y), static_cast<std::uint32_t>(sample), seed};
+                    const int stratum = sample_stratum(sample);
+                    const Ray ray =
+                        get_ray(x, y, stratum % sqrt_spp, stratum / sqrt_spp, sampler);
+                    estimate.add(ray_color(
+                        ray, world, lights, analytic_lights, pixel_index(x, y), sampler));
+                }
+                resolve(x, y, estimate, samples);
+            }
+        }
+    }
 
-        const pro::proxy<PDF> sampling_pdf =
-            make_light_mis_pdf(scatter_rec.pdf, lights, hit_rec.p, background.maxCoeff() > 0.0);
-        scattered = Ray {hit_rec.p, sampling_pdf->generate(), ray.time(), ray.subsurface_medium(),
-            ray.subsurface_owner()};
-        pdf_value = sampling_pdf->value(scattered.direction());
+    template <typename PixelSamplesFn, typename ResolveFn>
+    void render_wavefront_tile(const tbb::blocked_range2d<int>& range,
+        PixelSamplesFn&& pixel_samples, ResolveFn&& resolve, const pro::proxy<Hittable>& world,
+        const pro::proxy<Hittable>& lights, const rt::CpuAnalyticLightSampler* analytic_lights) {
+        // Each pixel's samples occupy a contiguous run of the tile radiance buffer
+        std::vector<PixelSampleRange> pixel_ranges;
+        std::vector<int> first_slots;
+        pixel_ranges.reserve(range.rows().size() * range.cols().size());
+        first_slots.reserve(range.rows().size() * range.cols().size());
+        std::size_t sample_count = 0;
+        for (int y = range.rows().begin(), y_end = range.rows().end(); y < y_end; ++y) {
+            for (int x = range.cols().begin(), x_end = range.cols().end(); x < x_end; ++x) {
+                pixel_ranges.push_back(pixel_samples(x, y));
+                first_slots.push_back(static_cast<int>(sample_count));
+                sample_count += static_cast<std::size_t>(pixel_ranges.back().count());
+            }
+        }
+        std::vector<Vec3d> radiance(sample_count, Vec3d::Zero());
 
-        const double scattering_pdf = hit_rec.mat->scattering_pdf(ray, hit_rec, scattered);
+        std::vector<WavefrontPath> paths;
+        std::vector<WavefrontPath> next_paths;
+        std::vector<WavefrontHit> hits;
+        std::vector<WavefrontShadowRay> shadow_rays;
+        paths.reserve(sample_count);
+        next_paths.reserve(sample_count);
+        hits.reserve(sample_count);
+        shadow_rays.reserve(sample_count);
 
-        const PreviousAnalyticScatter next_scatter {
-            .valid = true,
-            .delta = false,
-            .position = hit_rec.p,
-            .bsdf_pdf = std::max(0.0, scattering_pdf),
-        };
-        const Vec3d sample_color =
-            ray_color(scattered, depth - 1, world, lights, analytic_lights, next_scatter);
+        // Camera rays, drawn from the same streams as the recursive integrator
+        int pixel_slot = 0;
+        for (int y = range.rows().begin(), y_end = range.rows().end(); y < y_end; ++y) {
+            for (int x = range.cols().begin(), x_end = range.cols().end(); x < x_end;
+                ++x, ++pixel_slot) {
+                const PixelSampleRange& samples =
+                    pixel_ranges[static_cast<std::size_t>(pixel_slot)];
+                for (int sample = samples.first; sample < samples.last; ++sample) {
+                    rt::PathSampler sampler {
+                        pixel_index(x, y), static_cast<std::uint32_t>(sample), seed};
+                    const int stratum = sample_stratum(sample);
+                    const Ray ray =
+                        get_ray(x, y, stratum % sqrt_spp, stratum / sqrt_spp, sampler);
+                    paths.push_back(WavefrontPath {
+                        .ray = ray,
+                        .sampler = sampler,
+                        .sample = first_slots[static_cast<std::size_t>(pixel_slot)] + sample
+                                  - samples.first,
+                        .pixel = pixel_index(x, y),
+                    });
+                }
+            }
+        }
+
+        for (int bounce = 0; bounce < max_depth && !paths.empty(); ++bounce) {
+            next_paths.clear();
+            hits.clear();
+            shadow_rays.clear();
+
+            // Extend: closest hits for the whole wave; escaped paths and paths ending on an
+            // analytic light are resolved here
+            for (int index = 0; index < static_cast<int>(paths.size()); ++index) {
+                WavefrontPath& path = paths[static_cast<std::size_t>(index)];
+                path.sampler.start_bounce(bounce);
+                path.ray.set_sampler(&path.sampler);
+                const Ray& ray = path.ray;
+                const bool in_medium = ray.subsurface_medium().active != 0;
+
+                HitRecord hit_rec;
+                const bool world_hit = world->hit(ray, Interval {0.001, infinity}, hit_rec);
+                rt::CpuAnalyticLightHit analytic_hit;
+                if (analytic_lights != nullptr
+                    && analytic_lights->intersect(ray,
+                        Interval {0.001, world_hit ? hit_rec.t : infinity}, analytic_hit)) {
+                    if (!in_medium) {
+                        const PreviousAnalyticScatter& previous = path.previous_scatter;
+                        const double weight = analytic_lights->emission_mis_weight(analytic_hit,
+                            previous.position, ray.direction(), previous.bsdf_pdf, previous.valid,
+                            previous.delta);
+                        radiance[path.sample] +=
+                            path.throughput.cwiseProduct(analytic_hit.radiance * weight);
+                    }
+                    continue;
+                }
+
+                if (!world_hit) {
+                    if (!in_medium) {
+                        const PreviousAnalyticScatter& previous = path.previous_scatter;
+                        const Vec3d analytic_radiance =
+                            analytic_lights == nullptr
+                                ? Vec3d::Zero()
+                                : analytic_lights->infinite_radiance(ray.direction(),
+                                      previous.bsdf_pdf, previous.valid, previous.delta);
+                        radiance[path.sample] +=
+                            path.throughput.cwiseProduct(background + analytic_radiance);
+                    }
+                    continue;
+                }
+
+                Vec3d medium_weight = Vec3d::Ones();
+                if (in_medium) {
+                    std::optional<Ray> scattered;
+                    if (!sample_subsurface_segment(
+                            ray, hit_rec, path.sampler, medium_weight, scattered)) {
+                        continue;
+                    }
+                    if (scattered) {
+                        next_paths.push_back(WavefrontPath {
+                            .ray = *scattered,
+                            .throughput = path.throughput.cwiseProduct(medium_weight),
+                            .sampler = path.sampler,
+                            .sample = path.sample,
+                        });
+                        continue;
+                    }
+                }
 
-        const Vec3d color_from_scatter =    //
-            scatter_rec.attenuation.array() //
-            * scattering_pdf                //
-            * sample_color.array()          //
-            / pdf_value;
+                const MaterialKind kind = hit_rec.mat->kind();
+                hits.push_back(WavefrontHit {
+                    .path = index,
+                    .kind = kind,
+                    .medium_weight = medium_weight,
+                    .hit_rec = std::move(hit_rec),
+                });
+            }
+
+            // Group hits by shading model so each material's code runs over a contiguous batch
+            std::stable_sort(hits.begin(), hits.end(),
+                [](const WavefrontHit& a, const WavefrontHit& b) { return a.kind < b.kind; });
+
+            // Shade: emission, analytic-light samples into the shadow queue and continuation rays
+            for (WavefrontHit& hit : hits) {
+                WavefrontPath& path = paths[static_cast<std::size_t>(hit.path)];
+                const Ray& ray = path.ray;
+                ShadingPoint shading;
+                hit.hit_rec.shading = &shading;
+                const HitRecord& hit_rec = hit.hit_rec;
+                const Vec3d weight = path.throughput.cwiseProduct(hit.medium_weight);
+
+                const Vec3d color_from_emission =
+                    hit_rec.mat->emitted(ray, hit_rec, hit_rec.u, hit_rec.v, hit_rec.p);
+                if (analytic_lights != nullptr && ray.subsurface_medium().active == 0) {
+                    std::optional<AnalyticShadowRay> shadow = make_direct_shadow_ray(ray, hit_rec,
+                        *analytic_lights, bounce + 1 < max_depth, path.pixel, path.sampler);
+                    if (shadow) {
+                        shadow->contribution = shadow->contribution.cwiseProduct(weight);
+                        shadow_rays.push_back(
+                            WavefrontShadowRay {.sample = path.sample, .shadow = *shadow});
+                    }
+                }
+
+                ScatterRecord scatter_rec;
+                if (!hit_rec.mat->scatter(ray, hit_rec, scatter_rec, path.sampler)) {
+                    radiance[path.sample] += weight.cwiseProduct(color_from_emission);
+                    continue;
+                }
 
-        return medium_weight.array()
-               * (color_from_emission + color_from_analytic + color_from_scatter).array();
+                if (scatter_rec.skip_pdf) {
+                    // Specular continuations carry no emission term, as in the recursive estimator
+                    const double bsdf_pdf =
+                        hit_rec.mat->scattering_pdf(ray, hit_rec, scatter_rec.skip_pdf_ray);
+                    Vec3d throughput = weight.cwiseProduct(scatter_rec.attenuation);
+                    if (!survives_russian_roulette(bounce, throughput, path.sampler)) {
+                        continue;
+                    }
+                    next_paths.push_back(WavefrontPath {
+                        .ray = continue_cone(
+                            ray, hit_rec, scatter_rec.skip_pdf_ray, scatter_rec.lobe_roughness),
+                        .throughput = throughput,
+                        .previous_scatter =
+                            PreviousAnalyticScatter {
+                                .valid = true,
+                                .delta = bsdf_pdf <= 0.0,
+                                .position = hit_rec.p,
+                                .bsdf_pdf = std::max(0.0, bsdf_pdf),
+                            },
+                        .sampler = path.sampler,
+                        .sample = path.sample,
+                    });
+                    continue;
+                }
+
+                radiance[path.sample] += weight.cwiseProduct(color_from_emission);
+
+                const LightMisPdf sampling_pdf = make_light_mis_pdf(
+                    scatter_rec.pdf, lights, hit_rec.p, background.maxCoeff() > 0.0);
+                const Ray scattered = continue_cone(ray, hit_rec,
+                    Ray {hit_rec.p, sampling_pdf.generate(path.sampler), ray.time(),
+                        ray.subsurface_medium(), ray.subsurface_owner()},
+                    scatter_rec.lobe_roughness);
+                const double pdf_value = sampling_pdf.value(scattered.direction());
+                const double scattering_pdf = hit_rec.mat->scattering_pdf(ray, hit_rec, scattered);
+                Vec3d throughput =
+                    weight.cwiseProduct(scatter_rec.attenuation) * (scattering_pdf / pdf_value);
+                if (!survives_russian_roulette(bounce, throughput, path.sampler)) {
+                    continue;
+                }
+                next_paths.push_back(WavefrontPath {
+                    .ray = scattered,
+                    .throughput = throughput,
+                    .previous_scatter =
+                        PreviousAnalyticScatter {
+                            .valid = true,
+                            .delta = false,
+                            .position = hit_rec.p,
+                            .bsdf_pdf = std::max(0.0, scattering_pdf),
+                        },
+                    .sampler = path.sampler,
+                    .sample = path.sample,
+                });
+            }
+
+            // Shadow queue: one batch of visibility tests for this bounce's light samples
+            for (const WavefrontShadowRay& shadow_ray : shadow_rays) {
+                HitRecord occluder;
+                if (!world->hit(shadow_ray.shadow.ray, Interval {0.001, shadow_ray.shadow.max_t},
+                        occluder)) {
+                    radiance[shadow_ray.sample] += shadow_ray.shadow.contribution;
+                }
+            }
+
+            std::swap(paths, next_paths);
+        }
+
+        // Resolve pixels, summing samples in the recursive integrator's order
+        pixel_slot = 0;
+        for (int y = range.rows().begin(), y_end = range.rows().end(); y < y_end; ++y) {
+            for (int x = range.cols().begin(), x_end = range.cols().end(); x < x_end;
+                ++x, ++pixel_slot) {
+                const PixelSampleRange& samples =
+                    pixel_ranges[static_cast<std::size_t>(pixel_slot)];
+                const int first_slot = first_slots[static_cast<std::size_t>(pixel_slot)];
+                PixelEstimate estimate;
+                for (int sample = 0; sample < samples.count(); ++sample) {
+                    estimate.add(radiance[static_cast<std::size_t>(first_slot + sample)]);
+                }
+                resolve(x, y, estimate, samples);
+            }
+        }
     }
 };
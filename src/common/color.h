@@ -18,6 +18,10 @@ inline double hit_sphere(const Vec3d& center, const double radius, const Ray& ra
     return (h - std::sqrt(discriminant)) / a;
 }
 
+inline double rec709_luminance(const Vec3d& linear_color) {
+    return 0.2126 * linear_color.x() + 0.7152 * linear_color.y() + 0.0722 * linear_color.z();
+}
+
 inline double linear_to_gamma(const double linear_component) {
     if (linear_component > 0.0) {
         return std::sqrt(linear_component);
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <limits>
 #include <numbers>
-#include <random>
 
 #include <Eigen/Core>
 
@@ -31,9 +35,16 @@ using Vec3i = Eigen::Vector3i;
 // Random Number Generation
 
 inline double random_double() {
-    // Returns a random real in [0,1)
-    static std::mt19937 generator;
-    return std::uniform_real_distribution<double> {0.0, 1.0}(generator);
+    // Returns a random real in [0,1). Each thread draws from its own counter-based stream, so this
+    // is safe to call concurrently; renderers use rt::PathSampler for reproducible per-pixel draws.
+    thread_local const std::uint32_t stream = rt::allocate_thread_stream();
+    thread_local std::uint64_t index = 0;
+    const rt::PhiloxCounter bits = rt::philox4x32({stream, 0xFFFFFFFFu,
+                                                      static_cast<std::uint32_t>(index >> 32),
+                                                      static_cast<std::uint32_t>(index)},
+        rt::PhiloxKey {});
+    index += 1;
+    return rt::bits_to_unit_double(bits[0], bits[1]);
 }
 
 inline double random_double(const double min, const double max) {
@@ -43,8 +54,7 @@ inline double random_double(const double min, const double max) {
 
 inline int random_int(const int min, const int max) {
     // Returns a random int in [min, max]
-    static std::mt19937 generator;
-    return min + std::uniform_int_distribution<int> {}(generator) % (max - min + 1);
+    return rt::unit_double_to_int(random_double(), min, max);
 }
 
 inline Vec3d random_vec3d() {
@@ -55,16 +65,20 @@ inline Vec3d random_vec3d(const double min, const double max) {
     return Vec3d {random_double(min, max), random_double(min, max), random_double(min, max)};
 }
 
-// Random Unit Vector Generation
+// Random Direction Generation
+//
+// Each warp maps a pair of uniform reals in [0,1) to a direction, so callers choose where the
+// uniforms come from. The overloads without arguments draw from `random_double()`.
+
+inline Vec3d random_unit_vector(const Eigen::Vector2d& u) {
+    const double z = 1.0 - 2.0 * u.x();
+    const double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+    const double phi = 2.0 * pi * u.y();
+    return {r * std::cos(phi), r * std::sin(phi), z};
+}
 
 inline Vec3d random_unit_vector() {
-    while (true) {
-        const Vec3d p = Vec3d::Random();
-        const double norm_sq = p.squaredNorm();
-        if (norm_sq > 1e-100 && norm_sq <= 1.0) {
-            return p.normalized();
-        }
-    }
+    return random_unit_vector(Eigen::Vector2d {random_double(), random_double()});
 }
 
 inline Vec3d random_on_hemisphere(const Vec3d& normal) {
@@ -76,18 +90,19 @@ inline Vec3d random_on_hemisphere(const Vec3d& normal) {
     }
 }
 
+inline Vec3d random_in_unit_disk(const Eigen::Vector2d& u) {
+    const double r = std::sqrt(u.x());
+    const double phi = 2.0 * pi * u.y();
+    return {r * std::cos(phi), r * std::sin(phi), 0.0};
+}
+
 inline Vec3d random_in_unit_disk() {
-    while (true) {
-        if (const Vec3d p = {random_double(-1.0, 1.0), random_double(-1.0, 1.0), 0.0};
-            p.squaredNorm() < 1.0) {
-            return p;
-        }
-    }
+    return random_in_unit_disk(Eigen::Vector2d {random_double(), random_double()});
 }
 
-inline Vec3d random_cosine_direction() {
-    const double r1 = random_double();
-    const double r2 = random_double();
+inline Vec3d random_cosine_direction(const Eigen::Vector2d& u) {
+    const double r1 = u.x();
+    const double r2 = u.y();
 
     const double phi = 2.0 * pi * r1;
     const double x = std::cos(phi) * std::sqrt(r2);
@@ -97,9 +112,13 @@ inline Vec3d random_cosine_direction() {
     return {x, y, z};
 }
 
-inline Vec3d random_uniform_hemisphere_direction() {
-    const double r1 = random_double();
-    const double r2 = random_double();
+inline Vec3d random_cosine_direction() {
+    return random_cosine_direction(Eigen::Vector2d {random_double(), random_double()});
+}
+
+inline Vec3d random_uniform_hemisphere_direction(const Eigen::Vector2d& u) {
+    const double r1 = u.x();
+    const double r2 = u.y();
 
     const double phi = 2.0 * pi * r1;
     const double x = std::cos(phi) * 2.0 * std::sqrt(r2 * (1.0 - r2));
@@ -109,6 +128,10 @@ inline Vec3d random_uniform_hemisphere_direction() {
     return {x, y, z};
 }
 
+inline Vec3d random_uniform_hemisphere_direction() {
+    return random_uniform_hemisphere_direction(Eigen::Vector2d {random_double(), random_double()});
+}
+
 inline Vec3d reflect(const Vec3d& v, const Vec3d& n) {
     return v - 2.0 * v.dot(n) * n;
 }
@@ -6,6 +6,9 @@
 #include "interval.h"
 #include "aabb.h"
 
+#include <bit>
+#include <cstdint>
+
 struct ConstantMedium {
 
     explicit ConstantMedium(const pro::proxy<Hittable>& boundary, const double density,
@@ -41,7 +44,14 @@ struct ConstantMedium {
 
         const double ray_length = ray.direction().norm();
         const double distance_inside_boundary = (hit_rec2.t - hit_rec1.t) * ray_length;
-        const double hit_distance = m_neg_inv_density * std::log(random_double());
+        // The free-flight sample comes from the ray's path sampler, keyed by the ray and where it
+        // enters this medium so that media along one ray draw independently of test order
+        const std::uint64_t entry_bits = std::bit_cast<std::uint64_t>(hit_rec1.t);
+        const std::uint64_t key =
+            rt::ray_key(ray.origin(), ray.direction()) ^ (entry_bits * 0xBF58476D1CE4E5B9ull);
+        const double free_flight_sample = ray.sampler() != nullptr ? ray.sampler()->keyed_1d(key)
+                                                                   : rt::keyed_unit_double(key);
+        const double hit_distance = m_neg_inv_density * std::log(free_flight_sample);
 
         if (hit_distance > distance_inside_boundary) {
             return false;
@@ -61,7 +71,7 @@ struct ConstantMedium {
 
     double pdf_value(const Vec3d& origin, const Vec3d& direction) const { return 0.0; }
 
-    Vec3d random(const Vec3d& origin) const { return {1.0, 0.0, 0.0}; }
+    Vec3d random(const Vec3d& origin, rt::PathSampler&) const { return {1.0, 0.0, 0.0}; }
 
     pro::proxy<Hittable> m_boundary;
     double m_neg_inv_density;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace rt {
+
+// Fast non-cryptographic hash for change detection and cache keys: texture file contents, scene
+// arrays and cache sources. Not stable across versions of this header, so persisted hashes must
+// be keyed by a format version.
+inline constexpr std::uint64_t kHashSeed = 0x9E3779B97F4A7C15ULL;
+inline constexpr std::uint64_t kHashMultiplier = 0xFF51AFD7ED558CCDULL;
+
+inline std::uint64_t hash_mix(std::uint64_t hash, std::uint64_t word) {
+    hash ^= word;
+    hash *= kHashMultiplier;
+    return hash ^ (hash >> 32);
+}
+
+// Mixes four independent 64-bit lanes over 32-byte blocks, so the loop vectorizes
+inline std::uint64_t hash_bytes(std::uint64_t seed, const void* data, std::size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    std::array<std::uint64_t, 4> lanes {seed, seed + 1, seed + 2, seed + 3};
+    std::size_t offset = 0;
+    for (; offset + sizeof(lanes) <= size; offset += sizeof(lanes)) {
+        std::array<std::uint64_t, 4> words {};
+        std::memcpy(words.data(), bytes + offset, sizeof(words));
+        for (std::size_t lane = 0; lane < lanes.size(); ++lane) {
+            lanes[lane] = hash_mix(lanes[lane], words[lane]);
+        }
+    }
+    std::uint64_t hash = hash_mix(hash_mix(hash_mix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+    for (; offset < size; ++offset) {
+        hash = hash_mix(hash, bytes[offset]);
+    }
+    return hash_mix(hash, size);
+}
+
+} // namespace rt
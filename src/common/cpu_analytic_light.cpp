@@ -7,6 +7,7 @@
 #include <Eigen/Geometry>
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <limits>
 #include <numbers>
@@ -17,11 +18,6 @@ namespace {
 
 constexpr double kRayEpsilon = 1e-6;
 
-bool finite_light(AnalyticLightType type) {
-    return type == AnalyticLightType::sphere || type == AnalyticLightType::disk
-           || type == AnalyticLightType::rect || type == AnalyticLightType::cylinder;
-}
-
 double power_heuristic(double pdf_a, double pdf_b) {
     if (pdf_a <= 0.0) {
         return 0.0;
@@ -208,6 +204,39 @@ bool intersect_light(const AnalyticLightDesc& light, const Ray& ray, const Inter
     return true;
 }
 
+PackedLightVector3 tree_point(const Eigen::Vector3d& point) {
+    return {static_cast<float>(point.x()), static_cast<float>(point.y()),
+        static_cast<float>(point.z())};
+}
+
+bool hit_node_bounds(const LightTreeNode& node, const Ray& ray, double t_min, double t_max) {
+    const std::array<double, 3> bounds_min {node.bounds_min.x, node.bounds_min.y,
+        node.bounds_min.z};
+    const std::array<double, 3> bounds_max {node.bounds_max.x, node.bounds_max.y,
+        node.bounds_max.z};
+    for (int axis = 0; axis < 3; ++axis) {
+        const double origin = ray.origin()[axis];
+        const double direction = ray.direction()[axis];
+        if (std::abs(direction) <= 1e-12) {
+            if (origin < bounds_min[axis] || origin > bounds_max[axis]) {
+                return false;
+            }
+            continue;
+        }
+        double near_t = (bounds_min[axis] - origin) / direction;
+        double far_t = (bounds_max[axis] - origin) / direction;
+        if (near_t > far_t) {
+            std::swap(near_t, far_t);
+        }
+        t_min = std::max(t_min, near_t);
+        t_max = std::min(t_max, far_t);
+        if (t_max < t_min) {
+            return false;
+        }
+    }
+    return true;
+}
+
 double infinite_pdf(const AnalyticLightDesc& light) {
     if (light.delta) {
         return 0.0;
@@ -231,31 +260,46 @@ bool supports_infinite_direction(const AnalyticLightDesc& light, const Eigen::Ve
 } // namespace
 
 CpuAnalyticLightSampler::CpuAnalyticLightSampler(std::vector<AnalyticLightDesc> lights)
-    : lights_(std::move(lights)) {}
+    : lights_(std::move(lights)), tree_(build_analytic_light_tree(lights_)) {}
+
+double CpuAnalyticLightSampler::selection_pdf(int light_index,
+    const Eigen::Vector3d& surface_point) const {
+    if (light_index < 0 || static_cast<std::size_t>(light_index) >= lights_.size()) {
+        return 0.0;
+    }
+    const std::size_t index = static_cast<std::size_t>(light_index);
+    return light_hierarchy_selection_pdf(tree_.nodes.data(), static_cast<int>(tree_.nodes.size()),
+        static_cast<int>(tree_.infinite.size()), tree_.light_leaves[index],
+        static_cast<float>(lights_[index].selection_pdf), tree_point(surface_point));
+}
 
 CpuAnalyticLightSample CpuAnalyticLightSampler::sample(const Eigen::Vector3d& surface_point,
     double light_sample, double shape_sample_0, double shape_sample_1) const {
-    CpuAnalyticLightSample sample;
     if (lights_.empty()) {
-        return sample;
+        return {};
     }
 
-    const double selected = std::clamp(light_sample, 0.0, std::nextafter(1.0, 0.0));
-    auto light_it = std::find_if(lights_.begin(), lights_.end(),
-        [selected](const auto& light) { return selected < light.cdf; });
-    if (light_it == lights_.end()) {
-        light_it = std::prev(lights_.end());
-    }
-    const AnalyticLightDesc& light = *light_it;
-    if (light.selection_pdf <= 0.0) {
+    const int selected = sample_light_hierarchy(tree_.nodes.data(),
+        static_cast<int>(tree_.nodes.size()), tree_.infinite.data(),
+        static_cast<int>(tree_.infinite.size()), tree_point(surface_point),
+        static_cast<float>(light_sample));
+    return sample_light(selected, surface_point, shape_sample_0, shape_sample_1);
+}
+
+CpuAnalyticLightSample CpuAnalyticLightSampler::sample_light(int light_index,
+    const Eigen::Vector3d& surface_point, double shape_sample_0, double shape_sample_1) const {
+    CpuAnalyticLightSample sample;
+    const double selection = selection_pdf(light_index, surface_point);
+    if (selection <= 0.0) {
         return sample;
     }
+    const AnalyticLightDesc& light = lights_[static_cast<std::size_t>(light_index)];
 
     sample.radiance = light.radiance;
     if (light.type == AnalyticLightType::dome) {
         sample.direction = uniform_sphere_direction(shape_sample_0, shape_sample_1);
         sample.distance = infinity;
-        sample.pdf = light.selection_pdf * uniform_sphere_pdf();
+        sample.pdf = selection * uniform_sphere_pdf();
         sample.infinite = true;
     } else if (light.type == AnalyticLightType::distant) {
         const Eigen::Vector3d axis = light.local_to_world_linear.col(2).normalized();
@@ -264,7 +308,7 @@ CpuAnalyticLightSample CpuAnalyticLightSampler::sample(const Eigen::Vector3d& su
                                              shape_sample_0, shape_sample_1);
         sample.distance = infinity;
         sample.pdf =
-            light.selection_pdf * (light.delta ? 1.0 : uniform_cone_pdf(light.cos_theta_max));
+            selection * (light.delta ? 1.0 : uniform_cone_pdf(light.cos_theta_max));
         sample.infinite = true;
         sample.delta = light.delta;
     } else if (light.type == AnalyticLightType::sphere) {
@@ -280,7 +324,7 @@ CpuAnalyticLightSample CpuAnalyticLightSampler::sample(const Eigen::Vector3d& su
             sample.direction = to_center / sample.distance;
             const double intensity_scale = light.world_area > 1e-12 ? light.world_area : 1.0;
             sample.radiance *= intensity_scale / distance_squared;
-            sample.pdf = light.selection_pdf;
+            sample.pdf = selection;
             sample.delta = true;
         } else {
             const double cos_theta_max =
@@ -295,7 +339,7 @@ CpuAnalyticLightSample CpuAnalyticLightSampler::sample(const Eigen::Vector3d& su
             sample.position = surface_hit.position;
             sample.normal = surface_hit.normal;
             sample.distance = surface_hit.t;
-            sample.pdf = light.selection_pdf * uniform_cone_pdf(cos_theta_max);
+            sample.pdf = selection * uniform_cone_pdf(cos_theta_max);
         }
     } else {
         const double u0 = std::clamp(shape_sample_0, 0.0, 1.0);
@@ -334,9 +378,11 @@ CpuAnalyticLightSample CpuAnalyticLightSampler::sample(const Eigen::Vector3d& su
         const double abs_cosine = sample.normal.dot(-sample.direction);
         const double conditional_pdf =
             area_to_solid_angle_pdf(light.world_area, distance_squared, abs_cosine);
-        sample.pdf = light.selection_pdf * conditional_pdf;
+        sample.pdf = selection * conditional_pdf;
     }
 
+    sample.selection_pdf = selection;
+    sample.light_index = light_index;
     sample.valid = sample.pdf > 0.0 && sample.direction.allFinite() && sample.radiance.allFinite()
                    && sample.radiance.maxCoeff() > 0.0;
     return sample;
@@ -346,16 +392,32 @@ bool CpuAnalyticLightSampler::intersect(const Ray& ray, const Interval& ray_t,
     CpuAnalyticLightHit& hit) const {
     double closest = ray_t.max;
     bool found = false;
-    for (std::size_t i = 0; i < lights_.size(); ++i) {
-        const AnalyticLightDesc& light = lights_[i];
-        if (!finite_light(light.type) || light.treat_as_point) {
+    if (tree_.nodes.empty()) {
+        return false;
+    }
+    std::array<int, kLightTreeMaxDepth + 1> stack {};
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const LightTreeNode& node = tree_.nodes[static_cast<std::size_t>(stack[--stack_size])];
+        if (!hit_node_bounds(node, ray, ray_t.min, closest)) {
+            continue;
+        }
+        if (node.second_child >= 0) {
+            const int first = static_cast<int>(&node - tree_.nodes.data()) + 1;
+            stack[stack_size++] = node.second_child;
+            stack[stack_size++] = first;
+            continue;
+        }
+        const AnalyticLightDesc& light = lights_[static_cast<std::size_t>(node.light_index)];
+        if (light.treat_as_point) {
             continue;
         }
         CpuAnalyticLightHit candidate;
         if (!intersect_light(light, ray, Interval {ray_t.min, closest}, candidate)) {
             continue;
         }
-        candidate.light_index = static_cast<int>(i);
+        candidate.light_index = node.light_index;
         candidate.radiance = light.radiance;
         closest = candidate.t;
         hit = candidate;
@@ -389,7 +451,7 @@ double CpuAnalyticLightSampler::pdf_for_hit(const CpuAnalyticLightHit& hit,
         const double abs_cosine = std::max(0.0, hit.normal.dot(-direction.normalized()));
         conditional_pdf = area_to_solid_angle_pdf(light.world_area, distance_squared, abs_cosine);
     }
-    return light.selection_pdf * conditional_pdf;
+    return selection_pdf(hit.light_index, origin) * conditional_pdf;
 }
 
 double CpuAnalyticLightSampler::emission_mis_weight(const CpuAnalyticLightHit& hit,
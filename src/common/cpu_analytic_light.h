@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/analytic_light.h"
+#include "common/analytic_light_tree.h"
 
 #include <Eigen/Core>
 
@@ -27,20 +28,33 @@ struct CpuAnalyticLightSample {
     Eigen::Vector3d radiance = Eigen::Vector3d::Zero();
     double distance = 0.0;
     double pdf = 0.0;
+    double selection_pdf = 0.0; // Share of pdf that picked light_index; the rest samples its shape
+    int light_index = -1;
     bool infinite = false;
     bool delta = false;
     bool valid = false;
 };
 
+// Chooses finite lights by stochastic traversal of a light BVH, so nearby and facing emitters are
+// preferred over the global power distribution, and intersects them through the same tree.
+// Distant and dome lights keep their global selection probability.
 class CpuAnalyticLightSampler {
 public:
     explicit CpuAnalyticLightSampler(std::vector<AnalyticLightDesc> lights);
 
     [[nodiscard]] bool empty() const { return lights_.empty(); }
     [[nodiscard]] const std::vector<AnalyticLightDesc>& lights() const { return lights_; }
+    [[nodiscard]] const AnalyticLightTree& tree() const { return tree_; }
 
+    // Probability that sample() at surface_point picks the light
+    [[nodiscard]] double selection_pdf(int light_index,
+        const Eigen::Vector3d& surface_point) const;
     [[nodiscard]] CpuAnalyticLightSample sample(const Eigen::Vector3d& surface_point,
         double light_sample, double shape_sample_0, double shape_sample_1) const;
+    // The sample sample() draws once it has chosen light_index, with the same pdf. Resampling
+    // replays a stored (light, shape samples) pair at other surfaces through it.
+    [[nodiscard]] CpuAnalyticLightSample sample_light(int light_index,
+        const Eigen::Vector3d& surface_point, double shape_sample_0, double shape_sample_1) const;
     [[nodiscard]] bool intersect(const Ray& ray, const Interval& ray_t,
         CpuAnalyticLightHit& hit) const;
     [[nodiscard]] double pdf_for_hit(const CpuAnalyticLightHit& hit, const Eigen::Vector3d& origin,
@@ -53,6 +67,7 @@ public:
 
 private:
     std::vector<AnalyticLightDesc> lights_;
+    AnalyticLightTree tree_;
 };
 
 } // namespace rt
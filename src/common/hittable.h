@@ -7,6 +7,12 @@
 #include "material.h"
 #include "aabb.h"
 
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+#include <cmath>
+#include <stdexcept>
+
 
 struct Translate {
     Translate(const pro::proxy<Hittable>& object, const Vec3d& offset)
@@ -19,6 +25,8 @@ struct Translate {
         // Move the ray backwards by the offset
         Ray offset_r {ray.origin() - m_offset, ray.direction(), ray.time(),
             ray.subsurface_medium(), ray.subsurface_owner()};
+        offset_r.set_cone(ray.cone());
+        offset_r.set_sampler(ray.sampler());
 
         // Determine whether an intersection exists along the offset ray (and if so, where)
         if (!m_object->hit(offset_r, ray_t, hit_rec)) {
@@ -37,7 +45,9 @@ struct Translate {
         return m_object->pdf_value(origin - m_offset, direction);
     }
 
-    Vec3d random(const Vec3d& origin) const { return m_object->random(origin - m_offset); }
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        return m_object->random(origin - m_offset, sampler);
+    }
 
     pro::proxy<Hittable> m_object;
     Vec3d m_offset;
@@ -89,8 +99,10 @@ struct RotateY {
             ray.direction().y(),                                                       //
             (m_sin_theta * ray.direction().x()) + (m_cos_theta * ray.direction().z())};
 
-        const Ray rotated_ray {
+        Ray rotated_ray {
             origin, direction, ray.time(), ray.subsurface_medium(), ray.subsurface_owner()};
+        rotated_ray.set_cone(ray.cone());
+        rotated_ray.set_sampler(ray.sampler());
 
         // Determine whether an intersection exists in object space (and if so, where)
 
@@ -124,11 +136,11 @@ struct RotateY {
         return m_object->pdf_value(local_origin, local_direction);
     }
 
-    Vec3d random(const Vec3d& origin) const {
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
         const Vec3d local_origin {
             (m_cos_theta * origin.x()) - (m_sin_theta * origin.z()), origin.y(),
             (m_sin_theta * origin.x()) + (m_cos_theta * origin.z())};
-        const Vec3d local_direction = m_object->random(local_origin);
+        const Vec3d local_direction = m_object->random(local_origin, sampler);
         return {
             (m_cos_theta * local_direction.x()) + (m_sin_theta * local_direction.z()),
             local_direction.y(),
@@ -140,3 +152,91 @@ struct RotateY {
     double m_sin_theta;
     AABB m_bbox;
 };
+
+
+// Places a prototype hierarchy in the world with an affine transform. Rays are carried into the
+// prototype's space rather than the prototype being copied, so every instance of a mesh shares
+// one bottom-level BVH and a BVH over instances forms the top level.
+struct Instance {
+    Instance(const pro::proxy<Hittable>& prototype, const Eigen::Matrix3d& linear,
+        const Vec3d& translation)
+        : m_prototype(prototype),
+          m_linear(linear),
+          m_translation(translation) {
+        const double determinant = linear.determinant();
+        if (!std::isfinite(determinant) || std::abs(determinant) <= 1e-12) {
+            throw std::invalid_argument("instance transform must be invertible");
+        }
+        m_inverse_linear = linear.inverse();
+        m_normal_matrix = m_inverse_linear.transpose();
+        m_inverse_determinant = 1.0 / std::abs(determinant);
+        m_inverse_scale = std::cbrt(m_inverse_determinant);
+
+        const AABB local = m_prototype->bounding_box();
+        Vec3d min {infinity, infinity, infinity};
+        Vec3d max {-infinity, -infinity, -infinity};
+        for (int corner = 0; corner < 8; ++corner) {
+            const Vec3d point = to_world_point(Vec3d {
+                (corner & 1) != 0 ? local.x.max : local.x.min,
+                (corner & 2) != 0 ? local.y.max : local.y.min,
+                (corner & 4) != 0 ? local.z.max : local.z.min,
+            });
+            min = min.cwiseMin(point);
+            max = max.cwiseMax(point);
+        }
+        m_bbox = AABB {min, max};
+    }
+
+    bool hit(const Ray& ray, const Interval& ray_t, HitRecord& hit_rec) const {
+        // The affine map keeps the ray parameter, so t needs no conversion. The cone width is
+        // rescaled by the transform's mean scale to keep texture footprints in object units.
+        Ray local_ray {to_local_point(ray.origin()), m_inverse_linear * ray.direction(),
+            ray.time(), ray.subsurface_medium(), ray.subsurface_owner()};
+        local_ray.set_cone(
+            RayCone {.width = ray.cone().width * m_inverse_scale, .spread = ray.cone().spread});
+        local_ray.set_sampler(ray.sampler());
+
+        if (!m_prototype->hit(local_ray, ray_t, hit_rec)) {
+            return false;
+        }
+
+        // Normals take the inverse transpose, which keeps them facing against the incoming ray
+        hit_rec.p = to_world_point(hit_rec.p);
+        hit_rec.normal = (m_normal_matrix * hit_rec.normal).normalized();
+        return true;
+    }
+
+    AABB bounding_box() const { return m_bbox; }
+
+    double pdf_value(const Vec3d& origin, const Vec3d& direction) const {
+        // Solid angle does not survive scale or shear: a world direction w maps to the local
+        // direction A w / |A w| with A the inverse linear part, whose Jacobian is
+        // |det A| / |A w|^3 for unit w
+        const Vec3d local_direction = m_inverse_linear * direction;
+        const double stretch = local_direction.norm() / direction.norm();
+        if (stretch <= 0.0) {
+            return 0.0;
+        }
+        const double local_pdf = m_prototype->pdf_value(to_local_point(origin), local_direction);
+        return local_pdf * m_inverse_determinant / (stretch * stretch * stretch);
+    }
+
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        return m_linear * m_prototype->random(to_local_point(origin), sampler);
+    }
+
+    Vec3d to_world_point(const Vec3d& point) const { return m_linear * point + m_translation; }
+
+    Vec3d to_local_point(const Vec3d& point) const {
+        return m_inverse_linear * (point - m_translation);
+    }
+
+    pro::proxy<Hittable> m_prototype;
+    Eigen::Matrix3d m_linear;
+    Eigen::Matrix3d m_inverse_linear;
+    Eigen::Matrix3d m_normal_matrix;
+    Vec3d m_translation;
+    double m_inverse_determinant; // 1 / |det| of the linear part
+    double m_inverse_scale;       // Inverse of the mean scale, the cube root of |det|
+    AABB m_bbox;
+};
@@ -47,9 +47,9 @@ public:
         return sum;
     }
 
-    Vec3d random(const Vec3d& origin) const {
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
         const int num_objects = (int)m_objects.size();
-        return m_objects[random_int(0, num_objects - 1)]->random(origin);
+        return m_objects[sampler.next_int(0, num_objects - 1)]->random(origin, sampler);
     }
 
     std::vector<pro::proxy<Hittable>> m_objects;
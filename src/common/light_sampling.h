@@ -24,6 +24,8 @@ struct PackedLight {
     int primitive_index = -1;
     float selection_pdf = 0.0f;
     float cdf = 0.0f;
+    float alias_probability = 1.0f;
+    int alias = -1;
 };
 
 enum class PackedAnalyticLightType : int {
@@ -59,6 +61,9 @@ struct PackedAnalyticLight {
     int delta = 0;
     int treat_as_point = 0;
     int treat_as_line = 0;
+    float alias_probability = 1.0f;
+    int alias = -1;
+    int tree_leaf = -1; // Leaf in the light tree; -1 for distant and dome lights
 };
 
 RT_LIGHT_HD RT_LIGHT_INLINE float light_uniform_sphere_pdf() {
@@ -87,32 +92,56 @@ RT_LIGHT_HD RT_LIGHT_INLINE float light_power_heuristic(float pdf_a, float pdf_b
     return a2 / (a2 + b2);
 }
 
-RT_LIGHT_HD RT_LIGHT_INLINE int sample_packed_light(const PackedLight* lights, int light_count,
-    float u) {
+RT_LIGHT_HD RT_LIGHT_INLINE float light_largest_sample(float) {
+    return 0.99999994f;
+}
+
+RT_LIGHT_HD RT_LIGHT_INLINE double light_largest_sample(double) {
+    return 0.99999999999999989;
+}
+
+// Selects an entry of a light distribution. Lights carry both the CDF and a Walker alias table
+// (alias_probability, alias); prepared distributions always build the table and select in O(1).
+// Arrays whose first light has no alias (alias < 0) fall back to a binary search of the CDF.
+template <typename Light, typename Real>
+RT_LIGHT_HD RT_LIGHT_INLINE int sample_light_distribution(const Light* lights, int light_count,
+    Real u) {
     if (lights == nullptr || light_count <= 0) {
         return -1;
     }
-    const float sample = u < 0.0f ? 0.0f : (u < 1.0f ? u : 0.99999994f);
-    for (int i = 0; i < light_count; ++i) {
-        if (sample < lights[i].cdf) {
-            return i;
+    const Real sample = u < Real(0) ? Real(0) : (u < Real(1) ? u : light_largest_sample(u));
+    if (lights[0].alias >= 0) {
+        // The bucket index and the offset within the bucket both come from the one sample
+        const Real scaled = sample * static_cast<Real>(light_count);
+        const int bucket = scaled < static_cast<Real>(light_count - 1)
+                               ? static_cast<int>(scaled)
+                               : light_count - 1;
+        const Real offset = scaled - static_cast<Real>(bucket);
+        return offset < static_cast<Real>(lights[bucket].alias_probability) ? bucket
+                                                                          : lights[bucket].alias;
+    }
+    int first = 0;
+    int count = light_count;
+    while (count > 0) {
+        const int half = count / 2;
+        if (sample < static_cast<Real>(lights[first + half].cdf)) {
+            count = half;
+        } else {
+            first += half + 1;
+            count -= half + 1;
         }
     }
-    return light_count - 1;
+    return first < light_count ? first : light_count - 1;
+}
+
+RT_LIGHT_HD RT_LIGHT_INLINE int sample_packed_light(const PackedLight* lights, int light_count,
+    float u) {
+    return sample_light_distribution(lights, light_count, u);
 }
 
 RT_LIGHT_HD RT_LIGHT_INLINE int sample_packed_analytic_light(const PackedAnalyticLight* lights,
     int light_count, float u) {
-    if (lights == nullptr || light_count <= 0) {
-        return -1;
-    }
-    const float sample = u < 0.0f ? 0.0f : (u < 1.0f ? u : 0.99999994f);
-    for (int i = 0; i < light_count; ++i) {
-        if (sample < lights[i].cdf) {
-            return i;
-        }
-    }
-    return light_count - 1;
+    return sample_light_distribution(lights, light_count, u);
 }
 
 RT_LIGHT_HD RT_LIGHT_INLINE void sample_uniform_triangle(float u0, float u1, float& w0, float& w1,
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "common/light_sampling.h"
+
+#include <cmath>
+
+namespace rt {
+
+#if defined(__CUDACC__)
+#define RT_LIGHT_TREE_HD     __host__ __device__
+#define RT_LIGHT_TREE_INLINE __forceinline__
+#else
+#define RT_LIGHT_TREE_HD
+#define RT_LIGHT_TREE_INLINE inline
+#endif
+
+// Traversal stacks hold at most one pending node per level
+constexpr int kLightTreeMaxDepth = 64;
+
+// Node of a light BVH over the finite analytic lights. Nodes are stored depth first: an interior
+// node's first child follows it and second_child names the other one. Every leaf holds one light.
+// The orientation cone bounds the emitter normals (axis, cos_theta_o) and how far past them light
+// still leaves the surface (cos_theta_e); omnidirectional emitters use cos_theta_o = -1.
+struct LightTreeNode {
+    PackedLightVector3 bounds_min;
+    PackedLightVector3 bounds_max;
+    PackedLightVector3 axis;
+    float cos_theta_o = 1.0f;
+    float cos_theta_e = 0.0f;
+    float power = 0.0f; // Sum of the subtree's selection_pdf
+    int second_child = -1;
+    int light_index = -1; // Leaves only
+    int parent = -1;
+};
+
+// Distant and dome lights stay out of the tree and are chosen from their own alias table
+struct LightTreeInfiniteEntry {
+    int light_index = -1;
+    float cdf = 0.0f;
+    float alias_probability = 1.0f;
+    int alias = -1;
+};
+
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_cos_sub_clamped(float sin_a, float cos_a,
+    float sin_b, float cos_b) {
+    return cos_a > cos_b ? 1.0f : cos_a * cos_b + sin_a * sin_b;
+}
+
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_sin_sub_clamped(float sin_a, float cos_a,
+    float sin_b, float cos_b) {
+    return cos_a > cos_b ? 0.0f : sin_a * cos_b - cos_a * sin_b;
+}
+
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_safe_sqrt(float value) {
+    return sqrtf(value > 0.0f ? value : 0.0f);
+}
+
+// Conservative estimate of the light a node sends towards point: power over squared distance,
+// scaled by the cosine of the smallest angle between the orientation cone and the directions to
+// the node's bounds. Zero when point lies outside every emitter's emission cone.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_importance(const LightTreeNode& node,
+    const PackedLightVector3& point) {
+    if (node.power <= 0.0f) {
+        return 0.0f;
+    }
+    const float center_x = 0.5f * (node.bounds_min.x + node.bounds_max.x);
+    const float center_y = 0.5f * (node.bounds_min.y + node.bounds_max.y);
+    const float center_z = 0.5f * (node.bounds_min.z + node.bounds_max.z);
+    const float to_point_x = point.x - center_x;
+    const float to_point_y = point.y - center_y;
+    const float to_point_z = point.z - center_z;
+    const float diagonal_x = node.bounds_max.x - node.bounds_min.x;
+    const float diagonal_y = node.bounds_max.y - node.bounds_min.y;
+    const float diagonal_z = node.bounds_max.z - node.bounds_min.z;
+    const float radius_squared =
+        0.25f * (diagonal_x * diagonal_x + diagonal_y * diagonal_y + diagonal_z * diagonal_z);
+    const float distance_squared =
+        to_point_x * to_point_x + to_point_y * to_point_y + to_point_z * to_point_z;
+    const float clamped_distance_squared = fmaxf(fmaxf(distance_squared, sqrtf(radius_squared)),
+        1e-12f);
+
+    // Cone of directions from the bounds to the point; everything when the point is inside
+    const bool inside = point.x >= node.bounds_min.x && point.x <= node.bounds_max.x
+                        && point.y >= node.bounds_min.y && point.y <= node.bounds_max.y
+                        && point.z >= node.bounds_min.z && point.z <= node.bounds_max.z;
+    const float cos_theta_b = inside || distance_squared <= radius_squared
+                                  ? -1.0f
+                                  : light_tree_safe_sqrt(1.0f - radius_squared / distance_squared);
+    const float sin_theta_b = light_tree_safe_sqrt(1.0f - cos_theta_b * cos_theta_b);
+
+    const float distance = sqrtf(distance_squared);
+    const float cos_theta_w = distance > 0.0f
+                                  ? (node.axis.x * to_point_x + node.axis.y * to_point_y
+                                        + node.axis.z * to_point_z)
+                                        / distance
+                                  : 1.0f;
+    const float sin_theta_w = light_tree_safe_sqrt(1.0f - cos_theta_w * cos_theta_w);
+    const float sin_theta_o = light_tree_safe_sqrt(1.0f - node.cos_theta_o * node.cos_theta_o);
+    const float cos_theta_x =
+        light_tree_cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, node.cos_theta_o);
+    const float sin_theta_x =
+        light_tree_sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, node.cos_theta_o);
+    const float cos_theta_p =
+        light_tree_cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+    if (cos_theta_p <= node.cos_theta_e) {
+        return 0.0f;
+    }
+    return node.power * cos_theta_p / clamped_distance_squared;
+}
+
+// Walks from the root to a leaf, choosing each child with probability proportional to its
+// importance and reusing u for the next level. Returns the light index, or -1 when every light
+// is unimportant at point; pmf receives the probability of the chosen leaf.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE int sample_light_tree(const LightTreeNode* nodes,
+    int node_count, const PackedLightVector3& point, float u, float& pmf) {
+    pmf = 0.0f;
+    if (nodes == nullptr || node_count <= 0 || light_tree_importance(nodes[0], point) <= 0.0f) {
+        return -1;
+    }
+    float sample = u < 0.0f ? 0.0f : (u < 1.0f ? u : light_largest_sample(u));
+    float probability = 1.0f;
+    int index = 0;
+    while (nodes[index].second_child >= 0) {
+        const float first = light_tree_importance(nodes[index + 1], point);
+        const float second = light_tree_importance(nodes[nodes[index].second_child], point);
+        const float total = first + second;
+        if (total <= 0.0f) {
+            return -1;
+        }
+        const float first_probability = first / total;
+        if (sample < first_probability) {
+            sample = sample / first_probability;
+            probability *= first_probability;
+            index = index + 1;
+        } else {
+            sample = (sample - first_probability) / (1.0f - first_probability);
+            probability *= 1.0f - first_probability;
+            index = nodes[index].second_child;
+        }
+        sample = sample < 1.0f ? sample : light_largest_sample(sample);
+    }
+    pmf = probability;
+    return nodes[index].light_index;
+}
+
+// Probability that sample_light_tree picks the light stored in leaf, found by walking up to the
+// root and repeating the child choices with the same importances.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_pmf(const LightTreeNode* nodes,
+    int node_count, int leaf, const PackedLightVector3& point) {
+    if (nodes == nullptr || leaf < 0 || leaf >= node_count) {
+        return 0.0f;
+    }
+    float probability = 1.0f;
+    int index = leaf;
+    while (nodes[index].parent >= 0) {
+        const int parent = nodes[index].parent;
+        const float first = light_tree_importance(nodes[parent + 1], point);
+        const float second = light_tree_importance(nodes[nodes[parent].second_child], point);
+        const float total = first + second;
+        if (total <= 0.0f) {
+            return 0.0f;
+        }
+        const float first_probability = first / total;
+        probability *= index == parent + 1 ? first_probability : 1.0f - first_probability;
+        index = parent;
+    }
+    return light_tree_importance(nodes[0], point) > 0.0f ? probability : 0.0f;
+}
+
+// Share of the light selection that goes through the tree: the tree's selection_pdf sum, or all
+// of it when there is nothing else to choose from.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_tree_selection_share(const LightTreeNode* nodes,
+    int node_count, int infinite_count) {
+    if (nodes == nullptr || node_count <= 0) {
+        return 0.0f;
+    }
+    if (infinite_count <= 0) {
+        return 1.0f;
+    }
+    const float power = nodes[0].power;
+    return power < 0.0f ? 0.0f : (power < 1.0f ? power : 1.0f);
+}
+
+// Selection probability of one light at point: the tree share times its traversal probability for
+// finite lights (leaf >= 0) and the light's own selection_pdf for infinite ones.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE float light_hierarchy_selection_pdf(
+    const LightTreeNode* nodes, int node_count, int infinite_count, int leaf,
+    float infinite_selection_pdf, const PackedLightVector3& point) {
+    if (leaf < 0) {
+        return infinite_selection_pdf;
+    }
+    return light_tree_selection_share(nodes, node_count, infinite_count)
+           * light_tree_pmf(nodes, node_count, leaf, point);
+}
+
+// Picks between the tree and the infinite lights with u, then within the chosen set with the
+// rescaled u. Returns the light index or -1.
+RT_LIGHT_TREE_HD RT_LIGHT_TREE_INLINE int sample_light_hierarchy(const LightTreeNode* nodes,
+    int node_count, const LightTreeInfiniteEntry* infinite, int infinite_count,
+    const PackedLightVector3& point, float u) {
+    const float share = light_tree_selection_share(nodes, node_count, infinite_count);
+    const float sample = u < 0.0f ? 0.0f : (u < 1.0f ? u : light_largest_sample(u));
+    if (sample < share) {
+        float pmf = 0.0f;
+        return sample_light_tree(nodes, node_count, point, sample / share, pmf);
+    }
+    const int entry = sample_light_distribution(infinite, infinite_count,
+        share < 1.0f ? (sample - share) / (1.0f - share) : 0.0f);
+    return entry < 0 ? -1 : infinite[entry].light_index;
+}
+
+#undef RT_LIGHT_TREE_HD
+#undef RT_LIGHT_TREE_INLINE
+
+} // namespace rt
@@ -11,6 +11,16 @@
 #include <stdexcept>
 #include <vector>
 
+// Material inputs evaluated once per intersection. Emission, scattering, BSDF pdfs and direct
+// light evaluation all query the same hit; an integrator that points HitRecord::shading at one of
+// these lets the material compile its textured parameters on the first query and reuse them for
+// the rest. Use a fresh one for every intersection.
+struct ShadingPoint {
+    const void* material = nullptr; // Material that filled it; nullptr while empty
+    rt::OpenPbrCoreMaterial parameters;
+    rt::OpenPbrFrame frame;
+};
+
 struct HitRecord {
     Vec3d p;
     Vec3d normal;
@@ -19,6 +29,8 @@ struct HitRecord {
     double u;
     double v;
     bool front_face;
+    double texture_footprint = 0.0; // Width of the ray cone at the hit, in uv units
+    ShadingPoint* shading = nullptr; // Per-intersection cache; materials evaluate anew without one
 
     void set_face_normal(const Ray& ray, const Vec3d& outward_normal) {
         // Sets the hit record normal vector
@@ -26,24 +38,43 @@ struct HitRecord {
         front_face = ray.direction().dot(outward_normal) < 0.0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    void set_texture_footprint(const Ray& ray, const double uv_per_world) {
+        // Projects the ray cone onto the surface at t, stretched by the incidence angle, and
+        // scales it by the primitive's uv density. Call after set_face_normal.
+        const RayCone& cone = ray.cone();
+        if (cone.width <= 0.0 && cone.spread <= 0.0) {
+            texture_footprint = 0.0;
+            return;
+        }
+        const double length = ray.direction().norm();
+        const double cosine = std::abs(ray.direction().dot(normal)) / length;
+        texture_footprint = cone.width_at(t * length) / std::max(cosine, 1e-4) * uv_per_world;
+    }
 };
 
 struct ScatterRecord {
     Vec3d attenuation;
-    pro::proxy<PDF> pdf;
+    ScatterPdf pdf;
     bool skip_pdf;
     Ray skip_pdf_ray;
+    // Roughness of the sampled lobe, 0 for a mirror or a refraction and 1 for a diffuse lobe. The
+    // camera widens the ray cone of the continuation with it.
+    double lobe_roughness = 0.0;
 };
 
 
 struct EmptyMaterial {
 
+    MaterialKind kind() const { return MaterialKind::empty; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         return {0.0, 0.0, 0.0};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler&) const {
         return false;
     }
 
@@ -63,15 +94,20 @@ struct Lambertion {
         : m_tex(pro::make_proxy_shared<Texture, SolidColor>(albedo)) {}
     explicit Lambertion(const pro::proxy<Texture>& tex) : m_tex(tex) {}
 
+    MaterialKind kind() const { return MaterialKind::lambertian; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         return {0.0, 0.0, 0.0};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
-        scatter_rec.attenuation = m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p);
-        scatter_rec.pdf = pro::make_proxy_shared<PDF, CosinePDF>(hit_rec.normal);
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler&) const {
+        scatter_rec.attenuation =
+            m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p, hit_rec.texture_footprint);
+        scatter_rec.pdf = CosinePDF {hit_rec.normal};
         scatter_rec.skip_pdf = false;
+        scatter_rec.lobe_roughness = 1.0;
         return true;
     }
 
@@ -84,7 +120,7 @@ struct Lambertion {
         double& pdf) const {
         const double cosine = std::max(0.0, hit_rec.normal.dot(direction.normalized()));
         pdf = cosine / pi;
-        return m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p) * pdf;
+        return m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p, hit_rec.texture_footprint) * pdf;
     }
 
 private:
@@ -95,18 +131,23 @@ private:
 struct Metal {
     Metal(const Vec3d& albedo, const double fuzz) : albedo(albedo), fuzz(fuzz < 1.0 ? fuzz : 1.0) {}
 
+    MaterialKind kind() const { return MaterialKind::metal; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         return {0.0, 0.0, 0.0};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler& sampler) const {
         const Vec3d reflected = reflect(ray_in.direction(), hit_rec.normal).normalized()
-                                + (fuzz * random_unit_vector());
+                                + (fuzz * random_unit_vector(sampler.next_2d()));
 
         scatter_rec.attenuation = albedo;
-        scatter_rec.pdf = nullptr;
+        scatter_rec.pdf = std::monostate {};
         scatter_rec.skip_pdf = true;
+        // Fuzz tilts the mirror direction by up to fuzz radians, as a GGX lobe of alpha = fuzz
+        scatter_rec.lobe_roughness = std::sqrt(fuzz);
         scatter_rec.skip_pdf_ray = Ray(hit_rec.p, reflected, ray_in.time(),
             ray_in.subsurface_medium(), ray_in.subsurface_owner());
 
@@ -131,15 +172,19 @@ private:
 struct Dielectric {
     Dielectric(const double refraction_index) : refraction_index(refraction_index) {}
 
+    MaterialKind kind() const { return MaterialKind::dielectric; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         return {0.0, 0.0, 0.0};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler& sampler) const {
         scatter_rec.attenuation = {1.0, 1.0, 1.0};
-        scatter_rec.pdf = nullptr;
+        scatter_rec.pdf = std::monostate {};
         scatter_rec.skip_pdf = true;
+        scatter_rec.lobe_roughness = 0.0;
 
         const double ri = hit_rec.front_face ? (1.0 / refraction_index) : refraction_index;
 
@@ -149,7 +194,7 @@ struct Dielectric {
 
         const bool cannot_refract = ri * sin_theta > 1.0;
         const Vec3d direction =
-            (cannot_refract || reflectance(cos_theta, refraction_index) > random_double())
+            (cannot_refract || reflectance(cos_theta, refraction_index) > sampler.next_1d())
                 ? reflect(unit_direction, hit_rec.normal)
                 : refract(unit_direction, hit_rec.normal, ri);
 
@@ -194,32 +239,43 @@ struct OpenPbrSurfaceMaterial {
           specular_roughness_texture(
               resolve_texture(material.scalar_textures.specular_roughness, textures)) {}
 
-    Vec3d emitted(const Ray&, const HitRecord&, const double u, const double v,
+    MaterialKind kind() const { return MaterialKind::openpbr; }
+
+    Vec3d emitted(const Ray&, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
-        const rt::OpenPbrCoreMaterial parameters = evaluated_emission_parameters(u, v, p);
-        const rt::OpenPbrVec3 value = rt::emission_openpbr_core(parameters);
+        // Only emission is needed, so without a cache for this very point one lookup is enough
+        rt::OpenPbrVec3 value;
+        if (hit_rec.shading != nullptr && u == hit_rec.u && v == hit_rec.v && p == hit_rec.p) {
+            value = rt::emission_openpbr_core(shading_point(hit_rec, *hit_rec.shading).parameters);
+        } else {
+            value = rt::emission_openpbr_core(
+                evaluated_emission_parameters(u, v, p, hit_rec.texture_footprint));
+        }
         return {value.x, value.y, value.z};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler& sampler) const {
         if (ray_in.subsurface_medium().active != 0 && ray_in.subsurface_owner() != this) {
             return false;
         }
-        const rt::OpenPbrCoreMaterial parameters =
-            evaluated_scattering_parameters(hit_rec.u, hit_rec.v, hit_rec.p);
-        const Vec3d outward_normal = hit_rec.front_face ? hit_rec.normal : -hit_rec.normal;
-        const rt::OpenPbrFrame frame =
-            rt::make_openpbr_frame(to_openpbr(outward_normal), rt::OpenPbrVec3 {});
+        ShadingPoint local;
+        const ShadingPoint& shading = shading_point(hit_rec, local);
+        const rt::OpenPbrCoreMaterial& parameters = shading.parameters;
+        const rt::OpenPbrFrame& frame = shading.frame;
+        const float lobe_sample = static_cast<float>(sampler.next_1d());
+        const Eigen::Vector2d direction_sample = sampler.next_2d();
         const rt::OpenPbrSample sample = rt::sample_openpbr_core(parameters, frame,
-            to_openpbr(-ray_in.direction().normalized()), static_cast<float>(random_double()),
-            static_cast<float>(random_double()), static_cast<float>(random_double()));
+            to_openpbr(-ray_in.direction().normalized()), lobe_sample,
+            static_cast<float>(direction_sample.x()), static_cast<float>(direction_sample.y()));
         if (sample.valid == 0) {
             return false;
         }
 
         scatter_rec.attenuation = {sample.weight.x, sample.weight.y, sample.weight.z};
-        scatter_rec.pdf = nullptr;
+        scatter_rec.pdf = std::monostate {};
         scatter_rec.skip_pdf = true;
+        scatter_rec.lobe_roughness = lobe_roughness(parameters, sample);
         rt::OpenPbrSubsurfaceMedium medium = ray_in.subsurface_medium();
         const void* medium_owner = ray_in.subsurface_owner();
         if (sample.event == rt::OpenPbrScatterEvent::subsurface_entry) {
@@ -235,11 +291,10 @@ struct OpenPbrSurfaceMaterial {
     }
 
     double scattering_pdf(const Ray& ray_in, const HitRecord& hit_rec, const Ray& scattered) const {
-        const rt::OpenPbrCoreMaterial parameters =
-            evaluated_scattering_parameters(hit_rec.u, hit_rec.v, hit_rec.p);
-        const Vec3d outward_normal = hit_rec.front_face ? hit_rec.normal : -hit_rec.normal;
-        const rt::OpenPbrFrame frame =
-            rt::make_openpbr_frame(to_openpbr(outward_normal), rt::OpenPbrVec3 {});
+        ShadingPoint local;
+        const ShadingPoint& shading = shading_point(hit_rec, local);
+        const rt::OpenPbrCoreMaterial& parameters = shading.parameters;
+        const rt::OpenPbrFrame& frame = shading.frame;
         return static_cast<double>(
             rt::pdf_openpbr_core(parameters, frame, to_openpbr(-ray_in.direction().normalized()),
                 to_openpbr(scattered.direction().normalized())));
@@ -247,11 +302,10 @@ struct OpenPbrSurfaceMaterial {
 
     Vec3d evaluate_direct(const Ray& ray_in, const HitRecord& hit_rec, const Vec3d& direction,
         double& pdf) const {
-        const rt::OpenPbrCoreMaterial parameters =
-            evaluated_scattering_parameters(hit_rec.u, hit_rec.v, hit_rec.p);
-        const Vec3d outward_normal = hit_rec.front_face ? hit_rec.normal : -hit_rec.normal;
-        const rt::OpenPbrFrame frame =
-            rt::make_openpbr_frame(to_openpbr(outward_normal), rt::OpenPbrVec3 {});
+        ShadingPoint local;
+        const ShadingPoint& shading = shading_point(hit_rec, local);
+        const rt::OpenPbrCoreMaterial& parameters = shading.parameters;
+        const rt::OpenPbrFrame& frame = shading.frame;
         const rt::OpenPbrEvaluation evaluation = rt::evaluate_openpbr_core(parameters, frame,
             to_openpbr(-ray_in.direction().normalized()), to_openpbr(direction.normalized()));
         pdf = static_cast<double>(evaluation.pdf);
@@ -260,6 +314,21 @@ struct OpenPbrSurfaceMaterial {
     }
 
 private:
+    // Parameters and shading frame at hit_rec, taken from hit_rec.shading when this material
+    // already filled it. Otherwise they are evaluated into hit_rec.shading, or into local when the
+    // integrator supplied no cache.
+    const ShadingPoint& shading_point(const HitRecord& hit_rec, ShadingPoint& local) const {
+        ShadingPoint& shading = hit_rec.shading != nullptr ? *hit_rec.shading : local;
+        if (shading.material != this) {
+            shading.parameters =
+                evaluated_parameters(hit_rec.u, hit_rec.v, hit_rec.p, hit_rec.texture_footprint);
+            const Vec3d outward_normal = hit_rec.front_face ? hit_rec.normal : -hit_rec.normal;
+            shading.frame = rt::make_openpbr_frame(to_openpbr(outward_normal), rt::OpenPbrVec3 {});
+            shading.material = this;
+        }
+        return shading;
+    }
+
     template<typename Binding>
     static pro::proxy<Texture> resolve_texture(const Binding& binding,
         const std::vector<pro::proxy<Texture>>& textures) {
@@ -274,53 +343,59 @@ private:
     }
 
     static rt::OpenPbrVec3 sample_texture(const pro::proxy<Texture>& texture, double u, double v,
-        const Vec3d& p) {
-        const Vec3d value = texture->value(u, v, p);
+        const Vec3d& p, double footprint) {
+        const Vec3d value = texture->value(u, v, p, footprint);
         return {static_cast<float>(value.x()), static_cast<float>(value.y()),
             static_cast<float>(value.z())};
     }
 
     static void apply_binding(rt::OpenPbrCoreMaterial& parameters,
         const rt::OpenPbrColorTextureBinding& binding, rt::OpenPbrColorInput input,
-        const pro::proxy<Texture>& texture, double u, double v, const Vec3d& p) {
+        const pro::proxy<Texture>& texture, double u, double v, const Vec3d& p, double footprint) {
         if (binding.texture_index < 0) {
             return;
         }
-        rt::openpbr_apply_color_input(parameters, input, sample_texture(texture, u, v, p),
-            binding.source_color_space);
+        rt::openpbr_apply_color_input(parameters, input,
+            sample_texture(texture, u, v, p, footprint), binding.source_color_space);
     }
 
     static void apply_binding(rt::OpenPbrCoreMaterial& parameters,
         const rt::OpenPbrScalarTextureBinding& binding, rt::OpenPbrScalarInput input,
-        const pro::proxy<Texture>& texture, double u, double v, const Vec3d& p) {
+        const pro::proxy<Texture>& texture, double u, double v, const Vec3d& p, double footprint) {
         if (binding.texture_index < 0) {
             return;
         }
         rt::openpbr_apply_scalar_input(parameters, input,
-            static_cast<float>(texture->value(u, v, p).x()));
+            static_cast<float>(texture->value(u, v, p, footprint).x()));
     }
 
-    rt::OpenPbrCoreMaterial evaluated_scattering_parameters(double u, double v,
-        const Vec3d& p) const {
+    // Scattering and emission inputs together; the BSDF ignores the emission terms and emission
+    // ignores the rest, so one set serves every query at a hit
+    rt::OpenPbrCoreMaterial evaluated_parameters(double u, double v, const Vec3d& p,
+        double footprint) const {
         rt::OpenPbrCoreMaterial parameters = material.parameters;
         apply_binding(parameters, material.color_textures.base_color,
-            rt::OpenPbrColorInput::base_color, base_color_texture, u, v, p);
+            rt::OpenPbrColorInput::base_color, base_color_texture, u, v, p, footprint);
         apply_binding(parameters, material.color_textures.specular_color,
-            rt::OpenPbrColorInput::specular_color, specular_color_texture, u, v, p);
+            rt::OpenPbrColorInput::specular_color, specular_color_texture, u, v, p, footprint);
         apply_binding(parameters, material.color_textures.transmission_color,
-            rt::OpenPbrColorInput::transmission_color, transmission_color_texture, u, v, p);
+            rt::OpenPbrColorInput::transmission_color, transmission_color_texture, u, v, p,
+            footprint);
         apply_binding(parameters, material.scalar_textures.base_metalness,
-            rt::OpenPbrScalarInput::base_metalness, base_metalness_texture, u, v, p);
+            rt::OpenPbrScalarInput::base_metalness, base_metalness_texture, u, v, p, footprint);
         apply_binding(parameters, material.scalar_textures.specular_roughness,
-            rt::OpenPbrScalarInput::specular_roughness, specular_roughness_texture, u, v, p);
+            rt::OpenPbrScalarInput::specular_roughness, specular_roughness_texture, u, v, p,
+            footprint);
+        apply_binding(parameters, material.color_textures.emission_color,
+            rt::OpenPbrColorInput::emission_color, emission_color_texture, u, v, p, footprint);
         return parameters;
     }
 
-    rt::OpenPbrCoreMaterial evaluated_emission_parameters(double u, double v,
-        const Vec3d& p) const {
+    rt::OpenPbrCoreMaterial evaluated_emission_parameters(double u, double v, const Vec3d& p,
+        double footprint) const {
         rt::OpenPbrCoreMaterial parameters = material.parameters;
         apply_binding(parameters, material.color_textures.emission_color,
-            rt::OpenPbrColorInput::emission_color, emission_color_texture, u, v, p);
+            rt::OpenPbrColorInput::emission_color, emission_color_texture, u, v, p, footprint);
         return parameters;
     }
 
@@ -329,6 +404,28 @@ private:
             static_cast<float>(value.z())};
     }
 
+    static double lobe_roughness(const rt::OpenPbrCoreMaterial& parameters,
+        const rt::OpenPbrSample& sample) {
+        if (sample.delta != 0) {
+            return 0.0;
+        }
+        switch (sample.event) {
+            case rt::OpenPbrScatterEvent::diffuse_reflection:
+            case rt::OpenPbrScatterEvent::fuzz_reflection:
+            case rt::OpenPbrScatterEvent::subsurface_exit: return 1.0;
+            case rt::OpenPbrScatterEvent::coat_reflection:
+                return std::clamp(static_cast<double>(parameters.coat_roughness), 0.0, 1.0);
+            case rt::OpenPbrScatterEvent::glossy_reflection:
+            case rt::OpenPbrScatterEvent::glossy_transmission:
+            case rt::OpenPbrScatterEvent::thin_walled_transmission:
+            case rt::OpenPbrScatterEvent::subsurface_entry:
+                return rt::openpbr_effective_specular_roughness(parameters);
+            case rt::OpenPbrScatterEvent::none:
+            case rt::OpenPbrScatterEvent::opacity_passthrough: return 0.0;
+        }
+        return 0.0;
+    }
+
     rt::OpenPbrCompiledMaterial material;
     pro::proxy<Texture> base_color_texture;
     pro::proxy<Texture> specular_color_texture;
@@ -343,15 +440,18 @@ struct DiffuseLight {
         : m_tex(pro::make_proxy_shared<Texture, SolidColor>(emit)) {}
     explicit DiffuseLight(const pro::proxy<Texture>& tex) : m_tex(tex) {}
 
+    MaterialKind kind() const { return MaterialKind::diffuse_light; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         if (!hit_rec.front_face) {
             return {0.0, 0.0, 0.0};
         }
-        return m_tex->value(u, v, p);
+        return m_tex->value(u, v, p, hit_rec.texture_footprint);
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler&) const {
         return false;
     }
 
@@ -372,15 +472,20 @@ struct Isotropic {
         : m_tex(pro::make_proxy_shared<Texture, SolidColor>(albedo)) {}
     explicit Isotropic(const pro::proxy<Texture>& tex) : m_tex(tex) {}
 
+    MaterialKind kind() const { return MaterialKind::isotropic; }
+
     Vec3d emitted(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
         const Vec3d& p) const {
         return {0.0, 0.0, 0.0};
     }
 
-    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const {
-        scatter_rec.attenuation = m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p);
-        scatter_rec.pdf = pro::make_proxy_shared<PDF, SpherePDF>();
+    bool scatter(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+        rt::PathSampler&) const {
+        scatter_rec.attenuation =
+            m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p, hit_rec.texture_footprint);
+        scatter_rec.pdf = SpherePDF {};
         scatter_rec.skip_pdf = false;
+        scatter_rec.lobe_roughness = 1.0;
         return true;
     }
 
@@ -390,7 +495,7 @@ struct Isotropic {
 
     Vec3d evaluate_direct(const Ray&, const HitRecord& hit_rec, const Vec3d&, double& pdf) const {
         pdf = 1.0 / (4.0 * pi);
-        return m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p) * pdf;
+        return m_tex->value(hit_rec.u, hit_rec.v, hit_rec.p, hit_rec.texture_footprint) * pdf;
     }
 
     pro::proxy<Texture> m_tex;
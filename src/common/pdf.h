@@ -5,10 +5,15 @@
 #include "common.h"
 #include "onb.h"
 
+#include <type_traits>
+#include <variant>
+
 
 struct SpherePDF {
     double value(const Vec3d& direction) const { return 1.0 / (4.0 * pi); }
-    Vec3d generate() const { return random_unit_vector(); }
+    Vec3d generate(rt::PathSampler& sampler) const {
+        return random_unit_vector(sampler.next_2d());
+    }
 };
 
 struct CosinePDF {
@@ -19,7 +24,9 @@ struct CosinePDF {
         return std::max(1e-8, cosine_theta / pi);
     }
 
-    Vec3d generate() const { return m_uvw.from_basis(random_cosine_direction()); }
+    Vec3d generate(rt::PathSampler& sampler) const {
+        return m_uvw.from_basis(random_cosine_direction(sampler.next_2d()));
+    }
 
     ONB m_uvw;
 };
@@ -29,55 +36,95 @@ struct UniformHemispherePDF {
 
     double value(const Vec3d&) const { return 1.0 / (2.0 * pi); }
 
-    Vec3d generate() const { return m_uvw.from_basis(random_uniform_hemisphere_direction()); }
+    Vec3d generate(rt::PathSampler& sampler) const {
+        return m_uvw.from_basis(random_uniform_hemisphere_direction(sampler.next_2d()));
+    }
 
     ONB m_uvw;
 };
 
-struct HittablePDF {
-    HittablePDF(const pro::proxy<Hittable>& objects, const Vec3d& origin)
-        : m_objects(objects),
-          m_origin(origin) {}
-
-    double value(const Vec3d& direction) const { return m_objects->pdf_value(m_origin, direction); }
-
-    Vec3d generate() const { return m_objects->random(m_origin); }
+// Sampling density a material hands back from scatter(). The set is closed and every member is a
+// value type, so filling a ScatterRecord never allocates. Materials that set skip_pdf or absorb
+// leave it empty.
+using ScatterPdf = std::variant<std::monostate, CosinePDF, SpherePDF, UniformHemispherePDF>;
+
+inline double pdf_value(const ScatterPdf& pdf, const Vec3d& direction) {
+    return std::visit(
+        [&](const auto& alternative) -> double {
+            if constexpr (std::is_same_v<std::decay_t<decltype(alternative)>, std::monostate>) {
+                return 0.0;
+            } else {
+                return alternative.value(direction);
+            }
+        },
+        pdf);
+}
 
-    pro::proxy<Hittable> m_objects;
-    Vec3d m_origin;
-};
+inline Vec3d pdf_generate(const ScatterPdf& pdf, rt::PathSampler& sampler) {
+    return std::visit(
+        [&](const auto& alternative) -> Vec3d {
+            if constexpr (std::is_same_v<std::decay_t<decltype(alternative)>, std::monostate>) {
+                return random_unit_vector(sampler.next_2d());
+            } else {
+                return alternative.generate(sampler);
+            }
+        },
+        pdf);
+}
 
-struct MixturePDF {
-    MixturePDF(const pro::proxy<PDF>& pdf0, const pro::proxy<PDF>& pdf1)
-        : m_pdf0(pdf0),
-          m_pdf1(pdf1) {}
+// One-sample MIS mixture for a non-specular bounce: half the directions come from the BSDF and
+// half from the direct-light densities, which split evenly between the geometric lights and the
+// environment when both are present. Without either the BSDF is used alone. The BSDF is copied
+// and the lights are borrowed, so it lives on the stack for the duration of the bounce.
+class LightMisPdf {
+public:
+    LightMisPdf(const ScatterPdf& bsdf_pdf, const pro::proxy<Hittable>& lights, const Vec3d& origin,
+        bool sample_environment)
+        : bsdf_pdf_(bsdf_pdf),
+          lights_(lights.has_value() ? &lights : nullptr),
+          origin_(origin),
+          sample_environment_(sample_environment) {}
 
     double value(const Vec3d& direction) const {
-        return 0.5 * m_pdf0->value(direction) + 0.5 * m_pdf1->value(direction);
+        const double bsdf = pdf_value(bsdf_pdf_, direction);
+        if (lights_ == nullptr && !sample_environment_) {
+            return bsdf;
+        }
+        return 0.5 * bsdf + 0.5 * direct_value(direction);
+    }
+
+    Vec3d generate(rt::PathSampler& sampler) const {
+        if (lights_ == nullptr && !sample_environment_) {
+            return pdf_generate(bsdf_pdf_, sampler);
+        }
+        if (sampler.next_1d() < 0.5) {
+            return pdf_generate(bsdf_pdf_, sampler);
+        }
+        if (lights_ != nullptr && sample_environment_) {
+            return sampler.next_1d() < 0.5 ? (*lights_)->random(origin_, sampler)
+                                           : SpherePDF {}.generate(sampler);
+        }
+        return lights_ != nullptr ? (*lights_)->random(origin_, sampler)
+                                  : SpherePDF {}.generate(sampler);
     }
 
-    Vec3d generate() const {
-        return (random_double() < 0.5) ? m_pdf0->generate() : m_pdf1->generate();
+private:
+    double direct_value(const Vec3d& direction) const {
+        const double environment = SpherePDF {}.value(direction);
+        if (lights_ == nullptr) {
+            return environment;
+        }
+        const double geometry = (*lights_)->pdf_value(origin_, direction);
+        return sample_environment_ ? 0.5 * geometry + 0.5 * environment : geometry;
     }
 
-    pro::proxy<PDF> m_pdf0;
-    pro::proxy<PDF> m_pdf1;
+    ScatterPdf bsdf_pdf_;
+    const pro::proxy<Hittable>* lights_;
+    Vec3d origin_;
+    bool sample_environment_;
 };
 
-inline pro::proxy<PDF> make_light_mis_pdf(const pro::proxy<PDF>& bsdf_pdf,
+inline LightMisPdf make_light_mis_pdf(const ScatterPdf& bsdf_pdf,
     const pro::proxy<Hittable>& lights, const Vec3d& origin, bool sample_environment) {
-    pro::proxy<PDF> direct_pdf;
-    if (lights.has_value()) {
-        direct_pdf = pro::make_proxy_shared<PDF, HittablePDF>(lights, origin);
-    }
-    if (sample_environment) {
-        pro::proxy<PDF> environment_pdf = pro::make_proxy_shared<PDF, SpherePDF>();
-        direct_pdf = direct_pdf.has_value()
-                         ? pro::make_proxy_shared<PDF, MixturePDF>(direct_pdf, environment_pdf)
-                         : environment_pdf;
-    }
-    if (!direct_pdf.has_value()) {
-        return bsdf_pdf;
-    }
-    return pro::make_proxy_shared<PDF, MixturePDF>(bsdf_pdf, direct_pdf);
+    return LightMisPdf {bsdf_pdf, lights, origin, sample_environment};
 }
@@ -6,13 +6,16 @@
 #include <numeric>
 
 struct Perlin {
-    Perlin() {
+    explicit Perlin(const std::uint64_t seed = 0) {
+        // A fixed stream makes the lattice identical for every instance built with the same seed,
+        // whichever thread constructs it
+        rt::PathSampler sampler {0, 0, seed};
         for (auto& elem : m_rand_vec) {
-            elem = Vec3d::Random().normalized();
+            elem = random_unit_vector(sampler.next_2d());
         }
-        perlin_generate_perm(m_perm_x);
-        perlin_generate_perm(m_perm_y);
-        perlin_generate_perm(m_perm_z);
+        perlin_generate_perm(m_perm_x, sampler);
+        perlin_generate_perm(m_perm_y, sampler);
+        perlin_generate_perm(m_perm_z, sampler);
     }
 
     double noise(const Vec3d& p) const {
@@ -58,11 +61,11 @@ private:
     std::array<int, s_point_count> m_perm_y;
     std::array<int, s_point_count> m_perm_z;
 
-    static void perlin_generate_perm(std::array<int, s_point_count>& p) {
+    static void perlin_generate_perm(std::array<int, s_point_count>& p, rt::PathSampler& sampler) {
         std::iota(p.begin(), p.end(), 0);
 
         for (int i = s_point_count - 1; i > 0; --i) {
-            const int target_idx = random_int(0, i);
+            const int target_idx = sampler.next_int(0, i);
             std::swap(p[i], p[target_idx]);
         }
     }
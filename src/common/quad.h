@@ -45,8 +45,9 @@ struct Quad {
         return distance_sq / (cosine * m_area);
     }
 
-    Vec3d random(const Vec3d& origin) const {
-        const Vec3d p = m_Q + (random_double() * m_u) + (random_double() * m_v);
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        const Eigen::Vector2d u = sampler.next_2d();
+        const Vec3d p = m_Q + (u.x() * m_u) + (u.y() * m_v);
         return p - origin;
     }
 
@@ -79,6 +80,7 @@ struct Quad {
         hit_rec.p = intersection;
         hit_rec.mat = m_mat;
         hit_rec.set_face_normal(ray, m_normal);
+        hit_rec.set_texture_footprint(ray, 1.0 / std::sqrt(m_area));
 
         return true;
     }
@@ -3,6 +3,16 @@
 #include "common.h"
 #include "common/openpbr_core.h"
 
+// Ray cone for texture level of detail: the width of the beam a ray stands for at its origin and
+// the angle it widens by per unit of distance travelled. A zero cone samples textures at their
+// finest level.
+struct RayCone {
+    double width = 0.0;
+    double spread = 0.0;
+
+    double width_at(const double distance) const { return width + spread * distance; }
+};
+
 class Ray {
 
 public:
@@ -23,6 +33,11 @@ public:
     double time() const { return m_time; }
     const rt::OpenPbrSubsurfaceMedium& subsurface_medium() const { return m_subsurface_medium; }
     const void* subsurface_owner() const { return m_subsurface_owner; }
+    const RayCone& cone() const { return m_cone; }
+    void set_cone(const RayCone& cone) { m_cone = cone; }
+    // Sampler of the path vertex the ray leaves, for the draws `hit` takes; null off a path
+    const rt::PathSampler* sampler() const { return m_sampler; }
+    void set_sampler(const rt::PathSampler* sampler) { m_sampler = sampler; }
 
     Vec3d at(const double t) const { return m_origin + m_direction * t; }
 
@@ -32,4 +47,6 @@ private:
     double m_time = 0.0;
     rt::OpenPbrSubsurfaceMedium m_subsurface_medium {};
     const void* m_subsurface_owner = nullptr;
+    RayCone m_cone {};
+    const rt::PathSampler* m_sampler = nullptr;
 };
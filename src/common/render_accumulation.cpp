@@ -0,0 +1,185 @@
+#include "common/render_accumulation.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+namespace rt {
+namespace {
+
+constexpr std::array<char, 8> kCheckpointMagic {'R', 'T', 'A', 'C', 'C', 'U', 'M', '1'};
+constexpr std::uint32_t kCheckpointVersion = 2;
+constexpr std::uint32_t kMaxLabelLength = 4096;
+
+struct CheckpointHeader {
+    std::array<char, 8> magic = kCheckpointMagic;
+    std::uint32_t version = kCheckpointVersion;
+    std::int32_t width = 0;
+    std::int32_t height = 0;
+    std::int32_t target_samples_per_pixel = 0;
+    std::uint64_t seed = 0;
+    std::uint32_t label_length = 0;
+};
+
+template <typename T>
+void write_value(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void read_value(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void write_matrix(std::ofstream& out, const cv::Mat& mat) {
+    const cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+    out.write(reinterpret_cast<const char*>(continuous.data),
+        static_cast<std::streamsize>(continuous.total() * continuous.elemSize()));
+}
+
+void read_matrix(std::ifstream& in, cv::Mat& mat) {
+    in.read(reinterpret_cast<char*>(mat.data),
+        static_cast<std::streamsize>(mat.total() * mat.elemSize()));
+}
+
+} // namespace
+
+int RenderAccumulation::min_sample_count() const {
+    if (sample_count.empty()) {
+        return 0;
+    }
+    int min_count = std::numeric_limits<int>::max();
+    for (int y = 0; y < sample_count.rows; ++y) {
+        const std::int32_t* row = sample_count.ptr<std::int32_t>(y);
+        for (int x = 0; x < sample_count.cols; ++x) {
+            min_count = std::min(min_count, static_cast<int>(row[x]));
+        }
+    }
+    return min_count;
+}
+
+std::uint64_t RenderAccumulation::total_sample_count() const {
+    std::uint64_t total = 0;
+    for (int y = 0; y < sample_count.rows; ++y) {
+        const std::int32_t* row = sample_count.ptr<std::int32_t>(y);
+        for (int x = 0; x < sample_count.cols; ++x) {
+            total += static_cast<std::uint64_t>(row[x]);
+        }
+    }
+    return total;
+}
+
+RenderAccumulation make_render_accumulation(const int width, const int height,
+    const int target_samples_per_pixel, const std::uint64_t seed) {
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("render accumulation dimensions must be positive");
+    }
+    if (target_samples_per_pixel <= 0) {
+        throw std::invalid_argument("render accumulation sample target must be positive");
+    }
+    RenderAccumulation accumulation;
+    accumulation.target_samples_per_pixel = target_samples_per_pixel;
+    accumulation.seed = seed;
+    accumulation.radiance_sum = cv::Mat(height, width, CV_32FC3, cv::Scalar::all(0.0));
+    accumulation.luminance_square_sum = cv::Mat(height, width, CV_32FC1, cv::Scalar::all(0.0));
+    accumulation.sample_count = cv::Mat(height, width, CV_32SC1, cv::Scalar::all(0.0));
+    return accumulation;
+}
+
+void save_render_checkpoint(
+    const std::filesystem::path& path, const RenderAccumulation& accumulation) {
+    if (accumulation.empty() || accumulation.radiance_sum.type() != CV_32FC3
+        || accumulation.luminance_square_sum.type() != CV_32FC1
+        || accumulation.sample_count.type() != CV_32SC1
+        || accumulation.luminance_square_sum.size() != accumulation.radiance_sum.size()
+        || accumulation.sample_count.size() != accumulation.radiance_sum.size()) {
+        throw std::invalid_argument("render checkpoint needs float sums and int32 sample counts");
+    }
+    if (accumulation.label.size() > kMaxLabelLength) {
+        throw std::invalid_argument("render checkpoint label is too long");
+    }
+
+    const CheckpointHeader header {
+        .width = accumulation.width(),
+        .height = accumulation.height(),
+        .target_samples_per_pixel = accumulation.target_samples_per_pixel,
+        .seed = accumulation.seed,
+        .label_length = static_cast<std::uint32_t>(accumulation.label.size()),
+    };
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("failed to open render checkpoint for writing: "
+                                     + temporary.string());
+        }
+        write_value(out, header.magic);
+        write_value(out, header.version);
+        write_value(out, header.width);
+        write_value(out, header.height);
+        write_value(out, header.target_samples_per_pixel);
+        write_value(out, header.seed);
+        write_value(out, header.label_length);
+        out.write(accumulation.label.data(),
+            static_cast<std::streamsize>(accumulation.label.size()));
+        write_matrix(out, accumulation.radiance_sum);
+        write_matrix(out, accumulation.luminance_square_sum);
+        write_matrix(out, accumulation.sample_count);
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("failed to write render checkpoint: " + temporary.string());
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        throw std::runtime_error("failed to move render checkpoint into place: " + path.string());
+    }
+}
+
+RenderAccumulation load_render_checkpoint(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("failed to open render checkpoint: " + path.string());
+    }
+
+    CheckpointHeader header;
+    read_value(in, header.magic);
+    read_value(in, header.version);
+    read_value(in, header.width);
+    read_value(in, header.height);
+    read_value(in, header.target_samples_per_pixel);
+    read_value(in, header.seed);
+    read_value(in, header.label_length);
+    if (!in || header.magic != kCheckpointMagic) {
+        throw std::runtime_error("not a render checkpoint: " + path.string());
+    }
+    if (header.version != kCheckpointVersion) {
+        throw std::runtime_error("unsupported render checkpoint version: " + path.string());
+    }
+    if (header.label_length > kMaxLabelLength) {
+        throw std::runtime_error("corrupt render checkpoint label: " + path.string());
+    }
+
+    RenderAccumulation accumulation = make_render_accumulation(
+        header.width, header.height, header.target_samples_per_pixel, header.seed);
+    accumulation.label.resize(header.label_length);
+    in.read(accumulation.label.data(), static_cast<std::streamsize>(header.label_length));
+    read_matrix(in, accumulation.radiance_sum);
+    read_matrix(in, accumulation.luminance_square_sum);
+    read_matrix(in, accumulation.sample_count);
+    if (!in) {
+        throw std::runtime_error("truncated render checkpoint: " + path.string());
+    }
+    return accumulation;
+}
+
+} // namespace rt
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace rt {
+
+// Linear radiance summed over the samples rendered so far, with per-pixel sample counts. Every
+// draw of the counter-based sampler is a function of (pixel, sample index, seed), so the seed and
+// the counts are the whole sampler state: pixel p resumes at sample index sample_count(p).
+struct RenderAccumulation {
+    std::string label;                // Identifies the render, e.g. the scene id
+    int target_samples_per_pixel = 0; // Samples each pixel receives once the render completes
+    std::uint64_t seed = 0;
+    cv::Mat radiance_sum;          // CV_32FC3 linear RGB
+    cv::Mat luminance_square_sum;  // CV_32FC1, for per-pixel variance estimates
+    cv::Mat sample_count;          // CV_32SC1
+
+    bool empty() const { return radiance_sum.empty(); }
+    int width() const { return radiance_sum.cols; }
+    int height() const { return radiance_sum.rows; }
+
+    // Fewest samples any pixel has received
+    int min_sample_count() const;
+    std::uint64_t total_sample_count() const;
+    bool complete() const { return !empty() && min_sample_count() >= target_samples_per_pixel; }
+};
+
+RenderAccumulation make_render_accumulation(
+    int width, int height, int target_samples_per_pixel, std::uint64_t seed);
+
+// Checkpoints are a small header followed by the raw float sums and int32 counts in host byte
+// order. They are written to a sibling temporary file and renamed into place, so an interrupted
+// write never replaces the previous checkpoint.
+void save_render_checkpoint(
+    const std::filesystem::path& path, const RenderAccumulation& accumulation);
+RenderAccumulation load_render_checkpoint(const std::filesystem::path& path);
+
+} // namespace rt
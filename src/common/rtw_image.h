@@ -1,15 +1,15 @@
 #pragma once
 
 #include "common.h"
+#include "common/texture_cache.h"
 
-#include <opencv2/opencv.hpp>
 #include <fmt/core.h>
 
 struct RTWImage {
-    cv::Mat m_f32Mat;
-    cv::Mat m_u8Mat;
+    rt::DecodedTextureHandle m_texture;
 
     RTWImage() = default;
+    explicit RTWImage(rt::DecodedTextureHandle texture) : m_texture(std::move(texture)) {}
     RTWImage(const std::string& img_filepath) {
         if (load(img_filepath)) {
             return;
@@ -18,22 +18,8 @@ struct RTWImage {
     }
 
     bool load(const std::string& img_filepath) {
-        cv::Mat img = cv::imread(img_filepath);
-        if (img.empty()) {
-            return false;
-        }
-
-        cv::cvtColor(img, m_u8Mat, cv::COLOR_BGR2RGB);
-        if (m_u8Mat.empty()) {
-            return false;
-        }
-
-        m_u8Mat.convertTo(m_f32Mat, CV_32FC3, 1 / 255.0);
-        if (m_f32Mat.empty()) {
-            return false;
-        }
-
-        return true;
+        m_texture = rt::global_texture_cache().load(img_filepath);
+        return is_valid();
     }
 
     Vec3d pixel_data(const int x, const int y) const {
@@ -44,13 +30,23 @@ struct RTWImage {
         const int clamped_x = std::clamp(x, 0, width() - 1);
         const int clamped_y = std::clamp(y, 0, height() - 1);
 
-        const cv::Vec3f cv_pixel = m_f32Mat.at<cv::Vec3f>(y, x);
+        const std::uint8_t* texel = m_texture->texel(clamped_x, clamped_y);
 
-        return {cv_pixel[0], cv_pixel[1], cv_pixel[2]};
+        return {rt::DecodedTexture::unit_value(texel[0]), rt::DecodedTexture::unit_value(texel[1]),
+            rt::DecodedTexture::unit_value(texel[2])};
+    }
+
+    // Trilinear lookup at image coordinates s, t in [0, 1] (t = 0 on the top row) over a
+    // footprint of the given width in the same units
+    Vec3d sample(const double s, const double t, const double footprint) const {
+        if (!is_valid()) {
+            return {1.0, 0.0, 1.0};
+        }
+        return m_texture->mips.sample(s, t, footprint).cast<double>();
     }
 
-    int width() const { return m_u8Mat.cols; }
-    int height() const { return m_u8Mat.rows; }
+    int width() const { return m_texture ? m_texture->width() : 0; }
+    int height() const { return m_texture ? m_texture->height() : 0; }
 
-    bool is_valid() const { return !m_f32Mat.empty() && !m_u8Mat.empty(); }
+    bool is_valid() const { return m_texture && !m_texture->mips.empty(); }
 };
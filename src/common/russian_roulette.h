@@ -0,0 +1,33 @@
+#pragma once
+
+namespace rt {
+
+#if defined(__CUDACC__)
+#define RT_ROULETTE_HD     __host__ __device__
+#define RT_ROULETTE_INLINE __forceinline__
+#else
+#define RT_ROULETTE_HD
+#define RT_ROULETTE_INLINE inline
+#endif
+
+// Russian roulette policy shared by the CPU and GPU path tracers. From `start_bounce` on, a path
+// continues with the survival probability of its throughput and survivors divide their throughput
+// by it, so terminating paths adds noise but no bias. A negative start bounce disables roulette.
+inline constexpr int kDefaultRussianRouletteStartBounce = 3;
+
+RT_ROULETTE_HD RT_ROULETTE_INLINE bool russian_roulette_applies(
+    const int bounce, const int start_bounce) {
+    return start_bounce >= 0 && bounce >= start_bounce;
+}
+
+// Bright paths are kept almost surely and dim ones are still given a small chance, which bounds
+// the weight a survivor can gain in one step
+template <typename Scalar>
+RT_ROULETTE_HD RT_ROULETTE_INLINE Scalar russian_roulette_survival_probability(
+    const Scalar max_throughput_component) {
+    const Scalar p = max_throughput_component > Scalar(0.05) ? max_throughput_component
+                                                              : Scalar(0.05);
+    return p < Scalar(0.95) ? p : Scalar(0.95);
+}
+
+} // namespace rt
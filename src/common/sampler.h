@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+namespace rt {
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"). The generator is a
+// pure function of a 128-bit counter and a 64-bit key, so any sample can be recomputed on any
+// thread without shared state.
+using PhiloxCounter = std::array<std::uint32_t, 4>;
+using PhiloxKey = std::array<std::uint32_t, 2>;
+
+inline PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) {
+    constexpr std::uint32_t kMultiplier0 = 0xD2511F53u;
+    constexpr std::uint32_t kMultiplier1 = 0xCD9E8D57u;
+    constexpr std::uint32_t kWeyl0 = 0x9E3779B9u;
+    constexpr std::uint32_t kWeyl1 = 0xBB67AE85u;
+
+    for (int round = 0; round < 10; ++round) {
+        const std::uint64_t product0 = std::uint64_t {kMultiplier0} * counter[0];
+        const std::uint64_t product1 = std::uint64_t {kMultiplier1} * counter[2];
+        counter = {
+            static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<std::uint32_t>(product1),
+            static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<std::uint32_t>(product0),
+        };
+        key[0] += kWeyl0;
+        key[1] += kWeyl1;
+    }
+    return counter;
+}
+
+inline PhiloxKey philox_key(const std::uint64_t seed) {
+    return {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+}
+
+inline double bits_to_unit_double(const std::uint32_t high, const std::uint32_t low) {
+    // Uses the top 53 bits so the result is exactly representable and strictly below 1
+    const std::uint64_t bits = (std::uint64_t {high} << 32) | low;
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+inline int unit_double_to_int(const double u, const int min, const int max) {
+    // Maps a [0,1) real onto [min, max]
+    return std::min(max, min + static_cast<int>(u * (static_cast<double>(max) - min + 1.0)));
+}
+
+// Counter-based sample stream for one camera path. Every draw is addressed by
+// (pixel, sample index, bounce, dimension), so the value consumed at a given path vertex does not
+// depend on which thread renders the pixel or in what order pixels are scheduled.
+class PathSampler {
+public:
+    PathSampler(const std::uint32_t pixel_index, const std::uint32_t sample_index,
+        const std::uint64_t seed = 0)
+        : pixel_index_(pixel_index),
+          sample_index_(sample_index),
+          key_(philox_key(seed)) {}
+
+    // Restarts the dimension counter; call once at every path vertex.
+    void start_bounce(const int bounce) {
+        bounce_ = static_cast<std::uint32_t>(bounce);
+        dimension_ = 0;
+    }
+
+    int bounce() const { return static_cast<int>(bounce_); }
+    std::uint32_t dimension() const { return dimension_; }
+
+    double next_1d() {
+        const PhiloxCounter bits = next_block();
+        return bits_to_unit_double(bits[0], bits[1]);
+    }
+
+    // Both components come from a single block, so a 2D draw costs one dimension.
+    Eigen::Vector2d next_2d() {
+        const PhiloxCounter bits = next_block();
+        return {bits_to_unit_double(bits[0], bits[1]), bits_to_unit_double(bits[2], bits[3])};
+    }
+
+    int next_int(const int min, const int max) {
+        // Returns an int in [min, max]
+        return unit_double_to_int(next_1d(), min, max);
+    }
+
+    // Draw addressed by the current vertex and `key` instead of the dimension counter, for
+    // samples whose draw order is not fixed: `hit` may test several media along a ray, in
+    // whatever order the BVH visits them.
+    double keyed_1d(const std::uint64_t key) const {
+        constexpr std::uint32_t kKeyedStream = 0x4B455944u;
+        const PhiloxCounter bits =
+            philox4x32({pixel_index_, sample_index_, bounce_, static_cast<std::uint32_t>(key)},
+                {key_[0] ^ static_cast<std::uint32_t>(key >> 32), key_[1] ^ kKeyedStream});
+        return bits_to_unit_double(bits[0], bits[1]);
+    }
+
+private:
+    PhiloxCounter next_block() {
+        return philox4x32({pixel_index_, sample_index_, bounce_, dimension_++}, key_);
+    }
+
+    std::uint32_t pixel_index_ = 0;
+    std::uint32_t sample_index_ = 0;
+    std::uint32_t bounce_ = 0;
+    std::uint32_t dimension_ = 0;
+    PhiloxKey key_ {};
+};
+
+// Key of a ray for PathSampler::keyed_1d; distinct rays get decorrelated keys.
+inline std::uint64_t ray_key(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction) {
+    std::uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (const double value : {origin.x(), origin.y(), origin.z(), direction.x(), direction.y(),
+             direction.z()}) {
+        h = (h ^ std::bit_cast<std::uint64_t>(value)) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+// Stateless draw keyed by `key` alone, for rays traced outside a camera path, which carry no
+// sampler; a repeated query is stable.
+inline double keyed_unit_double(const std::uint64_t key) {
+    const PhiloxCounter bits = philox4x32({static_cast<std::uint32_t>(key),
+                                              static_cast<std::uint32_t>(key >> 32), 0u, 0u},
+        philox_key(0x5EED5EEDull));
+    return bits_to_unit_double(bits[0], bits[1]);
+}
+
+// Identifies the calling thread's stream for the legacy `random_double()` helpers.
+inline std::uint32_t allocate_thread_stream() {
+    static std::atomic<std::uint32_t> next_stream {0};
+    return next_stream.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace rt
@@ -48,11 +48,11 @@ public:
         return std::max(1e-8, 1.0 / solid_angle);
     }
 
-    Vec3d random(const Vec3d& origin) const {
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
         const Vec3d direction = m_center.at(0.0) - origin;
         const double distance_sq = direction.squaredNorm();
         const ONB uvw {direction};
-        return uvw.from_basis(random_to_sphere(m_radius, distance_sq));
+        return uvw.from_basis(random_to_sphere(m_radius, distance_sq, sampler));
     }
 
     bool hit(const Ray& ray, const Interval& ray_t, HitRecord& hit_rec) const {
@@ -83,6 +83,8 @@ public:
         const Vec3d outward_normal = (hit_rec.p - current_center) / m_radius;
         hit_rec.set_face_normal(ray, outward_normal);
         get_sphere_uv(outward_normal, hit_rec.u, hit_rec.v);
+        // The unit uv square covers the 4 pi r^2 of the surface
+        hit_rec.set_texture_footprint(ray, 0.5 / (m_radius * std::sqrt(pi)));
         hit_rec.mat = m_mat;
 
         return true;
@@ -103,9 +105,11 @@ public:
         v = theta / pi;
     }
 
-    static Vec3d random_to_sphere(const double radius, const double distance_sq) {
-        const double r1 = random_double();
-        const double r2 = random_double();
+    static Vec3d random_to_sphere(const double radius, const double distance_sq,
+        rt::PathSampler& sampler) {
+        const Eigen::Vector2d u = sampler.next_2d();
+        const double r1 = u.x();
+        const double r2 = u.y();
 
         const double z = 1.0 + r2 * (std::sqrt(1.0 - radius * radius / distance_sq) - 1.0);
 
@@ -12,7 +12,9 @@ struct SolidColor {
     SolidColor(const double red, const double green, const double blue)
         : SolidColor(Vec3d {red, green, blue}) {}
 
-    Vec3d value(const double u, const double v, const Vec3d& p) const { return m_albedo; }
+    Vec3d value(const double u, const double v, const Vec3d& p, const double footprint) const {
+        return m_albedo;
+    }
 
     Vec3d m_albedo;
 };
@@ -28,14 +30,14 @@ struct CheckerTexture {
         : CheckerTexture(scale, pro::make_proxy_shared<Texture, SolidColor>(color1),
               pro::make_proxy_shared<Texture, SolidColor>(color2)) {}
 
-    Vec3d value(const double u, const double v, const Vec3d& p) const {
+    Vec3d value(const double u, const double v, const Vec3d& p, const double footprint) const {
         const int x = std::floor(m_inv_scale * p.x());
         const int y = std::floor(m_inv_scale * p.y());
         const int z = std::floor(m_inv_scale * p.z());
 
         const bool isEven = (x + y + z) % 2 == 0;
 
-        return isEven ? m_even->value(u, v, p) : m_odd->value(u, v, p);
+        return isEven ? m_even->value(u, v, p, footprint) : m_odd->value(u, v, p, footprint);
     }
 
     double m_inv_scale;
@@ -45,8 +47,9 @@ struct CheckerTexture {
 
 struct ImageTexture {
     ImageTexture(const std::string& img_filepath) : m_image(img_filepath) {}
+    ImageTexture(rt::DecodedTextureHandle image) : m_image(std::move(image)) {}
 
-    Vec3d value(const double u, const double v, const Vec3d& p) const {
+    Vec3d value(const double u, const double v, const Vec3d& p, const double footprint) const {
         // If we have no texture data, then return solid cyan as a debugging aid.
         if (m_image.height() <= 0) {
             return {0.0, 1.0, 1.0};
@@ -57,10 +60,11 @@ struct ImageTexture {
         // Flip Y to image coordinates
         const double clamped_v = std::clamp(1.0 - v, 0.0, 1.0);
 
-        const int i = int(clamped_u * m_image.width());
-        const int j = int(clamped_v * m_image.height());
-
-        return m_image.pixel_data(i, j);
+        // Bilinear on the finest level for a point footprint, trilinear across mips otherwise.
+        // Lookups used to return the nearest texel, so between texel centers colors now blend:
+        // magnified textures read smooth rather than blocky, and a point footprint only returns
+        // an exact texel at its center.
+        return m_image.sample(clamped_u, clamped_v, footprint);
     }
 
     RTWImage m_image;
@@ -69,7 +73,7 @@ struct ImageTexture {
 struct NoiseTexture {
     NoiseTexture(const double scale) : m_scale(scale) {}
 
-    Vec3d value(const double u, const double v, const Vec3d& p) const {
+    Vec3d value(const double u, const double v, const Vec3d& p, const double footprint) const {
         return Vec3d {0.5, 0.5, 0.5}
                * (1.0 + std::sin(m_scale * p.z() + 10.0 * m_noise.turb(p, 7)));
     }
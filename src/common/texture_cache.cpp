@@ -0,0 +1,202 @@
+#include "common/texture_cache.h"
+
+#include "common/content_hash.h"
+
+#include <opencv2/opencv.hpp>
+#include <tbb/parallel_for.h>
+
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <system_error>
+
+namespace rt {
+namespace {
+
+std::optional<std::filesystem::path> resolve_texture_path(const std::string& path) {
+    const std::array<std::filesystem::path, 3> candidates {std::filesystem::path(path),
+        std::filesystem::path("..") / path, std::filesystem::path("../..") / path};
+    for (const std::filesystem::path& candidate : candidates) {
+        std::error_code error;
+        if (std::filesystem::is_regular_file(candidate, error)) {
+            const std::filesystem::path resolved =
+                std::filesystem::weakly_canonical(candidate, error);
+            return error ? candidate : resolved;
+        }
+        if (candidate.is_absolute()) {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::vector<unsigned char>> read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+} // namespace
+
+float DecodedTexture::unit_value(std::uint8_t value) {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> values {};
+        for (int i = 0; i < 256; ++i) {
+            values[static_cast<std::size_t>(i)] = static_cast<float>(i * (1.0 / 255.0));
+        }
+        return values;
+    }();
+    return table[value];
+}
+
+DecodedTextureHandle TextureCache::load(const std::string& path) {
+    const std::optional<std::filesystem::path> resolved = resolve_texture_path(path);
+    std::error_code size_error;
+    std::error_code time_error;
+    const std::uintmax_t file_size =
+        resolved ? std::filesystem::file_size(*resolved, size_error) : 0;
+    const std::filesystem::file_time_type write_time =
+        resolved ? std::filesystem::last_write_time(*resolved, time_error)
+                 : std::filesystem::file_time_type {};
+    {
+        const std::lock_guard lock(mutex_);
+        ++stats_.lookups;
+        if (!resolved || size_error || time_error) {
+            ++stats_.failures;
+            return nullptr;
+        }
+        const auto known = paths_.find(*resolved);
+        if (known != paths_.end() && known->second.file_size == file_size
+            && known->second.write_time == write_time) {
+            if (DecodedTextureHandle texture = find_texture(known->second.content_hash)) {
+                ++stats_.hits;
+                return texture;
+            }
+        }
+    }
+
+    const std::optional<std::vector<unsigned char>> bytes = read_file(*resolved);
+    if (!bytes) {
+        const std::lock_guard lock(mutex_);
+        ++stats_.failures;
+        return nullptr;
+    }
+    const std::uint64_t hash = hash_bytes(kHashSeed, bytes->data(), bytes->size());
+    {
+        const std::lock_guard lock(mutex_);
+        paths_[*resolved] =
+            PathEntry {.file_size = file_size, .write_time = write_time, .content_hash = hash};
+        if (DecodedTextureHandle texture = find_texture(hash)) {
+            ++stats_.hits;
+            return texture;
+        }
+    }
+
+    const cv::Mat bgr = cv::imdecode(*bytes, cv::IMREAD_COLOR);
+    if (bgr.empty()) {
+        const std::lock_guard lock(mutex_);
+        ++stats_.failures;
+        return nullptr;
+    }
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    auto decoded = std::make_shared<DecodedTexture>();
+    decoded->resolved_path = *resolved;
+    decoded->content_hash = hash;
+    decoded->mips = TextureMipPyramid(rgb.cols, rgb.rows, rgb.ptr<std::uint8_t>(0), rgb.step[0]);
+
+    const std::lock_guard lock(mutex_);
+    ++stats_.decodes;
+    // Another thread may have decoded the same contents meanwhile; keep the first copy
+    if (DecodedTextureHandle texture = find_texture(hash)) {
+        return texture;
+    }
+    TextureEntry& entry = textures_[hash];
+    DecodedTextureHandle texture = std::move(decoded);
+    entry = TextureEntry {.texture = texture, .retained = retained_.end()};
+    retain(entry, texture);
+    return texture;
+}
+
+std::vector<DecodedTextureHandle> TextureCache::load_all(const std::vector<std::string>& paths) {
+    std::vector<DecodedTextureHandle> textures(paths.size());
+    tbb::parallel_for(std::size_t {0}, paths.size(),
+        [&](std::size_t index) { textures[index] = load(paths[index]); });
+    return textures;
+}
+
+TextureCacheStats TextureCache::stats() const {
+    const std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+void TextureCache::clear() {
+    const std::lock_guard lock(mutex_);
+    paths_.clear();
+    textures_.clear();
+    retained_.clear();
+    stats_ = {};
+}
+
+void TextureCache::set_capacity_bytes(std::uint64_t bytes) {
+    const std::lock_guard lock(mutex_);
+    capacity_bytes_ = bytes;
+    evict_over_capacity();
+}
+
+std::uint64_t TextureCache::capacity_bytes() const {
+    const std::lock_guard lock(mutex_);
+    return capacity_bytes_;
+}
+
+DecodedTextureHandle TextureCache::find_texture(std::uint64_t content_hash) {
+    const auto found = textures_.find(content_hash);
+    if (found == textures_.end()) {
+        return nullptr;
+    }
+    DecodedTextureHandle texture = found->second.texture.lock();
+    if (!texture) {
+        textures_.erase(found);
+        return nullptr;
+    }
+    retain(found->second, texture);
+    return texture;
+}
+
+void TextureCache::retain(TextureEntry& entry, const DecodedTextureHandle& texture) {
+    if (entry.retained != retained_.end()) {
+        retained_.splice(retained_.begin(), retained_, entry.retained);
+        return;
+    }
+    retained_.push_front(texture);
+    entry.retained = retained_.begin();
+    ++stats_.texture_count;
+    stats_.resident_bytes += texture->byte_size();
+    evict_over_capacity();
+}
+
+void TextureCache::evict_over_capacity() {
+    while (stats_.resident_bytes > capacity_bytes_ && !retained_.empty()) {
+        const DecodedTextureHandle& oldest = retained_.back();
+        textures_.at(oldest->content_hash).retained = retained_.end();
+        --stats_.texture_count;
+        stats_.resident_bytes -= oldest->byte_size();
+        ++stats_.evictions;
+        retained_.pop_back();
+    }
+}
+
+TextureCache& global_texture_cache() {
+    static TextureCache cache;
+    return cache;
+}
+
+} // namespace rt
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common/texture_mip_pyramid.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+// One decoded image, shared by every texture that references the same file contents. Texels are
+// kept once, as 8-bit RGB straight from the file in a tiled mip pyramid; unit_value() gives the
+// float both backends sample, so neither keeps a float copy of its own.
+struct DecodedTexture {
+    std::filesystem::path resolved_path; // First path this content was loaded from
+    std::uint64_t content_hash = 0;      // Hash of the encoded file bytes
+    TextureMipPyramid mips;              // Level 0 is the image as decoded, in RGB order
+
+    int width() const { return mips.width(); }
+    int height() const { return mips.height(); }
+    std::size_t byte_size() const { return mips.byte_size(); }
+    const std::uint8_t* texel(int x, int y) const { return mips.texel(0, x, y); }
+
+    // Same rounding as converting the 8-bit image to CV_32F with a 1/255 scale
+    static float unit_value(std::uint8_t value);
+};
+
+using DecodedTextureHandle = std::shared_ptr<const DecodedTexture>;
+
+struct TextureCacheStats {
+    std::uint64_t lookups = 0;
+    std::uint64_t hits = 0;             // Served without decoding, by path or by content
+    std::uint64_t decodes = 0;
+    std::uint64_t failures = 0;         // Missing or undecodable files
+    std::uint64_t evictions = 0;        // Textures released to stay within the capacity
+    std::uint64_t texture_count = 0;    // Distinct decoded contents held
+    std::uint64_t resident_bytes = 0;   // Decoded texel bytes held, mip levels included
+
+    double hit_rate() const {
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+// Process-wide cache of decoded image textures, keyed by resolved path and by the hash of the
+// file contents: a file referenced twice, or the same bytes under two names, is decoded once. A
+// path is re-read when its size or modification time changes. Thread-safe; decoding runs outside
+// the lock.
+//
+// The cache holds at most capacity_bytes() of decoded texels, releasing the least recently used
+// textures beyond it. A released texture that a handle elsewhere still references is found again
+// and shared rather than decoded twice.
+class TextureCache {
+public:
+    static constexpr std::uint64_t kDefaultCapacityBytes = std::uint64_t {1} << 30;
+
+    // Returns null when the file cannot be found or decoded. Relative paths that do not resolve
+    // from the working directory are retried from its parent and grandparent, as build trees run
+    // binaries one or two levels below the source root.
+    DecodedTextureHandle load(const std::string& path);
+    // Loads every path in parallel; results are in input order.
+    std::vector<DecodedTextureHandle> load_all(const std::vector<std::string>& paths);
+
+    TextureCacheStats stats() const;
+    void clear();
+    // Evicts down to the new capacity at once
+    void set_capacity_bytes(std::uint64_t bytes);
+    std::uint64_t capacity_bytes() const;
+
+private:
+    struct PathEntry {
+        std::uintmax_t file_size = 0;
+        std::filesystem::file_time_type write_time {};
+        std::uint64_t content_hash = 0;
+    };
+
+    struct TextureEntry {
+        std::weak_ptr<const DecodedTexture> texture;
+        std::list<DecodedTextureHandle>::iterator retained; // retained_.end() once evicted
+    };
+
+    // Callers hold mutex_
+    DecodedTextureHandle find_texture(std::uint64_t content_hash);
+    void retain(TextureEntry& entry, const DecodedTextureHandle& texture);
+    void evict_over_capacity();
+
+    mutable std::mutex mutex_;
+    std::map<std::filesystem::path, PathEntry> paths_;
+    std::map<std::uint64_t, TextureEntry> textures_;
+    std::list<DecodedTextureHandle> retained_; // Most recently used first
+    std::uint64_t capacity_bytes_ = kDefaultCapacityBytes;
+    TextureCacheStats stats_ {};
+};
+
+TextureCache& global_texture_cache();
+
+} // namespace rt
@@ -0,0 +1,129 @@
+#include "common/texture_mip_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rt {
+namespace {
+
+constexpr std::size_t kTileBytes = 3 * TextureMipPyramid::kTileSize * TextureMipPyramid::kTileSize;
+
+int tile_count(int texels) {
+    return (texels + TextureMipPyramid::kTileSize - 1) >> TextureMipPyramid::kTileShift;
+}
+
+} // namespace
+
+TextureMipPyramid::TextureMipPyramid(int width, int height, const std::uint8_t* rgb,
+    std::size_t row_stride) {
+    if (width <= 0 || height <= 0 || rgb == nullptr) {
+        throw std::invalid_argument("texture mip pyramid needs a non-empty image");
+    }
+
+    std::size_t byte_count = 0;
+    for (int level_width = width, level_height = height;;
+        level_width = std::max(1, level_width / 2), level_height = std::max(1, level_height / 2)) {
+        const int tiles_x = tile_count(level_width);
+        levels_.push_back(Level {
+            .width = level_width,
+            .height = level_height,
+            .tiles_x = tiles_x,
+            .offset = byte_count,
+        });
+        byte_count += static_cast<std::size_t>(tiles_x) * tile_count(level_height) * kTileBytes;
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+    }
+    texels_.assign(byte_count, 0);
+
+    const Level& base = levels_.front();
+    for (int y = 0; y < height; ++y) {
+        const std::uint8_t* row = rgb + static_cast<std::size_t>(y) * row_stride;
+        for (int x = 0; x < width; ++x) {
+            std::copy_n(row + 3 * x, 3, texels_.data() + texel_offset(base, x, y));
+        }
+    }
+
+    // 2x2 box filter; odd edges repeat their last texel
+    for (std::size_t index = 1; index < levels_.size(); ++index) {
+        const Level& source = levels_[index - 1];
+        const Level& level = levels_[index];
+        for (int y = 0; y < level.height; ++y) {
+            const int y0 = std::min(2 * y, source.height - 1);
+            const int y1 = std::min(2 * y + 1, source.height - 1);
+            for (int x = 0; x < level.width; ++x) {
+                const int x0 = std::min(2 * x, source.width - 1);
+                const int x1 = std::min(2 * x + 1, source.width - 1);
+                const std::uint8_t* a = texels_.data() + texel_offset(source, x0, y0);
+                const std::uint8_t* b = texels_.data() + texel_offset(source, x1, y0);
+                const std::uint8_t* c = texels_.data() + texel_offset(source, x0, y1);
+                const std::uint8_t* d = texels_.data() + texel_offset(source, x1, y1);
+                std::uint8_t* out = texels_.data() + texel_offset(level, x, y);
+                for (int channel = 0; channel < 3; ++channel) {
+                    out[channel] = static_cast<std::uint8_t>(
+                        (a[channel] + b[channel] + c[channel] + d[channel] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+std::size_t TextureMipPyramid::texel_offset(const Level& level, int x, int y) const {
+    constexpr int kTileMask = kTileSize - 1;
+    const std::size_t tile =
+        static_cast<std::size_t>(y >> kTileShift) * level.tiles_x + (x >> kTileShift);
+    const std::size_t within =
+        static_cast<std::size_t>(((y & kTileMask) << kTileShift) + (x & kTileMask));
+    return level.offset + tile * kTileBytes + 3 * within;
+}
+
+const std::uint8_t* TextureMipPyramid::texel(int level, int x, int y) const {
+    return texels_.data() + texel_offset(levels_[level], x, y);
+}
+
+float TextureMipPyramid::level_of_detail(double footprint) const {
+    if (empty() || !(footprint > 0.0)) {
+        return 0.0f;
+    }
+    const double texels = footprint * std::max(levels_.front().width, levels_.front().height);
+    return static_cast<float>(
+        std::clamp(std::log2(std::max(texels, 1.0)), 0.0, static_cast<double>(level_count() - 1)));
+}
+
+Eigen::Vector3f TextureMipPyramid::bilinear(int level, double s, double t) const {
+    const Level& current = levels_[level];
+    const double x = s * current.width - 0.5;
+    const double y = t * current.height - 0.5;
+    const double x_floor = std::floor(x);
+    const double y_floor = std::floor(y);
+    const float fx = static_cast<float>(x - x_floor);
+    const float fy = static_cast<float>(y - y_floor);
+    const int x0 = std::clamp(static_cast<int>(x_floor), 0, current.width - 1);
+    const int y0 = std::clamp(static_cast<int>(y_floor), 0, current.height - 1);
+    // s and t are clamped to [0, 1], so the floors are at least -1
+    const int x1 = std::min(static_cast<int>(x_floor) + 1, current.width - 1);
+    const int y1 = std::min(static_cast<int>(y_floor) + 1, current.height - 1);
+
+    const auto fetch = [&](int tx, int ty) {
+        const std::uint8_t* value = texels_.data() + texel_offset(current, tx, ty);
+        return Eigen::Vector3f {value[0], value[1], value[2]};
+    };
+    const Eigen::Vector3f top = fetch(x0, y0) * (1.0f - fx) + fetch(x1, y0) * fx;
+    const Eigen::Vector3f bottom = fetch(x0, y1) * (1.0f - fx) + fetch(x1, y1) * fx;
+    return (top * (1.0f - fy) + bottom * fy) * (1.0f / 255.0f);
+}
+
+Eigen::Vector3f TextureMipPyramid::sample(double s, double t, double footprint) const {
+    const float lod = level_of_detail(footprint);
+    const int fine = static_cast<int>(lod);
+    const float blend = lod - static_cast<float>(fine);
+    const Eigen::Vector3f fine_value = bilinear(fine, s, t);
+    if (blend <= 0.0f || fine + 1 >= level_count()) {
+        return fine_value;
+    }
+    return fine_value * (1.0f - blend) + bilinear(fine + 1, s, t) * blend;
+}
+
+} // namespace rt
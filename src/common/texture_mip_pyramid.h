@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rt {
+
+// 8-bit RGB image with its box-filtered mip chain. Every level is stored in 8x8-texel tiles
+// (192 bytes, three cache lines), so a bilinear footprint touches one or two tiles instead of two
+// image rows that may be a whole image width apart.
+class TextureMipPyramid {
+public:
+    static constexpr int kTileShift = 3;
+    static constexpr int kTileSize = 1 << kTileShift;
+
+    TextureMipPyramid() = default;
+    // rgb points at height rows of width RGB texels, row_stride bytes apart
+    TextureMipPyramid(int width, int height, const std::uint8_t* rgb, std::size_t row_stride);
+
+    bool empty() const { return levels_.empty(); }
+    int level_count() const { return static_cast<int>(levels_.size()); }
+    int width(int level = 0) const { return empty() ? 0 : levels_[level].width; }
+    int height(int level = 0) const { return empty() ? 0 : levels_[level].height; }
+    std::size_t byte_size() const { return texels_.size(); }
+
+    const std::uint8_t* texel(int level, int x, int y) const;
+
+    // Level whose texels are as wide as a footprint of the given width in uv units
+    float level_of_detail(double footprint) const;
+    // Bilinear lookup on one level; s and t are in [0, 1] with t = 0 on the first row
+    Eigen::Vector3f bilinear(int level, double s, double t) const;
+    // Trilinear lookup between the two levels bracketing the footprint's level of detail. A zero
+    // footprint samples the finest level.
+    Eigen::Vector3f sample(double s, double t, double footprint) const;
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int tiles_x = 0;
+        std::size_t offset = 0; // Byte offset of the level's first tile
+    };
+
+    std::size_t texel_offset(const Level& level, int x, int y) const;
+
+    std::vector<Level> levels_;
+    std::vector<std::uint8_t> texels_;
+};
+
+} // namespace rt
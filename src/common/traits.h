@@ -26,11 +26,25 @@ struct Hittable                                         //
       ::add_convention<HittableMemBB, AABB() const>                              //
       ::add_convention<HittableMemPDFValue,
           double(const Vec3d& origin, const Vec3d& direction) const>        //
-      ::add_convention<HittableMemRandom, Vec3d(const Vec3d& origin) const> //
+      ::add_convention<HittableMemRandom,
+          Vec3d(const Vec3d& origin, rt::PathSampler& sampler) const> //
       ::build {};
 
 // Material
 
+// Shading model behind a material proxy, so batched integrators can group hits that run the same
+// code before shading them.
+enum class MaterialKind {
+    empty,
+    lambertian,
+    metal,
+    dielectric,
+    openpbr,
+    diffuse_light,
+    isotropic,
+};
+
+PRO_DEF_MEM_DISPATCH(MaterialMemKind, kind);
 PRO_DEF_MEM_DISPATCH(MaterialMemEmitted, emitted);
 PRO_DEF_MEM_DISPATCH(MaterialMemScatter, scatter);
 PRO_DEF_MEM_DISPATCH(MaterialMemScatteringPDF, scattering_pdf);
@@ -39,11 +53,13 @@ PRO_DEF_MEM_DISPATCH(MaterialMemEvaluateDirect, evaluate_direct);
 struct Material                                         //
     : pro::facade_builder                               //
       ::support_copy<pro::constraint_level::nontrivial> //
+      ::add_convention<MaterialMemKind, MaterialKind() const> //
       ::add_convention<MaterialMemEmitted,
           Vec3d(const Ray& ray_in, const HitRecord& hit_rec, const double u, const double v,
               const Vec3d& p) const> //
       ::add_convention<MaterialMemScatter,
-          bool(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec) const> //
+          bool(const Ray& ray_in, const HitRecord& hit_rec, ScatterRecord& scatter_rec,
+              rt::PathSampler& sampler) const> //
       ::add_convention<MaterialMemScatteringPDF,
           double(const Ray& ray_in, const HitRecord& hit_rec, const Ray& scattered) const> //
       ::add_convention<MaterialMemEvaluateDirect,
@@ -54,6 +70,8 @@ struct Material                                         //
 
 // Texture
 
+// `footprint` is the width of the shading point's ray cone in uv units (HitRecord's
+// texture_footprint); filtered textures pick their level of detail from it, 0 means point sampling.
 
 PRO_DEF_MEM_DISPATCH(TextureMemValue, value);
 
@@ -61,18 +79,6 @@ struct Texture                                          //
     : pro::facade_builder                               //
       ::support_copy<pro::constraint_level::nontrivial> //
       ::add_convention<TextureMemValue,
-          Vec3d(const double u, const double v, const Vec3d& p) const> //
-      ::build {};
-
-
-// PDF
-
-PRO_DEF_MEM_DISPATCH(PDFMemValue, value);
-PRO_DEF_MEM_DISPATCH(PDFMemGenerate, generate);
-
-struct PDF                                                                //
-    : pro::facade_builder                                                 //
-      ::support_copy<pro::constraint_level::nontrivial>                   //
-      ::add_convention<PDFMemValue, double(const Vec3d& direction) const> //
-      ::add_convention<PDFMemGenerate, Vec3d() const>                     //
+          Vec3d(const double u, const double v, const Vec3d& p, const double footprint)
+              const> //
       ::build {};
@@ -42,9 +42,10 @@ struct Triangle {
         return distance_sq / (cosine * m_area);
     }
 
-    Vec3d random(const Vec3d& origin) const {
-        const double sqrt_r1 = std::sqrt(random_double());
-        const double r2 = random_double();
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        const Eigen::Vector2d u = sampler.next_2d();
+        const double sqrt_r1 = std::sqrt(u.x());
+        const double r2 = u.y();
         const double w0 = 1.0 - sqrt_r1;
         const double w1 = sqrt_r1 * (1.0 - r2);
         const double w2 = sqrt_r1 * r2;
@@ -86,6 +87,8 @@ struct Triangle {
         hit_rec.v = v;
         hit_rec.mat = m_mat;
         hit_rec.set_face_normal(ray, outward_normal);
+        // Barycentric uv spans half the unit square over the triangle's area
+        hit_rec.set_texture_footprint(ray, std::sqrt(0.5 / m_area));
         return true;
     }
 
@@ -0,0 +1,343 @@
+#pragma once
+
+#include "traits.h"
+
+#include "bvh.h"
+#include "bvh_builder.h"
+#include "material.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Vertex attributes of an indexed triangle mesh, one array per attribute. An attribute with an
+// empty index array is addressed per vertex through `triangles`; otherwise its indices are per
+// triangle corner, matching TriangleMeshShape.
+struct TriangleMeshData {
+    std::vector<Vec3d> positions;
+    std::vector<Eigen::Vector3i> triangles;
+    std::vector<Vec3d> normals;
+    std::vector<Eigen::Vector3i> normal_indices;
+    std::vector<Eigen::Vector2d> texcoords;
+    std::vector<Eigen::Vector3i> texcoord_indices;
+};
+
+// Indexed triangle mesh with its own BVH over triangle indices. Triangles are stored once as
+// vertex indices into the shared attribute arrays rather than as one hittable per triangle, and
+// hits interpolate the vertex normals and texture coordinates when the mesh provides them.
+// Positions are stored and intersected in `Scalar`: double is the reference mode, float halves the
+// vertex traffic of traversal and matches the GPU's intersection numerics. Hit records, areas and
+// sampling stay in double either way.
+template <typename Scalar>
+struct BasicTriangleMesh {
+    using Vec3 = Eigen::Vector3<Scalar>;
+
+    BasicTriangleMesh(TriangleMeshData data, pro::proxy<Material> mat,
+        const rt::BvhBuildOptions& options = {})
+        : m_mesh(std::move(data)),
+          m_mat(std::move(mat)) {
+        validate();
+        m_positions.reserve(m_mesh.positions.size());
+        for (const Vec3d& position : m_mesh.positions) {
+            m_positions.push_back(position.cast<Scalar>());
+        }
+        m_mesh.positions = {};
+
+        std::vector<AABB> bounds;
+        bounds.reserve(m_mesh.triangles.size());
+        for (const Eigen::Vector3i& tri : m_mesh.triangles) {
+            bounds.push_back(triangle_bounds(tri));
+        }
+        const rt::FlatBvh binary = rt::build_binned_sah_bvh(bounds, options);
+
+        // Reorder the per-triangle arrays once so leaves address a contiguous run of triangles.
+        reorder(m_mesh.triangles, binary.primitive_indices);
+        reorder(m_mesh.normal_indices, binary.primitive_indices);
+        reorder(m_mesh.texcoord_indices, binary.primitive_indices);
+        m_bbox = binary.empty() ? AABB::empty : binary.nodes.front().bbox;
+        m_bvh = rt::collapse_bvh(binary, options);
+
+        m_area_cdf.reserve(m_mesh.triangles.size());
+        for (std::size_t i = 0; i < m_mesh.triangles.size(); ++i) {
+            m_total_area += triangle_area(static_cast<int>(i));
+            m_area_cdf.push_back(m_total_area);
+        }
+    }
+
+    AABB bounding_box() const { return m_bbox; }
+
+    double pdf_value(const Vec3d& origin, const Vec3d& direction) const {
+        // Area sampling picks any point of the mesh with density 1 / total area, so every surface
+        // crossing along the direction contributes its solid-angle conversion
+        if (m_total_area <= 1e-12) {
+            return 0.0;
+        }
+
+        const Ray ray {origin, direction};
+        const TriangleRay triangle_ray = make_triangle_ray(ray);
+        const double direction_length_sq = direction.squaredNorm();
+        double pdf = 0.0;
+        rt::traverse_wide_bvh(m_bvh, ray, Interval {0.001, infinity},
+            [&](const int first, const int count, double&) {
+                for (int i = first, end = first + count; i < end; ++i) {
+                    TriangleHit candidate;
+                    if (!intersect(i, triangle_ray, Interval {0.001, infinity}, candidate)) {
+                        continue;
+                    }
+                    const Vec3d geometric_normal = face_normal(i).normalized();
+                    const double cosine =
+                        std::abs(direction.dot(geometric_normal)) / std::sqrt(direction_length_sq);
+                    if (cosine > 1e-12) {
+                        pdf += candidate.t * candidate.t * direction_length_sq
+                               / (cosine * m_total_area);
+                    }
+                }
+                return false;
+            });
+        return pdf;
+    }
+
+    Vec3d random(const Vec3d& origin, rt::PathSampler& sampler) const {
+        if (m_total_area <= 1e-12) {
+            return {1.0, 0.0, 0.0};
+        }
+
+        // Pick a triangle proportionally to its area, then a uniform point on it
+        const double target = sampler.next_1d() * m_total_area;
+        const auto it = std::upper_bound(m_area_cdf.begin(), m_area_cdf.end(), target);
+        const int index = static_cast<int>(std::min<std::ptrdiff_t>(it - m_area_cdf.begin(),
+            static_cast<std::ptrdiff_t>(m_area_cdf.size()) - 1));
+
+        const Eigen::Vector2d u = sampler.next_2d();
+        const double sqrt_r1 = std::sqrt(u.x());
+        const double r2 = u.y();
+        const Eigen::Vector3i& tri = m_mesh.triangles[static_cast<std::size_t>(index)];
+        const Vec3d p = (1.0 - sqrt_r1) * reference_position(tri.x())
+                        + sqrt_r1 * (1.0 - r2) * reference_position(tri.y())
+                        + sqrt_r1 * r2 * reference_position(tri.z());
+        return p - origin;
+    }
+
+    bool hit(const Ray& ray, const Interval& ray_t, HitRecord& hit_rec) const {
+        // Only barycentrics are tracked during traversal; the record is filled for the final hit
+        TriangleHit closest;
+        const TriangleRay triangle_ray = make_triangle_ray(ray);
+        const bool hit_anything = rt::traverse_wide_bvh(m_bvh, ray, ray_t,
+            [&](const int first, const int count, double& closest_so_far) {
+                bool hit_leaf = false;
+                for (int i = first, end = first + count; i < end; ++i) {
+                    if (intersect(
+                            i, triangle_ray, Interval {ray_t.min, closest_so_far}, closest)) {
+                        closest.triangle = i;
+                        closest_so_far = closest.t;
+                        hit_leaf = true;
+                    }
+                }
+                return hit_leaf;
+            });
+        if (!hit_anything) {
+            return false;
+        }
+
+        fill_hit_record(ray, closest, hit_rec);
+        return true;
+    }
+
+    std::size_t triangle_count() const { return m_mesh.triangles.size(); }
+    std::size_t vertex_count() const { return m_positions.size(); }
+    std::size_t node_count() const { return m_bvh.node_count(); }
+    double total_area() const { return m_total_area; }
+
+private:
+    struct TriangleHit {
+        int triangle = -1;
+        double t = 0.0;
+        double b1 = 0.0; // Barycentric weight of the second vertex
+        double b2 = 0.0; // Barycentric weight of the third vertex
+    };
+
+    // Ray converted to the mesh's precision once per query
+    struct TriangleRay {
+        Vec3 origin;
+        Vec3 direction;
+    };
+
+    static TriangleRay make_triangle_ray(const Ray& ray) {
+        return {ray.origin().cast<Scalar>(), ray.direction().cast<Scalar>()};
+    }
+
+    const Vec3& position(const int vertex) const {
+        return m_positions[static_cast<std::size_t>(vertex)];
+    }
+
+    // Stored positions widen to double exactly, so derived quantities agree across precisions
+    Vec3d reference_position(const int vertex) const {
+        return position(vertex).template cast<double>();
+    }
+
+    Vec3d face_normal(const int index) const {
+        const Eigen::Vector3i& tri = m_mesh.triangles[static_cast<std::size_t>(index)];
+        const Vec3d a = reference_position(tri.x());
+        return (reference_position(tri.y()) - a).cross(reference_position(tri.z()) - a);
+    }
+
+    double triangle_area(const int index) const { return 0.5 * face_normal(index).norm(); }
+
+    AABB triangle_bounds(const Eigen::Vector3i& tri) const {
+        const Vec3d a = reference_position(tri.x());
+        const Vec3d b = reference_position(tri.y());
+        const Vec3d c = reference_position(tri.z());
+        return AABB {AABB {a, b}, AABB {AABB {a, c}, AABB {b, c}}};
+    }
+
+    bool intersect(const int index, const TriangleRay& ray, const Interval& ray_t,
+        TriangleHit& result) const {
+        // Moller-Trumbore, matching Triangle::hit
+        constexpr Scalar kEpsilon = Scalar(1e-8);
+
+        const Eigen::Vector3i& tri = m_mesh.triangles[static_cast<std::size_t>(index)];
+        const Vec3& a = position(tri.x());
+        const Vec3 edge_ab = position(tri.y()) - a;
+        const Vec3 edge_ac = position(tri.z()) - a;
+
+        const Vec3 pvec = ray.direction.cross(edge_ac);
+        const Scalar det = edge_ab.dot(pvec);
+        if (std::abs(det) <= kEpsilon) {
+            return false;
+        }
+
+        const Scalar inv_det = Scalar(1) / det;
+        const Vec3 tvec = ray.origin - a;
+        const Scalar u = tvec.dot(pvec) * inv_det;
+        if (u < Scalar(0) || u > Scalar(1)) {
+            return false;
+        }
+
+        const Vec3 qvec = tvec.cross(edge_ab);
+        const Scalar v = ray.direction.dot(qvec) * inv_det;
+        if (v < Scalar(0) || (u + v) > Scalar(1)) {
+            return false;
+        }
+
+        const double t = static_cast<double>(edge_ac.dot(qvec) * inv_det);
+        if (!ray_t.surrounds(t)) {
+            return false;
+        }
+
+        result.t = t;
+        result.b1 = static_cast<double>(u);
+        result.b2 = static_cast<double>(v);
+        return true;
+    }
+
+    void fill_hit_record(const Ray& ray, const TriangleHit& hit, HitRecord& hit_rec) const {
+        const auto index = static_cast<std::size_t>(hit.triangle);
+        const double b0 = 1.0 - hit.b1 - hit.b2;
+        const Vec3d scaled_normal = face_normal(hit.triangle);
+        const Vec3d geometric_normal = scaled_normal.normalized();
+        // Twice the triangle's uv area; over twice its world area it gives the uv density the
+        // texture footprint is scaled by
+        double uv_area = 1.0;
+
+        hit_rec.t = hit.t;
+        hit_rec.p = ray.at(hit.t);
+        hit_rec.mat = m_mat;
+
+        if (m_mesh.texcoords.empty()) {
+            hit_rec.u = hit.b1;
+            hit_rec.v = hit.b2;
+        } else {
+            const Eigen::Vector3i& corners = m_mesh.texcoord_indices.empty()
+                                                 ? m_mesh.triangles[index]
+                                                 : m_mesh.texcoord_indices[index];
+            const Eigen::Vector2d& uv0 = m_mesh.texcoords[corners.x()];
+            const Eigen::Vector2d& uv1 = m_mesh.texcoords[corners.y()];
+            const Eigen::Vector2d& uv2 = m_mesh.texcoords[corners.z()];
+            const Eigen::Vector2d uv = b0 * uv0 + hit.b1 * uv1 + hit.b2 * uv2;
+            hit_rec.u = uv.x();
+            hit_rec.v = uv.y();
+            const Eigen::Vector2d uv_ab = uv1 - uv0;
+            const Eigen::Vector2d uv_ac = uv2 - uv0;
+            uv_area = std::abs(uv_ab.x() * uv_ac.y() - uv_ab.y() * uv_ac.x());
+        }
+
+        // Faces are classified by the geometric normal; the interpolated normal only shades, and
+        // is kept on the geometric side so inconsistent winding cannot flip a surface inside out
+        hit_rec.front_face = ray.direction().dot(geometric_normal) < 0.0;
+        Vec3d shading_normal = geometric_normal;
+        if (!m_mesh.normals.empty()) {
+            const Eigen::Vector3i& corners = m_mesh.normal_indices.empty()
+                                                 ? m_mesh.triangles[index]
+                                                 : m_mesh.normal_indices[index];
+            const Vec3d interpolated = b0 * m_mesh.normals[corners.x()]
+                                       + hit.b1 * m_mesh.normals[corners.y()]
+                                       + hit.b2 * m_mesh.normals[corners.z()];
+            const double length = interpolated.norm();
+            if (length > 1e-12) {
+                shading_normal = interpolated / length;
+                if (shading_normal.dot(geometric_normal) < 0.0) {
+                    shading_normal = -shading_normal;
+                }
+            }
+        }
+        hit_rec.normal = hit_rec.front_face ? shading_normal : -shading_normal;
+        hit_rec.set_texture_footprint(ray, std::sqrt(uv_area / scaled_normal.norm()));
+    }
+
+    template <typename T>
+    static void reorder(std::vector<T>& values, const std::vector<int>& order) {
+        if (values.empty()) {
+            return;
+        }
+        std::vector<T> ordered;
+        ordered.reserve(values.size());
+        for (const int index : order) {
+            ordered.push_back(values[static_cast<std::size_t>(index)]);
+        }
+        values = std::move(ordered);
+    }
+
+    void validate() const {
+        const auto check_indices = [](const std::vector<Eigen::Vector3i>& indices,
+                                       std::size_t value_count, const char* message) {
+            for (const Eigen::Vector3i& corners : indices) {
+                if ((corners.array() < 0).any()
+                    || (corners.array() >= static_cast<int>(value_count)).any()) {
+                    throw std::out_of_range(message);
+                }
+            }
+        };
+        check_indices(m_mesh.triangles, m_mesh.positions.size(),
+            "triangle mesh vertex index out of range");
+        const auto check_attribute = [&](const std::vector<Eigen::Vector3i>& indices,
+                                         std::size_t value_count, const char* message) {
+            if (value_count == 0) {
+                return;
+            }
+            if (indices.empty()) {
+                check_indices(m_mesh.triangles, value_count, message);
+            } else if (indices.size() != m_mesh.triangles.size()) {
+                throw std::invalid_argument(message);
+            } else {
+                check_indices(indices, value_count, message);
+            }
+        };
+        check_attribute(m_mesh.normal_indices, m_mesh.normals.size(),
+            "triangle mesh normal indices do not match the triangles");
+        check_attribute(m_mesh.texcoord_indices, m_mesh.texcoords.size(),
+            "triangle mesh texcoord indices do not match the triangles");
+    }
+
+    TriangleMeshData m_mesh; // Positions live in m_positions
+    std::vector<Vec3> m_positions;
+    pro::proxy<Material> m_mat;
+    rt::WideBvh m_bvh;
+    std::vector<double> m_area_cdf;
+    double m_total_area = 0.0;
+    AABB m_bbox;
+};
+
+using TriangleMesh = BasicTriangleMesh<double>;
+using TriangleMeshF = BasicTriangleMesh<float>;
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace rt {
+
+#if defined(__CUDACC__)
+#define RT_QUANTIZATION_HD     __host__ __device__
+#define RT_QUANTIZATION_INLINE __forceinline__
+#else
+#define RT_QUANTIZATION_HD
+#define RT_QUANTIZATION_INLINE inline
+#endif
+
+// Compact vertex attribute encodings shared by the scene preparation on the host and the hit
+// shading on the device. Unit normals fold onto an octahedron and keep two signed 16-bit
+// coordinates; texture coordinates are stored as IEEE half floats.
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE std::uint32_t quantization_float_bits(const float value) {
+#if defined(__CUDA_ARCH__)
+    return __float_as_uint(value);
+#else
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+#endif
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE float quantization_bits_float(const std::uint32_t bits) {
+#if defined(__CUDA_ARCH__)
+    return __uint_as_float(bits);
+#else
+    float value = 0.0f;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+#endif
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE float quantization_sign(const float value) {
+    return value < 0.0f ? -1.0f : 1.0f;
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE std::uint32_t encode_snorm16(const float value) {
+    const float clamped = fminf(fmaxf(value, -1.0f), 1.0f);
+    const auto quantized = static_cast<std::int32_t>(roundf(clamped * 32767.0f));
+    return static_cast<std::uint32_t>(quantized) & 0xffffu;
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE float decode_snorm16(const std::uint32_t bits) {
+    const auto quantized = static_cast<std::int16_t>(static_cast<std::uint16_t>(bits & 0xffffu));
+    return fmaxf(static_cast<float>(quantized) / 32767.0f, -1.0f);
+}
+
+// A zero vector encodes as +z; callers only encode normals they have already checked
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE std::uint32_t encode_octahedral_normal(
+    const float x, const float y, const float z) {
+    const float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+    if (!(l1 > 0.0f)) {
+        return 0u;
+    }
+    float u = x / l1;
+    float v = y / l1;
+    if (z < 0.0f) {
+        const float folded_u = (1.0f - fabsf(v)) * quantization_sign(u);
+        v = (1.0f - fabsf(u)) * quantization_sign(v);
+        u = folded_u;
+    }
+    return encode_snorm16(u) | (encode_snorm16(v) << 16);
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE void decode_octahedral_normal(
+    const std::uint32_t bits, float& x, float& y, float& z) {
+    x = decode_snorm16(bits);
+    y = decode_snorm16(bits >> 16);
+    z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f) {
+        const float unfolded_x = (1.0f - fabsf(y)) * quantization_sign(x);
+        y = (1.0f - fabsf(x)) * quantization_sign(y);
+        x = unfolded_x;
+    }
+    const float inverse_length = 1.0f / sqrtf(x * x + y * y + z * z);
+    x *= inverse_length;
+    y *= inverse_length;
+    z *= inverse_length;
+}
+
+// Round to nearest even, with overflow to infinity and gradual underflow
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE std::uint32_t float_to_half_bits(const float value) {
+    const std::uint32_t bits = quantization_float_bits(value);
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    const std::uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x7f800000u) {
+        return sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x0200u : 0u);
+    }
+    if (magnitude >= 0x477ff000u) {
+        return sign | 0x7c00u;
+    }
+    if (magnitude < 0x38800000u) {
+        if (magnitude <= 0x33000000u) {
+            return sign;
+        }
+        const std::uint32_t exponent = magnitude >> 23;
+        const std::uint32_t mantissa = (magnitude & 0x007fffffu) | 0x00800000u;
+        const std::uint32_t shift = 126u - exponent;
+        std::uint32_t half = mantissa >> shift;
+        const std::uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        const std::uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u) != 0u)) {
+            ++half;
+        }
+        return sign | half;
+    }
+    std::uint32_t half = (magnitude - 0x38000000u) >> 13;
+    const std::uint32_t remainder = magnitude & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0u)) {
+        ++half;
+    }
+    return sign | half;
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE float half_bits_to_float(const std::uint32_t half) {
+    const std::uint32_t sign = (half & 0x8000u) << 16;
+    const std::uint32_t exponent = (half >> 10) & 0x1fu;
+    const std::uint32_t mantissa = half & 0x03ffu;
+    if (exponent == 0u) {
+        const float subnormal = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+        return sign != 0u ? -subnormal : subnormal;
+    }
+    if (exponent == 0x1fu) {
+        return quantization_bits_float(sign | 0x7f800000u | (mantissa << 13));
+    }
+    return quantization_bits_float(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE std::uint32_t encode_half2(const float u, const float v) {
+    return float_to_half_bits(u) | (float_to_half_bits(v) << 16);
+}
+
+RT_QUANTIZATION_HD RT_QUANTIZATION_INLINE void decode_half2(
+    const std::uint32_t bits, float& u, float& v) {
+    u = half_bits_to_float(bits & 0xffffu);
+    v = half_bits_to_float(bits >> 16);
+}
+
+} // namespace rt
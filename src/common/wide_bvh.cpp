@@ -0,0 +1,265 @@
+#include "common/wide_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RT_WIDE_BVH_X86 1
+#include <immintrin.h>
+#else
+#define RT_WIDE_BVH_X86 0
+#endif
+
+namespace rt {
+namespace {
+
+// Relative slack covering the float rounding of the origin, the slab subtraction, the reciprocal
+// and the product. Each contributes at most one ulp (2^-24), so 2^-21 leaves a wide margin.
+constexpr float kSlabSlack = 1.0f / (1 << 21);
+// Reciprocals are clamped so zero and huge direction components stay finite; an infinite slab
+// distance times a zero reciprocal would otherwise produce NaN for empty lanes.
+constexpr double kMinInverseDirection = 1e-30;
+constexpr double kMaxInverseDirection = 1e30;
+
+template <int Width>
+std::uint32_t box_test_scalar(const float* bounds, const WideBvhRay& ray, const float t_min,
+    const float t_max, float* t_entry) {
+    std::uint32_t mask = 0;
+    for (int lane = 0; lane < Width; ++lane) {
+        float entry = t_min;
+        float exit = t_max;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float near = (bounds[ray.near_plane[axis] * Width + lane] - ray.origin_near[axis])
+                               * ray.inv_direction_near[axis];
+            const float far = (bounds[ray.far_plane[axis] * Width + lane] - ray.origin_far[axis])
+                              * ray.inv_direction_far[axis];
+            entry = std::max(entry, near);
+            exit = std::min(exit, far);
+        }
+        t_entry[lane] = entry;
+        if (entry <= exit) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+#if RT_WIDE_BVH_X86
+
+// SSE is part of the x86-64 baseline, so this kernel needs no runtime check.
+template <int Width>
+std::uint32_t box_test_sse(const float* bounds, const WideBvhRay& ray, const float t_min,
+    const float t_max, float* t_entry) {
+    std::uint32_t mask = 0;
+    for (int group = 0; group < Width; group += 4) {
+        __m128 entry = _mm_set1_ps(t_min);
+        __m128 exit = _mm_set1_ps(t_max);
+        for (int axis = 0; axis < 3; ++axis) {
+            const __m128 near_plane = _mm_loadu_ps(bounds + ray.near_plane[axis] * Width + group);
+            const __m128 far_plane = _mm_loadu_ps(bounds + ray.far_plane[axis] * Width + group);
+            const __m128 near =
+                _mm_mul_ps(_mm_sub_ps(near_plane, _mm_set1_ps(ray.origin_near[axis])),
+                    _mm_set1_ps(ray.inv_direction_near[axis]));
+            const __m128 far = _mm_mul_ps(_mm_sub_ps(far_plane, _mm_set1_ps(ray.origin_far[axis])),
+                _mm_set1_ps(ray.inv_direction_far[axis]));
+            entry = _mm_max_ps(entry, near);
+            exit = _mm_min_ps(exit, far);
+        }
+        _mm_storeu_ps(t_entry + group, entry);
+        mask |= static_cast<std::uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << group;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2"))) std::uint32_t box_test_avx2_8(const float* bounds,
+    const WideBvhRay& ray, const float t_min, const float t_max, float* t_entry) {
+    __m256 entry = _mm256_set1_ps(t_min);
+    __m256 exit = _mm256_set1_ps(t_max);
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m256 near_plane = _mm256_loadu_ps(bounds + ray.near_plane[axis] * 8);
+        const __m256 far_plane = _mm256_loadu_ps(bounds + ray.far_plane[axis] * 8);
+        const __m256 near = _mm256_mul_ps(
+            _mm256_sub_ps(near_plane, _mm256_set1_ps(ray.origin_near[axis])),
+            _mm256_set1_ps(ray.inv_direction_near[axis]));
+        const __m256 far = _mm256_mul_ps(
+            _mm256_sub_ps(far_plane, _mm256_set1_ps(ray.origin_far[axis])),
+            _mm256_set1_ps(ray.inv_direction_far[axis]));
+        entry = _mm256_max_ps(entry, near);
+        exit = _mm256_min_ps(exit, far);
+    }
+    _mm256_storeu_ps(t_entry, entry);
+    return static_cast<std::uint32_t>(
+        _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+}
+
+#endif
+
+BvhTraversalKernel widest_supported_kernel() {
+#if RT_WIDE_BVH_X86
+    static const BvhTraversalKernel widest = __builtin_cpu_supports("avx2")
+                                                 ? BvhTraversalKernel::avx2
+                                                 : BvhTraversalKernel::sse;
+    return widest;
+#else
+    return BvhTraversalKernel::scalar;
+#endif
+}
+
+WideBoxTest select_box_test(const int width, const BvhTraversalKernel kernel) {
+#if RT_WIDE_BVH_X86
+    if (kernel == BvhTraversalKernel::avx2 && width == 8) {
+        return box_test_avx2_8;
+    }
+    // Four lanes fit one SSE register, so AVX2 has nothing to add for BVH4
+    if (kernel == BvhTraversalKernel::sse || kernel == BvhTraversalKernel::avx2) {
+        return width == 8 ? box_test_sse<8> : box_test_sse<4>;
+    }
+#endif
+    return width == 8 ? box_test_scalar<8> : box_test_scalar<4>;
+}
+
+class WideBvhCollapser {
+public:
+    WideBvhCollapser(const FlatBvh& source, WideBvh& target) : source_(source), target_(target) {}
+
+    int emit(const int source_index) {
+        const int width = target_.width;
+        const int node_index = static_cast<int>(target_.node_count());
+        target_.bounds.resize(target_.bounds.size() + 6 * width,
+            std::numeric_limits<float>::infinity());
+        std::fill(target_.bounds.end() - 3 * width, target_.bounds.end(),
+            -std::numeric_limits<float>::infinity());
+        target_.children.resize(target_.children.size() + width, 0);
+        target_.counts.resize(target_.counts.size() + width, -1);
+
+        // Open the largest interior child until the node is full; a leaf root keeps one lane
+        std::vector<int> lanes;
+        const BvhFlatNode& node = source_.nodes[static_cast<std::size_t>(source_index)];
+        if (node.is_leaf()) {
+            lanes.push_back(source_index);
+        } else {
+            lanes = {source_index + 1, node.first};
+        }
+        while (static_cast<int>(lanes.size()) < width) {
+            int largest = -1;
+            double largest_area = -1.0;
+            for (int lane = 0; lane < static_cast<int>(lanes.size()); ++lane) {
+                const BvhFlatNode& candidate = source_node(lanes[lane]);
+                if (!candidate.is_leaf() && candidate.bbox.surface_area() > largest_area) {
+                    largest = lane;
+                    largest_area = candidate.bbox.surface_area();
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            const int opened = lanes[largest];
+            lanes[largest] = opened + 1;
+            lanes.push_back(source_node(opened).first);
+        }
+
+        for (int lane = 0; lane < static_cast<int>(lanes.size()); ++lane) {
+            const BvhFlatNode& child = source_node(lanes[lane]);
+            write_bounds(node_index, lane, child.bbox);
+            const std::size_t slot = static_cast<std::size_t>(node_index * width + lane);
+            if (child.is_leaf()) {
+                target_.children[slot] = child.first;
+                target_.counts[slot] = child.count;
+            } else {
+                // Emitting may grow the arrays, so the slot is written after the recursion
+                const int child_index = emit(lanes[lane]);
+                target_.children[slot] = child_index;
+                target_.counts[slot] = 0;
+            }
+        }
+        return node_index;
+    }
+
+private:
+    const BvhFlatNode& source_node(const int index) const {
+        return source_.nodes[static_cast<std::size_t>(index)];
+    }
+
+    void write_bounds(const int node_index, const int lane, const AABB& bbox) {
+        const int width = target_.width;
+        float* rows = target_.bounds.data() + static_cast<std::size_t>(6 * width * node_index);
+        for (int axis = 0; axis < 3; ++axis) {
+            const Interval& interval = bbox.axis_interval(axis);
+            rows[axis * width + lane] = round_down_to_float(interval.min);
+            rows[(axis + 3) * width + lane] = round_up_to_float(interval.max);
+        }
+    }
+
+    const FlatBvh& source_;
+    WideBvh& target_;
+};
+
+} // namespace
+
+float round_down_to_float(const double value) {
+    const float rounded = static_cast<float>(value);
+    return static_cast<double>(rounded) > value
+               ? std::nextafter(rounded, -std::numeric_limits<float>::infinity())
+               : rounded;
+}
+
+float round_up_to_float(const double value) {
+    const float rounded = static_cast<float>(value);
+    return static_cast<double>(rounded) < value
+               ? std::nextafter(rounded, std::numeric_limits<float>::infinity())
+               : rounded;
+}
+
+BvhTraversalKernel resolve_bvh_traversal_kernel(const BvhTraversalKernel requested) {
+    const BvhTraversalKernel widest = widest_supported_kernel();
+    if (requested == BvhTraversalKernel::automatic || requested > widest) {
+        return widest;
+    }
+    return requested;
+}
+
+WideBvhRay make_wide_bvh_ray(const Vec3d& origin, const Vec3d& direction) {
+    WideBvhRay ray;
+    for (int axis = 0; axis < 3; ++axis) {
+        const bool negative = std::signbit(direction[axis]);
+        const double inverse = std::clamp(1.0 / std::abs(direction[axis]), kMinInverseDirection,
+            kMaxInverseDirection);
+        const float sign = negative ? -1.0f : 1.0f;
+
+        // Entry distances are rounded toward the ray and exit distances away from it
+        const float origin_f = static_cast<float>(origin[axis]);
+        const float origin_error = std::abs(origin_f) * kSlabSlack;
+        ray.origin_near[axis] = origin_f + sign * origin_error;
+        ray.origin_far[axis] = origin_f - sign * origin_error;
+        ray.inv_direction_near[axis] = sign * static_cast<float>(inverse) * (1.0f - kSlabSlack);
+        ray.inv_direction_far[axis] = sign * static_cast<float>(inverse) * (1.0f + kSlabSlack);
+        ray.near_plane[axis] = negative ? axis + 3 : axis;
+        ray.far_plane[axis] = negative ? axis : axis + 3;
+    }
+    return ray;
+}
+
+WideBvh collapse_bvh(const FlatBvh& bvh, const BvhBuildOptions& options) {
+    if (options.width != 4 && options.width != 8) {
+        throw std::invalid_argument("wide BVH width must be 4 or 8");
+    }
+    WideBvh wide;
+    wide.width = options.width;
+    wide.kernel = resolve_bvh_traversal_kernel(options.kernel);
+    wide.box_test = select_box_test(wide.width, wide.kernel);
+    if (bvh.empty()) {
+        return wide;
+    }
+
+    // Every collapsed node replaces at least one binary interior node
+    const std::size_t node_estimate = bvh.nodes.size() / 2 + 1;
+    wide.bounds.reserve(node_estimate * 6 * wide.width);
+    wide.children.reserve(node_estimate * wide.width);
+    wide.counts.reserve(node_estimate * wide.width);
+    WideBvhCollapser {bvh, wide}.emit(0);
+    return wide;
+}
+
+} // namespace rt
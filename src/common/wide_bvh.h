@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/bvh_builder.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace rt {
+
+inline constexpr int kMaxWideBvhWidth = 8;
+
+// Single-precision ray prepared once per traversal. Near and far slabs use separately rounded
+// origins and reciprocal directions, so float box tests never cull a box the exact ray enters.
+struct WideBvhRay {
+    std::array<float, 3> origin_near {};
+    std::array<float, 3> origin_far {};
+    std::array<float, 3> inv_direction_near {};
+    std::array<float, 3> inv_direction_far {};
+    std::array<int, 3> near_plane {}; // Row of the node bounds holding each axis' entry plane
+    std::array<int, 3> far_plane {};
+};
+
+// Tests the ray against every lane of one node. Writes the entry distance of each lane and
+// returns a bit mask of the lanes whose box overlaps [t_min, t_max].
+using WideBoxTest = std::uint32_t (*)(const float* bounds, const WideBvhRay& ray, float t_min,
+    float t_max, float* t_entry);
+
+// Collapsed BVH whose nodes hold `width` children in structure-of-arrays form. Node i owns six
+// rows of `width` floats starting at bounds[6 * width * i] (min x, y, z then max x, y, z), and the
+// lanes `width * i` onward of `children` and `counts`. A lane with a positive count is a leaf
+// covering `count` primitives from `children[lane]` in the source FlatBvh's primitive order; a
+// zero count points at a child node and a negative count marks an unused lane.
+struct WideBvh {
+    int width = 0;
+    BvhTraversalKernel kernel = BvhTraversalKernel::scalar;
+    WideBoxTest box_test = nullptr;
+    std::vector<float> bounds;
+    std::vector<std::int32_t> children;
+    std::vector<std::int32_t> counts;
+
+    bool empty() const { return counts.empty(); }
+    std::size_t node_count() const { return width > 0 ? counts.size() / width : 0; }
+    const float* node_bounds(const int node) const {
+        return bounds.data() + static_cast<std::size_t>(6 * width * node);
+    }
+};
+
+// Collapses a binary hierarchy into `options.width`-wide nodes, always opening the child with the
+// largest surface area, and binds the box-test kernel for `options.kernel`.
+WideBvh collapse_bvh(const FlatBvh& bvh, const BvhBuildOptions& options = {});
+
+// Kernel actually used for a request: `automatic` and kernels the CPU lacks resolve to the widest
+// supported one.
+BvhTraversalKernel resolve_bvh_traversal_kernel(BvhTraversalKernel requested);
+
+WideBvhRay make_wide_bvh_ray(const Vec3d& origin, const Vec3d& direction);
+
+// Float bounds of a double ray interval that never shrink it.
+float round_down_to_float(double value);
+float round_up_to_float(double value);
+
+} // namespace rt
@@ -3,13 +3,19 @@
 #include <Eigen/Geometry>
 
 #include "common/camera.h"
+#include "common/render_accumulation.h"
 #include "realtime/camera_rig.h"
 #include "realtime/scene_catalog.h"
+#include "scene/analytic_light_compiler.h"
 #include "scene/cpu_scene_adapter.h"
 #include "scene/shared_scene_builders.h"
 
+#include <chrono>
+#include <filesystem>
 #include <numbers>
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace rt {
 namespace {
@@ -139,9 +145,17 @@ void configure_offline_camera(const OfflineCameraConfig& config, const int sampl
     cam.set_shared_camera_ray_config(config.shared_camera);
 }
 
-template <typename ConfigureFn>
-cv::Mat render_shared_scene_with_camera(
-    std::string_view scene_id, const int samples_per_pixel, ConfigureFn&& configure_camera) {
+Camera::Integrator to_camera_integrator(const OfflineIntegrator integrator) {
+    switch (integrator) {
+        case OfflineIntegrator::wavefront: return Camera::Integrator::wavefront;
+        case OfflineIntegrator::recursive: break;
+    }
+    return Camera::Integrator::recursive;
+}
+
+template <typename ConfigureFn, typename RenderFn>
+auto render_shared_scene_with_camera(std::string_view scene_id, const int samples_per_pixel,
+    const OfflineRenderOptions& options, ConfigureFn&& configure_camera, RenderFn&& render) {
     const SceneCatalogEntry* entry = find_scene_catalog_entry(scene_id);
     if (entry == nullptr || !entry->supports_cpu_render) {
         throw std::invalid_argument("scene id is not available for offline CPU rendering");
@@ -150,32 +164,99 @@ cv::Mat render_shared_scene_with_camera(
     const scene::CpuRenderPreset* preset = scene::default_cpu_render_preset(scene_id);
     const int resolved_spp = samples_per_pixel > 0 ? samples_per_pixel : preset->samples_per_pixel;
     const scene::SceneIR scene_ir = scene::build_scene(scene_id);
-    const scene::CpuSceneAdapterResult adapted = scene::adapt_to_cpu(scene_ir);
+    scene::CpuSceneAdapterOptions adapter_options;
+    if (options.single_precision_geometry) {
+        adapter_options.geometry_precision = scene::CpuGeometryPrecision::single_precision;
+    }
+    scene::CpuSceneAdapterResult adapted = scene::adapt_to_cpu(scene_ir, adapter_options);
     if (!adapted.world.has_value()) {
         throw std::runtime_error("adapted CPU world is empty");
     }
+    // The legacy scene carries emissive geometry only; analytic lights come from the staged scene
+    adapted.analytic_lights = scene::compile_analytic_lights(scene::build_scene_v2(scene_id));
 
     Camera cam;
     configure_camera(*preset, resolved_spp, cam);
     cam.background = scene::scene_background(scene_id);
-    cam.render(adapted.world, adapted.lights);
+    cam.integrator = to_camera_integrator(options.integrator);
+    cam.rr_start_bounce = options.rr_start_bounce;
+    cam.adaptive.enabled = options.adaptive.enabled;
+    cam.adaptive.relative_error = options.adaptive.relative_error;
+    cam.adaptive.min_samples = options.adaptive.min_samples;
+    cam.adaptive.max_samples_per_pixel = options.adaptive.max_samples_per_pixel;
+    cam.restir.enabled = options.restir.enabled;
+    cam.restir.initial_candidates = options.restir.initial_candidates;
+    cam.restir.temporal_reuse = options.restir.temporal_reuse;
+    cam.restir.spatial_neighbors = options.restir.spatial_neighbors;
+    cam.restir.min_analytic_lights = options.restir.min_analytic_lights;
+    return render(cam, adapted);
+}
+
+cv::Mat render_in_one_pass(Camera& cam, const scene::CpuSceneAdapterResult& adapted) {
+    cam.render(adapted.world, adapted.lights, adapted.analytic_lights);
     return cam.img.clone();
 }
 
 }  // namespace
 
-cv::Mat render_shared_scene(std::string_view scene_id, const int samples_per_pixel) {
-    return render_shared_scene_with_camera(scene_id, samples_per_pixel,
+cv::Mat render_shared_scene(
+    std::string_view scene_id, const int samples_per_pixel, const OfflineRenderOptions& options) {
+    return render_shared_scene_with_camera(scene_id, samples_per_pixel, options,
         [](const scene::CpuRenderPreset& preset, const int resolved_spp, Camera& cam) {
             configure_offline_camera(make_offline_camera_config(preset.camera, preset.camera.max_depth), resolved_spp, cam);
-        });
+        },
+        render_in_one_pass);
 }
 
 cv::Mat render_shared_scene_from_camera(std::string_view scene_id, const PackedCamera& camera,
-    const int samples_per_pixel) {
-    return render_shared_scene_with_camera(scene_id, samples_per_pixel,
+    const int samples_per_pixel, const OfflineRenderOptions& options) {
+    return render_shared_scene_with_camera(scene_id, samples_per_pixel, options,
         [&camera](const scene::CpuRenderPreset&, const int resolved_spp, Camera& cam) {
             configure_offline_camera(make_offline_camera_config(camera), resolved_spp, cam);
+        },
+        render_in_one_pass);
+}
+
+ProgressiveRenderResult render_shared_scene_progressive(std::string_view scene_id,
+    const int samples_per_pixel, const OfflineRenderOptions& options,
+    const ProgressiveRenderOptions& progressive) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto configure = [](const scene::CpuRenderPreset& preset, const int resolved_spp, Camera& cam) {
+        configure_offline_camera(make_offline_camera_config(preset.camera, preset.camera.max_depth), resolved_spp, cam);
+    };
+
+    return render_shared_scene_with_camera(scene_id, samples_per_pixel, options, configure,
+        [&](Camera& cam, const scene::CpuSceneAdapterResult& adapted) {
+            const bool has_checkpoint = !progressive.checkpoint_path.empty();
+            if (progressive.resume && has_checkpoint && std::filesystem::exists(progressive.checkpoint_path)) {
+                RenderAccumulation accumulation = load_render_checkpoint(progressive.checkpoint_path);
+                if (accumulation.label != scene_id) {
+                    throw std::invalid_argument("render checkpoint was written for a different scene");
+                }
+                cam.accumulation = std::move(accumulation);
+            }
+
+            Camera::ProgressiveOptions pass_options;
+            pass_options.samples_per_pass = progressive.samples_per_pass;
+            pass_options.label = std::string(scene_id);
+            if (progressive.time_budget.has_value()) {
+                pass_options.deadline =
+                    start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(*progressive.time_budget);
+            }
+            if (has_checkpoint) {
+                pass_options.on_pass = [&progressive](const RenderAccumulation& accumulation) {
+                    save_render_checkpoint(progressive.checkpoint_path, accumulation);
+                };
+            }
+
+            ProgressiveRenderResult result;
+            result.completed = cam.render_progressive(
+                adapted.world, adapted.lights, adapted.analytic_lights, pass_options);
+            result.image = cam.img.clone();
+            result.min_samples_per_pixel = cam.accumulation.min_sample_count();
+            result.target_samples_per_pixel = cam.accumulation.target_samples_per_pixel;
+            result.sample_counts = cam.accumulation.sample_count.clone();
+            return result;
         });
 }
 
@@ -2,13 +2,76 @@
 
 #include <opencv2/core/mat.hpp>
 
+#include "common/russian_roulette.h"
 #include "realtime/camera_rig.h"
 
+#include <chrono>
+#include <filesystem>
+#include <optional>
 #include <string_view>
 
 namespace rt {
 
-cv::Mat render_shared_scene(std::string_view scene_id, int samples_per_pixel);
-cv::Mat render_shared_scene_from_camera(std::string_view scene_id, const PackedCamera& camera, int samples_per_pixel);
+enum class OfflineIntegrator {
+    recursive,  // One path at a time, bounce by bounce
+    wavefront,  // Tiles of paths advanced together, with material-sorted shading and shadow queues
+};
+
+// Per-pixel sample counts driven by variance; the scene's samples per pixel become the average
+// budget and `max_samples_per_pixel` caps the noisiest pixels
+struct OfflineAdaptiveSampling {
+    bool enabled = false;
+    double relative_error = 0.02;
+    int min_samples = 16;
+    int max_samples_per_pixel = 0;  // 0 caps pixels at four times the average budget
+};
+
+// Reservoir resampling of the scene's analytic lights at primary hits, reusing the previous
+// sample round at the same pixel and its neighbours; scenes with fewer than
+// `min_analytic_lights` lights keep one light sample per hit
+struct OfflineRestirDi {
+    bool enabled = false;
+    int initial_candidates = 4;
+    bool temporal_reuse = true;
+    int spatial_neighbors = 1;  // Up to 8
+    int min_analytic_lights = 16;
+};
+
+struct OfflineRenderOptions {
+    OfflineIntegrator integrator = OfflineIntegrator::recursive;
+    OfflineAdaptiveSampling adaptive;
+    OfflineRestirDi restir;
+    bool single_precision_geometry = false;  // Store and intersect mesh vertices in float
+    // First bounce whose continuation may end by Russian roulette, as in RenderProfile; negative
+    // traces every path to the scene's max depth
+    int rr_start_bounce = kDefaultRussianRouletteStartBounce;
+};
+
+struct ProgressiveRenderOptions {
+    int samples_per_pass = 16;
+    std::optional<std::chrono::duration<double>> time_budget;  // Wall-clock limit for this run
+    std::filesystem::path checkpoint_path;                     // Written after every pass if set
+    bool resume = false;  // Continue from checkpoint_path when it exists
+};
+
+struct ProgressiveRenderResult {
+    cv::Mat image;
+    bool completed = false;  // Every pixel reached the target sample count
+    int min_samples_per_pixel = 0;
+    int target_samples_per_pixel = 0;
+    cv::Mat sample_counts;  // CV_32SC1 samples taken per pixel
+};
+
+cv::Mat render_shared_scene(
+    std::string_view scene_id, int samples_per_pixel, const OfflineRenderOptions& options = {});
+cv::Mat render_shared_scene_from_camera(std::string_view scene_id, const PackedCamera& camera, int samples_per_pixel,
+    const OfflineRenderOptions& options = {});
+
+// Renders in passes of `progressive.samples_per_pass` samples into a float accumulation. A
+// checkpoint written by an earlier run of the same scene and sample count can be resumed, and a
+// time budget ends the run after the pass in flight, leaving a checkpoint to continue from.
+ProgressiveRenderResult render_shared_scene_progressive(std::string_view scene_id,
+    int samples_per_pixel, const OfflineRenderOptions& options,
+    const ProgressiveRenderOptions& progressive);
 
 }  // namespace rt
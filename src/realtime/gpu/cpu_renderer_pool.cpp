@@ -0,0 +1,331 @@
+#include "realtime/gpu/cpu_renderer_pool.h"
+
+#include "realtime/gpu/packed_scene_preparation.h"
+#include "realtime/gpu/radiance_frame_assembly.h"
+#include "realtime/gpu/radiance_launch_setup.h"
+#include "realtime/gpu/radiance_path_tracing.h"
+#include "realtime/gpu/render_request_validation.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace rt {
+
+namespace {
+
+int checked_primitive_count(std::size_t count, const char* label) {
+    if (count > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error(std::string("scene ") + label + " count exceeds int range");
+    }
+    return static_cast<int>(count);
+}
+
+void require_surface_primitives(std::size_t spheres, std::size_t quads, std::size_t triangles,
+    std::size_t mesh_instances) {
+    const int surface_count = checked_primitive_count(spheres, "sphere")
+                              + checked_primitive_count(quads, "quad")
+                              + checked_primitive_count(triangles, "triangle")
+                              + checked_primitive_count(mesh_instances, "mesh instance");
+    if (surface_count == 0) {
+        throw std::runtime_error("render_radiance requires at least one surface primitive");
+    }
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+        .count();
+}
+
+template<typename T>
+T* mutable_data(std::span<const T> values) {
+    // The path tracer only reads the scene; DeviceSceneView is shared with the mutable device side
+    return const_cast<T*>(values.data());
+}
+
+template<typename T>
+T* mutable_data(const std::vector<T>& values) {
+    return mutable_data(std::span<const T> {values});
+}
+
+// Same layout as DeviceSceneBuffers::view(), over the host arrays
+DeviceSceneView make_host_scene_view(const GpuPreparedSceneView& scene,
+    const GpuSceneAcceleration& acceleration) {
+    return DeviceSceneView {
+        .spheres = mutable_data(scene.spheres),
+        .quads = mutable_data(scene.quads),
+        .triangles = mutable_data(scene.triangles),
+        .vertex_positions = mutable_data(scene.vertex_positions),
+        .vertex_attributes = mutable_data(scene.vertex_attributes),
+        .media = mutable_data(scene.media),
+        .textures = mutable_data(scene.textures),
+        .image_texels = mutable_data(scene.image_texels),
+        .materials = mutable_data(scene.materials),
+        .openpbr_materials = mutable_data(scene.openpbr_materials),
+        .lights = mutable_data(scene.lights),
+        .analytic_lights = mutable_data(scene.analytic_lights),
+        .analytic_light_tree = mutable_data(scene.analytic_light_tree),
+        .analytic_infinite_lights = mutable_data(scene.analytic_infinite_lights),
+        .acceleration_nodes = mutable_data(acceleration.nodes()),
+        .acceleration_references = mutable_data(acceleration.references()),
+        .prototype_triangles = mutable_data(scene.prototype_triangles),
+        .prototype_vertex_positions = mutable_data(scene.prototype_vertex_positions),
+        .prototype_vertex_attributes = mutable_data(scene.prototype_vertex_attributes),
+        .mesh_instances = mutable_data(scene.mesh_instances),
+        .bottom_level_nodes = mutable_data(acceleration.bottom_level_nodes()),
+        .bottom_level_references = mutable_data(acceleration.bottom_level_references()),
+        .prototype_roots = mutable_data(acceleration.prototype_roots()),
+        .sphere_count = static_cast<int>(scene.spheres.size()),
+        .quad_count = static_cast<int>(scene.quads.size()),
+        .triangle_count = static_cast<int>(scene.triangles.size()),
+        .vertex_count = static_cast<int>(scene.vertex_positions.size()),
+        .medium_count = static_cast<int>(scene.media.size()),
+        .texture_count = static_cast<int>(scene.textures.size()),
+        .image_texel_count = static_cast<int>(scene.image_texels.size()),
+        .material_count = static_cast<int>(scene.materials.size()),
+        .openpbr_material_count = static_cast<int>(scene.openpbr_materials.size()),
+        .light_count = static_cast<int>(scene.lights.size()),
+        .analytic_light_count = static_cast<int>(scene.analytic_lights.size()),
+        .analytic_light_tree_node_count = static_cast<int>(scene.analytic_light_tree.size()),
+        .analytic_infinite_light_count = static_cast<int>(scene.analytic_infinite_lights.size()),
+        .acceleration_node_count = static_cast<int>(acceleration.nodes().size()),
+        .acceleration_reference_count = static_cast<int>(acceleration.references().size()),
+        .prototype_triangle_count = static_cast<int>(scene.prototype_triangles.size()),
+        .prototype_vertex_count = static_cast<int>(scene.prototype_vertex_positions.size()),
+        .mesh_instance_count = static_cast<int>(scene.mesh_instances.size()),
+        .bottom_level_node_count = static_cast<int>(acceleration.bottom_level_nodes().size()),
+        .bottom_level_reference_count =
+            static_cast<int>(acceleration.bottom_level_references().size()),
+        .prototype_count = static_cast<int>(acceleration.prototype_roots().size()),
+    };
+}
+
+// Host counterpart of one OptixRenderer's DeviceFrameBufferSet and sample stream
+struct CpuCameraState {
+    int width = 0;
+    int height = 0;
+    std::uint32_t sample_stream = 0;
+    std::vector<float4> beauty;
+    std::vector<float4> normal;
+    std::vector<float4> albedo;
+    std::vector<float> depth;
+    std::vector<RestirReservoir> reservoirs;
+    std::vector<float4> history_beauty;
+    std::vector<float4> history_normal;
+    std::vector<float> history_depth;
+    std::vector<RestirReservoir> history_reservoirs;
+    LaunchHistoryState history {};
+
+    void resize(int new_width, int new_height) {
+        if (new_width == width && new_height == height) {
+            return;
+        }
+        const std::size_t pixel_count =
+            static_cast<std::size_t>(new_width) * static_cast<std::size_t>(new_height);
+        beauty.assign(pixel_count, float4 {});
+        normal.assign(pixel_count, float4 {});
+        albedo.assign(pixel_count, float4 {});
+        depth.assign(pixel_count, 0.0f);
+        reservoirs.assign(pixel_count, RestirReservoir {});
+        history_beauty.assign(pixel_count, float4 {});
+        history_normal.assign(pixel_count, float4 {});
+        history_depth.assign(pixel_count, 0.0f);
+        history_reservoirs.assign(pixel_count, RestirReservoir {});
+        history = LaunchHistoryState {};
+        width = new_width;
+        height = new_height;
+    }
+
+    void reset_accumulation() {
+        history.history_length = 0;
+        history.previous_camera_valid = 0;
+    }
+
+    void clear_frame() {
+        std::fill(beauty.begin(), beauty.end(), float4 {});
+        std::fill(normal.begin(), normal.end(), float4 {});
+        std::fill(albedo.begin(), albedo.end(), float4 {});
+        std::fill(depth.begin(), depth.end(), 0.0f);
+        std::fill(reservoirs.begin(), reservoirs.end(), RestirReservoir {});
+    }
+
+    DeviceFrameBuffers frame_buffers() {
+        return DeviceFrameBuffers {
+            .beauty = beauty.data(),
+            .normal = normal.data(),
+            .albedo = albedo.data(),
+            .depth = depth.data(),
+            .restir_reservoirs = reservoirs.data(),
+        };
+    }
+
+    LaunchHistoryState history_state() {
+        LaunchHistoryState state = history;
+        state.buffers = DeviceFrameBuffers {
+            .beauty = history_beauty.data(),
+            .normal = history_normal.data(),
+            .depth = history_depth.data(),
+            .restir_reservoirs = history_reservoirs.data(),
+        };
+        return state;
+    }
+
+    void copy_frame_to_history() {
+        history_beauty = beauty;
+        history_normal = normal;
+        history_depth = depth;
+        history_reservoirs = reservoirs;
+    }
+};
+
+// One launch's radiance and reprojection passes, in the order the CUDA renderer enqueues them
+void trace_camera(const LaunchParams& params) {
+    const tbb::blocked_range<int> rows(0, params.height);
+    tbb::parallel_for(rows, [&params](const tbb::blocked_range<int>& range) {
+        for (int y = range.begin(); y != range.end(); ++y) {
+            for (int x = 0; x < params.width; ++x) {
+                path_tracing::render_radiance_pixel(params, x, y);
+            }
+        }
+    });
+    tbb::parallel_for(rows, [&params](const tbb::blocked_range<int>& range) {
+        for (int y = range.begin(); y != range.end(); ++y) {
+            for (int x = 0; x < params.width; ++x) {
+                path_tracing::resolve_reprojection_pixel(params, x, y);
+            }
+        }
+    });
+}
+
+} // namespace
+
+struct CpuRendererPool::Impl {
+    explicit Impl(int renderer_count) : cameras(static_cast<std::size_t>(renderer_count)) {}
+
+    void use_prepared_scene(const GpuPreparedSceneView& view,
+        std::chrono::steady_clock::time_point begin) {
+        prepared_view = view;
+        acceleration_stats = acceleration.update(view);
+        acceleration_stats.elapsed_ms = elapsed_ms(begin);
+        scene_view = make_host_scene_view(view, acceleration);
+        scene_prepared = true;
+        for (CpuCameraState& camera : cameras) {
+            camera.sample_stream = 0;
+            camera.reset_accumulation();
+        }
+    }
+
+    // The arrays traced come from an owned preparation or from a mapped cache file
+    GpuPreparedScene prepared;
+    std::optional<MappedPreparedScene> mapped;
+    GpuPreparedSceneView prepared_view;
+    GpuSceneAcceleration acceleration;
+    DeviceSceneView scene_view {};
+    bool scene_prepared = false;
+    std::vector<CpuCameraState> cameras;
+    std::uint64_t submissions = 0;
+    mutable std::mutex operation_mutex;
+    AccelerationUpdateStats acceleration_stats;
+};
+
+CpuRendererPool::CpuRendererPool(int renderer_count) {
+    if (renderer_count < 1 || renderer_count > 4) {
+        throw std::runtime_error("CpuRendererPool requires renderer_count in [1, 4]");
+    }
+    impl_ = std::make_unique<Impl>(renderer_count);
+}
+
+CpuRendererPool::~CpuRendererPool() = default;
+
+void CpuRendererPool::prepare_scene(const PackedScene& scene, const PreparedSceneSource* source) {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    const auto begin = std::chrono::steady_clock::now();
+    require_surface_primitives(scene.spheres.size(), scene.quads.size(), scene.triangles.size(),
+        scene.mesh_instances.size());
+    impl_->prepared = source != nullptr ? prepare_and_cache_gpu_scene(scene, *source)
+                                        : prepare_gpu_scene(scene);
+    impl_->mapped.reset();
+    impl_->use_prepared_scene(impl_->prepared, begin);
+}
+
+void CpuRendererPool::prepare_scene(MappedPreparedScene mapped) {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    const auto begin = std::chrono::steady_clock::now();
+    const GpuPreparedSceneView& view = mapped.view();
+    require_surface_primitives(view.spheres.size(), view.quads.size(), view.triangles.size(),
+        view.mesh_instances.size());
+    impl_->prepared = GpuPreparedScene {};
+    impl_->mapped = std::move(mapped);
+    impl_->use_prepared_scene(impl_->mapped->view(), begin);
+}
+
+void CpuRendererPool::reset_accumulation() {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    for (CpuCameraState& camera : impl_->cameras) {
+        camera.reset_accumulation();
+    }
+}
+
+void CpuRendererPool::reset_sequence(std::uint32_t sample_stream) {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    for (CpuCameraState& camera : impl_->cameras) {
+        camera.sample_stream = sample_stream;
+        camera.reset_accumulation();
+    }
+}
+
+std::vector<CameraRenderResult> CpuRendererPool::render_frame(const PackedCameraRig& rig,
+    const RenderProfile& profile, int active_cameras) {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    validate_render_pool_request(rig, active_cameras, static_cast<int>(impl_->cameras.size()),
+        "CpuRendererPool");
+    if (!impl_->scene_prepared) {
+        throw std::runtime_error("CpuRendererPool::render_frame requires prepare_scene() first");
+    }
+
+    std::vector<CameraRenderResult> results(static_cast<std::size_t>(active_cameras));
+    impl_->submissions += static_cast<std::uint64_t>(active_cameras);
+    tbb::parallel_for(0, active_cameras, [this, &rig, &profile, &results](int camera_index) {
+        const PackedCamera& camera = rig.cameras[static_cast<std::size_t>(camera_index)];
+        CpuCameraState& state = impl_->cameras[static_cast<std::size_t>(camera_index)];
+        CameraRenderResult& result = results[static_cast<std::size_t>(camera_index)];
+        result.camera_index = camera_index;
+
+        const auto render_begin = std::chrono::steady_clock::now();
+        state.resize(camera.width, camera.height);
+        state.clear_frame();
+        const LaunchParams params = make_radiance_launch_params(impl_->prepared_view.background,
+            impl_->scene_view, rig, profile, camera_index, state.sample_stream++,
+            state.frame_buffers(), state.history_state());
+        trace_camera(params);
+        state.history = capture_launch_history(params);
+        state.copy_frame_to_history();
+        result.profiled.timing.render_ms = static_cast<float>(elapsed_ms(render_begin));
+
+        const auto assembly_begin = std::chrono::steady_clock::now();
+        result.profiled.frame = make_radiance_frame(params.width, params.height,
+            state.beauty.data(), state.normal.data(), state.albedo.data(), state.depth.data());
+        result.profiled.timing.download_ms = static_cast<float>(elapsed_ms(assembly_begin));
+    });
+    return results;
+}
+
+RendererPoolDiagnostics CpuRendererPool::diagnostics() const {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    return RendererPoolDiagnostics {
+        .worker_count = static_cast<int>(impl_->cameras.size()),
+        .task_submission_count = impl_->submissions,
+        .acceleration = impl_->acceleration_stats,
+    };
+}
+
+} // namespace rt
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "realtime/gpu/renderer_pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rt {
+
+// Host fallback for RendererPool. It traces the prepared scene with the same per-pixel passes as
+// the CUDA kernels over host copies of the arrays and the host-built acceleration, rendering the
+// active cameras concurrently on the TBB scheduler. There is no denoiser, so denoise_ms stays zero
+// and enable_denoise returns the raw beauty.
+class CpuRendererPool {
+public:
+    explicit CpuRendererPool(int renderer_count);
+    ~CpuRendererPool();
+
+    CpuRendererPool(const CpuRendererPool&) = delete;
+    CpuRendererPool& operator=(const CpuRendererPool&) = delete;
+    CpuRendererPool(CpuRendererPool&&) = delete;
+    CpuRendererPool& operator=(CpuRendererPool&&) = delete;
+
+    // With a source, the preparation also refreshes that scene's on-disk cache
+    void prepare_scene(const PackedScene& scene, const PreparedSceneSource* source = nullptr);
+    // Traces the mapped cache in place; the pool keeps the mapping until the next preparation
+    void prepare_scene(MappedPreparedScene mapped);
+    void reset_accumulation();
+    void reset_sequence(std::uint32_t sample_stream);
+    std::vector<CameraRenderResult> render_frame(const PackedCameraRig& rig,
+        const RenderProfile& profile, int active_cameras);
+    RendererPoolDiagnostics diagnostics() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace rt
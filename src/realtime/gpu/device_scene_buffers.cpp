@@ -2,6 +2,7 @@
 
 #include <cuda_runtime.h>
 
+#include <span>
 #include <stdexcept>
 #include <string>
 
@@ -24,7 +25,7 @@ void free_device_ptr(void* ptr) {
 }
 
 template<typename T>
-void upload_vector(T*& out, std::size_t& capacity, const std::vector<T>& values) {
+void upload_vector(T*& out, std::size_t& capacity, std::span<const T> values) {
     if (values.size() > capacity) {
         free_device_ptr(out);
         out = nullptr;
@@ -39,14 +40,20 @@ void upload_vector(T*& out, std::size_t& capacity, const std::vector<T>& values)
         cudaMemcpy(out, values.data(), values.size() * sizeof(T), cudaMemcpyHostToDevice));
 }
 
+template<typename T>
+void upload_vector(T*& out, std::size_t& capacity, const std::vector<T>& values) {
+    upload_vector(out, capacity, std::span<const T> {values});
+}
+
 } // namespace
 
 DeviceSceneBuffers::~DeviceSceneBuffers() {
     reset();
 }
 
-void DeviceSceneBuffers::upload(const GpuPreparedScene& scene) {
-    if (scene.spheres.empty() && scene.quads.empty() && scene.triangles.empty()) {
+void DeviceSceneBuffers::upload(const GpuPreparedSceneView& scene) {
+    if (scene.spheres.empty() && scene.quads.empty() && scene.triangles.empty()
+        && scene.mesh_instances.empty()) {
         reset();
         return;
     }
@@ -55,7 +62,7 @@ void DeviceSceneBuffers::upload(const GpuPreparedScene& scene) {
     upload(scene, acceleration, update.kind);
 }
 
-void DeviceSceneBuffers::upload(const GpuPreparedScene& scene,
+void DeviceSceneBuffers::upload(const GpuPreparedSceneView& scene,
     const GpuSceneAcceleration& acceleration, AccelerationUpdateKind update_kind) {
     const bool upload_geometry = update_kind == AccelerationUpdateKind::rebuild
                                  || update_kind == AccelerationUpdateKind::refit;
@@ -64,10 +71,26 @@ void DeviceSceneBuffers::upload(const GpuPreparedScene& scene,
         upload_vector(spheres_, sphere_capacity_, scene.spheres);
         upload_vector(quads_, quad_capacity_, scene.quads);
         upload_vector(triangles_, triangle_capacity_, scene.triangles);
+        upload_vector(vertex_positions_, vertex_position_capacity_, scene.vertex_positions);
+        upload_vector(vertex_attributes_, vertex_attribute_capacity_, scene.vertex_attributes);
+        upload_vector(mesh_instances_, mesh_instance_capacity_, scene.mesh_instances);
         upload_vector(acceleration_nodes_, acceleration_node_capacity_, acceleration.nodes());
+        // A refit only moves top-level bounds, so the prototypes and their hierarchies stay
         if (update_kind == AccelerationUpdateKind::rebuild) {
             upload_vector(acceleration_references_, acceleration_reference_capacity_,
                 acceleration.references());
+            upload_vector(prototype_triangles_, prototype_triangle_capacity_,
+                scene.prototype_triangles);
+            upload_vector(prototype_vertex_positions_, prototype_vertex_position_capacity_,
+                scene.prototype_vertex_positions);
+            upload_vector(prototype_vertex_attributes_, prototype_vertex_attribute_capacity_,
+                scene.prototype_vertex_attributes);
+            upload_vector(bottom_level_nodes_, bottom_level_node_capacity_,
+                acceleration.bottom_level_nodes());
+            upload_vector(bottom_level_references_, bottom_level_reference_capacity_,
+                acceleration.bottom_level_references());
+            upload_vector(prototype_roots_, prototype_root_capacity_,
+                acceleration.prototype_roots());
         }
     }
     if (upload_scene_data) {
@@ -78,11 +101,16 @@ void DeviceSceneBuffers::upload(const GpuPreparedScene& scene,
         upload_vector(openpbr_materials_, openpbr_material_capacity_, scene.openpbr_materials);
         upload_vector(lights_, light_capacity_, scene.lights);
         upload_vector(analytic_lights_, analytic_light_capacity_, scene.analytic_lights);
+        upload_vector(analytic_light_tree_, analytic_light_tree_capacity_,
+            scene.analytic_light_tree);
+        upload_vector(analytic_infinite_lights_, analytic_infinite_light_capacity_,
+            scene.analytic_infinite_lights);
     }
 
     sphere_count_ = static_cast<int>(scene.spheres.size());
     quad_count_ = static_cast<int>(scene.quads.size());
     triangle_count_ = static_cast<int>(scene.triangles.size());
+    vertex_count_ = static_cast<int>(scene.vertex_positions.size());
     medium_count_ = static_cast<int>(scene.media.size());
     texture_count_ = static_cast<int>(scene.textures.size());
     image_texel_count_ = static_cast<int>(scene.image_texels.size());
@@ -90,14 +118,25 @@ void DeviceSceneBuffers::upload(const GpuPreparedScene& scene,
     openpbr_material_count_ = static_cast<int>(scene.openpbr_materials.size());
     light_count_ = static_cast<int>(scene.lights.size());
     analytic_light_count_ = static_cast<int>(scene.analytic_lights.size());
+    analytic_light_tree_node_count_ = static_cast<int>(scene.analytic_light_tree.size());
+    analytic_infinite_light_count_ = static_cast<int>(scene.analytic_infinite_lights.size());
     acceleration_node_count_ = static_cast<int>(acceleration.nodes().size());
     acceleration_reference_count_ = static_cast<int>(acceleration.references().size());
+    prototype_triangle_count_ = static_cast<int>(scene.prototype_triangles.size());
+    prototype_vertex_count_ = static_cast<int>(scene.prototype_vertex_positions.size());
+    mesh_instance_count_ = static_cast<int>(scene.mesh_instances.size());
+    bottom_level_node_count_ = static_cast<int>(acceleration.bottom_level_nodes().size());
+    bottom_level_reference_count_ =
+        static_cast<int>(acceleration.bottom_level_references().size());
+    prototype_count_ = static_cast<int>(acceleration.prototype_roots().size());
 }
 
 void DeviceSceneBuffers::reset() {
     free_device_ptr(spheres_);
     free_device_ptr(quads_);
     free_device_ptr(triangles_);
+    free_device_ptr(vertex_positions_);
+    free_device_ptr(vertex_attributes_);
     free_device_ptr(media_);
     free_device_ptr(textures_);
     free_device_ptr(image_texels_);
@@ -105,11 +144,22 @@ void DeviceSceneBuffers::reset() {
     free_device_ptr(openpbr_materials_);
     free_device_ptr(lights_);
     free_device_ptr(analytic_lights_);
+    free_device_ptr(analytic_light_tree_);
+    free_device_ptr(analytic_infinite_lights_);
     free_device_ptr(acceleration_nodes_);
     free_device_ptr(acceleration_references_);
+    free_device_ptr(prototype_triangles_);
+    free_device_ptr(prototype_vertex_positions_);
+    free_device_ptr(prototype_vertex_attributes_);
+    free_device_ptr(mesh_instances_);
+    free_device_ptr(bottom_level_nodes_);
+    free_device_ptr(bottom_level_references_);
+    free_device_ptr(prototype_roots_);
     spheres_ = nullptr;
     quads_ = nullptr;
     triangles_ = nullptr;
+    vertex_positions_ = nullptr;
+    vertex_attributes_ = nullptr;
     media_ = nullptr;
     textures_ = nullptr;
     image_texels_ = nullptr;
@@ -117,11 +167,22 @@ void DeviceSceneBuffers::reset() {
     openpbr_materials_ = nullptr;
     lights_ = nullptr;
     analytic_lights_ = nullptr;
+    analytic_light_tree_ = nullptr;
+    analytic_infinite_lights_ = nullptr;
     acceleration_nodes_ = nullptr;
     acceleration_references_ = nullptr;
+    prototype_triangles_ = nullptr;
+    prototype_vertex_positions_ = nullptr;
+    prototype_vertex_attributes_ = nullptr;
+    mesh_instances_ = nullptr;
+    bottom_level_nodes_ = nullptr;
+    bottom_level_references_ = nullptr;
+    prototype_roots_ = nullptr;
     sphere_capacity_ = 0;
     quad_capacity_ = 0;
     triangle_capacity_ = 0;
+    vertex_position_capacity_ = 0;
+    vertex_attribute_capacity_ = 0;
     medium_capacity_ = 0;
     texture_capacity_ = 0;
     image_texel_capacity_ = 0;
@@ -129,11 +190,21 @@ void DeviceSceneBuffers::reset() {
     openpbr_material_capacity_ = 0;
     light_capacity_ = 0;
     analytic_light_capacity_ = 0;
+    analytic_light_tree_capacity_ = 0;
+    analytic_infinite_light_capacity_ = 0;
     acceleration_node_capacity_ = 0;
     acceleration_reference_capacity_ = 0;
+    prototype_triangle_capacity_ = 0;
+    prototype_vertex_position_capacity_ = 0;
+    prototype_vertex_attribute_capacity_ = 0;
+    mesh_instance_capacity_ = 0;
+    bottom_level_node_capacity_ = 0;
+    bottom_level_reference_capacity_ = 0;
+    prototype_root_capacity_ = 0;
     sphere_count_ = 0;
     quad_count_ = 0;
     triangle_count_ = 0;
+    vertex_count_ = 0;
     medium_count_ = 0;
     texture_count_ = 0;
     image_texel_count_ = 0;
@@ -141,8 +212,16 @@ void DeviceSceneBuffers::reset() {
     openpbr_material_count_ = 0;
     light_count_ = 0;
     analytic_light_count_ = 0;
+    analytic_light_tree_node_count_ = 0;
+    analytic_infinite_light_count_ = 0;
     acceleration_node_count_ = 0;
     acceleration_reference_count_ = 0;
+    prototype_triangle_count_ = 0;
+    prototype_vertex_count_ = 0;
+    mesh_instance_count_ = 0;
+    bottom_level_node_count_ = 0;
+    bottom_level_reference_count_ = 0;
+    prototype_count_ = 0;
 }
 
 DeviceSceneView DeviceSceneBuffers::view() const {
@@ -150,6 +229,8 @@ DeviceSceneView DeviceSceneBuffers::view() const {
         .spheres = spheres_,
         .quads = quads_,
         .triangles = triangles_,
+        .vertex_positions = vertex_positions_,
+        .vertex_attributes = vertex_attributes_,
         .media = media_,
         .textures = textures_,
         .image_texels = image_texels_,
@@ -157,11 +238,21 @@ DeviceSceneView DeviceSceneBuffers::view() const {
         .openpbr_materials = openpbr_materials_,
         .lights = lights_,
         .analytic_lights = analytic_lights_,
+        .analytic_light_tree = analytic_light_tree_,
+        .analytic_infinite_lights = analytic_infinite_lights_,
         .acceleration_nodes = acceleration_nodes_,
         .acceleration_references = acceleration_references_,
+        .prototype_triangles = prototype_triangles_,
+        .prototype_vertex_positions = prototype_vertex_positions_,
+        .prototype_vertex_attributes = prototype_vertex_attributes_,
+        .mesh_instances = mesh_instances_,
+        .bottom_level_nodes = bottom_level_nodes_,
+        .bottom_level_references = bottom_level_references_,
+        .prototype_roots = prototype_roots_,
         .sphere_count = sphere_count_,
         .quad_count = quad_count_,
         .triangle_count = triangle_count_,
+        .vertex_count = vertex_count_,
         .medium_count = medium_count_,
         .texture_count = texture_count_,
         .image_texel_count = image_texel_count_,
@@ -169,8 +260,16 @@ DeviceSceneView DeviceSceneBuffers::view() const {
         .openpbr_material_count = openpbr_material_count_,
         .light_count = light_count_,
         .analytic_light_count = analytic_light_count_,
+        .analytic_light_tree_node_count = analytic_light_tree_node_count_,
+        .analytic_infinite_light_count = analytic_infinite_light_count_,
         .acceleration_node_count = acceleration_node_count_,
         .acceleration_reference_count = acceleration_reference_count_,
+        .prototype_triangle_count = prototype_triangle_count_,
+        .prototype_vertex_count = prototype_vertex_count_,
+        .mesh_instance_count = mesh_instance_count_,
+        .bottom_level_node_count = bottom_level_node_count_,
+        .bottom_level_reference_count = bottom_level_reference_count_,
+        .prototype_count = prototype_count_,
     };
 }
 
@@ -17,8 +17,8 @@ public:
     DeviceSceneBuffers(DeviceSceneBuffers&&) = delete;
     DeviceSceneBuffers& operator=(DeviceSceneBuffers&&) = delete;
 
-    void upload(const GpuPreparedScene& scene);
-    void upload(const GpuPreparedScene& scene, const GpuSceneAcceleration& acceleration,
+    void upload(const GpuPreparedSceneView& scene);
+    void upload(const GpuPreparedSceneView& scene, const GpuSceneAcceleration& acceleration,
         AccelerationUpdateKind update_kind);
     void reset();
     DeviceSceneView view() const;
@@ -27,6 +27,8 @@ private:
     PackedSphere* spheres_ = nullptr;
     PackedQuad* quads_ = nullptr;
     PackedTriangle* triangles_ = nullptr;
+    Eigen::Vector3f* vertex_positions_ = nullptr;
+    PackedVertexAttributes* vertex_attributes_ = nullptr;
     PackedMedium* media_ = nullptr;
     PackedTexture* textures_ = nullptr;
     Eigen::Vector3f* image_texels_ = nullptr;
@@ -34,11 +36,22 @@ private:
     OpenPbrCompiledMaterial* openpbr_materials_ = nullptr;
     PackedLight* lights_ = nullptr;
     PackedAnalyticLight* analytic_lights_ = nullptr;
+    LightTreeNode* analytic_light_tree_ = nullptr;
+    LightTreeInfiniteEntry* analytic_infinite_lights_ = nullptr;
     PackedBvhNode* acceleration_nodes_ = nullptr;
     PackedPrimitiveRef* acceleration_references_ = nullptr;
+    PackedTriangle* prototype_triangles_ = nullptr;
+    Eigen::Vector3f* prototype_vertex_positions_ = nullptr;
+    PackedVertexAttributes* prototype_vertex_attributes_ = nullptr;
+    PackedMeshInstance* mesh_instances_ = nullptr;
+    PackedBvhNode* bottom_level_nodes_ = nullptr;
+    PackedPrimitiveRef* bottom_level_references_ = nullptr;
+    int* prototype_roots_ = nullptr;
     std::size_t sphere_capacity_ = 0;
     std::size_t quad_capacity_ = 0;
     std::size_t triangle_capacity_ = 0;
+    std::size_t vertex_position_capacity_ = 0;
+    std::size_t vertex_attribute_capacity_ = 0;
     std::size_t medium_capacity_ = 0;
     std::size_t texture_capacity_ = 0;
     std::size_t image_texel_capacity_ = 0;
@@ -46,11 +59,21 @@ private:
     std::size_t openpbr_material_capacity_ = 0;
     std::size_t light_capacity_ = 0;
     std::size_t analytic_light_capacity_ = 0;
+    std::size_t analytic_light_tree_capacity_ = 0;
+    std::size_t analytic_infinite_light_capacity_ = 0;
     std::size_t acceleration_node_capacity_ = 0;
     std::size_t acceleration_reference_capacity_ = 0;
+    std::size_t prototype_triangle_capacity_ = 0;
+    std::size_t prototype_vertex_position_capacity_ = 0;
+    std::size_t prototype_vertex_attribute_capacity_ = 0;
+    std::size_t mesh_instance_capacity_ = 0;
+    std::size_t bottom_level_node_capacity_ = 0;
+    std::size_t bottom_level_reference_capacity_ = 0;
+    std::size_t prototype_root_capacity_ = 0;
     int sphere_count_ = 0;
     int quad_count_ = 0;
     int triangle_count_ = 0;
+    int vertex_count_ = 0;
     int medium_count_ = 0;
     int texture_count_ = 0;
     int image_texel_count_ = 0;
@@ -58,8 +81,16 @@ private:
     int openpbr_material_count_ = 0;
     int light_count_ = 0;
     int analytic_light_count_ = 0;
+    int analytic_light_tree_node_count_ = 0;
+    int analytic_infinite_light_count_ = 0;
     int acceleration_node_count_ = 0;
     int acceleration_reference_count_ = 0;
+    int prototype_triangle_count_ = 0;
+    int prototype_vertex_count_ = 0;
+    int mesh_instance_count_ = 0;
+    int bottom_level_node_count_ = 0;
+    int bottom_level_reference_count_ = 0;
+    int prototype_count_ = 0;
 };
 
 } // namespace rt
@@ -1,14 +1,18 @@
 #include "realtime/gpu/gpu_scene_acceleration.h"
 
+#include "common/bvh_builder.h"
+#include "common/content_hash.h"
+
 #include <algorithm>
 #include <array>
 #include <chrono>
 #include <cmath>
 #include <cstddef>
-#include <cstring>
 #include <limits>
 #include <set>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <utility>
 
@@ -16,9 +20,8 @@ namespace rt {
 namespace {
 
 constexpr int kLeafSize = 4;
+constexpr int kParallelThreshold = 4096;
 constexpr float kBoundsPadding = 1e-5f;
-constexpr std::uint64_t kFnvOffset = 14695981039346656037ULL;
-constexpr std::uint64_t kFnvPrime = 1099511628211ULL;
 
 struct Bounds {
     Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::infinity());
@@ -50,6 +53,15 @@ Bounds padded_bounds(Bounds bounds) {
     return bounds;
 }
 
+// Bounds-checked element access; std::span only gains at() in C++26
+template<typename T>
+const T& element_at(std::span<const T> values, std::size_t index) {
+    if (index >= values.size()) {
+        throw std::out_of_range("prepared scene index out of range");
+    }
+    return values[index];
+}
+
 Bounds sphere_bounds(const PackedSphere& sphere) {
     const Eigen::Vector3f radius = Eigen::Vector3f::Constant(std::abs(sphere.radius));
     return Bounds {.min = sphere.center - radius, .max = sphere.center + radius};
@@ -64,118 +76,268 @@ Bounds quad_bounds(const PackedQuad& quad) {
     return padded_bounds(bounds);
 }
 
-Bounds triangle_bounds(const PackedTriangle& triangle) {
+Bounds triangle_bounds(const PackedTriangle& triangle,
+    std::span<const Eigen::Vector3f> vertex_positions) {
     Bounds bounds;
-    extend(bounds, triangle.p0);
-    extend(bounds, triangle.p1);
-    extend(bounds, triangle.p2);
+    extend(bounds, element_at(vertex_positions, triangle.vertex0));
+    extend(bounds, element_at(vertex_positions, triangle.vertex1));
+    extend(bounds, element_at(vertex_positions, triangle.vertex2));
     return padded_bounds(bounds);
 }
 
-Bounds reference_bounds(const GpuPreparedScene& scene, const PackedPrimitiveRef& reference) {
+Bounds reference_bounds(const GpuPreparedSceneView& scene, const PackedPrimitiveRef& reference) {
     switch (static_cast<PackedPrimitiveType>(reference.primitive_type)) {
         case PackedPrimitiveType::sphere:
             return sphere_bounds(
-                scene.spheres.at(static_cast<std::size_t>(reference.primitive_index)));
+                element_at(scene.spheres, static_cast<std::size_t>(reference.primitive_index)));
         case PackedPrimitiveType::quad:
-            return quad_bounds(scene.quads.at(static_cast<std::size_t>(reference.primitive_index)));
+            return quad_bounds(
+                element_at(scene.quads, static_cast<std::size_t>(reference.primitive_index)));
         case PackedPrimitiveType::triangle:
             return triangle_bounds(
-                scene.triangles.at(static_cast<std::size_t>(reference.primitive_index)));
+                element_at(scene.triangles, static_cast<std::size_t>(reference.primitive_index)),
+                scene.vertex_positions);
+        case PackedPrimitiveType::mesh_instance: break;
     }
     throw std::logic_error("unknown packed acceleration primitive type");
 }
 
-Eigen::Vector3f centroid(const Bounds& bounds) {
-    return (bounds.min + bounds.max) * 0.5f;
+// World bounds of an instance from the eight transformed corners of its prototype's root bounds.
+// An instance of an empty prototype has empty bounds.
+Bounds mesh_instance_bounds(const PackedMeshInstance& instance,
+    const std::vector<PackedBvhNode>& bottom_level_nodes, const std::vector<int>& prototype_roots) {
+    const int root_index = prototype_roots.at(static_cast<std::size_t>(instance.prototype_index));
+    if (root_index < 0) {
+        return Bounds {};
+    }
+    const PackedBvhNode& root = bottom_level_nodes.at(static_cast<std::size_t>(root_index));
+    Bounds bounds;
+    for (int corner = 0; corner < 8; ++corner) {
+        const Eigen::Vector3f local {(corner & 1) != 0 ? root.bounds_max.x() : root.bounds_min.x(),
+            (corner & 2) != 0 ? root.bounds_max.y() : root.bounds_min.y(),
+            (corner & 4) != 0 ? root.bounds_max.z() : root.bounds_min.z()};
+        extend(bounds,
+            Eigen::Vector3f {instance.linear_row0.dot(local), instance.linear_row1.dot(local),
+                instance.linear_row2.dot(local)}
+                + instance.translation);
+    }
+    return padded_bounds(bounds);
+}
+
+template<typename T>
+std::uint64_t hash_vector(std::uint64_t hash, std::span<const T> values,
+    std::uint64_t& hashed_bytes) {
+    const std::size_t size = values.size() * sizeof(T);
+    hashed_bytes += size;
+    return size == 0 ? hash_mix(hash, 0) : hash_bytes(hash, values.data(), size);
 }
 
-std::uint64_t hash_bytes(std::uint64_t hash, const void* data, std::size_t size) {
-    const auto* bytes = static_cast<const unsigned char*>(data);
-    for (std::size_t i = 0; i < size; ++i) {
-        hash ^= bytes[i];
-        hash *= kFnvPrime;
+// Arrays are tracked in three groups: top-level geometry (refit), mesh prototypes (rebuild), then
+// shading data (update).
+enum TrackedArrayIndex : int {
+    kSpheres,
+    kQuads,
+    kTriangles,
+    kMeshInstances,
+    kMeshPrototypes,
+    kMedia,
+    kTextures,
+    kMaterials,
+    kAnalyticLights,
+};
+
+constexpr int kGeometryArrayEnd = kMedia;
+
+std::string_view tracked_array_name(int array) {
+    switch (array) {
+        case kSpheres: return "spheres";
+        case kQuads: return "quads";
+        case kTriangles: return "triangles";
+        case kMeshInstances: return "mesh_instances";
+        case kMeshPrototypes: return "mesh_prototypes";
+        case kMedia: return "media";
+        case kTextures: return "textures";
+        case kMaterials: return "materials";
+        case kAnalyticLights: return "analytic_lights";
     }
-    return hash;
+    return "unknown";
+}
+
+std::uint64_t tracked_array_generation(const SceneGenerations& generations, int array) {
+    switch (array) {
+        case kSpheres: return generations.spheres;
+        case kQuads: return generations.quads;
+        case kTriangles: return generations.triangles;
+        case kMeshInstances: return generations.mesh_instances;
+        case kMeshPrototypes: return generations.mesh_prototypes;
+        case kMedia: return generations.media;
+        case kTextures: return generations.textures;
+        case kMaterials: return generations.materials;
+        case kAnalyticLights: return generations.analytic_lights;
+    }
+    return 0;
 }
 
 template<typename T>
-std::uint64_t hash_value(std::uint64_t hash, const T& value) {
+std::uint64_t hash_value(std::uint64_t hash, const T& value, std::uint64_t& hashed_bytes) {
+    hashed_bytes += sizeof(T);
     return hash_bytes(hash, &value, sizeof(T));
 }
 
-template<typename T>
-std::uint64_t hash_vector(std::uint64_t hash, const std::vector<T>& values) {
-    hash = hash_value(hash, values.size());
-    if (!values.empty()) {
-        hash = hash_bytes(hash, values.data(), values.size() * sizeof(T));
-    }
-    return hash;
-}
-
-std::uint64_t geometry_signature(const GpuPreparedScene& scene) {
-    std::uint64_t hash = kFnvOffset;
-    hash = hash_vector(hash, scene.spheres);
-    hash = hash_vector(hash, scene.quads);
-    hash = hash_vector(hash, scene.triangles);
-    return hash;
-}
-
-std::uint64_t scene_signature(const GpuPreparedScene& scene) {
-    std::uint64_t hash = geometry_signature(scene);
-    hash = hash_value(hash, scene.background);
-    hash = hash_vector(hash, scene.media);
-    hash = hash_vector(hash, scene.textures);
-    hash = hash_vector(hash, scene.image_texels);
-    hash = hash_vector(hash, scene.materials);
-    hash = hash_vector(hash, scene.openpbr_materials);
-    hash = hash_vector(hash, scene.lights);
-    hash = hash_vector(hash, scene.analytic_lights);
-    return hash;
-}
-
-int largest_axis(const Bounds& bounds) {
-    const Eigen::Vector3f extent = bounds.max - bounds.min;
-    if (extent.y() > extent.x() && extent.y() >= extent.z()) {
-        return 1;
+// Arrays without per-element stamps hash whole, with the arrays derived from them: prototype
+// triangles and vertex streams with their ranges, the light tree with the analytic lights. The
+// light distribution is derived from arrays that are already tracked.
+std::uint64_t tracked_array_hash(const GpuPreparedSceneView& scene, int array,
+    std::uint64_t& hashed_bytes) {
+    switch (array) {
+        case kMeshPrototypes: {
+            const std::uint64_t triangles =
+                hash_vector(hash_vector(kHashSeed, scene.mesh_prototypes, hashed_bytes),
+                    scene.prototype_triangles, hashed_bytes);
+            const std::uint64_t positions =
+                hash_vector(triangles, scene.prototype_vertex_positions, hashed_bytes);
+            return hash_vector(positions, scene.prototype_vertex_attributes, hashed_bytes);
+        }
+        case kAnalyticLights: {
+            const std::uint64_t lights =
+                hash_vector(kHashSeed, scene.analytic_lights, hashed_bytes);
+            return hash_vector(hash_vector(lights, scene.analytic_light_tree, hashed_bytes),
+                scene.analytic_infinite_lights, hashed_bytes);
+        }
     }
-    return extent.z() > extent.x() ? 2 : 0;
+    throw std::logic_error("scene array is tracked per element");
 }
 
-int build_node(std::vector<PackedBvhNode>& nodes, std::vector<BuildReference>& references,
-    int begin, int end) {
-    const int node_index = static_cast<int>(nodes.size());
-    nodes.emplace_back();
+// A view without stamps reads as a scene stamped zero, so every array in it is hashed
+const SceneGenerations& scene_generations(const GpuPreparedSceneView& scene) {
+    static const SceneGenerations unstamped {};
+    return scene.generations != nullptr ? *scene.generations : unstamped;
+}
 
-    Bounds node_bounds;
-    Bounds centroid_bounds;
-    for (int i = begin; i < end; ++i) {
-        extend(node_bounds, references[static_cast<std::size_t>(i)].bounds);
-        extend(centroid_bounds, centroid(references[static_cast<std::size_t>(i)].bounds));
+// Stamps of the arrays whose prepared elements map one to one onto the scene's, or null
+const std::vector<std::uint64_t>* tracked_element_generations(const SceneGenerations& generations,
+    int array) {
+    switch (array) {
+        case kSpheres: return &generations.sphere_elements;
+        case kQuads: return &generations.quad_elements;
+        case kTriangles: return &generations.triangle_elements;
+        case kMeshInstances: return &generations.mesh_instance_elements;
+        case kMedia: return &generations.medium_elements;
+        case kTextures: return &generations.texture_elements;
+        case kMaterials: return &generations.material_elements;
     }
+    return nullptr;
+}
 
-    const int count = end - begin;
-    PackedBvhNode& node = nodes[static_cast<std::size_t>(node_index)];
-    node.bounds_min = node_bounds.min;
-    node.bounds_max = node_bounds.max;
-    if (count <= kLeafSize) {
-        node.first_reference = begin;
-        node.reference_count = count;
-        return node_index;
+std::size_t tracked_element_count(const GpuPreparedSceneView& scene, int array) {
+    switch (array) {
+        case kSpheres: return scene.spheres.size();
+        case kQuads: return scene.quads.size();
+        case kTriangles: return scene.triangles.size();
+        case kMeshInstances: return scene.mesh_instances.size();
+        case kMedia: return scene.media.size();
+        case kTextures: return scene.textures.size();
+        case kMaterials: return scene.materials.size();
+    }
+    return 0;
+}
+
+// An element hashes what it resolves to rather than where its derived data sits: triangles their
+// vertices, textures their texels, materials their compiled OpenPBR parameters. Editing one
+// element can shift the offsets of the others, which must not read as a change to them.
+std::uint64_t tracked_element_hash(const GpuPreparedSceneView& scene, int array, std::size_t index,
+    std::uint64_t& hashed_bytes) {
+    switch (array) {
+        case kSpheres: return hash_value(kHashSeed, scene.spheres[index], hashed_bytes);
+        case kQuads: return hash_value(kHashSeed, scene.quads[index], hashed_bytes);
+        case kTriangles: {
+            PackedTriangle triangle = scene.triangles[index];
+            std::uint64_t hash = kHashSeed;
+            for (const std::uint32_t vertex :
+                {triangle.vertex0, triangle.vertex1, triangle.vertex2}) {
+                hash = hash_value(hash, element_at(scene.vertex_positions, vertex), hashed_bytes);
+                hash = hash_value(hash, element_at(scene.vertex_attributes, vertex), hashed_bytes);
+            }
+            triangle.vertex0 = triangle.vertex1 = triangle.vertex2 = 0;
+            return hash_value(hash_value(hash, triangle, hashed_bytes),
+                element_at(scene.triangle_acceleration_ids, index), hashed_bytes);
+        }
+        case kMeshInstances:
+            return hash_value(kHashSeed, scene.mesh_instances[index], hashed_bytes);
+        case kMedia: return hash_value(kHashSeed, scene.media[index], hashed_bytes);
+        case kTextures: {
+            PackedTexture texture = scene.textures[index];
+            const std::size_t first = static_cast<std::size_t>(texture.image_offset);
+            const std::size_t count =
+                static_cast<std::size_t>(texture.image_width) * texture.image_height;
+            if (first + count > scene.image_texels.size()) {
+                throw std::logic_error("prepared texture reads past the image texels");
+            }
+            hashed_bytes += count * sizeof(Eigen::Vector3f);
+            const std::uint64_t texels = hash_bytes(kHashSeed, scene.image_texels.data() + first,
+                count * sizeof(Eigen::Vector3f));
+            texture.image_offset = 0;
+            return hash_value(texels, texture, hashed_bytes);
+        }
+        case kMaterials: {
+            MaterialSample material = scene.materials[index];
+            std::uint64_t hash = kHashSeed;
+            if (material.openpbr_index >= 0) {
+                hash = hash_value(hash,
+                    element_at(scene.openpbr_materials,
+                        static_cast<std::size_t>(material.openpbr_index)),
+                    hashed_bytes);
+                material.openpbr_index = 0;
+            }
+            return hash_value(hash, material, hashed_bytes);
+        }
     }
+    throw std::logic_error("scene array is tracked whole");
+}
+
+// The device traversal tests a whole leaf at once, so an intersection is priced at a fraction of
+// a node visit: ranges of up to kLeafSize primitives stay leaves and SAH only chooses the splits.
+BvhBuildOptions gpu_build_options() {
+    return BvhBuildOptions {
+        .max_leaf_size = kLeafSize,
+        .parallel_threshold = kParallelThreshold,
+        .traversal_cost = 1.0,
+        .intersection_cost = 1.0 / kLeafSize,
+    };
+}
+
+AABB to_aabb(const Bounds& bounds) {
+    // Assign the intervals directly: the bounds are already padded, and the interval constructor
+    // would pad again.
+    AABB box;
+    box.x = Interval {bounds.min.x(), bounds.max.x()};
+    box.y = Interval {bounds.min.y(), bounds.max.y()};
+    box.z = Interval {bounds.min.z(), bounds.max.z()};
+    return box;
+}
 
-    const int axis = largest_axis(centroid_bounds);
-    const int middle = begin + count / 2;
-    std::nth_element(references.begin() + begin, references.begin() + middle,
-        references.begin() + end, [&](const BuildReference& lhs, const BuildReference& rhs) {
-            return centroid(lhs.bounds)[axis] < centroid(rhs.bounds)[axis];
-        });
-    const int left = build_node(nodes, references, begin, middle);
-    const int right = build_node(nodes, references, middle, end);
-    PackedBvhNode& completed = nodes[static_cast<std::size_t>(node_index)];
-    completed.left_child = left;
-    completed.right_child = right;
-    return node_index;
+double surface_area(const Eigen::Vector3f& min, const Eigen::Vector3f& max) {
+    const Eigen::Vector3d extent = (max - min).cast<double>().cwiseMax(0.0);
+    return 2.0 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+double packed_sah_cost(const std::vector<PackedBvhNode>& nodes) {
+    if (nodes.empty()) {
+        return 0.0;
+    }
+    const double root_area = surface_area(nodes.front().bounds_min, nodes.front().bounds_max);
+    if (root_area <= 0.0) {
+        return 0.0;
+    }
+    const BvhBuildOptions options = gpu_build_options();
+    double cost = 0.0;
+    for (const PackedBvhNode& node : nodes) {
+        const double area_ratio = surface_area(node.bounds_min, node.bounds_max) / root_area;
+        cost += node.reference_count > 0
+                    ? area_ratio * options.intersection_cost * node.reference_count
+                    : area_ratio * options.traversal_cost;
+    }
+    return cost;
 }
 
 void append_reference(std::vector<BuildReference>& out, PackedPrimitiveType type, int index,
@@ -192,7 +354,83 @@ void append_reference(std::vector<BuildReference>& out, PackedPrimitiveType type
     });
 }
 
-AccelerationUpdateStats instance_stats(const std::vector<PackedPrimitiveRef>& references) {
+FlatBvh build_hierarchy(const std::vector<BuildReference>& build_references,
+    AccelerationBuildMode mode) {
+    std::vector<AABB> primitive_bounds;
+    primitive_bounds.reserve(build_references.size());
+    for (const BuildReference& reference : build_references) {
+        primitive_bounds.push_back(to_aabb(reference.bounds));
+    }
+    return mode == AccelerationBuildMode::lbvh
+               ? build_lbvh(primitive_bounds, gpu_build_options())
+               : build_binned_sah_bvh(primitive_bounds, gpu_build_options());
+}
+
+// Appends a builder's nodes and leaf references, offsetting child and reference indices so that
+// several hierarchies can share one array. Both builders emit nodes depth-first with the left
+// child next, so children always follow their parent and refit can sweep the nodes in reverse.
+void append_hierarchy(const FlatBvh& bvh, const std::vector<BuildReference>& build_references,
+    std::vector<PackedBvhNode>& nodes, std::vector<PackedPrimitiveRef>& references) {
+    const int node_offset = static_cast<int>(nodes.size());
+    const int reference_offset = static_cast<int>(references.size());
+    references.reserve(references.size() + bvh.primitive_indices.size());
+    for (const int primitive : bvh.primitive_indices) {
+        references.push_back(build_references[static_cast<std::size_t>(primitive)].reference);
+    }
+    nodes.reserve(nodes.size() + bvh.nodes.size());
+    for (std::size_t i = 0; i < bvh.nodes.size(); ++i) {
+        const BvhFlatNode& source = bvh.nodes[i];
+        PackedBvhNode node;
+        if (source.is_leaf()) {
+            node.first_reference = reference_offset + source.first;
+            node.reference_count = source.count;
+        } else {
+            node.left_child = node_offset + static_cast<int>(i) + 1;
+            node.right_child = node_offset + source.first;
+        }
+        nodes.push_back(node);
+    }
+}
+
+// Recomputes the bounds of nodes [begin, end) of one appended hierarchy, children first
+template<typename ReferenceBounds>
+void refit_nodes(std::vector<PackedBvhNode>& nodes, std::size_t begin, std::size_t end,
+    const std::vector<PackedPrimitiveRef>& references, const ReferenceBounds& reference_bounds) {
+    for (std::size_t node_index = end; node_index-- > begin;) {
+        PackedBvhNode& node = nodes[node_index];
+        Bounds bounds;
+        if (node.reference_count > 0) {
+            for (int i = 0; i < node.reference_count; ++i) {
+                const std::size_t reference_index =
+                    static_cast<std::size_t>(node.first_reference + i);
+                extend(bounds, reference_bounds(references.at(reference_index)));
+            }
+        } else {
+            const PackedBvhNode& left = nodes.at(static_cast<std::size_t>(node.left_child));
+            const PackedBvhNode& right = nodes.at(static_cast<std::size_t>(node.right_child));
+            extend(bounds, Bounds {.min = left.bounds_min, .max = left.bounds_max});
+            extend(bounds, Bounds {.min = right.bounds_min, .max = right.bounds_max});
+        }
+        node.bounds_min = bounds.min;
+        node.bounds_max = bounds.max;
+    }
+}
+
+// A mesh instance reference stands for every triangle of its prototype
+int referenced_primitive_count(const GpuPreparedSceneView& scene,
+    const PackedPrimitiveRef& reference) {
+    if (static_cast<PackedPrimitiveType>(reference.primitive_type)
+        != PackedPrimitiveType::mesh_instance) {
+        return 1;
+    }
+    const PackedMeshInstance& instance =
+        element_at(scene.mesh_instances, static_cast<std::size_t>(reference.primitive_index));
+    return element_at(scene.mesh_prototypes, static_cast<std::size_t>(instance.prototype_index))
+        .triangle_count;
+}
+
+AccelerationUpdateStats instance_stats(const GpuPreparedSceneView& scene,
+    const std::vector<PackedPrimitiveRef>& references) {
     std::set<int> prototypes;
     std::set<int> instances;
     std::set<std::pair<int, int>> prototype_instances;
@@ -222,7 +460,7 @@ AccelerationUpdateStats instance_stats(const std::vector<PackedPrimitiveRef>& re
     int instanced_primitive_count = 0;
     for (const PackedPrimitiveRef& reference : references) {
         if (reference.prototype_id >= 0 && repeated_prototypes.contains(reference.prototype_id)) {
-            ++instanced_primitive_count;
+            instanced_primitive_count += referenced_primitive_count(scene, reference);
         }
     }
     return AccelerationUpdateStats {
@@ -244,24 +482,53 @@ std::string_view acceleration_update_kind_name(AccelerationUpdateKind kind) {
     return "unknown";
 }
 
-AccelerationUpdateStats GpuSceneAcceleration::update(const GpuPreparedScene& scene) {
+std::string_view acceleration_build_mode_name(AccelerationBuildMode mode) {
+    switch (mode) {
+        case AccelerationBuildMode::binned_sah: return "binned_sah";
+        case AccelerationBuildMode::lbvh: return "lbvh";
+    }
+    return "unknown";
+}
+
+AccelerationUpdateStats GpuSceneAcceleration::update(const GpuPreparedSceneView& scene) {
     const auto begin = std::chrono::steady_clock::now();
-    const std::uint64_t next_geometry_signature = geometry_signature(scene);
-    const std::uint64_t next_scene_signature = scene_signature(scene);
-    const bool topology_changed = sphere_count_ != static_cast<int>(scene.spheres.size())
-                                  || quad_count_ != static_cast<int>(scene.quads.size())
-                                  || triangle_count_ != static_cast<int>(scene.triangles.size());
+    std::uint64_t hashed_bytes = 0;
+    const bool geometry_changed = track_changes(scene, 0, kMeshPrototypes, hashed_bytes);
+    const bool prototypes_changed =
+        track_changes(scene, kMeshPrototypes, kGeometryArrayEnd, hashed_bytes);
+    const bool shading_changed =
+        track_changes(scene, kGeometryArrayEnd, kTrackedArrayCount, hashed_bytes);
+    const bool scene_changed = geometry_changed || prototypes_changed || shading_changed
+                               || scene.background != background_;
+    // Instance transforms are top-level geometry: moving an instance refits the top level and
+    // keeps every bottom-level hierarchy. Editing a prototype rebuilds both levels.
+    const bool topology_changed =
+        prototypes_changed || sphere_count_ != static_cast<int>(scene.spheres.size())
+        || quad_count_ != static_cast<int>(scene.quads.size())
+        || triangle_count_ != static_cast<int>(scene.triangles.size())
+        || mesh_instance_count_ != static_cast<int>(scene.mesh_instances.size());
 
     AccelerationUpdateKind kind = AccelerationUpdateKind::reuse;
-    if (topology_changed || nodes_.empty()) {
+    double build_ms = 0.0;
+    if (topology_changed || nodes_.empty() || last_update_.build_mode != build_mode_) {
+        const auto build_begin = std::chrono::steady_clock::now();
         rebuild(scene);
+        build_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - build_begin)
+                       .count();
+        sah_cost_ = packed_sah_cost(nodes_);
         kind = AccelerationUpdateKind::rebuild;
         ++generation_;
-    } else if (geometry_signature_ != next_geometry_signature) {
+    } else if (geometry_changed) {
+        const auto build_begin = std::chrono::steady_clock::now();
         refit(scene);
+        build_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - build_begin)
+                       .count();
+        sah_cost_ = packed_sah_cost(nodes_);
         kind = AccelerationUpdateKind::refit;
         ++generation_;
-    } else if (scene_signature_ != next_scene_signature) {
+    } else if (scene_changed) {
         kind = AccelerationUpdateKind::update;
         ++generation_;
     }
@@ -269,16 +536,21 @@ AccelerationUpdateStats GpuSceneAcceleration::update(const GpuPreparedScene& sce
     sphere_count_ = static_cast<int>(scene.spheres.size());
     quad_count_ = static_cast<int>(scene.quads.size());
     triangle_count_ = static_cast<int>(scene.triangles.size());
-    geometry_signature_ = next_geometry_signature;
-    scene_signature_ = next_scene_signature;
+    mesh_instance_count_ = static_cast<int>(scene.mesh_instances.size());
+    background_ = scene.background;
 
     const auto end = std::chrono::steady_clock::now();
-    const AccelerationUpdateStats instances = instance_stats(references_);
+    const AccelerationUpdateStats instances = instance_stats(scene, references_);
     last_update_ = AccelerationUpdateStats {
         .kind = kind,
+        .build_mode = build_mode_,
         .elapsed_ms = std::chrono::duration<double, std::milli>(end - begin).count(),
+        .build_ms = build_ms,
+        .sah_cost = sah_cost_,
+        .hashed_bytes = hashed_bytes,
         .node_count = static_cast<int>(nodes_.size()),
         .primitive_reference_count = static_cast<int>(references_.size()),
+        .bottom_level_node_count = static_cast<int>(bottom_level_nodes_.size()),
         .prototype_count = instances.prototype_count,
         .instance_count = instances.instance_count,
         .instanced_primitive_count = instances.instanced_primitive_count,
@@ -290,13 +562,30 @@ AccelerationUpdateStats GpuSceneAcceleration::update(const GpuPreparedScene& sce
 void GpuSceneAcceleration::reset() {
     nodes_.clear();
     references_.clear();
+    bottom_level_nodes_.clear();
+    bottom_level_references_.clear();
+    prototype_roots_.clear();
     last_update_ = {};
-    geometry_signature_ = 0;
-    scene_signature_ = 0;
+    sah_cost_ = 0.0;
+    tracked_arrays_ = {};
+    background_ = Eigen::Vector3f::Zero();
     generation_ = 0;
     sphere_count_ = -1;
     quad_count_ = -1;
     triangle_count_ = -1;
+    mesh_instance_count_ = -1;
+}
+
+void GpuSceneAcceleration::set_build_mode(AccelerationBuildMode mode) {
+    build_mode_ = mode;
+}
+
+AccelerationBuildMode GpuSceneAcceleration::build_mode() const {
+    return build_mode_;
+}
+
+void GpuSceneAcceleration::set_verify_generations(bool enabled) {
+    verify_generations_ = enabled;
 }
 
 const std::vector<PackedBvhNode>& GpuSceneAcceleration::nodes() const {
@@ -307,13 +596,91 @@ const std::vector<PackedPrimitiveRef>& GpuSceneAcceleration::references() const
     return references_;
 }
 
+const std::vector<PackedBvhNode>& GpuSceneAcceleration::bottom_level_nodes() const {
+    return bottom_level_nodes_;
+}
+
+const std::vector<PackedPrimitiveRef>& GpuSceneAcceleration::bottom_level_references() const {
+    return bottom_level_references_;
+}
+
+const std::vector<int>& GpuSceneAcceleration::prototype_roots() const {
+    return prototype_roots_;
+}
+
 const AccelerationUpdateStats& GpuSceneAcceleration::last_update() const {
     return last_update_;
 }
 
-void GpuSceneAcceleration::rebuild(const GpuPreparedScene& scene) {
+bool GpuSceneAcceleration::track_changes(const GpuPreparedSceneView& scene, int first_array,
+    int end_array, std::uint64_t& hashed_bytes) {
+    bool changed = false;
+    for (int array = first_array; array < end_array; ++array) {
+        TrackedArray& tracked = tracked_arrays_[static_cast<std::size_t>(array)];
+        const std::uint64_t generation = tracked_array_generation(scene_generations(scene), array);
+        const bool stamp_unchanged = generation != 0 && generation == tracked.generation;
+        if (stamp_unchanged && !verify_generations_) {
+            continue;
+        }
+        if (tracked_element_generations(scene_generations(scene), array) != nullptr) {
+            changed = track_element_changes(scene, array, tracked, hashed_bytes) || changed;
+            continue;
+        }
+        // A new stamp does not imply new contents (e.g. two scenes built separately), so the
+        // array is hashed and only a content difference counts as a change.
+        const std::uint64_t hash = tracked_array_hash(scene, array, hashed_bytes);
+        if (stamp_unchanged && hash != tracked.hash) {
+            throw std::logic_error("scene generation stamp missed a change to "
+                                   + std::string(tracked_array_name(array)));
+        }
+        changed = changed || hash != tracked.hash;
+        tracked = TrackedArray {.generation = generation, .hash = hash};
+    }
+    return changed;
+}
+
+// Only elements whose stamp moved since the last update are hashed, so editing one primitive
+// reads one primitive's data however large its array is.
+bool GpuSceneAcceleration::track_element_changes(const GpuPreparedSceneView& scene, int array,
+    TrackedArray& tracked, std::uint64_t& hashed_bytes) {
+    const std::uint64_t generation = tracked_array_generation(scene_generations(scene), array);
+    const std::vector<std::uint64_t>& element_generations =
+        *tracked_element_generations(scene_generations(scene), array);
+    const std::size_t count = tracked_element_count(scene, array);
+    // A zero array stamp, or element stamps out of step with the array, leave every element
+    // untracked; so does a change of the element count
+    const bool stamped = generation != 0 && element_generations.size() == count;
+    const bool comparable = tracked.element_hashes.size() == count;
+    bool changed = !comparable;
+    tracked.element_generations.resize(count, 0);
+    tracked.element_hashes.resize(count, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::uint64_t element_generation = stamped ? element_generations[i] : 0;
+        const bool stamp_unchanged = comparable && element_generation != 0
+                                     && element_generation == tracked.element_generations[i];
+        if (stamp_unchanged && !verify_generations_) {
+            continue;
+        }
+        const std::uint64_t hash = tracked_element_hash(scene, array, i, hashed_bytes);
+        if (stamp_unchanged && hash != tracked.element_hashes[i]) {
+            throw std::logic_error("scene generation stamp missed a change to "
+                                   + std::string(tracked_array_name(array)) + " element "
+                                   + std::to_string(i));
+        }
+        changed = changed || hash != tracked.element_hashes[i];
+        tracked.element_generations[i] = element_generation;
+        tracked.element_hashes[i] = hash;
+    }
+    tracked.generation = generation;
+    return changed;
+}
+
+void GpuSceneAcceleration::rebuild(const GpuPreparedSceneView& scene) {
+    rebuild_bottom_level(scene);
+
     std::vector<BuildReference> build_references;
-    build_references.reserve(scene.spheres.size() + scene.quads.size() + scene.triangles.size());
+    build_references.reserve(scene.spheres.size() + scene.quads.size() + scene.triangles.size()
+                             + scene.mesh_instances.size());
     for (std::size_t i = 0; i < scene.spheres.size(); ++i) {
         const PackedSphere& sphere = scene.spheres[i];
         append_reference(build_references, PackedPrimitiveType::sphere, static_cast<int>(i),
@@ -326,44 +693,75 @@ void GpuSceneAcceleration::rebuild(const GpuPreparedScene& scene) {
             quad.acceleration_prototype_id, quad.acceleration_instance_id, quad_bounds(quad));
     }
     for (std::size_t i = 0; i < scene.triangles.size(); ++i) {
-        const PackedTriangle& triangle = scene.triangles[i];
+        const PackedTriangleAccelerationIds& ids = element_at(scene.triangle_acceleration_ids, i);
         append_reference(build_references, PackedPrimitiveType::triangle, static_cast<int>(i),
-            triangle.acceleration_prototype_id, triangle.acceleration_instance_id,
-            triangle_bounds(triangle));
+            ids.prototype_id, ids.instance_id,
+            triangle_bounds(scene.triangles[i], scene.vertex_positions));
+    }
+    for (std::size_t i = 0; i < scene.mesh_instances.size(); ++i) {
+        const PackedMeshInstance& instance = scene.mesh_instances[i];
+        const Bounds bounds = mesh_instance_bounds(instance, bottom_level_nodes_, prototype_roots_);
+        if (bounds.min.x() > bounds.max.x()) {
+            continue;
+        }
+        append_reference(build_references, PackedPrimitiveType::mesh_instance,
+            static_cast<int>(i), instance.acceleration_prototype_id,
+            instance.acceleration_instance_id, bounds);
     }
     if (build_references.empty()) {
         throw std::invalid_argument("GPU acceleration structure requires at least one surface");
     }
 
     nodes_.clear();
-    nodes_.reserve(build_references.size() * 2U);
-    build_node(nodes_, build_references, 0, static_cast<int>(build_references.size()));
     references_.clear();
-    references_.reserve(build_references.size());
-    for (const BuildReference& reference : build_references) {
-        references_.push_back(reference.reference);
-    }
+    append_hierarchy(build_hierarchy(build_references, build_mode_), build_references, nodes_,
+        references_);
+    refit(scene);
 }
 
-void GpuSceneAcceleration::refit(const GpuPreparedScene& scene) {
-    for (std::size_t node_index = nodes_.size(); node_index-- > 0;) {
-        PackedBvhNode& node = nodes_[node_index];
-        Bounds bounds;
-        if (node.reference_count > 0) {
-            for (int i = 0; i < node.reference_count; ++i) {
-                const std::size_t reference_index =
-                    static_cast<std::size_t>(node.first_reference + i);
-                extend(bounds, reference_bounds(scene, references_.at(reference_index)));
-            }
-        } else {
-            const PackedBvhNode& left = nodes_.at(static_cast<std::size_t>(node.left_child));
-            const PackedBvhNode& right = nodes_.at(static_cast<std::size_t>(node.right_child));
-            extend(bounds, Bounds {.min = left.bounds_min, .max = left.bounds_max});
-            extend(bounds, Bounds {.min = right.bounds_min, .max = right.bounds_max});
+void GpuSceneAcceleration::rebuild_bottom_level(const GpuPreparedSceneView& scene) {
+    bottom_level_nodes_.clear();
+    bottom_level_references_.clear();
+    prototype_roots_.assign(scene.mesh_prototypes.size(), -1);
+    const auto prototype_triangle_bounds = [&](const PackedPrimitiveRef& reference) {
+        return triangle_bounds(
+            element_at(scene.prototype_triangles,
+                static_cast<std::size_t>(reference.primitive_index)),
+            scene.prototype_vertex_positions);
+    };
+    std::vector<BuildReference> build_references;
+    for (std::size_t prototype = 0; prototype < scene.mesh_prototypes.size(); ++prototype) {
+        const PackedMeshPrototype& range = scene.mesh_prototypes[prototype];
+        if (range.triangle_count <= 0) {
+            continue;
         }
-        node.bounds_min = bounds.min;
-        node.bounds_max = bounds.max;
+        build_references.clear();
+        for (int i = range.first_triangle; i < range.first_triangle + range.triangle_count; ++i) {
+            append_reference(build_references, PackedPrimitiveType::triangle, i,
+                static_cast<int>(prototype), -1,
+                triangle_bounds(element_at(scene.prototype_triangles, static_cast<std::size_t>(i)),
+                    scene.prototype_vertex_positions));
+        }
+        const std::size_t root = bottom_level_nodes_.size();
+        append_hierarchy(build_hierarchy(build_references, build_mode_), build_references,
+            bottom_level_nodes_, bottom_level_references_);
+        refit_nodes(bottom_level_nodes_, root, bottom_level_nodes_.size(),
+            bottom_level_references_, prototype_triangle_bounds);
+        prototype_roots_[prototype] = static_cast<int>(root);
     }
 }
 
+void GpuSceneAcceleration::refit(const GpuPreparedSceneView& scene) {
+    refit_nodes(nodes_, 0, nodes_.size(), references_, [&](const PackedPrimitiveRef& reference) {
+        if (static_cast<PackedPrimitiveType>(reference.primitive_type)
+            == PackedPrimitiveType::mesh_instance) {
+            return mesh_instance_bounds(
+                element_at(scene.mesh_instances,
+                    static_cast<std::size_t>(reference.primitive_index)),
+                bottom_level_nodes_, prototype_roots_);
+        }
+        return reference_bounds(scene, reference);
+    });
+}
+
 } // namespace rt
@@ -3,6 +3,7 @@
 #include "realtime/gpu/launch_params.h"
 #include "realtime/gpu/packed_scene_preparation.h"
 
+#include <array>
 #include <cstdint>
 #include <string_view>
 #include <vector>
@@ -18,39 +19,91 @@ enum class AccelerationUpdateKind {
 
 std::string_view acceleration_update_kind_name(AccelerationUpdateKind kind);
 
+// Rebuild strategies: binned SAH gives the better hierarchy, LBVH (Morton-sorted) the faster build
+// for scenes whose topology changes every frame.
+enum class AccelerationBuildMode {
+    binned_sah,
+    lbvh,
+};
+
+std::string_view acceleration_build_mode_name(AccelerationBuildMode mode);
+
 struct AccelerationUpdateStats {
     AccelerationUpdateKind kind = AccelerationUpdateKind::rebuild;
+    AccelerationBuildMode build_mode = AccelerationBuildMode::binned_sah;
     double elapsed_ms = 0.0;
+    double build_ms = 0.0; // Hierarchy rebuild or refit alone; zero when the nodes were kept
+    double sah_cost = 0.0; // Expected traversal cost of the current nodes, relative to the root
+    std::uint64_t hashed_bytes = 0; // Scene data read to classify the update
     int node_count = 0;
     int primitive_reference_count = 0;
+    int bottom_level_node_count = 0; // Summed over the per-prototype hierarchies
     int prototype_count = 0;
     int instance_count = 0;
     int instanced_primitive_count = 0;
     std::uint64_t generation = 0;
 };
 
+// Two levels: one bottom-level hierarchy per mesh prototype in object space, built when the
+// prototypes change, and a top-level hierarchy over the world-space primitives and the mesh
+// instances. Moving an instance only refits the top level.
 class GpuSceneAcceleration {
 public:
-    AccelerationUpdateStats update(const GpuPreparedScene& scene);
+    // Reads the scene only during the call; nothing is kept that points into it
+    AccelerationUpdateStats update(const GpuPreparedSceneView& scene);
     void reset();
+    // Takes effect at the next update, which rebuilds if the mode changed.
+    void set_build_mode(AccelerationBuildMode mode);
+    AccelerationBuildMode build_mode() const;
+    // Debug cross-check: hash every array on each update and throw std::logic_error when an
+    // unchanged generation stamp hides a content change.
+    void set_verify_generations(bool enabled);
 
     const std::vector<PackedBvhNode>& nodes() const;
     const std::vector<PackedPrimitiveRef>& references() const;
+    // Nodes of every prototype's hierarchy in one array, with child and reference indices absolute
+    const std::vector<PackedBvhNode>& bottom_level_nodes() const;
+    const std::vector<PackedPrimitiveRef>& bottom_level_references() const;
+    // Root node of each prototype in bottom_level_nodes(), or -1 for an empty prototype
+    const std::vector<int>& prototype_roots() const;
     const AccelerationUpdateStats& last_update() const;
 
 private:
-    void rebuild(const GpuPreparedScene& scene);
-    void refit(const GpuPreparedScene& scene);
+    // Generation stamp and content hash of one scene array as of the last update. Arrays with
+    // per-element stamps keep a stamp and a hash per element instead of the array hash.
+    struct TrackedArray {
+        std::uint64_t generation = 0;
+        std::uint64_t hash = 0;
+        std::vector<std::uint64_t> element_generations;
+        std::vector<std::uint64_t> element_hashes;
+    };
+
+    void rebuild(const GpuPreparedSceneView& scene);
+    void rebuild_bottom_level(const GpuPreparedSceneView& scene);
+    void refit(const GpuPreparedSceneView& scene);
+    bool track_changes(const GpuPreparedSceneView& scene, int first_array, int end_array,
+        std::uint64_t& hashed_bytes);
+    bool track_element_changes(const GpuPreparedSceneView& scene, int array, TrackedArray& tracked,
+        std::uint64_t& hashed_bytes);
 
     std::vector<PackedBvhNode> nodes_;
     std::vector<PackedPrimitiveRef> references_;
+    std::vector<PackedBvhNode> bottom_level_nodes_;
+    std::vector<PackedPrimitiveRef> bottom_level_references_;
+    std::vector<int> prototype_roots_;
     AccelerationUpdateStats last_update_ {};
-    std::uint64_t geometry_signature_ = 0;
-    std::uint64_t scene_signature_ = 0;
+    AccelerationBuildMode build_mode_ = AccelerationBuildMode::binned_sah;
+    double sah_cost_ = 0.0;
+    static constexpr int kTrackedArrayCount = 9;
+
+    std::array<TrackedArray, kTrackedArrayCount> tracked_arrays_ {};
+    Eigen::Vector3f background_ = Eigen::Vector3f::Zero();
+    bool verify_generations_ = false;
     std::uint64_t generation_ = 0;
     int sphere_count_ = -1;
     int quad_count_ = -1;
     int triangle_count_ = -1;
+    int mesh_instance_count_ = -1;
 };
 
 } // namespace rt
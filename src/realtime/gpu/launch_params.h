@@ -1,8 +1,11 @@
 #pragma once
 
 #include "common/light_sampling.h"
+#include "common/light_tree.h"
 #include "common/openpbr_core.h"
 #include "common/restir_di.h"
+#include "common/russian_roulette.h"
+#include "common/vertex_quantization.h"
 #include "realtime/camera_rig.h"
 #include "realtime/gpu/frame_types.h"
 
@@ -16,6 +19,8 @@ namespace rt {
 struct PackedSphere;
 struct PackedQuad;
 struct PackedTriangle;
+struct PackedVertexAttributes;
+struct PackedMeshInstance;
 struct PackedMedium;
 struct PackedTexture;
 struct MaterialSample;
@@ -37,6 +42,8 @@ struct DeviceSceneView {
     PackedSphere* spheres = nullptr;
     PackedQuad* quads = nullptr;
     PackedTriangle* triangles = nullptr;
+    Eigen::Vector3f* vertex_positions = nullptr;
+    PackedVertexAttributes* vertex_attributes = nullptr;
     PackedMedium* media = nullptr;
     PackedTexture* textures = nullptr;
     Eigen::Vector3f* image_texels = nullptr;
@@ -44,11 +51,23 @@ struct DeviceSceneView {
     OpenPbrCompiledMaterial* openpbr_materials = nullptr;
     PackedLight* lights = nullptr;
     PackedAnalyticLight* analytic_lights = nullptr;
+    LightTreeNode* analytic_light_tree = nullptr;
+    LightTreeInfiniteEntry* analytic_infinite_lights = nullptr;
     PackedBvhNode* acceleration_nodes = nullptr;
     PackedPrimitiveRef* acceleration_references = nullptr;
+    // Two-level instancing: object-space prototype triangles under one bottom-level hierarchy per
+    // prototype, entered from mesh_instance references of the top-level hierarchy above.
+    PackedTriangle* prototype_triangles = nullptr;
+    Eigen::Vector3f* prototype_vertex_positions = nullptr;
+    PackedVertexAttributes* prototype_vertex_attributes = nullptr;
+    PackedMeshInstance* mesh_instances = nullptr;
+    PackedBvhNode* bottom_level_nodes = nullptr;
+    PackedPrimitiveRef* bottom_level_references = nullptr;
+    int* prototype_roots = nullptr;
     int sphere_count = 0;
     int quad_count = 0;
     int triangle_count = 0;
+    int vertex_count = 0;
     int medium_count = 0;
     int texture_count = 0;
     int image_texel_count = 0;
@@ -56,8 +75,16 @@ struct DeviceSceneView {
     int openpbr_material_count = 0;
     int light_count = 0;
     int analytic_light_count = 0;
+    int analytic_light_tree_node_count = 0;
+    int analytic_infinite_light_count = 0;
     int acceleration_node_count = 0;
     int acceleration_reference_count = 0;
+    int prototype_triangle_count = 0;
+    int prototype_vertex_count = 0;
+    int mesh_instance_count = 0;
+    int bottom_level_node_count = 0;
+    int bottom_level_reference_count = 0;
+    int prototype_count = 0;
 };
 
 struct DevicePinhole32Params {
@@ -107,7 +134,7 @@ struct LaunchParams {
     std::uint32_t sample_stream = 0;
     int samples_per_pixel = 1;
     int max_bounces = 4;
-    int rr_start_bounce = 3;
+    int rr_start_bounce = kDefaultRussianRouletteStartBounce;
     int mode = 0;
 
     // --- ReSTIR DI ---
@@ -151,33 +178,52 @@ struct PackedQuad {
     int acceleration_instance_id = -1;
 };
 
+enum PackedTriangleFlags : std::uint32_t {
+    kTriangleHasVertexNormals = 1u << 0,
+    kTriangleHasTexcoords = 1u << 1,
+};
+
+// Indexed triangle: the corners index a shared vertex position stream, and the shading
+// attributes of the same vertices sit in a parallel stream read only once a hit is confirmed
 struct PackedTriangle {
-    Eigen::Vector3f p0;
-    float pad0 = 0.0f;
-    Eigen::Vector3f p1;
-    float pad1 = 0.0f;
-    Eigen::Vector3f p2;
+    std::uint32_t vertex0 = 0;
+    std::uint32_t vertex1 = 0;
+    std::uint32_t vertex2 = 0;
     int material_index = -1;
-    Eigen::Vector3f n0;
-    int has_vertex_normals = 0;
-    Eigen::Vector3f n1;
-    int has_texcoords = 0;
-    Eigen::Vector3f n2;
-    float pad2 = 0.0f;
-    Eigen::Vector2f uv0;
-    Eigen::Vector2f uv1;
-    Eigen::Vector2f uv2;
-    Eigen::Vector2f pad3 = Eigen::Vector2f::Zero();
+    std::uint32_t flags = 0;
+};
+
+// Octahedral unit normal as two snorm16 values and texture coordinates as two halves, see
+// common/vertex_quantization.h
+struct PackedVertexAttributes {
+    std::uint32_t normal = 0;
+    std::uint32_t texcoord = 0;
+};
+
+// Rows of the object-to-world linear map and of its inverse. Points go to object space as
+// inverse * (p - translation); normals go to world space through the inverse rows, transposed.
+struct PackedMeshInstance {
+    Eigen::Vector3f linear_row0;
+    int prototype_index = -1;
+    Eigen::Vector3f linear_row1;
+    int material_index = -1;
+    Eigen::Vector3f linear_row2;
     int acceleration_prototype_id = -1;
+    Eigen::Vector3f translation;
     int acceleration_instance_id = -1;
-    int acceleration_pad0 = 0;
-    int acceleration_pad1 = 0;
+    Eigen::Vector3f inverse_row0;
+    float pad0 = 0.0f;
+    Eigen::Vector3f inverse_row1;
+    float pad1 = 0.0f;
+    Eigen::Vector3f inverse_row2;
+    float pad2 = 0.0f;
 };
 
 enum class PackedPrimitiveType : int {
     sphere = 0,
     quad = 1,
     triangle = 2,
+    mesh_instance = 3,
 };
 
 struct PackedPrimitiveRef {
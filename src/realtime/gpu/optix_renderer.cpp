@@ -71,25 +71,55 @@ int checked_primitive_count(std::size_t count, const char* label) {
     return static_cast<int>(count);
 }
 
-} // namespace
-
-AccelerationUpdateStats SharedGpuSceneState::prepare(const PackedScene& scene) {
-    const auto begin = std::chrono::steady_clock::now();
-    const int surface_count = checked_primitive_count(scene.spheres.size(), "sphere")
-                              + checked_primitive_count(scene.quads.size(), "quad")
-                              + checked_primitive_count(scene.triangles.size(), "triangle");
+void require_surface_primitives(std::size_t spheres, std::size_t quads, std::size_t triangles,
+    std::size_t mesh_instances) {
+    const int surface_count = checked_primitive_count(spheres, "sphere")
+                              + checked_primitive_count(quads, "quad")
+                              + checked_primitive_count(triangles, "triangle")
+                              + checked_primitive_count(mesh_instances, "mesh instance");
     if (surface_count == 0) {
         throw std::runtime_error("render_radiance requires at least one surface primitive");
     }
-    const GpuPreparedScene prepared = prepare_gpu_scene(scene);
-    last_acceleration_update_ = acceleration_.update(prepared);
-    buffers_.upload(prepared, acceleration_, last_acceleration_update_.kind);
+}
+
+} // namespace
+
+AccelerationUpdateStats SharedGpuSceneState::prepare(const PackedScene& scene,
+    const PreparedSceneSource* source) {
+    const auto begin = std::chrono::steady_clock::now();
+    require_surface_primitives(scene.spheres.size(), scene.quads.size(), scene.triangles.size(),
+        scene.mesh_instances.size());
+    const GpuPreparedScene prepared = source != nullptr
+                                          ? prepare_and_cache_gpu_scene(scene, *source)
+                                          : prepare_gpu_scene(scene);
+    upload_prepared(prepared);
     const auto end = std::chrono::steady_clock::now();
     last_acceleration_update_.elapsed_ms =
         std::chrono::duration<double, std::milli>(end - begin).count();
     return last_acceleration_update_;
 }
 
+AccelerationUpdateStats SharedGpuSceneState::prepare(const GpuPreparedSceneView& prepared) {
+    const auto begin = std::chrono::steady_clock::now();
+    require_surface_primitives(prepared.spheres.size(), prepared.quads.size(),
+        prepared.triangles.size(), prepared.mesh_instances.size());
+    upload_prepared(prepared);
+    const auto end = std::chrono::steady_clock::now();
+    last_acceleration_update_.elapsed_ms =
+        std::chrono::duration<double, std::milli>(end - begin).count();
+    return last_acceleration_update_;
+}
+
+void SharedGpuSceneState::upload_prepared(const GpuPreparedSceneView& prepared) {
+    last_acceleration_update_ = acceleration_.update(prepared);
+    buffers_.upload(prepared, acceleration_, last_acceleration_update_.kind);
+    background_ = prepared.background;
+}
+
+void SharedGpuSceneState::set_acceleration_build_mode(AccelerationBuildMode mode) {
+    acceleration_.set_build_mode(mode);
+}
+
 DeviceSceneView SharedGpuSceneState::view() const {
     return buffers_.view();
 }
@@ -98,6 +128,10 @@ const AccelerationUpdateStats& SharedGpuSceneState::last_acceleration_update() c
     return last_acceleration_update_;
 }
 
+const Eigen::Vector3f& SharedGpuSceneState::background() const {
+    return background_;
+}
+
 OptixRenderer::OptixRenderer(std::shared_ptr<SharedGpuSceneState> shared_scene)
     : shared_scene_(
           shared_scene ? std::move(shared_scene) : std::make_shared<SharedGpuSceneState>()) {
@@ -154,7 +188,6 @@ DirectionDebugFrame OptixRenderer::render_direction_debug(const PackedCameraRig&
 void OptixRenderer::upload_scene(const PackedScene& scene) {
     scene_prepared_ = false;
     shared_scene_->prepare(scene);
-    uploaded_scene_ = scene;
 }
 
 void OptixRenderer::free_device_resources() {
@@ -166,7 +199,6 @@ void OptixRenderer::free_device_resources() {
         cudaFree(device_launch_params_);
         device_launch_params_ = nullptr;
     }
-    uploaded_scene_ = PackedScene {};
     scene_prepared_ = false;
 }
 
@@ -224,17 +256,17 @@ const AccelerationUpdateStats& OptixRenderer::acceleration_diagnostics() const {
 
 void OptixRenderer::launch_radiance(const PackedCameraRig& rig, const RenderProfile& profile,
     int camera_index, RadianceTiming* timing) {
-    launch_radiance_pipeline(uploaded_scene_, rig, profile, camera_index, timing);
+    launch_radiance_pipeline(rig, profile, camera_index, timing);
 }
 
-void OptixRenderer::launch_radiance_pipeline(const PackedScene& scene, const PackedCameraRig& rig,
+void OptixRenderer::launch_radiance_pipeline(const PackedCameraRig& rig,
     const RenderProfile& profile, int camera_index, RadianceTiming* timing) {
     const PackedCamera& camera = rig.cameras[static_cast<std::size_t>(camera_index)];
     frame_buffers_.resize_frame(camera.width, camera.height);
     frame_buffers_.resize_history(camera.width, camera.height);
-    LaunchParams params =
-        make_radiance_launch_params(scene, shared_scene_->view(), rig, profile, camera_index,
-            launch_sample_stream_++, frame_buffers_.frame(), frame_buffers_.history_state());
+    LaunchParams params = make_radiance_launch_params(shared_scene_->background(),
+        shared_scene_->view(), rig, profile, camera_index, launch_sample_stream_++,
+        frame_buffers_.frame(), frame_buffers_.history_state());
     const std::size_t pixel_count =
         static_cast<std::size_t>(params.width) * static_cast<std::size_t>(params.height);
 
@@ -269,7 +301,6 @@ void OptixRenderer::launch_radiance_pipeline(const PackedScene& scene, const Pac
         launch();
         timing->render_ms = timer.record_stop_and_elapsed_ms();
     }
-    uploaded_scene_ = scene;
     last_width_ = params.width;
     last_height_ = params.height;
     last_camera_index_ = camera_index;
@@ -406,11 +437,10 @@ std::vector<float> OptixRenderer::download_depth() const {
 
 void OptixRenderer::prepare_scene(const PackedScene& scene) {
     upload_scene(scene);
-    use_prepared_scene(scene);
+    use_prepared_scene();
 }
 
-void OptixRenderer::use_prepared_scene(const PackedScene& scene) {
-    uploaded_scene_ = scene;
+void OptixRenderer::use_prepared_scene() {
     scene_prepared_ = true;
     launch_sample_stream_ = 0;
     reset_accumulation();
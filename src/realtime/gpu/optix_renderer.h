@@ -9,6 +9,7 @@
 #include "realtime/gpu/gpu_scene_acceleration.h"
 #include "realtime/gpu/host_radiance_staging.h"
 #include "realtime/gpu/launch_params.h"
+#include "realtime/gpu/prepared_scene_cache.h"
 #include "realtime/gpu/radiance_launch_setup.h"
 #include "realtime/render_profile.h"
 #include "realtime/scene_description.h"
@@ -56,14 +57,23 @@ struct LaunchParameterDiagnostics {
 
 class SharedGpuSceneState {
 public:
-    AccelerationUpdateStats prepare(const PackedScene& scene);
+    // With a source, the prepared arrays come from and refresh that scene's on-disk cache
+    AccelerationUpdateStats prepare(const PackedScene& scene,
+        const PreparedSceneSource* source = nullptr);
+    // Uploads prepared arrays directly, such as a mapped cache file; the view is not retained
+    AccelerationUpdateStats prepare(const GpuPreparedSceneView& prepared);
+    void set_acceleration_build_mode(AccelerationBuildMode mode);
     DeviceSceneView view() const;
     const AccelerationUpdateStats& last_acceleration_update() const;
+    const Eigen::Vector3f& background() const;
 
 private:
+    void upload_prepared(const GpuPreparedSceneView& prepared);
+
     DeviceSceneBuffers buffers_;
     GpuSceneAcceleration acceleration_;
     AccelerationUpdateStats last_acceleration_update_ {};
+    Eigen::Vector3f background_ = Eigen::Vector3f::Zero();
 };
 
 class OptixRenderer {
@@ -73,7 +83,7 @@ public:
 
     DirectionDebugFrame render_direction_debug(const PackedCameraRig& rig, int camera_index = 0);
     void prepare_scene(const PackedScene& scene);
-    void use_prepared_scene(const PackedScene& scene);
+    void use_prepared_scene();
     void reset_accumulation();
     void reset_sequence(std::uint32_t sample_stream);
     RestirDiagnostics restir_diagnostics() const;
@@ -99,8 +109,8 @@ private:
     RadianceFrame download_radiance_frame(int camera_index) const;
     RadianceFrame download_radiance_frame_profiled(int camera_index, const float4* beauty_source,
         RadianceTiming* timing);
-    void launch_radiance_pipeline(const PackedScene& scene, const PackedCameraRig& rig,
-        const RenderProfile& profile, int camera_index, RadianceTiming* timing = nullptr);
+    void launch_radiance_pipeline(const PackedCameraRig& rig, const RenderProfile& profile,
+        int camera_index, RadianceTiming* timing = nullptr);
     RadianceFrame download_camera_frame(int camera_index) const;
     int last_launch_width(int camera_index) const;
     int last_launch_height(int camera_index) const;
@@ -116,7 +126,6 @@ private:
     OptixDenoiserWrapper denoiser_;
     std::shared_ptr<SharedGpuSceneState> shared_scene_;
     LaunchParams* device_launch_params_ = nullptr;
-    PackedScene uploaded_scene_ {};
     int last_width_ = 0;
     int last_height_ = 0;
     int last_camera_index_ = 0;
@@ -1,10 +1,19 @@
 #include "realtime/gpu/packed_scene_preparation.h"
 
-#include <opencv2/opencv.hpp>
+#include "common/alias_table.h"
+#include "common/analytic_light_tree.h"
+#include "common/texture_cache.h"
+
+#include <Eigen/LU>
 
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
 
 namespace rt {
 namespace {
@@ -33,6 +42,8 @@ PackedAnalyticLight pack_analytic_light(const AnalyticLightDesc& light) {
         .delta = light.delta ? 1 : 0,
         .treat_as_point = light.treat_as_point ? 1 : 0,
         .treat_as_line = light.treat_as_line ? 1 : 0,
+        .alias_probability = static_cast<float>(light.alias_probability),
+        .alias = light.alias,
     };
 }
 
@@ -57,22 +68,151 @@ PackedQuad pack_quad(const QuadPrimitive& quad) {
     };
 }
 
-PackedTriangle pack_triangle(const TrianglePrimitive& triangle) {
-    return PackedTriangle {
-        .p0 = triangle.p0.cast<float>(),
-        .p1 = triangle.p1.cast<float>(),
-        .p2 = triangle.p2.cast<float>(),
-        .material_index = triangle.material_index,
-        .n0 = triangle.n0.cast<float>(),
-        .has_vertex_normals = triangle.has_vertex_normals ? 1 : 0,
-        .n1 = triangle.n1.cast<float>(),
-        .has_texcoords = triangle.has_texcoords ? 1 : 0,
-        .n2 = triangle.n2.cast<float>(),
-        .uv0 = triangle.uv0.cast<float>(),
-        .uv1 = triangle.uv1.cast<float>(),
-        .uv2 = triangle.uv2.cast<float>(),
-        .acceleration_prototype_id = triangle.acceleration_prototype_id,
-        .acceleration_instance_id = triangle.acceleration_instance_id,
+bool usable_vertex_normal(const Eigen::Vector3d& normal) {
+    return normal.allFinite() && normal.squaredNorm() > 0.0;
+}
+
+// Packs triangle soups into indexed triangles over welded vertex streams. Corners weld when their
+// float positions and quantized attributes agree bit for bit, so a mesh stores each shared vertex
+// once however many triangles meet there; face-varying normals or texcoords keep their seams.
+// Meshes that arrive indexed skip the weld, see append_indexed_mesh.
+class IndexedTriangleWriter {
+public:
+    IndexedTriangleWriter(std::vector<PackedTriangle>& triangles,
+        std::vector<Eigen::Vector3f>& positions, std::vector<PackedVertexAttributes>& attributes)
+        : triangles_(triangles),
+          positions_(positions),
+          attributes_(attributes) {}
+
+    void append(const TrianglePrimitive& triangle) {
+        std::uint32_t flags = 0;
+        if (triangle.has_vertex_normals && usable_vertex_normal(triangle.n0)
+            && usable_vertex_normal(triangle.n1) && usable_vertex_normal(triangle.n2)) {
+            flags |= kTriangleHasVertexNormals;
+        }
+        if (triangle.has_texcoords) {
+            flags |= kTriangleHasTexcoords;
+        }
+        triangles_.push_back(PackedTriangle {
+            .vertex0 = vertex(triangle.p0, triangle.n0, triangle.uv0, flags),
+            .vertex1 = vertex(triangle.p1, triangle.n1, triangle.uv1, flags),
+            .vertex2 = vertex(triangle.p2, triangle.n2, triangle.uv2, flags),
+            .material_index = triangle.material_index,
+            .flags = flags,
+        });
+    }
+
+private:
+    struct VertexKey {
+        std::uint32_t position[3] {};
+        PackedVertexAttributes attributes;
+
+        bool operator==(const VertexKey& other) const {
+            return position[0] == other.position[0] && position[1] == other.position[1]
+                   && position[2] == other.position[2]
+                   && attributes.normal == other.attributes.normal
+                   && attributes.texcoord == other.attributes.texcoord;
+        }
+    };
+
+    struct VertexKeyHash {
+        std::size_t operator()(const VertexKey& key) const {
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for (const std::uint32_t word : {key.position[0], key.position[1], key.position[2],
+                     key.attributes.normal, key.attributes.texcoord}) {
+                hash = (hash ^ word) * 0x100000001b3ull;
+                hash ^= hash >> 29;
+            }
+            return static_cast<std::size_t>(hash);
+        }
+    };
+
+    std::uint32_t vertex(const Eigen::Vector3d& position, const Eigen::Vector3d& normal,
+        const Eigen::Vector2d& texcoord, std::uint32_t flags) {
+        // Adding zero turns -0 into +0, so signed zeros weld
+        const Eigen::Vector3f packed_position =
+            position.cast<float>() + Eigen::Vector3f::Zero();
+        VertexKey key;
+        for (int axis = 0; axis < 3; ++axis) {
+            key.position[axis] = quantization_float_bits(packed_position[axis]);
+        }
+        if ((flags & kTriangleHasVertexNormals) != 0) {
+            const Eigen::Vector3f unit = normal.normalized().cast<float>();
+            key.attributes.normal = encode_octahedral_normal(unit.x(), unit.y(), unit.z());
+        }
+        if ((flags & kTriangleHasTexcoords) != 0) {
+            key.attributes.texcoord = encode_half2(
+                static_cast<float>(texcoord.x()), static_cast<float>(texcoord.y()));
+        }
+
+        const auto [entry, inserted] =
+            indices_.try_emplace(key, static_cast<std::uint32_t>(positions_.size()));
+        if (inserted) {
+            positions_.push_back(packed_position);
+            attributes_.push_back(key.attributes);
+        }
+        return entry->second;
+    }
+
+    std::vector<PackedTriangle>& triangles_;
+    std::vector<Eigen::Vector3f>& positions_;
+    std::vector<PackedVertexAttributes>& attributes_;
+    std::unordered_map<VertexKey, std::uint32_t, VertexKeyHash> indices_;
+};
+
+// Appends an indexed mesh's streams as they are, its vertex indices offset past the vertices
+// already packed
+void append_indexed_mesh(const IndexedTriangleMesh& mesh, std::vector<PackedTriangle>& triangles,
+    std::vector<Eigen::Vector3f>& positions, std::vector<PackedVertexAttributes>& attributes) {
+    if (mesh.positions.size() > std::numeric_limits<std::uint32_t>::max() - positions.size()) {
+        throw std::length_error("packed triangle vertex streams exceed 32-bit indices");
+    }
+    const auto first_vertex = static_cast<std::uint32_t>(positions.size());
+    std::uint32_t flags = 0;
+    if (!mesh.normals.empty()) {
+        flags |= kTriangleHasVertexNormals;
+    }
+    if (!mesh.texcoords.empty()) {
+        flags |= kTriangleHasTexcoords;
+    }
+
+    positions.insert(positions.end(), mesh.positions.begin(), mesh.positions.end());
+    attributes.reserve(attributes.size() + mesh.positions.size());
+    for (std::size_t vertex = 0; vertex < mesh.positions.size(); ++vertex) {
+        attributes.push_back(PackedVertexAttributes {
+            .normal = mesh.normals.empty() ? 0u : mesh.normals[vertex],
+            .texcoord = mesh.texcoords.empty() ? 0u : mesh.texcoords[vertex],
+        });
+    }
+    triangles.reserve(triangles.size() + mesh.triangles.size());
+    for (std::size_t index = 0; index < mesh.triangles.size(); ++index) {
+        const std::array<std::uint32_t, 3>& triangle = mesh.triangles[index];
+        triangles.push_back(PackedTriangle {
+            .vertex0 = first_vertex + triangle[0],
+            .vertex1 = first_vertex + triangle[1],
+            .vertex2 = first_vertex + triangle[2],
+            .material_index = mesh.material_indices[index],
+            .flags = flags,
+        });
+    }
+}
+
+PackedMeshInstance pack_mesh_instance(const MeshInstance& instance) {
+    // Inverted in double precision; SceneDescription has already rejected singular transforms
+    const Eigen::Matrix3f linear = instance.linear.cast<float>();
+    const Eigen::Matrix3f inverse = instance.linear.inverse().cast<float>();
+    return PackedMeshInstance {
+        .linear_row0 = linear.row(0).transpose(),
+        .prototype_index = instance.prototype_index,
+        .linear_row1 = linear.row(1).transpose(),
+        .material_index = instance.material_index,
+        .linear_row2 = linear.row(2).transpose(),
+        .acceleration_prototype_id = instance.acceleration_prototype_id,
+        .translation = instance.translation.cast<float>(),
+        .acceleration_instance_id = instance.acceleration_instance_id,
+        .inverse_row0 = inverse.row(0).transpose(),
+        .inverse_row1 = inverse.row(1).transpose(),
+        .inverse_row2 = inverse.row(2).transpose(),
     };
 }
 
@@ -123,30 +263,22 @@ MaterialSample pack_material(const MaterialDesc& material,
     return sample;
 }
 
-cv::Mat load_texture_image_rgb32f(const std::string& path) {
-    cv::Mat bgr = cv::imread(path, cv::IMREAD_COLOR);
-    if (bgr.empty()) {
-        const std::array<std::string, 2> fallbacks {std::string("../") + path,
-            std::string("../../") + path};
-        for (const std::string& fallback : fallbacks) {
-            bgr = cv::imread(fallback, cv::IMREAD_COLOR);
-            if (!bgr.empty()) {
-                break;
-            }
+void append_image_texels(const DecodedTexture& image, std::vector<Eigen::Vector3f>& image_texels) {
+    // The device buffer stays float RGB; this is the upload staging copy of the cached 8-bit image
+    const std::size_t offset = image_texels.size();
+    image_texels.resize(offset + static_cast<std::size_t>(image.width() * image.height()));
+    Eigen::Vector3f* out = image_texels.data() + offset;
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x, ++out) {
+            const std::uint8_t* texel = image.texel(x, y);
+            *out = Eigen::Vector3f {DecodedTexture::unit_value(texel[0]),
+                DecodedTexture::unit_value(texel[1]), DecodedTexture::unit_value(texel[2])};
         }
     }
-    if (bgr.empty()) {
-        return {};
-    }
-
-    cv::Mat rgb_u8;
-    cv::cvtColor(bgr, rgb_u8, cv::COLOR_BGR2RGB);
-    cv::Mat rgb_f32;
-    rgb_u8.convertTo(rgb_f32, CV_32FC3, 1.0 / 255.0);
-    return rgb_f32;
 }
 
-PackedTexture pack_texture(const TextureDesc& texture, std::vector<Eigen::Vector3f>& image_texels) {
+PackedTexture pack_texture(const TextureDesc& texture, const DecodedTextureHandle& image,
+    std::vector<Eigen::Vector3f>& image_texels) {
     PackedTexture packed {};
     std::visit(
         [&](const auto& value) {
@@ -165,20 +297,12 @@ PackedTexture pack_texture(const TextureDesc& texture, std::vector<Eigen::Vector
                 packed.v_address_mode = static_cast<int>(value.v_address_mode);
                 packed.filter_type = static_cast<int>(value.filter_type);
                 packed.image_offset = static_cast<int>(image_texels.size());
-                const cv::Mat image = load_texture_image_rgb32f(value.path);
-                if (image.empty()) {
+                if (image == nullptr) {
                     return;
                 }
-                packed.image_width = image.cols;
-                packed.image_height = image.rows;
-                image_texels.reserve(
-                    image_texels.size() + static_cast<std::size_t>(image.cols * image.rows));
-                for (int y = 0; y < image.rows; ++y) {
-                    for (int x = 0; x < image.cols; ++x) {
-                        const cv::Vec3f pixel = image.at<cv::Vec3f>(y, x);
-                        image_texels.emplace_back(pixel[0], pixel[1], pixel[2]);
-                    }
-                }
+                packed.image_width = image->width();
+                packed.image_height = image->height();
+                append_image_texels(*image, image_texels);
             } else if constexpr (std::is_same_v<T, NoiseTextureDesc>) {
                 packed.type = 3;
                 packed.scale = static_cast<float>(value.scale);
@@ -278,8 +402,10 @@ void build_light_distribution(GpuPreparedScene& prepared) {
     }
     for (std::size_t i = 0; i < prepared.triangles.size(); ++i) {
         const PackedTriangle& triangle = prepared.triangles[i];
-        const float area =
-            0.5f * (triangle.p1 - triangle.p0).cross(triangle.p2 - triangle.p0).norm();
+        const Eigen::Vector3f& p0 = prepared.vertex_positions[triangle.vertex0];
+        const Eigen::Vector3f edge1 = prepared.vertex_positions[triangle.vertex1] - p0;
+        const Eigen::Vector3f edge2 = prepared.vertex_positions[triangle.vertex2] - p0;
+        const float area = 0.5f * edge1.cross(edge2).norm();
         append_light(prepared.lights, PackedLightType::triangle, static_cast<int>(i),
             area * material_emission_luminance(prepared, triangle.material_index));
     }
@@ -291,7 +417,10 @@ void build_light_distribution(GpuPreparedScene& prepared) {
         total_weight += light.selection_pdf;
     }
     float cdf = 0.0f;
+    std::vector<double> weights;
+    weights.reserve(prepared.lights.size());
     for (PackedLight& light : prepared.lights) {
+        weights.push_back(light.selection_pdf);
         light.selection_pdf /= total_weight;
         cdf += light.selection_pdf;
         light.cdf = cdf;
@@ -299,10 +428,40 @@ void build_light_distribution(GpuPreparedScene& prepared) {
     if (!prepared.lights.empty()) {
         prepared.lights.back().cdf = 1.0f;
     }
+
+    const std::vector<AliasTableEntry> table = build_alias_table(weights);
+    for (std::size_t i = 0; i < prepared.lights.size(); ++i) {
+        prepared.lights[i].alias_probability = static_cast<float>(table[i].probability);
+        prepared.lights[i].alias = table[i].alias;
+    }
 }
 
 } // namespace
 
+GpuPreparedSceneView::GpuPreparedSceneView(const GpuPreparedScene& scene)
+    : background(scene.background),
+      spheres(scene.spheres),
+      quads(scene.quads),
+      triangles(scene.triangles),
+      vertex_positions(scene.vertex_positions),
+      vertex_attributes(scene.vertex_attributes),
+      triangle_acceleration_ids(scene.triangle_acceleration_ids),
+      prototype_triangles(scene.prototype_triangles),
+      prototype_vertex_positions(scene.prototype_vertex_positions),
+      prototype_vertex_attributes(scene.prototype_vertex_attributes),
+      mesh_prototypes(scene.mesh_prototypes),
+      mesh_instances(scene.mesh_instances),
+      media(scene.media),
+      textures(scene.textures),
+      image_texels(scene.image_texels),
+      materials(scene.materials),
+      openpbr_materials(scene.openpbr_materials),
+      lights(scene.lights),
+      analytic_lights(scene.analytic_lights),
+      analytic_light_tree(scene.analytic_light_tree),
+      analytic_infinite_lights(scene.analytic_infinite_lights),
+      generations(&scene.generations) {}
+
 GpuPreparedScene prepare_gpu_scene(const PackedScene& scene) {
     GpuPreparedScene prepared {};
     prepared.background = scene.background.cast<float>();
@@ -317,9 +476,51 @@ GpuPreparedScene prepare_gpu_scene(const PackedScene& scene) {
         prepared.quads.push_back(pack_quad(quad));
     }
 
-    prepared.triangles.reserve(scene.triangles.size());
+    std::size_t triangle_count = scene.triangles.size();
+    for (const IndexedTriangleMesh& mesh : scene.triangle_meshes) {
+        triangle_count += mesh.triangles.size();
+    }
+    prepared.triangles.reserve(triangle_count);
+    prepared.triangle_acceleration_ids.reserve(triangle_count);
+    IndexedTriangleWriter triangle_writer {
+        prepared.triangles, prepared.vertex_positions, prepared.vertex_attributes};
     for (const TrianglePrimitive& triangle : scene.triangles) {
-        prepared.triangles.push_back(pack_triangle(triangle));
+        triangle_writer.append(triangle);
+        prepared.triangle_acceleration_ids.push_back(PackedTriangleAccelerationIds {
+            .prototype_id = triangle.acceleration_prototype_id,
+            .instance_id = triangle.acceleration_instance_id,
+        });
+    }
+    for (const IndexedTriangleMesh& mesh : scene.triangle_meshes) {
+        append_indexed_mesh(
+            mesh, prepared.triangles, prepared.vertex_positions, prepared.vertex_attributes);
+        prepared.triangle_acceleration_ids.insert(prepared.triangle_acceleration_ids.end(),
+            mesh.triangles.size(),
+            PackedTriangleAccelerationIds {
+                .prototype_id = mesh.acceleration_prototype_id,
+                .instance_id = mesh.acceleration_instance_id,
+            });
+    }
+
+    prepared.mesh_prototypes.reserve(scene.mesh_prototypes.size());
+    IndexedTriangleWriter prototype_writer {prepared.prototype_triangles,
+        prepared.prototype_vertex_positions, prepared.prototype_vertex_attributes};
+    for (const MeshPrototype& prototype : scene.mesh_prototypes) {
+        prepared.mesh_prototypes.push_back(PackedMeshPrototype {
+            .first_triangle = static_cast<int>(prepared.prototype_triangles.size()),
+            .triangle_count =
+                static_cast<int>(prototype.triangles.size() + prototype.mesh.triangles.size()),
+        });
+        for (const TrianglePrimitive& triangle : prototype.triangles) {
+            prototype_writer.append(triangle);
+        }
+        append_indexed_mesh(prototype.mesh, prepared.prototype_triangles,
+            prepared.prototype_vertex_positions, prepared.prototype_vertex_attributes);
+    }
+
+    prepared.mesh_instances.reserve(scene.mesh_instances.size());
+    for (const MeshInstance& instance : scene.mesh_instances) {
+        prepared.mesh_instances.push_back(pack_mesh_instance(instance));
     }
 
     prepared.media.reserve(scene.media.size());
@@ -332,17 +533,49 @@ GpuPreparedScene prepare_gpu_scene(const PackedScene& scene) {
         prepared.materials.push_back(pack_material(material, prepared.openpbr_materials));
     }
 
+    // Decode every image up front so that cache misses decode in parallel
+    std::vector<std::string> image_paths;
+    for (const TextureDesc& texture : scene.textures) {
+        if (const auto* image = std::get_if<ImageTextureDesc>(&texture)) {
+            image_paths.push_back(image->path);
+        }
+    }
+    const std::vector<DecodedTextureHandle> images = global_texture_cache().load_all(image_paths);
+
     prepared.textures.reserve(scene.textures.size());
+    std::size_t next_image = 0;
     for (const TextureDesc& texture : scene.textures) {
-        prepared.textures.push_back(pack_texture(texture, prepared.image_texels));
+        const DecodedTextureHandle image = std::holds_alternative<ImageTextureDesc>(texture)
+                                               ? images[next_image++]
+                                               : nullptr;
+        prepared.textures.push_back(pack_texture(texture, image, prepared.image_texels));
     }
 
     prepared.analytic_lights.reserve(scene.analytic_lights.size());
     for (const AnalyticLightDesc& light : scene.analytic_lights) {
         prepared.analytic_lights.push_back(pack_analytic_light(light));
     }
+    AnalyticLightTree light_tree = build_analytic_light_tree(scene.analytic_lights);
+    for (std::size_t i = 0; i < prepared.analytic_lights.size(); ++i) {
+        prepared.analytic_lights[i].tree_leaf = light_tree.light_leaves[i];
+    }
+    prepared.analytic_light_tree = std::move(light_tree.nodes);
+    prepared.analytic_infinite_lights = std::move(light_tree.infinite);
 
     build_light_distribution(prepared);
+    prepared.generations = scene.generations;
+    // Indexed mesh triangles follow the soup, each stamped with its mesh's stamp
+    std::vector<std::uint64_t>& triangle_elements = prepared.generations.triangle_elements;
+    if (triangle_elements.size() == scene.triangles.size()
+        && prepared.generations.triangle_mesh_elements.size() == scene.triangle_meshes.size()) {
+        for (std::size_t mesh = 0; mesh < scene.triangle_meshes.size(); ++mesh) {
+            triangle_elements.insert(triangle_elements.end(),
+                scene.triangle_meshes[mesh].triangles.size(),
+                prepared.generations.triangle_mesh_elements[mesh]);
+        }
+    } else {
+        triangle_elements.clear();
+    }
 
     return prepared;
 }
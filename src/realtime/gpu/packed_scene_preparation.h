@@ -5,15 +5,40 @@
 
 #include <Eigen/Core>
 
+#include <span>
 #include <vector>
 
 namespace rt {
 
+// Acceleration statistics ids of a world-space triangle. They are only read on the host, so
+// they stay out of the uploaded triangle stream.
+struct PackedTriangleAccelerationIds {
+    int prototype_id = -1;
+    int instance_id = -1;
+};
+
+// Range of GpuPreparedScene::prototype_triangles holding one mesh prototype
+struct PackedMeshPrototype {
+    int first_triangle = 0;
+    int triangle_count = 0;
+};
+
 struct GpuPreparedScene {
     Eigen::Vector3f background = Eigen::Vector3f::Zero();
     std::vector<PackedSphere> spheres;
     std::vector<PackedQuad> quads;
+    // Triangles index shared vertex streams, copied from indexed meshes or welded from soups; world
+    // triangles and prototypes keep separate streams so that editing one never reads as a change
+    // to the other
     std::vector<PackedTriangle> triangles;
+    std::vector<Eigen::Vector3f> vertex_positions;
+    std::vector<PackedVertexAttributes> vertex_attributes;
+    std::vector<PackedTriangleAccelerationIds> triangle_acceleration_ids;
+    std::vector<PackedTriangle> prototype_triangles; // Object space, shared by every placement
+    std::vector<Eigen::Vector3f> prototype_vertex_positions;
+    std::vector<PackedVertexAttributes> prototype_vertex_attributes;
+    std::vector<PackedMeshPrototype> mesh_prototypes;
+    std::vector<PackedMeshInstance> mesh_instances;
     std::vector<PackedMedium> media;
     std::vector<PackedTexture> textures;
     std::vector<Eigen::Vector3f> image_texels;
@@ -21,6 +46,41 @@ struct GpuPreparedScene {
     std::vector<OpenPbrCompiledMaterial> openpbr_materials;
     std::vector<PackedLight> lights;
     std::vector<PackedAnalyticLight> analytic_lights;
+    std::vector<LightTreeNode> analytic_light_tree;
+    std::vector<LightTreeInfiniteEntry> analytic_infinite_lights;
+    SceneGenerations generations; // Carried over from the packed scene
+};
+
+// Read-only view of prepared arrays, whether a GpuPreparedScene owns them or a mapped cache file
+// does. Converts implicitly from a GpuPreparedScene, the way std::string_view does from a string,
+// and is only valid while that storage lives.
+struct GpuPreparedSceneView {
+    GpuPreparedSceneView() = default;
+    GpuPreparedSceneView(const GpuPreparedScene& scene);
+
+    Eigen::Vector3f background = Eigen::Vector3f::Zero();
+    std::span<const PackedSphere> spheres;
+    std::span<const PackedQuad> quads;
+    std::span<const PackedTriangle> triangles;
+    std::span<const Eigen::Vector3f> vertex_positions;
+    std::span<const PackedVertexAttributes> vertex_attributes;
+    std::span<const PackedTriangleAccelerationIds> triangle_acceleration_ids;
+    std::span<const PackedTriangle> prototype_triangles;
+    std::span<const Eigen::Vector3f> prototype_vertex_positions;
+    std::span<const PackedVertexAttributes> prototype_vertex_attributes;
+    std::span<const PackedMeshPrototype> mesh_prototypes;
+    std::span<const PackedMeshInstance> mesh_instances;
+    std::span<const PackedMedium> media;
+    std::span<const PackedTexture> textures;
+    std::span<const Eigen::Vector3f> image_texels;
+    std::span<const MaterialSample> materials;
+    std::span<const OpenPbrCompiledMaterial> openpbr_materials;
+    std::span<const PackedLight> lights;
+    std::span<const PackedAnalyticLight> analytic_lights;
+    std::span<const LightTreeNode> analytic_light_tree;
+    std::span<const LightTreeInfiniteEntry> analytic_infinite_lights;
+    // Null when the arrays carry no stamps, as in a cache file; every array then reads as changed
+    const SceneGenerations* generations = nullptr;
 };
 
 GpuPreparedScene prepare_gpu_scene(const PackedScene& scene);
@@ -0,0 +1,342 @@
+#include "realtime/gpu/prepared_scene_cache.h"
+
+#include "common/content_hash.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace rt {
+namespace {
+
+constexpr std::array<char, 8> kCacheMagic {'R', 'T', 'S', 'C', 'A', 'C', 'H', 'E'};
+constexpr std::size_t kPreparedArrayCount = 20;
+constexpr std::size_t kSectionAlignment = 64;
+constexpr std::size_t kSourceAlignment = 8;
+constexpr std::int64_t kNanosecondsPerSecond = 1'000'000'000;
+
+// Fixed-width records, so the file reads the same from any build of the same layout
+struct CacheHeader {
+    std::array<char, 8> magic {};
+    std::uint32_t version = 0;
+    std::uint32_t section_count = 0;
+    std::uint64_t layout_hash = 0;
+    std::uint64_t source_count = 0;
+    std::uint64_t file_size = 0;
+    float background[3] {};
+    std::uint32_t source_bytes = 0; // The source table, right after the section table
+};
+
+struct CacheSection {
+    std::uint64_t element_size = 0;
+    std::uint64_t offset = 0;
+    std::uint64_t count = 0;
+};
+
+// One source file as it was when the cache was written. Its path follows, padded to
+// kSourceAlignment.
+struct CacheSourceStamp {
+    std::uint64_t size = 0;
+    std::int64_t modified_ns = 0;
+    std::uint32_t path_bytes = 0;
+    std::uint32_t reserved = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader> && sizeof(CacheHeader) == 56);
+static_assert(std::is_trivially_copyable_v<CacheSection> && sizeof(CacheSection) == 24);
+static_assert(std::is_trivially_copyable_v<CacheSourceStamp> && sizeof(CacheSourceStamp) == 24);
+
+// Header and section table; the source table starts here
+constexpr std::size_t kTableBytes =
+    sizeof(CacheHeader) + kPreparedArrayCount * sizeof(CacheSection);
+static_assert(kTableBytes % kSourceAlignment == 0);
+
+template<typename Array>
+using PreparedElement = typename std::remove_cvref_t<Array>::value_type;
+
+// Element sizes and alignments in file order; a layout change in any array rejects old files
+std::uint64_t layout_hash() {
+    std::uint64_t hash = hash_mix(kHashSeed, kPreparedSceneCacheVersion);
+    GpuPreparedScene scene {};
+    visit_prepared_arrays(scene, [&hash](const auto& array) {
+        using Element = PreparedElement<decltype(array)>;
+        hash = hash_mix(hash_mix(hash, sizeof(Element)), alignof(Element));
+    });
+    return hash;
+}
+
+std::size_t align_to(std::size_t offset, std::size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool stamp_source(const std::filesystem::path& path, CacheSourceStamp& stamp) {
+    struct stat status {};
+    if (::stat(path.c_str(), &status) != 0) {
+        return false;
+    }
+    stamp.size = static_cast<std::uint64_t>(status.st_size);
+    stamp.modified_ns = static_cast<std::int64_t>(status.st_mtim.tv_sec) * kNanosecondsPerSecond
+                        + status.st_mtim.tv_nsec;
+    return true;
+}
+
+// The scene file first, then each dependency once, with paths relative to the scene's directory
+// where they can be, so a scene tree moves together with its cache
+std::vector<unsigned char> encode_sources(const PreparedSceneSource& source,
+    std::uint64_t& source_count) {
+    const std::filesystem::path scene_file = source.scene_file.lexically_normal();
+    const std::filesystem::path scene_directory = scene_file.parent_path();
+    std::vector<std::filesystem::path> paths {scene_file};
+    for (const std::string& dependency : source.dependencies) {
+        std::filesystem::path path = std::filesystem::path {dependency}.lexically_normal();
+        if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+            paths.push_back(std::move(path));
+        }
+    }
+
+    std::vector<unsigned char> table;
+    for (const std::filesystem::path& path : paths) {
+        CacheSourceStamp stamp {};
+        if (!stamp_source(path, stamp)) {
+            throw std::runtime_error("failed to stat scene source: " + path.string());
+        }
+        const std::filesystem::path relative = path.lexically_relative(scene_directory);
+        const std::string key =
+            relative.empty() ? path.generic_string() : relative.generic_string();
+        stamp.path_bytes = static_cast<std::uint32_t>(key.size());
+        const std::size_t offset = table.size();
+        table.resize(align_to(offset + sizeof(stamp) + key.size(), kSourceAlignment));
+        std::memcpy(table.data() + offset, &stamp, sizeof(stamp));
+        std::memcpy(table.data() + offset + sizeof(stamp), key.data(), key.size());
+    }
+    source_count = paths.size();
+    return table;
+}
+
+// Whether every recorded source still has the size and modification time it was written with
+bool sources_current(const unsigned char* table, std::size_t table_bytes,
+    std::uint64_t source_count, const std::filesystem::path& scene_directory) {
+    std::size_t offset = 0;
+    for (std::uint64_t i = 0; i < source_count; ++i) {
+        CacheSourceStamp recorded {};
+        if (table_bytes - offset < sizeof(recorded)) {
+            return false;
+        }
+        std::memcpy(&recorded, table + offset, sizeof(recorded));
+        offset += sizeof(recorded);
+        if (recorded.path_bytes > table_bytes - offset) {
+            return false;
+        }
+        const std::filesystem::path path {std::string(
+            reinterpret_cast<const char*>(table + offset), recorded.path_bytes)};
+        offset = std::min(align_to(offset + recorded.path_bytes, kSourceAlignment), table_bytes);
+
+        CacheSourceStamp current {};
+        if (!stamp_source(path.is_absolute() ? path : scene_directory / path, current)
+            || current.size != recorded.size || current.modified_ns != recorded.modified_ns) {
+            return false;
+        }
+    }
+    return source_count > 0;
+}
+
+} // namespace
+
+std::filesystem::path prepared_scene_cache_path(const std::filesystem::path& scene_file) {
+    std::filesystem::path path = scene_file;
+    path.replace_extension(".rtcache");
+    return path;
+}
+
+void write_prepared_scene_cache(const PreparedSceneSource& source, const GpuPreparedScene& scene) {
+    std::uint64_t source_count = 0;
+    const std::vector<unsigned char> sources = encode_sources(source, source_count);
+    if (sources.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("scene cache source table is too large");
+    }
+    std::array<CacheSection, kPreparedArrayCount> sections {};
+    std::size_t offset = align_to(kTableBytes + sources.size(), kSectionAlignment);
+    std::size_t section = 0;
+    visit_prepared_arrays(scene, [&](const auto& array) {
+        using Element = PreparedElement<decltype(array)>;
+        sections[section++] = CacheSection {
+            .element_size = sizeof(Element),
+            .offset = offset,
+            .count = array.size(),
+        };
+        offset = align_to(offset + array.size() * sizeof(Element), kSectionAlignment);
+    });
+
+    CacheHeader header {};
+    header.magic = kCacheMagic;
+    header.version = kPreparedSceneCacheVersion;
+    header.section_count = static_cast<std::uint32_t>(sections.size());
+    header.layout_hash = layout_hash();
+    header.source_count = source_count;
+    header.file_size = offset;
+    header.background[0] = scene.background.x();
+    header.background[1] = scene.background.y();
+    header.background[2] = scene.background.z();
+    header.source_bytes = static_cast<std::uint32_t>(sources.size());
+
+    const std::filesystem::path path = prepared_scene_cache_path(source.scene_file);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("failed to open scene cache: " + temporary.string());
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sections.data()), sizeof(sections));
+        out.write(reinterpret_cast<const char*>(sources.data()),
+            static_cast<std::streamsize>(sources.size()));
+        const std::array<char, kSectionAlignment> padding {};
+        std::size_t written = kTableBytes + sources.size();
+        section = 0;
+        visit_prepared_arrays(scene, [&](const auto& array) {
+            const CacheSection& current = sections[section++];
+            out.write(padding.data(), static_cast<std::streamsize>(current.offset - written));
+            const std::size_t bytes = current.count * current.element_size;
+            out.write(reinterpret_cast<const char*>(array.data()),
+                static_cast<std::streamsize>(bytes));
+            written = current.offset + bytes;
+        });
+        out.write(padding.data(), static_cast<std::streamsize>(offset - written));
+        if (!out.flush()) {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            throw std::runtime_error("failed to write scene cache: " + temporary.string());
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        throw std::runtime_error("failed to replace scene cache: " + path.string());
+    }
+}
+
+std::optional<MappedPreparedScene> MappedPreparedScene::open(
+    const std::filesystem::path& scene_file) {
+    const std::filesystem::path path = prepared_scene_cache_path(scene_file);
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(CacheHeader))) {
+        ::close(fd);
+        return std::nullopt;
+    }
+    const auto size = static_cast<std::size_t>(status.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    MappedPreparedScene mapped;
+    mapped.data_ = data;
+    mapped.size_ = size;
+
+    CacheHeader header {};
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kCacheMagic || header.version != kPreparedSceneCacheVersion
+        || header.section_count != kPreparedArrayCount || header.layout_hash != layout_hash()
+        || header.file_size != size || size < kTableBytes
+        || header.source_bytes > size - kTableBytes) {
+        return std::nullopt;
+    }
+    std::array<CacheSection, kPreparedArrayCount> sections {};
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    std::memcpy(sections.data(), bytes + sizeof(CacheHeader), sizeof(sections));
+    if (!sources_current(bytes + kTableBytes, header.source_bytes, header.source_count,
+            scene_file.lexically_normal().parent_path())) {
+        return std::nullopt;
+    }
+    const std::size_t first_section = kTableBytes + header.source_bytes;
+
+    mapped.view_.background =
+        Eigen::Vector3f {header.background[0], header.background[1], header.background[2]};
+    bool valid = true;
+    std::size_t section = 0;
+    visit_prepared_arrays(mapped.view_, [&](auto& span) {
+        using Element = PreparedElement<decltype(span)>;
+        const CacheSection& current = sections[section++];
+        // Counts are bounded by the file size first, so the byte count cannot overflow
+        valid = valid && current.element_size == sizeof(Element)
+                && current.offset % kSectionAlignment == 0 && current.offset >= first_section
+                && current.offset <= size
+                && current.count <= (size - current.offset) / sizeof(Element);
+        if (valid) {
+            span = std::span<const Element> {
+                reinterpret_cast<const Element*>(bytes + current.offset),
+                static_cast<std::size_t>(current.count)};
+        }
+    });
+    if (!valid) {
+        return std::nullopt;
+    }
+    return mapped;
+}
+
+MappedPreparedScene::MappedPreparedScene(MappedPreparedScene&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      view_(std::exchange(other.view_, GpuPreparedSceneView {})) {}
+
+MappedPreparedScene& MappedPreparedScene::operator=(MappedPreparedScene&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        view_ = std::exchange(other.view_, GpuPreparedSceneView {});
+    }
+    return *this;
+}
+
+MappedPreparedScene::~MappedPreparedScene() {
+    release();
+}
+
+void MappedPreparedScene::release() {
+    if (data_ != nullptr) {
+        ::munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+const GpuPreparedSceneView& MappedPreparedScene::view() const {
+    return view_;
+}
+
+std::size_t MappedPreparedScene::mapped_bytes() const {
+    return size_;
+}
+
+GpuPreparedScene prepare_and_cache_gpu_scene(const PackedScene& scene,
+    const PreparedSceneSource& source) {
+    GpuPreparedScene prepared = prepare_gpu_scene(scene);
+    try {
+        write_prepared_scene_cache(source, prepared);
+    } catch (const std::exception&) {
+        // A read-only scene tree still renders; it just prepares from scratch every time
+    }
+    return prepared;
+}
+
+} // namespace rt
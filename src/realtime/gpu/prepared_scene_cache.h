@@ -0,0 +1,93 @@
+#pragma once
+
+#include "realtime/gpu/packed_scene_preparation.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+// Bump whenever the loader, the importers, the realtime adapter or prepare_gpu_scene change what
+// they produce from the same source files, or a prepared array's element layout changes without
+// changing its size
+inline constexpr std::uint32_t kPreparedSceneCacheVersion = 3;
+
+// Files a scene was compiled from. The cache records the size and modification time of each one,
+// by its path relative to the scene file's directory, and stays current while they all match:
+// checking it stats the sources and never reads them.
+struct PreparedSceneSource {
+    std::filesystem::path scene_file;
+    std::vector<std::string> dependencies;
+};
+
+// The cache lives next to its scene: scenes/foo/scene.yaml caches to scenes/foo/scene.rtcache
+std::filesystem::path prepared_scene_cache_path(const std::filesystem::path& scene_file);
+
+// Visits every cached array of a GpuPreparedScene or a GpuPreparedSceneView in file order.
+// Appending an array here needs a version bump.
+template<typename Scene, typename Visitor>
+void visit_prepared_arrays(Scene& scene, Visitor&& visitor) {
+    visitor(scene.spheres);
+    visitor(scene.quads);
+    visitor(scene.triangles);
+    visitor(scene.vertex_positions);
+    visitor(scene.vertex_attributes);
+    visitor(scene.triangle_acceleration_ids);
+    visitor(scene.prototype_triangles);
+    visitor(scene.prototype_vertex_positions);
+    visitor(scene.prototype_vertex_attributes);
+    visitor(scene.mesh_prototypes);
+    visitor(scene.mesh_instances);
+    visitor(scene.media);
+    visitor(scene.textures);
+    visitor(scene.image_texels);
+    visitor(scene.materials);
+    visitor(scene.openpbr_materials);
+    visitor(scene.lights);
+    visitor(scene.analytic_lights);
+    visitor(scene.analytic_light_tree);
+    visitor(scene.analytic_infinite_lights);
+}
+
+// Writes through a temporary file and renames it into place, so readers never map a partial file.
+// The sources are stamped as they are at the call, so write straight after preparing: an edit
+// that lands while the scene is being prepared goes unnoticed until the file changes again.
+void write_prepared_scene_cache(const PreparedSceneSource& source, const GpuPreparedScene& scene);
+
+// A scene's cache file mapped read-only
+class MappedPreparedScene {
+public:
+    // Needs only the scene path, so callers check the cache before loading or importing anything.
+    // Empty when the file is missing, was written for another layout, a source's size or
+    // modification time no longer matches, or the file fails its bounds checks.
+    static std::optional<MappedPreparedScene> open(const std::filesystem::path& scene_file);
+
+    MappedPreparedScene(MappedPreparedScene&& other) noexcept;
+    MappedPreparedScene& operator=(MappedPreparedScene&& other) noexcept;
+    MappedPreparedScene(const MappedPreparedScene&) = delete;
+    MappedPreparedScene& operator=(const MappedPreparedScene&) = delete;
+    ~MappedPreparedScene();
+
+    // Spans into the mapping, valid for the lifetime of this object; nothing is copied out
+    const GpuPreparedSceneView& view() const;
+    std::size_t mapped_bytes() const;
+
+private:
+    MappedPreparedScene() = default;
+    void release();
+
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    GpuPreparedSceneView view_ {};
+};
+
+// Prepares the scene and refreshes its cache. Failing to write the cache never fails the
+// preparation.
+GpuPreparedScene prepare_and_cache_gpu_scene(const PackedScene& scene,
+    const PreparedSceneSource& source);
+
+} // namespace rt
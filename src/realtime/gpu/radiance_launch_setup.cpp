@@ -1,20 +1,6 @@
 #include "realtime/gpu/radiance_launch_setup.h"
 
-#include <limits>
-#include <stdexcept>
-#include <string>
-
 namespace rt {
-namespace {
-
-int checked_scene_count(std::size_t count, const char* label) {
-    if (count > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
-        throw std::runtime_error(std::string("scene ") + label + " count exceeds int range");
-    }
-    return static_cast<int>(count);
-}
-
-} // namespace
 
 DeviceActiveCamera make_device_active_camera(const PackedCamera& camera) {
     DeviceActiveCamera active {};
@@ -63,7 +49,7 @@ DeviceActiveCamera make_device_active_camera(const PackedCamera& camera) {
     return active;
 }
 
-LaunchParams make_radiance_launch_params(const PackedScene& scene,
+LaunchParams make_radiance_launch_params(const Eigen::Vector3f& background,
     const DeviceSceneView& scene_view, const PackedCameraRig& rig, const RenderProfile& profile,
     int camera_index, std::uint32_t sample_stream, DeviceFrameBuffers frame,
     const LaunchHistoryState& history) {
@@ -74,17 +60,11 @@ LaunchParams make_radiance_launch_params(const PackedScene& scene,
     params.height = camera.height;
     params.sample_stream = sample_stream;
     params.active_camera = make_device_active_camera(camera);
-    params.background[0] = static_cast<float>(scene.background.x());
-    params.background[1] = static_cast<float>(scene.background.y());
-    params.background[2] = static_cast<float>(scene.background.z());
+    params.background[0] = background.x();
+    params.background[1] = background.y();
+    params.background[2] = background.z();
     params.frame = frame;
     params.scene = scene_view;
-    params.scene.sphere_count = checked_scene_count(scene.spheres.size(), "sphere");
-    params.scene.quad_count = checked_scene_count(scene.quads.size(), "quad");
-    params.scene.triangle_count = checked_scene_count(scene.triangles.size(), "triangle");
-    params.scene.medium_count = checked_scene_count(scene.media.size(), "medium");
-    params.scene.texture_count = checked_scene_count(scene.textures.size(), "texture");
-    params.scene.material_count = checked_scene_count(scene.materials.size(), "material");
     params.samples_per_pixel = profile.samples_per_pixel;
     params.max_bounces = profile.max_bounces;
     params.rr_start_bounce = profile.rr_start_bounce;
@@ -101,7 +81,7 @@ LaunchParams make_radiance_launch_params(const PackedScene& scene,
         profile.restir_min_analytic_lights > 0 ? profile.restir_min_analytic_lights : 1;
     params.restir_di_enabled =
         profile.enable_restir_di
-                && static_cast<int>(scene.analytic_lights.size()) >= restir_min_lights
+                && scene_view.analytic_light_count >= restir_min_lights
             ? 1
             : 0;
 
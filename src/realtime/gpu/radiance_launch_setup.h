@@ -20,9 +20,12 @@ struct LaunchHistoryState {
 
 DeviceActiveCamera make_device_active_camera(const PackedCamera& camera);
 
-LaunchParams make_radiance_launch_params(const PackedScene& scene, const DeviceSceneView& scene_view,
-    const PackedCameraRig& rig, const RenderProfile& profile, int camera_index, std::uint32_t sample_stream,
-    DeviceFrameBuffers frame, const LaunchHistoryState& history);
+// The scene is described by its prepared background and the uploaded view, with its counts, so
+// a launch needs neither the packed scene nor a copy of it
+LaunchParams make_radiance_launch_params(const Eigen::Vector3f& background,
+    const DeviceSceneView& scene_view, const PackedCameraRig& rig, const RenderProfile& profile,
+    int camera_index, std::uint32_t sample_stream, DeviceFrameBuffers frame,
+    const LaunchHistoryState& history);
 
 LaunchHistoryState capture_launch_history(const LaunchParams& params);
 
@@ -100,6 +100,18 @@ struct RendererPool::Impl {
         }
     }
 
+    void use_prepared_scene() {
+        std::vector<std::future<void>> futures;
+        futures.reserve(workers.size());
+        for (const std::unique_ptr<RendererWorker>& worker : workers) {
+            futures.push_back(
+                worker->submit([](OptixRenderer& renderer) { renderer.use_prepared_scene(); }));
+        }
+        for (std::future<void>& future : futures) {
+            future.get();
+        }
+    }
+
     std::shared_ptr<SharedGpuSceneState> shared_scene;
     std::vector<std::unique_ptr<RendererWorker>> workers;
     std::atomic<std::uint64_t> worker_starts {0};
@@ -117,18 +129,16 @@ RendererPool::RendererPool(int renderer_count) {
 
 RendererPool::~RendererPool() = default;
 
-void RendererPool::prepare_scene(const PackedScene& scene) {
+void RendererPool::prepare_scene(const PackedScene& scene, const PreparedSceneSource* source) {
     std::lock_guard<std::mutex> lock(impl_->operation_mutex);
-    impl_->acceleration = impl_->shared_scene->prepare(scene);
-    std::vector<std::future<void>> futures;
-    futures.reserve(impl_->workers.size());
-    for (const std::unique_ptr<RendererWorker>& worker : impl_->workers) {
-        futures.push_back(worker->submit(
-            [&scene](OptixRenderer& renderer) { renderer.use_prepared_scene(scene); }));
-    }
-    for (std::future<void>& future : futures) {
-        future.get();
-    }
+    impl_->acceleration = impl_->shared_scene->prepare(scene, source);
+    impl_->use_prepared_scene();
+}
+
+void RendererPool::prepare_scene(const MappedPreparedScene& mapped) {
+    std::lock_guard<std::mutex> lock(impl_->operation_mutex);
+    impl_->acceleration = impl_->shared_scene->prepare(mapped.view());
+    impl_->use_prepared_scene();
 }
 
 void RendererPool::reset_accumulation() {
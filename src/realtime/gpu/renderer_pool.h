@@ -37,7 +37,10 @@ public:
     RendererPool(RendererPool&&) = delete;
     RendererPool& operator=(RendererPool&&) = delete;
 
-    void prepare_scene(const PackedScene& scene);
+    // With a source, the preparation also refreshes that scene's on-disk cache
+    void prepare_scene(const PackedScene& scene, const PreparedSceneSource* source = nullptr);
+    // Uploads straight from the mapped cache; the mapping may be released once this returns
+    void prepare_scene(const MappedPreparedScene& mapped);
     void reset_accumulation();
     void reset_sequence(std::uint32_t sample_stream);
     // Device views are consumed before the next pool operation invalidates renderer outputs.
@@ -309,6 +309,12 @@ void write_json(const RunReport& report, const std::filesystem::path& path) {
         << escape_json_string(report.gpu_scheduling.acceleration_update_kind) << "\",\n";
     out << "    \"acceleration_update_ms\": " << report.gpu_scheduling.acceleration_update_ms
         << ",\n";
+    out << "    \"acceleration_build_mode\": \""
+        << escape_json_string(report.gpu_scheduling.acceleration_build_mode) << "\",\n";
+    out << "    \"acceleration_build_ms\": " << report.gpu_scheduling.acceleration_build_ms
+        << ",\n";
+    out << "    \"acceleration_sah_cost\": " << report.gpu_scheduling.acceleration_sah_cost
+        << ",\n";
     out << "    \"acceleration_node_count\": " << report.gpu_scheduling.acceleration_node_count
         << ",\n";
     out << "    \"acceleration_reference_count\": "
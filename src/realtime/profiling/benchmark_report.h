@@ -108,6 +108,9 @@ struct GpuSchedulingReport {
     std::uint64_t launch_parameter_upload_count = 0;
     std::string acceleration_update_kind;
     double acceleration_update_ms = 0.0;
+    std::string acceleration_build_mode;
+    double acceleration_build_ms = 0.0;
+    double acceleration_sah_cost = 0.0;
     int acceleration_node_count = 0;
     int acceleration_reference_count = 0;
     int acceleration_prototype_count = 0;
@@ -3,6 +3,8 @@
 #include "realtime/frame_convention.h"
 
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace rt {
 
@@ -14,6 +16,17 @@ void validate_active_cameras(int active_cameras) {
     }
 }
 
+int resolve_cpu_renderer_count(int requested) {
+    if (requested == 0) {
+        // One slot per camera, as for OptiX; each slot already spreads its rows over TBB
+        return 4;
+    }
+    if (requested < 1 || requested > 4) {
+        throw std::runtime_error("realtime pipeline cpu_renderer_count must be 0 or in [1, 4]");
+    }
+    return requested;
+}
+
 PackedScene make_smoke_scene() {
     SceneDescription scene;
     const int light = scene.add_material(DiffuseLightMaterial {Eigen::Vector3d {8.0, 8.0, 8.0}});
@@ -50,6 +63,9 @@ PackedCameraRig make_smoke_rig(int active_cameras, double pose_jump_translation)
 
 } // namespace
 
+RealtimePipeline::RealtimePipeline(RealtimeBackend backend, int cpu_renderer_count)
+    : backend_(backend), cpu_renderer_count_(resolve_cpu_renderer_count(cpu_renderer_count)) {}
+
 RealtimeFrameSet RealtimePipeline::render_profiled_smoke_frame(int active_cameras,
     const RenderProfile& profile) {
     return render_profiled_smoke_frame_impl(active_cameras, profile, false);
@@ -71,6 +87,30 @@ RealtimeFrameSet RealtimePipeline::render_profiled_smoke_frame_impl(int active_c
 
     RealtimeFrameSet out {};
     out.frames.resize(static_cast<std::size_t>(active_cameras));
+    if (backend_ == RealtimeBackend::cpu) {
+        if (active_cameras > cpu_renderer_count_) {
+            throw std::runtime_error("realtime pipeline has " + std::to_string(cpu_renderer_count_)
+                                     + " cpu renderers for " + std::to_string(active_cameras)
+                                     + " active cameras");
+        }
+        if (cpu_pool_ == nullptr) {
+            cpu_pool_ = std::make_unique<CpuRendererPool>(cpu_renderer_count_);
+            cpu_pool_->prepare_scene(scene);
+        }
+        if (pose_jump) {
+            cpu_pool_->reset_accumulation();
+        }
+        std::vector<CameraRenderResult> results =
+            cpu_pool_->render_frame(rig, profile, active_cameras);
+        for (CameraRenderResult& result : results) {
+            const std::size_t idx = static_cast<std::size_t>(result.camera_index);
+            history_lengths_[idx] = pose_jump ? 1 : history_lengths_[idx] + 1;
+            out.frames[idx].history_length = history_lengths_[idx];
+            out.frames[idx].radiance = std::move(result.profiled.frame);
+        }
+        return out;
+    }
+
     for (int i = 0; i < active_cameras; ++i) {
         const std::size_t idx = static_cast<std::size_t>(i);
         if (pose_jump) {
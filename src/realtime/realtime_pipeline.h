@@ -1,5 +1,6 @@
 #pragma once
 
+#include "realtime/gpu/cpu_renderer_pool.h"
 #include "realtime/gpu/optix_renderer.h"
 #include "realtime/render_profile.h"
 
@@ -18,8 +19,18 @@ struct RealtimeFrameSet {
     std::vector<RealtimeFrame> frames;
 };
 
+enum class RealtimeBackend {
+    optix,
+    cpu,
+};
+
 class RealtimePipeline {
 public:
+    // The CPU backend keeps one renderer per camera it can render at once, in [1, 4]. Zero keeps
+    // one for each of the four cameras; a smaller count caps the cameras a frame may render.
+    explicit RealtimePipeline(RealtimeBackend backend = RealtimeBackend::optix,
+        int cpu_renderer_count = 0);
+
     RealtimeFrameSet render_profiled_smoke_frame(int active_cameras, const RenderProfile& profile);
     RealtimeFrameSet render_profiled_smoke_frame_with_pose_jump(int active_cameras,
         const RenderProfile& profile);
@@ -27,9 +38,12 @@ public:
 private:
     RealtimeFrameSet render_profiled_smoke_frame_impl(int active_cameras,
         const RenderProfile& profile, bool pose_jump);
+    RealtimeBackend backend_ = RealtimeBackend::optix;
+    int cpu_renderer_count_ = 1;
     std::array<int, 4> history_lengths_ {};
     std::array<std::unique_ptr<OptixRenderer>, 4> renderers_ {};
     std::array<bool, 4> scene_prepared_ {};
+    std::unique_ptr<CpuRendererPool> cpu_pool_;
 };
 
 } // namespace rt
@@ -72,13 +72,18 @@ CameraRig default_camera_rig_for_scene(std::string_view scene_id, int camera_cou
     if (!realtime_scene_supported(scene_id)) {
         throw std::invalid_argument("unsupported realtime scene");
     }
+    return camera_rig_for_preset(require_realtime_view_preset(scene_id), camera_count, width, height);
+}
+
+CameraRig camera_rig_for_preset(
+    const scene::RealtimeViewPreset& preset, int camera_count, int width, int height) {
     if (camera_count < 1 || camera_count > 4) {
         throw std::invalid_argument("camera_count must be in [1, 4]");
     }
     if (width <= 0 || height <= 0) {
         throw std::invalid_argument("camera rig dimensions must be positive");
     }
-    return make_camera_rig_from_preset(require_realtime_view_preset(scene_id), camera_count, width, height);
+    return make_camera_rig_from_preset(preset, camera_count, width, height);
 }
 
 viewer::BodyPose default_spawn_pose_for_scene(std::string_view scene_id) {
@@ -3,6 +3,7 @@
 #include "realtime/camera_rig.h"
 #include "realtime/scene_description.h"
 #include "realtime/viewer/body_pose.h"
+#include "scene/shared_scene_builders.h"
 
 #include <string_view>
 
@@ -11,6 +12,9 @@ namespace rt {
 bool realtime_scene_supported(std::string_view scene_id);
 SceneDescription make_realtime_scene(std::string_view scene_id);
 CameraRig default_camera_rig_for_scene(std::string_view scene_id, int camera_count, int width, int height);
+// The same rig from a preset already in hand, such as one read from a scene summary
+CameraRig camera_rig_for_preset(
+    const scene::RealtimeViewPreset& preset, int camera_count, int width, int height);
 viewer::ViewerFrameConvention viewer_frame_convention_for_scene(std::string_view scene_id);
 viewer::BodyPose default_spawn_pose_for_scene(std::string_view scene_id);
 double default_move_speed_for_scene(std::string_view scene_id);
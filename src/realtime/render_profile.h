@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/restir_di.h"
+#include "common/russian_roulette.h"
 
 #include <optional>
 #include <string>
@@ -11,7 +12,7 @@ struct RenderProfile {
     int samples_per_pixel = 1;
     int max_bounces = 4;
     bool enable_denoise = true;
-    int rr_start_bounce = 3;
+    int rr_start_bounce = kDefaultRussianRouletteStartBounce; // Negative disables roulette
     double accumulation_reset_rotation_deg = 2.0;
     double accumulation_reset_translation = 0.05;
     bool enable_restir_di = false;
@@ -1,79 +1,246 @@
 #include "realtime/scene_description.h"
 
+#include <Eigen/LU>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 
 namespace rt {
 
 namespace {
 
-int ensure_constant_texture(std::vector<TextureDesc>& textures, int texture_index,
-    const Eigen::Vector3d& color) {
-    if (texture_index >= 0) {
-        return texture_index;
+std::atomic<std::uint64_t> g_scene_generation {0};
+
+template<typename T>
+T& checked_element(std::vector<T>& values, int index, const char* kind) {
+    if (index < 0 || static_cast<std::size_t>(index) >= values.size()) {
+        throw std::out_of_range(std::string("scene ") + kind + " index out of range: "
+                                + std::to_string(index));
+    }
+    return values[static_cast<std::size_t>(index)];
+}
+
+// Restamps an array together with the one element that was added or replaced
+void stamp_element(std::uint64_t& array_generation, std::vector<std::uint64_t>& element_generations,
+    std::size_t index) {
+    array_generation = next_scene_generation();
+    if (element_generations.size() <= index) {
+        element_generations.resize(index + 1, 0);
+    }
+    element_generations[index] = array_generation;
+}
+
+void validate_triangle_mesh(const IndexedTriangleMesh& mesh) {
+    const std::size_t vertex_count = mesh.positions.size();
+    if ((!mesh.normals.empty() && mesh.normals.size() != vertex_count)
+        || (!mesh.texcoords.empty() && mesh.texcoords.size() != vertex_count)
+        || mesh.material_indices.size() != mesh.triangles.size()) {
+        throw std::invalid_argument("scene triangle mesh streams differ in length");
+    }
+    for (const std::array<std::uint32_t, 3>& triangle : mesh.triangles) {
+        for (const std::uint32_t vertex : triangle) {
+            if (vertex >= vertex_count) {
+                throw std::out_of_range("scene triangle mesh vertex index out of range: "
+                                        + std::to_string(vertex));
+            }
+        }
     }
-    textures.push_back(ConstantColorTextureDesc {.color = color});
-    return static_cast<int>(textures.size()) - 1;
 }
 
 } // namespace
 
+std::uint64_t next_scene_generation() {
+    return g_scene_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 int SceneDescription::add_texture(const TextureDesc& texture) {
     textures_.push_back(texture);
+    stamp_element(generations_.textures, generations_.texture_elements, textures_.size() - 1);
     return static_cast<int>(textures_.size()) - 1;
 }
 
 int SceneDescription::add_material(const MaterialDesc& material) {
-    MaterialDesc normalized = material;
-    std::visit(
-        [&](auto& value) {
-            using T = std::decay_t<decltype(value)>;
-            if constexpr (std::is_same_v<T, LambertianMaterial>) {
-                value.albedo_texture =
-                    ensure_constant_texture(textures_, value.albedo_texture, value.albedo);
-            } else if constexpr (std::is_same_v<T, MetalMaterial>) {
-                value.albedo_texture =
-                    ensure_constant_texture(textures_, value.albedo_texture, value.albedo);
-            } else if constexpr (std::is_same_v<T, DiffuseLightMaterial>) {
-                value.emission_texture =
-                    ensure_constant_texture(textures_, value.emission_texture, value.emission);
-            }
-        },
-        normalized);
-    materials_.push_back(normalized);
+    materials_.push_back(normalize_material(material));
+    stamp_element(generations_.materials, generations_.material_elements, materials_.size() - 1);
     return static_cast<int>(materials_.size()) - 1;
 }
 
 void SceneDescription::add_sphere(const SpherePrimitive& sphere) {
     spheres_.push_back(sphere);
+    stamp_element(generations_.spheres, generations_.sphere_elements, spheres_.size() - 1);
 }
 
 void SceneDescription::add_quad(const QuadPrimitive& quad) {
     quads_.push_back(quad);
+    stamp_element(generations_.quads, generations_.quad_elements, quads_.size() - 1);
 }
 
 void SceneDescription::add_triangle(const TrianglePrimitive& triangle) {
     triangles_.push_back(triangle);
+    stamp_element(generations_.triangles, generations_.triangle_elements, triangles_.size() - 1);
+}
+
+void SceneDescription::add_triangle_mesh(IndexedTriangleMesh mesh) {
+    validate_triangle_mesh(mesh);
+    triangle_meshes_.push_back(std::move(mesh));
+    stamp_element(generations_.triangles, generations_.triangle_mesh_elements,
+        triangle_meshes_.size() - 1);
+}
+
+int SceneDescription::add_mesh_prototype(const MeshPrototype& prototype) {
+    validate_triangle_mesh(prototype.mesh);
+    mesh_prototypes_.push_back(prototype);
+    generations_.mesh_prototypes = next_scene_generation();
+    return static_cast<int>(mesh_prototypes_.size()) - 1;
+}
+
+void SceneDescription::add_mesh_instance(const MeshInstance& instance) {
+    mesh_instances_.push_back(checked_mesh_instance(instance));
+    stamp_element(generations_.mesh_instances, generations_.mesh_instance_elements,
+        mesh_instances_.size() - 1);
 }
 
 void SceneDescription::add_medium(const HomogeneousMediumPrimitive& medium) {
     media_.push_back(medium);
+    stamp_element(generations_.media, generations_.medium_elements, media_.size() - 1);
 }
 
 void SceneDescription::add_analytic_light(const AnalyticLightDesc& light) {
     analytic_lights_.push_back(light);
+    generations_.analytic_lights = next_scene_generation();
+}
+
+void SceneDescription::set_texture(int index, const TextureDesc& texture) {
+    checked_element(textures_, index, "texture") = texture;
+    stamp_element(generations_.textures, generations_.texture_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_material(int index, const MaterialDesc& material) {
+    checked_element(materials_, index, "material");
+    materials_[static_cast<std::size_t>(index)] = normalize_material(material);
+    stamp_element(generations_.materials, generations_.material_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_sphere(int index, const SpherePrimitive& sphere) {
+    checked_element(spheres_, index, "sphere") = sphere;
+    stamp_element(generations_.spheres, generations_.sphere_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_quad(int index, const QuadPrimitive& quad) {
+    checked_element(quads_, index, "quad") = quad;
+    stamp_element(generations_.quads, generations_.quad_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_triangle(int index, const TrianglePrimitive& triangle) {
+    checked_element(triangles_, index, "triangle") = triangle;
+    stamp_element(generations_.triangles, generations_.triangle_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_mesh_instance(int index, const MeshInstance& instance) {
+    checked_element(mesh_instances_, index, "mesh instance") = checked_mesh_instance(instance);
+    stamp_element(generations_.mesh_instances, generations_.mesh_instance_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_medium(int index, const HomogeneousMediumPrimitive& medium) {
+    checked_element(media_, index, "medium") = medium;
+    stamp_element(generations_.media, generations_.medium_elements,
+        static_cast<std::size_t>(index));
+}
+
+void SceneDescription::set_analytic_light(int index, const AnalyticLightDesc& light) {
+    checked_element(analytic_lights_, index, "analytic light") = light;
+    generations_.analytic_lights = next_scene_generation();
 }
 
 const std::vector<TrianglePrimitive>& SceneDescription::triangles() const {
     return triangles_;
 }
 
+const std::vector<IndexedTriangleMesh>& SceneDescription::triangle_meshes() const {
+    return triangle_meshes_;
+}
+
+const std::vector<MeshPrototype>& SceneDescription::mesh_prototypes() const {
+    return mesh_prototypes_;
+}
+
+const std::vector<MeshInstance>& SceneDescription::mesh_instances() const {
+    return mesh_instances_;
+}
+
+const SceneGenerations& SceneDescription::generations() const {
+    return generations_;
+}
+
+const MeshInstance& SceneDescription::checked_mesh_instance(const MeshInstance& instance) const {
+    if (instance.prototype_index < 0
+        || static_cast<std::size_t>(instance.prototype_index) >= mesh_prototypes_.size()) {
+        throw std::out_of_range("scene mesh prototype index out of range: "
+                                + std::to_string(instance.prototype_index));
+    }
+    const double determinant = instance.linear.determinant();
+    if (!std::isfinite(determinant) || std::abs(determinant) <= 1e-12
+        || !instance.translation.allFinite()) {
+        throw std::invalid_argument("scene mesh instance transform must be invertible");
+    }
+    return instance;
+}
+
+MaterialDesc SceneDescription::normalize_material(const MaterialDesc& material) {
+    const std::size_t texture_count = textures_.size();
+    const auto ensure_constant_texture = [this](int texture_index, const Eigen::Vector3d& color) {
+        if (texture_index >= 0) {
+            return texture_index;
+        }
+        textures_.push_back(ConstantColorTextureDesc {.color = color});
+        return static_cast<int>(textures_.size()) - 1;
+    };
+
+    MaterialDesc normalized = material;
+    std::visit(
+        [&](auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, LambertianMaterial>) {
+                value.albedo_texture = ensure_constant_texture(value.albedo_texture, value.albedo);
+            } else if constexpr (std::is_same_v<T, MetalMaterial>) {
+                value.albedo_texture = ensure_constant_texture(value.albedo_texture, value.albedo);
+            } else if constexpr (std::is_same_v<T, DiffuseLightMaterial>) {
+                value.emission_texture =
+                    ensure_constant_texture(value.emission_texture, value.emission);
+            }
+        },
+        normalized);
+    for (std::size_t texture = texture_count; texture < textures_.size(); ++texture) {
+        stamp_element(generations_.textures, generations_.texture_elements, texture);
+    }
+    return normalized;
+}
+
 PackedScene SceneDescription::pack() const {
+    std::size_t triangle_count = triangles_.size();
+    for (const IndexedTriangleMesh& mesh : triangle_meshes_) {
+        triangle_count += mesh.triangles.size();
+    }
     return PackedScene {
         .texture_count = static_cast<int>(textures_.size()),
         .material_count = static_cast<int>(materials_.size()),
         .sphere_count = static_cast<int>(spheres_.size()),
         .quad_count = static_cast<int>(quads_.size()),
-        .triangle_count = static_cast<int>(triangles_.size()),
+        .triangle_count = static_cast<int>(triangle_count),
+        .triangle_mesh_count = static_cast<int>(triangle_meshes_.size()),
+        .mesh_prototype_count = static_cast<int>(mesh_prototypes_.size()),
+        .mesh_instance_count = static_cast<int>(mesh_instances_.size()),
         .medium_count = static_cast<int>(media_.size()),
         .analytic_light_count = static_cast<int>(analytic_lights_.size()),
         .background = background,
@@ -82,8 +249,12 @@ PackedScene SceneDescription::pack() const {
         .spheres = spheres_,
         .quads = quads_,
         .triangles = triangles_,
+        .triangle_meshes = triangle_meshes_,
+        .mesh_prototypes = mesh_prototypes_,
+        .mesh_instances = mesh_instances_,
         .media = media_,
         .analytic_lights = analytic_lights_,
+        .generations = generations_,
     };
 }
 
@@ -5,6 +5,8 @@
 
 #include <Eigen/Core>
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <variant>
 #include <vector>
@@ -116,6 +118,41 @@ struct TrianglePrimitive {
     int acceleration_instance_id = -1;
 };
 
+// Triangles over shared vertex streams, indexed the way the source mesh indexes its points so
+// that preparation copies the streams instead of welding corners. Positions are stored in float
+// and the optional normals and texcoords already in their packed encodings from
+// common/vertex_quantization.h, one per vertex. A negative triangle material index stands for the
+// material of the placing instance.
+struct IndexedTriangleMesh {
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<std::uint32_t> normals;    // Octahedral unit normals, or empty
+    std::vector<std::uint32_t> texcoords;  // Pairs of halves, or empty
+    std::vector<std::array<std::uint32_t, 3>> triangles;
+    std::vector<int> material_indices;  // One per triangle
+    int acceleration_prototype_id = -1;
+    int acceleration_instance_id = -1;
+};
+
+// Object-space triangles stored once and placed by any number of MeshInstances. A negative
+// triangle material index stands for the material of the placing instance. Soup triangles come
+// first, then the indexed mesh.
+struct MeshPrototype {
+    std::vector<TrianglePrimitive> triangles;
+    IndexedTriangleMesh mesh;
+};
+
+// One placement of a MeshPrototype under an invertible affine transform. Instanced triangles are
+// not sampled as lights, so emissive meshes are added as world-space triangles instead.
+struct MeshInstance {
+    int prototype_index = -1;
+    int material_index = -1;
+    Eigen::Matrix3d linear = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+    bool dynamic = false;
+    int acceleration_prototype_id = -1;
+    int acceleration_instance_id = -1;
+};
+
 struct HomogeneousMediumPrimitive {
     int material_index = -1;
     double density = 0.0;
@@ -127,12 +164,45 @@ struct HomogeneousMediumPrimitive {
     Eigen::Vector3d translation = Eigen::Vector3d::Zero();
 };
 
+// Change stamps for each array of a scene. Every mutation stamps the arrays it touches with a fresh
+// value from one process-wide sequence, so equal stamps imply equal contents, also across copies,
+// and consumers can skip unchanged arrays without reading them. Zero means untracked: the array
+// must be compared by content.
+struct SceneGenerations {
+    std::uint64_t textures = 0;
+    std::uint64_t materials = 0;
+    std::uint64_t spheres = 0;
+    std::uint64_t quads = 0;
+    std::uint64_t triangles = 0;
+    std::uint64_t mesh_prototypes = 0;
+    std::uint64_t mesh_instances = 0;
+    std::uint64_t media = 0;
+    std::uint64_t analytic_lights = 0;
+    // Stamp of the last add or set of each element, for the arrays that are edited in place.
+    // Consumers compare these instead of rehashing a whole array whose stamp moved; a list that is
+    // out of step with its array counts as untracked.
+    std::vector<std::uint64_t> texture_elements;
+    std::vector<std::uint64_t> material_elements;
+    std::vector<std::uint64_t> sphere_elements;
+    std::vector<std::uint64_t> quad_elements;
+    std::vector<std::uint64_t> triangle_elements;
+    // Indexed meshes are world-space triangles too: adding one restamps `triangles`
+    std::vector<std::uint64_t> triangle_mesh_elements;
+    std::vector<std::uint64_t> mesh_instance_elements;
+    std::vector<std::uint64_t> medium_elements;
+};
+
+std::uint64_t next_scene_generation();
+
 struct PackedScene {
     int texture_count = 0;
     int material_count = 0;
     int sphere_count = 0;
     int quad_count = 0;
-    int triangle_count = 0;
+    int triangle_count = 0;  // World triangles, soup and indexed meshes together
+    int triangle_mesh_count = 0;
+    int mesh_prototype_count = 0;
+    int mesh_instance_count = 0;
     int medium_count = 0;
     int analytic_light_count = 0;
     Eigen::Vector3d background = Eigen::Vector3d::Zero();
@@ -141,8 +211,14 @@ struct PackedScene {
     std::vector<SpherePrimitive> spheres;
     std::vector<QuadPrimitive> quads;
     std::vector<TrianglePrimitive> triangles;
+    std::vector<IndexedTriangleMesh> triangle_meshes;
+    std::vector<MeshPrototype> mesh_prototypes;
+    std::vector<MeshInstance> mesh_instances;
     std::vector<HomogeneousMediumPrimitive> media;
     std::vector<AnalyticLightDesc> analytic_lights;
+    // Stamps from the SceneDescription this was packed from. Code that edits the arrays of a
+    // packed scene in place must zero the matching stamps.
+    SceneGenerations generations;
 };
 
 class SceneDescription {
@@ -152,21 +228,47 @@ public:
     void add_sphere(const SpherePrimitive& sphere);
     void add_quad(const QuadPrimitive& quad);
     void add_triangle(const TrianglePrimitive& triangle);
+    // Throws for streams of mismatched lengths or out-of-range vertex indices, as does
+    // add_mesh_prototype for its indexed mesh.
+    void add_triangle_mesh(IndexedTriangleMesh mesh);
+    int add_mesh_prototype(const MeshPrototype& prototype);
+    // Throws for an unknown prototype or a singular transform, as does set_mesh_instance.
+    void add_mesh_instance(const MeshInstance& instance);
     void add_medium(const HomogeneousMediumPrimitive& medium);
     void add_analytic_light(const AnalyticLightDesc& light);
+    // In-place edits for animation and live editing; indices out of range throw.
+    void set_texture(int index, const TextureDesc& texture);
+    void set_material(int index, const MaterialDesc& material);
+    void set_sphere(int index, const SpherePrimitive& sphere);
+    void set_quad(int index, const QuadPrimitive& quad);
+    void set_triangle(int index, const TrianglePrimitive& triangle);
+    void set_mesh_instance(int index, const MeshInstance& instance);
+    void set_medium(int index, const HomogeneousMediumPrimitive& medium);
+    void set_analytic_light(int index, const AnalyticLightDesc& light);
     const std::vector<TrianglePrimitive>& triangles() const;
+    const std::vector<IndexedTriangleMesh>& triangle_meshes() const;
+    const std::vector<MeshPrototype>& mesh_prototypes() const;
+    const std::vector<MeshInstance>& mesh_instances() const;
+    const SceneGenerations& generations() const;
     PackedScene pack() const;
 
     Eigen::Vector3d background = Eigen::Vector3d::Zero();
 
 private:
+    MaterialDesc normalize_material(const MaterialDesc& material);
+    const MeshInstance& checked_mesh_instance(const MeshInstance& instance) const;
+
     std::vector<TextureDesc> textures_;
     std::vector<MaterialDesc> materials_;
     std::vector<SpherePrimitive> spheres_;
     std::vector<QuadPrimitive> quads_;
     std::vector<TrianglePrimitive> triangles_;
+    std::vector<IndexedTriangleMesh> triangle_meshes_;
+    std::vector<MeshPrototype> mesh_prototypes_;
+    std::vector<MeshInstance> mesh_instances_;
     std::vector<HomogeneousMediumPrimitive> media_;
     std::vector<AnalyticLightDesc> analytic_lights_;
+    SceneGenerations generations_ {};
 };
 
 } // namespace rt
@@ -1,11 +1,14 @@
 #include "scene/analytic_light_compiler.h"
 
+#include "common/alias_table.h"
+
 #include <Eigen/Geometry>
 
 #include <algorithm>
 #include <array>
 #include <cmath>
 #include <iterator>
+#include <memory>
 #include <numbers>
 #include <stdexcept>
 #include <string_view>
@@ -36,6 +39,17 @@ void finalize_analytic_light_distribution(std::vector<AnalyticLightDesc>& lights
             lights[i].cdf = 1.0;
         }
     }
+
+    std::vector<double> weights;
+    weights.reserve(lights.size());
+    for (const AnalyticLightDesc& light : lights) {
+        weights.push_back(light.selection_weight);
+    }
+    const std::vector<AliasTableEntry> table = build_alias_table(weights);
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        lights[i].alias_probability = table[i].probability;
+        lights[i].alias = table[i].alias;
+    }
 }
 
 } // namespace rt
@@ -243,18 +257,19 @@ AnalyticLightDesc compile_light(const ScenePrim& prim, const SceneLight& light,
 std::vector<AnalyticLightDesc> compile_analytic_lights(const SceneIRv2& scene) {
     require_valid_scene_ir_v2(scene);
     std::vector<AnalyticLightDesc> out;
-    const double time_code = scene.stage_metadata().start_time_code.value_or(0.0);
-    for (const ScenePrim& prim : scene.prims()) {
+    const std::shared_ptr<const SceneHierarchyEvaluation> hierarchy =
+        scene.evaluate_hierarchy(scene.stage_metadata().start_time_code.value_or(0.0));
+    for (std::size_t index = 0; index < scene.prims().size(); ++index) {
+        const ScenePrim& prim = scene.prims()[index];
         if (!prim.light || prim.light->type == SceneLightType::geometry
-            || !compute_scene_visibility(scene, prim.path)) {
+            || hierarchy->visible[index] == 0) {
             continue;
         }
-        const ScenePurpose purpose = compute_scene_purpose(scene, prim.path);
+        const ScenePurpose purpose = hierarchy->purposes[index];
         if (purpose == ScenePurpose::proxy || purpose == ScenePurpose::guide) {
             continue;
         }
-        out.push_back(compile_light(prim, *prim.light,
-            compute_scene_world_transform(scene, prim.path, time_code)));
+        out.push_back(compile_light(prim, *prim.light, hierarchy->world_transforms[index]));
     }
     finalize_analytic_light_distribution(out);
     return out;
@@ -1,6 +1,7 @@
 #include "scene/cpu_scene_adapter.h"
 
 #include "scene/analytic_light_compiler.h"
+#include "common/bvh.h"
 #include "common/common.h"
 #include "common/constant_medium.h"
 #include "common/hittable.h"
@@ -9,16 +10,21 @@
 #include "common/quad.h"
 #include "common/sphere.h"
 #include "common/texture.h"
-#include "common/triangle.h"
+#include "common/texture_cache.h"
+#include "common/triangle_mesh.h"
 #include "scene/openpbr_core_adapter.h"
 #include "scene/scene_ir_validator.h"
 
 #include <Eigen/Geometry>
 
 #include <cmath>
+#include <iostream>
+#include <map>
 #include <optional>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace rt::scene {
@@ -28,42 +34,21 @@ Vec3d to_vec3(const Eigen::Vector3d& v) {
     return Vec3d {v.x(), v.y(), v.z()};
 }
 
-double extract_y_rotation_degrees(const Eigen::Matrix3d& rotation) {
-    constexpr double kTol = 1e-6;
-    if ((rotation - Eigen::Matrix3d::Identity()).cwiseAbs().maxCoeff() <= kTol) {
-        return 0.0;
+pro::proxy<Hittable> apply_transform(const pro::proxy<Hittable>& prototype,
+    const Transform& transform) {
+    // Untransformed objects are hit directly; everything else references the prototype through
+    // an instance carrying the full affine transform
+    constexpr double kTol = 1e-12;
+    if ((transform.rotation - Eigen::Matrix3d::Identity()).cwiseAbs().maxCoeff() <= kTol
+        && transform.translation.cwiseAbs().maxCoeff() <= kTol) {
+        return prototype;
     }
-
-    const bool is_supported = std::abs(rotation(0, 1)) <= kTol && std::abs(rotation(1, 0)) <= kTol
-                              && std::abs(rotation(1, 2)) <= kTol
-                              && std::abs(rotation(2, 1)) <= kTol
-                              && std::abs(rotation(1, 1) - 1.0) <= kTol;
-    if (!is_supported) {
-        throw std::invalid_argument("unsupported transform rotation for CPU adapter");
-    }
-
-    const double angle = std::atan2(rotation(0, 2), rotation(0, 0));
-    if (std::abs(rotation(2, 0) + std::sin(angle)) > 1e-4
-        || std::abs(rotation(2, 2) - std::cos(angle)) > 1e-4) {
-        throw std::invalid_argument("unsupported transform rotation for CPU adapter");
-    }
-    return rad2deg(angle);
-}
-
-pro::proxy<Hittable> apply_transform(pro::proxy<Hittable> object, const Transform& transform) {
-    const double yaw_deg = extract_y_rotation_degrees(transform.rotation);
-    if (std::abs(yaw_deg) > 1e-9) {
-        object = pro::make_proxy_shared<Hittable, RotateY>(object, yaw_deg);
-    }
-    if (transform.translation.norm() > 1e-9) {
-        object =
-            pro::make_proxy_shared<Hittable, Translate>(object, to_vec3(transform.translation));
-    }
-    return object;
+    return pro::make_proxy_shared<Hittable, Instance>(prototype, transform.rotation,
+        to_vec3(transform.translation));
 }
 
 pro::proxy<Hittable> make_shape_hittable(const ShapeDesc& shape,
-    const pro::proxy<Material>& material) {
+    const pro::proxy<Material>& material, const CpuSceneAdapterOptions& options) {
     return std::visit(
         [&](const auto& desc) -> pro::proxy<Hittable> {
             using T = std::decay_t<decltype(desc)>;
@@ -76,13 +61,20 @@ pro::proxy<Hittable> make_shape_hittable(const ShapeDesc& shape,
             } else if constexpr (std::is_same_v<T, BoxShape>) {
                 return box(to_vec3(desc.min_corner), to_vec3(desc.max_corner), material);
             } else if constexpr (std::is_same_v<T, TriangleMeshShape>) {
-                HittableList mesh_world;
-                for (const Eigen::Vector3i& tri : desc.triangles) {
-                    mesh_world.add(pro::make_proxy_shared<Hittable, Triangle>(
-                        to_vec3(desc.positions[tri.x()]), to_vec3(desc.positions[tri.y()]),
-                        to_vec3(desc.positions[tri.z()]), material));
+                TriangleMeshData data {
+                    .positions = desc.positions,
+                    .triangles = desc.triangles,
+                    .normals = desc.normals,
+                    .normal_indices = desc.normal_indices,
+                    .texcoords = desc.texcoords,
+                    .texcoord_indices = desc.texcoord_indices,
+                };
+                if (options.geometry_precision == CpuGeometryPrecision::single_precision) {
+                    return pro::make_proxy_shared<Hittable, TriangleMeshF>(std::move(data),
+                        material, options.bvh);
                 }
-                return pro::make_proxy_shared<Hittable, HittableList>(mesh_world);
+                return pro::make_proxy_shared<Hittable, TriangleMesh>(std::move(data), material,
+                    options.bvh);
             } else {
                 static_assert(std::is_same_v<T, void>, "unsupported shape type");
             }
@@ -93,10 +85,20 @@ pro::proxy<Hittable> make_shape_hittable(const ShapeDesc& shape,
 } // namespace
 
 CpuSceneAdapterResult adapt_to_cpu_impl(const SceneIR& scene,
-    const std::vector<std::optional<OpenPbrCompiledMaterial>>* openpbr_materials) {
+    const std::vector<std::optional<OpenPbrCompiledMaterial>>* openpbr_materials,
+    const CpuSceneAdapterOptions& options) {
     validate_scene_ir(scene);
 
     const std::vector<TextureDesc>& texture_descs = scene.textures();
+    std::vector<std::string> image_paths;
+    for (const TextureDesc& texture_desc : texture_descs) {
+        if (const auto* image = std::get_if<ImageTextureDesc>(&texture_desc)) {
+            image_paths.push_back(image->path);
+        }
+    }
+    const std::vector<DecodedTextureHandle> images = global_texture_cache().load_all(image_paths);
+    std::size_t next_image = 0;
+
     std::vector<pro::proxy<Texture>> textures;
     textures.reserve(texture_descs.size());
     for (const TextureDesc& texture_desc : texture_descs) {
@@ -112,7 +114,12 @@ CpuSceneAdapterResult adapt_to_cpu_impl(const SceneIR& scene,
                         textures[static_cast<std::size_t>(desc.odd_texture)];
                     return pro::make_proxy_shared<Texture, CheckerTexture>(desc.scale, even, odd);
                 } else if constexpr (std::is_same_v<T, ImageTextureDesc>) {
-                    return pro::make_proxy_shared<Texture, ImageTexture>(desc.path);
+                    const DecodedTextureHandle& image = images[next_image++];
+                    if (image == nullptr) {
+                        // Missing images render magenta rather than failing the whole scene
+                        std::cerr << "image texture could not be loaded: " << desc.path << '\n';
+                    }
+                    return pro::make_proxy_shared<Texture, ImageTexture>(image);
                 } else if constexpr (std::is_same_v<T, NoiseTextureDesc>) {
                     return pro::make_proxy_shared<Texture, NoiseTexture>(desc.scale);
                 } else {
@@ -177,19 +184,32 @@ CpuSceneAdapterResult adapt_to_cpu_impl(const SceneIR& scene,
     }
 
     const std::vector<ShapeDesc>& shape_descs = scene.shapes();
-    HittableList world;
+    std::vector<pro::proxy<Hittable>> world;
     HittableList lights;
 
+    // One prototype per shape and material, built on first use; a mesh placed many times keeps a
+    // single copy of its triangles and bottom-level BVH
+    std::map<std::pair<int, int>, pro::proxy<Hittable>> prototypes;
+    const auto prototype_for = [&](const int shape_index, const int material_index,
+                                   const pro::proxy<Material>& material) {
+        auto [it, inserted] = prototypes.try_emplace({shape_index, material_index});
+        if (inserted) {
+            it->second = make_shape_hittable(
+                shape_descs[static_cast<std::size_t>(shape_index)], material, options);
+        }
+        return it->second;
+    };
+
     for (const SurfaceInstance& instance : scene.surface_instances()) {
-        const ShapeDesc& shape_desc = shape_descs[static_cast<std::size_t>(instance.shape_index)];
         const MaterialDesc& material_desc =
             material_descs[static_cast<std::size_t>(instance.material_index)];
         const pro::proxy<Material>& material =
             materials[static_cast<std::size_t>(instance.material_index)];
 
-        pro::proxy<Hittable> object = make_shape_hittable(shape_desc, material);
-        object = apply_transform(object, instance.transform);
-        world.add(object);
+        const pro::proxy<Hittable> object = apply_transform(
+            prototype_for(instance.shape_index, instance.material_index, material),
+            instance.transform);
+        world.push_back(object);
 
         const bool openpbr_emissive =
             openpbr_materials != nullptr
@@ -216,32 +236,34 @@ CpuSceneAdapterResult adapt_to_cpu_impl(const SceneIR& scene,
                 "triangle mesh boundaries are unsupported for homogeneous media");
         }
 
-        pro::proxy<Hittable> boundary = make_shape_hittable(shape_desc, empty_material);
-        boundary = apply_transform(boundary, medium.transform);
+        // Boundaries carry no material, so media share them across material indices
+        const pro::proxy<Hittable> boundary = apply_transform(
+            prototype_for(medium.shape_index, -1, empty_material), medium.transform);
 
         const pro::proxy<Texture>& albedo =
             textures[static_cast<std::size_t>(isotropic->albedo_texture)];
-        world.add(
+        world.push_back(
             pro::make_proxy_shared<Hittable, ConstantMedium>(boundary, medium.density, albedo));
     }
 
     CpuSceneAdapterResult result;
-    result.world = pro::make_proxy_shared<Hittable, HittableList>(world);
+    result.prototype_count = prototypes.size();
+    result.world = pro::make_proxy_shared<Hittable, BVH>(std::move(world), options.bvh);
     if (!lights.m_objects.empty()) {
         result.lights = pro::make_proxy_shared<Hittable, HittableList>(lights);
     }
     return result;
 }
 
-CpuSceneAdapterResult adapt_to_cpu(const SceneIR& scene) {
-    return adapt_to_cpu_impl(scene, nullptr);
+CpuSceneAdapterResult adapt_to_cpu(const SceneIR& scene, const CpuSceneAdapterOptions& options) {
+    return adapt_to_cpu_impl(scene, nullptr, options);
 }
 
 CpuSceneAdapterResult adapt_to_cpu_openpbr(const SceneIR& compatibility_scene,
-    const SceneIRv2& scene_v2) {
+    const SceneIRv2& scene_v2, const CpuSceneAdapterOptions& options) {
     const auto materials = compile_openpbr_core_material_table(scene_v2,
         compatibility_scene.materials().size(), compatibility_scene.textures().size());
-    CpuSceneAdapterResult result = adapt_to_cpu_impl(compatibility_scene, &materials);
+    CpuSceneAdapterResult result = adapt_to_cpu_impl(compatibility_scene, &materials, options);
     result.analytic_lights = compile_analytic_lights(scene_v2);
     return result;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/analytic_light.h"
+#include "common/bvh_builder.h"
 #include "common/traits.h"
 #include "scene/scene_ir_v2.h"
 #include "scene/shared_scene_ir.h"
@@ -11,10 +12,25 @@ struct CpuSceneAdapterResult {
     pro::proxy<Hittable> world;
     pro::proxy<Hittable> lights;
     std::vector<AnalyticLightDesc> analytic_lights;
+    std::size_t prototype_count = 0; // Distinct shape hierarchies the world's instances reference
 };
 
-CpuSceneAdapterResult adapt_to_cpu(const SceneIR& scene);
+// Precision triangle meshes store and intersect their vertices in. Only mesh vertices change:
+// rays, hit records, the instance hierarchy and shading stay double in both modes.
+enum class CpuGeometryPrecision {
+    double_precision, // Reference mode
+    single_precision, // Half the vertex memory; intersections round like the GPU's
+};
+
+struct CpuSceneAdapterOptions {
+    // Applied to the top-level hierarchy over instances and to every triangle-mesh prototype.
+    BvhBuildOptions bvh {};
+    CpuGeometryPrecision geometry_precision = CpuGeometryPrecision::double_precision;
+};
+
+CpuSceneAdapterResult adapt_to_cpu(const SceneIR& scene,
+    const CpuSceneAdapterOptions& options = {});
 CpuSceneAdapterResult adapt_to_cpu_openpbr(const SceneIR& compatibility_scene,
-    const SceneIRv2& scene_v2);
+    const SceneIRv2& scene_v2, const CpuSceneAdapterOptions& options = {});
 
 } // namespace rt::scene
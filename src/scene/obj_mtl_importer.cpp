@@ -4,14 +4,31 @@
 #include <tiny_obj_loader.h>
 
 #include <Eigen/Core>
+#include <tbb/parallel_for.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <optional>
+#include <span>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace rt::scene {
@@ -19,44 +36,346 @@ namespace {
 
 using DependencySet = std::unordered_set<std::string>;
 
-struct ObjTriangle {
-    Eigen::Vector3i positions = Eigen::Vector3i::Constant(-1);
-    Eigen::Vector3i normals = Eigen::Vector3i::Constant(-1);
-    Eigen::Vector3i texcoords = Eigen::Vector3i::Constant(-1);
+// Large enough to amortize a task, small enough to keep every core busy on mid-sized files
+constexpr std::size_t kChunkBytes = std::size_t {8} << 20;
+constexpr std::int64_t kMissingIndex = -1;
+// Negative OBJ indices count back from the latest element, which a chunk only knows relative to
+// its own first element. They are stored offset by this bias until the chunk bases are known.
+constexpr std::int64_t kChunkRelativeBias = std::numeric_limits<std::int64_t>::min() / 2;
+
+struct ObjCorner {
+    std::int64_t position = kMissingIndex;
+    std::int64_t texcoord = kMissingIndex;
+    std::int64_t normal = kMissingIndex;
 };
 
-void append_dependency(std::vector<std::string>& dependencies, DependencySet& seen, const std::filesystem::path& path) {
-    const std::string normalized = path.lexically_normal().string();
-    if (seen.insert(normalized).second) {
-        dependencies.push_back(normalized);
+struct ObjMaterialSwitch {
+    std::size_t first_triangle = 0;
+    std::string name;
+};
+
+struct ObjChunk {
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<Eigen::Vector3d> normals;
+    std::vector<Eigen::Vector2d> texcoords;
+    std::vector<ObjCorner> corners;  // Three per triangle, polygons fanned
+    std::vector<ObjMaterialSwitch> material_switches;
+    std::vector<std::string> mtllibs;
+    std::size_t line_count = 0;
+    std::optional<std::pair<std::size_t, std::string>> error;  // First failing line in the chunk
+};
+
+// Triangles [first, last) of one chunk that share a material
+struct ObjTriangleRun {
+    std::size_t chunk = 0;
+    std::size_t first = 0;
+    std::size_t last = 0;
+};
+
+class MappedObjFile {
+   public:
+    explicit MappedObjFile(const std::filesystem::path& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open obj file");
+        }
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error("failed to stat obj file");
+        }
+        size_ = static_cast<std::size_t>(status.st_size);
+        if (size_ > 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("failed to map obj file");
+        }
+        if (data_ != nullptr) {
+            ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    MappedObjFile(const MappedObjFile&) = delete;
+    MappedObjFile& operator=(const MappedObjFile&) = delete;
+
+    ~MappedObjFile() {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    std::string_view text() const {
+        return data_ != nullptr ? std::string_view {static_cast<const char*>(data_), size_}
+                                : std::string_view {};
+    }
+
+   private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && is_space(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && is_space(text.back())) {
+        text.remove_suffix(1);
     }
+    return text;
 }
 
-std::vector<std::filesystem::path> referenced_mtl_files(const std::filesystem::path& obj_file) {
-    std::ifstream stream(obj_file);
-    if (!stream) {
-        throw std::runtime_error("failed to open obj file");
+std::string_view next_token(std::string_view& line) {
+    line = trim(line);
+    std::size_t end = 0;
+    while (end < line.size() && !is_space(line[end])) {
+        ++end;
     }
+    const std::string_view token = line.substr(0, end);
+    line.remove_prefix(end);
+    return token;
+}
 
-    std::vector<std::filesystem::path> result;
-    std::unordered_set<std::string> seen;
-    std::string keyword;
-    while (stream >> keyword) {
-        if (keyword == "mtllib") {
-            std::string mtl_name;
-            std::getline(stream >> std::ws, mtl_name);
-            if (!mtl_name.empty()) {
-                const std::filesystem::path mtl_path = (obj_file.parent_path() / mtl_name).lexically_normal();
-                if (seen.insert(mtl_path.string()).second) {
-                    result.push_back(mtl_path);
-                }
+double parse_real(std::string_view token) {
+    if (!token.empty() && token.front() == '+') {
+        token.remove_prefix(1);
+    }
+    double value = 0.0;
+    const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (token.empty() || error != std::errc {} || end != token.data() + token.size()) {
+        throw std::runtime_error("invalid number '" + std::string(token) + "'");
+    }
+    return value;
+}
+
+double parse_real_or(std::string_view& line, double fallback) {
+    const std::string_view token = next_token(line);
+    return token.empty() ? fallback : parse_real(token);
+}
+
+std::int64_t parse_index(std::string_view token, std::size_t local_count) {
+    std::int64_t index = 0;
+    const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), index);
+    if (token.empty() || error != std::errc {} || end != token.data() + token.size()) {
+        throw std::runtime_error("invalid face index '" + std::string(token) + "'");
+    }
+    if (index > 0) {
+        return index - 1;
+    }
+    if (index < -static_cast<std::int64_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("obj index out of range");
+    }
+    if (index < 0) {
+        return kChunkRelativeBias + static_cast<std::int64_t>(local_count) + index;
+    }
+    throw std::runtime_error("obj indices start at 1");
+}
+
+ObjCorner parse_corner(std::string_view token, const ObjChunk& chunk) {
+    ObjCorner corner;
+    const std::size_t first_slash = token.find('/');
+    corner.position = parse_index(token.substr(0, first_slash), chunk.positions.size());
+    if (first_slash == std::string_view::npos) {
+        return corner;
+    }
+    const std::string_view rest = token.substr(first_slash + 1);
+    const std::size_t second_slash = rest.find('/');
+    const std::string_view texcoord = rest.substr(0, second_slash);
+    if (!texcoord.empty()) {
+        corner.texcoord = parse_index(texcoord, chunk.texcoords.size());
+    }
+    if (second_slash != std::string_view::npos) {
+        corner.normal = parse_index(rest.substr(second_slash + 1), chunk.normals.size());
+    }
+    return corner;
+}
+
+void parse_line(std::string_view line, ObjChunk& chunk, std::vector<ObjCorner>& polygon) {
+    const std::string_view keyword = next_token(line);
+    if (keyword == "v") {
+        const double x = parse_real(next_token(line));
+        const double y = parse_real(next_token(line));
+        chunk.positions.push_back(Eigen::Vector3d {x, y, parse_real(next_token(line))});
+    } else if (keyword == "vn") {
+        const double x = parse_real(next_token(line));
+        const double y = parse_real(next_token(line));
+        chunk.normals.push_back(Eigen::Vector3d {x, y, parse_real(next_token(line))});
+    } else if (keyword == "vt") {
+        const double u = parse_real(next_token(line));
+        chunk.texcoords.push_back(Eigen::Vector2d {u, parse_real_or(line, 0.0)});
+    } else if (keyword == "f") {
+        polygon.clear();
+        for (std::string_view token = next_token(line); !token.empty(); token = next_token(line)) {
+            polygon.push_back(parse_corner(token, chunk));
+        }
+        if (polygon.size() < 3) {
+            throw std::runtime_error("faces need at least three vertices");
+        }
+        for (std::size_t i = 1; i + 1 < polygon.size(); ++i) {
+            chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[i], polygon[i + 1]});
+        }
+    } else if (keyword == "usemtl") {
+        chunk.material_switches.push_back(ObjMaterialSwitch {
+            .first_triangle = chunk.corners.size() / 3,
+            .name = std::string(trim(line)),
+        });
+    } else if (keyword == "mtllib") {
+        const std::string_view name = trim(line);
+        if (!name.empty()) {
+            chunk.mtllibs.emplace_back(name);
+        }
+    }
+}
+
+ObjChunk parse_chunk(std::string_view text) {
+    ObjChunk chunk;
+    std::vector<ObjCorner> polygon;
+    std::size_t cursor = 0;
+    while (cursor < text.size()) {
+        const std::size_t newline = text.find('\n', cursor);
+        const std::size_t end = newline == std::string_view::npos ? text.size() : newline;
+        ++chunk.line_count;
+        try {
+            parse_line(text.substr(cursor, end - cursor), chunk, polygon);
+        } catch (const std::exception& ex) {
+            chunk.error = std::pair {chunk.line_count, std::string(ex.what())};
+            return chunk;
+        }
+        cursor = end + 1;
+    }
+    return chunk;
+}
+
+// Chunk boundaries fall just after a newline, so no line straddles two chunks
+std::vector<std::string_view> split_lines_into_chunks(std::string_view text) {
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+    while (begin < text.size()) {
+        std::size_t end = std::min(text.size(), begin + kChunkBytes);
+        if (end < text.size()) {
+            const std::size_t newline = text.find('\n', end);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+std::vector<std::uint64_t> exclusive_prefix_sum(const std::vector<ObjChunk>& chunks,
+    std::size_t (*count)(const ObjChunk&)) {
+    std::vector<std::uint64_t> bases(chunks.size() + 1, 0);
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        bases[i + 1] = bases[i] + count(chunks[i]);
+    }
+    return bases;
+}
+
+std::int64_t resolve_index(std::int64_t index, std::uint64_t chunk_base, std::uint64_t total,
+    const char* kind) {
+    if (index == kMissingIndex) {
+        return index;
+    }
+    const std::int64_t resolved = index <= kChunkRelativeBias / 2
+                                      ? index - kChunkRelativeBias
+                                            + static_cast<std::int64_t>(chunk_base)
+                                      : index;
+    if (resolved < 0 || static_cast<std::uint64_t>(resolved) >= total) {
+        throw std::runtime_error(std::string("obj ") + kind + " index out of range");
+    }
+    return resolved;
+}
+
+// Finds the element behind a file-wide index among the per-chunk arrays
+template<typename T>
+const T& chunk_element(const std::vector<ObjChunk>& chunks, const std::vector<std::uint64_t>& bases,
+    std::vector<T> ObjChunk::*array, std::int64_t index) {
+    const auto index_u = static_cast<std::uint64_t>(index);
+    const auto upper = std::upper_bound(bases.begin(), bases.end(), index_u);
+    const std::size_t chunk = static_cast<std::size_t>(upper - bases.begin()) - 1;
+    return (chunks[chunk].*array)[static_cast<std::size_t>(index_u - bases[chunk])];
+}
+
+struct ObjCornerKeyHash {
+    std::size_t operator()(const ObjCorner& corner) const {
+        std::uint64_t hash = static_cast<std::uint64_t>(corner.position) * 0x9E3779B97F4A7C15ULL;
+        hash ^= static_cast<std::uint64_t>(corner.normal) + 0xFF51AFD7ED558CCDULL + (hash << 6)
+                + (hash >> 2);
+        hash ^= static_cast<std::uint64_t>(corner.texcoord) + 0xC4CEB9FE1A85EC53ULL + (hash << 6)
+                + (hash >> 2);
+        return static_cast<std::size_t>(hash);
+    }
+};
+
+struct ObjCornerKeyEqual {
+    bool operator()(const ObjCorner& a, const ObjCorner& b) const {
+        return a.position == b.position && a.normal == b.normal && a.texcoord == b.texcoord;
+    }
+};
+
+// Welds one material's corners on their index tuples. Most positions carry a single tuple, so the
+// first tuple per position sits in a dense slot table and only seams spill into the hash map.
+class ObjVertexWelder {
+   public:
+    explicit ObjVertexWelder(std::uint64_t position_count)
+        : first_vertex_(static_cast<std::size_t>(position_count), -1) {}
+
+    int weld(const ObjCorner& corner) {
+        int& slot = first_vertex_[static_cast<std::size_t>(corner.position)];
+        if (slot >= 0 && ObjCornerKeyEqual {}(vertices_[static_cast<std::size_t>(slot)], corner)) {
+            return slot;
+        }
+        if (slot >= 0) {
+            const auto seam = seams_.find(corner);
+            if (seam != seams_.end()) {
+                return seam->second;
             }
-        } else {
-            std::string ignored;
-            std::getline(stream, ignored);
+            const int vertex = next_vertex();
+            seams_.emplace(corner, vertex);
+            vertices_.push_back(corner);
+            return vertex;
+        }
+        slot = next_vertex();
+        touched_.push_back(corner.position);
+        vertices_.push_back(corner);
+        return slot;
+    }
+
+    // Hands the welded tuples over and clears the table for the next material
+    std::vector<ObjCorner> take_vertices() {
+        for (const std::int64_t position : touched_) {
+            first_vertex_[static_cast<std::size_t>(position)] = -1;
         }
+        touched_.clear();
+        seams_.clear();
+        return std::exchange(vertices_, {});
+    }
+
+   private:
+    int next_vertex() const {
+        if (vertices_.size() >= static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            throw std::runtime_error("obj mesh exceeds the triangle mesh vertex limit");
+        }
+        return static_cast<int>(vertices_.size());
+    }
+
+    std::vector<int> first_vertex_;
+    std::vector<std::int64_t> touched_;
+    std::vector<ObjCorner> vertices_;
+    std::unordered_map<ObjCorner, int, ObjCornerKeyHash, ObjCornerKeyEqual> seams_;
+};
+
+void append_dependency(std::vector<std::string>& dependencies, DependencySet& seen, const std::filesystem::path& path) {
+    const std::string normalized = path.lexically_normal().string();
+    if (seen.insert(normalized).second) {
+        dependencies.push_back(normalized);
     }
-    return result;
 }
 
 std::unordered_map<std::string, std::filesystem::path> material_roots_by_name(
@@ -115,120 +434,196 @@ int add_diffuse_material(SceneIR& scene_ir, const tinyobj::material_t* material,
     return scene_ir.add_material(DiffuseMaterial {.albedo_texture = texture});
 }
 
+std::string trim_trailing_newlines(std::string text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+        text.pop_back();
+    }
+    return text;
+}
+
+void append_warnings(std::vector<std::string>& warnings, const std::filesystem::path& file,
+    const std::string& text) {
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+        line = trim_trailing_newlines(std::move(line));
+        if (!line.empty()) {
+            warnings.push_back(file.string() + ": " + line);
+        }
+    }
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+        .count();
+}
+
+std::uint64_t peak_rss_bytes() {
+    rusage usage {};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024U;  // Linux reports kilobytes
+}
+
 }  // namespace
 
 ObjImportResult import_obj_mtl(const std::filesystem::path& obj_file) {
     const std::filesystem::path normalized_obj = obj_file.lexically_normal();
     try {
-        tinyobj::ObjReaderConfig config;
-        config.triangulate = true;
-        config.mtl_search_path = normalized_obj.parent_path().string();
+        const auto import_begin = std::chrono::steady_clock::now();
+        ObjImportResult out;
 
-        tinyobj::ObjReader reader;
-        if (!reader.ParseFromFile(normalized_obj.string(), config)) {
-            throw std::runtime_error(reader.Error().empty() ? "failed to parse obj file" : reader.Error());
+        const MappedObjFile mapped(normalized_obj);
+        const std::vector<std::string_view> pieces = split_lines_into_chunks(mapped.text());
+        std::vector<ObjChunk> chunks(pieces.size());
+        tbb::parallel_for(std::size_t {0}, pieces.size(),
+            [&](std::size_t i) { chunks[i] = parse_chunk(pieces[i]); });
+        std::size_t line_base = 0;
+        for (const ObjChunk& chunk : chunks) {
+            if (chunk.error.has_value()) {
+                throw std::runtime_error("line " + std::to_string(line_base + chunk.error->first)
+                                         + ": " + chunk.error->second);
+            }
+            line_base += chunk.line_count;
         }
+        out.stats.file_bytes = mapped.text().size();
+        out.stats.chunk_count = static_cast<int>(chunks.size());
+        out.stats.parse_ms = elapsed_ms(import_begin);
+
+        const auto merge_begin = std::chrono::steady_clock::now();
+        const std::vector<std::uint64_t> position_bases = exclusive_prefix_sum(
+            chunks, [](const ObjChunk& chunk) { return chunk.positions.size(); });
+        const std::vector<std::uint64_t> normal_bases = exclusive_prefix_sum(
+            chunks, [](const ObjChunk& chunk) { return chunk.normals.size(); });
+        const std::vector<std::uint64_t> texcoord_bases = exclusive_prefix_sum(
+            chunks, [](const ObjChunk& chunk) { return chunk.texcoords.size(); });
+        const std::uint64_t position_count = position_bases.back();
+        out.stats.source_position_count = position_count;
+        tbb::parallel_for(std::size_t {0}, chunks.size(), [&](std::size_t i) {
+            for (ObjCorner& corner : chunks[i].corners) {
+                corner.position =
+                    resolve_index(corner.position, position_bases[i], position_count, "vertex");
+                corner.normal =
+                    resolve_index(corner.normal, normal_bases[i], normal_bases.back(), "normal");
+                corner.texcoord = resolve_index(
+                    corner.texcoord, texcoord_bases[i], texcoord_bases.back(), "texcoord");
+            }
+        });
 
-        ObjImportResult out;
         DependencySet dependency_set;
         append_dependency(out.dependencies, dependency_set, normalized_obj);
-        const std::vector<std::filesystem::path> mtl_files = referenced_mtl_files(normalized_obj);
-        for (const std::filesystem::path& mtl_file : mtl_files) {
-            append_dependency(out.dependencies, dependency_set, mtl_file);
+        std::vector<std::filesystem::path> mtl_files;
+        std::unordered_set<std::string> seen_mtl_files;
+        for (const ObjChunk& chunk : chunks) {
+            for (const std::string& mtl_name : chunk.mtllibs) {
+                const std::filesystem::path mtl_path =
+                    (normalized_obj.parent_path() / mtl_name).lexically_normal();
+                if (seen_mtl_files.insert(mtl_path.string()).second) {
+                    mtl_files.push_back(mtl_path);
+                    append_dependency(out.dependencies, dependency_set, mtl_path);
+                }
+            }
         }
         const auto material_roots = material_roots_by_name(mtl_files);
-
-        const tinyobj::attrib_t& attrib = reader.GetAttrib();
-        TriangleMeshShape base_mesh;
-        base_mesh.positions.reserve(attrib.vertices.size() / 3);
-        for (std::size_t i = 0; i + 2 < attrib.vertices.size(); i += 3) {
-            base_mesh.positions.push_back(Eigen::Vector3d {
-                static_cast<double>(attrib.vertices[i + 0]),
-                static_cast<double>(attrib.vertices[i + 1]),
-                static_cast<double>(attrib.vertices[i + 2]),
-            });
-        }
-        base_mesh.normals.reserve(attrib.normals.size() / 3);
-        for (std::size_t i = 0; i + 2 < attrib.normals.size(); i += 3) {
-            base_mesh.normals.push_back(Eigen::Vector3d {
-                static_cast<double>(attrib.normals[i + 0]),
-                static_cast<double>(attrib.normals[i + 1]),
-                static_cast<double>(attrib.normals[i + 2]),
-            });
+        std::vector<tinyobj::material_t> materials;
+        std::map<std::string, int> material_ids;
+        for (const std::filesystem::path& mtl_file : mtl_files) {
+            std::ifstream stream(mtl_file);
+            std::string warning;
+            std::string error;
+            tinyobj::LoadMtl(&material_ids, &materials, &stream, &warning, &error);
+            if (!error.empty()) {
+                throw std::runtime_error(mtl_file.string() + ": " + trim_trailing_newlines(error));
+            }
+            append_warnings(out.warnings, mtl_file, warning);
         }
-        base_mesh.texcoords.reserve(attrib.texcoords.size() / 2);
-        for (std::size_t i = 0; i + 1 < attrib.texcoords.size(); i += 2) {
-            base_mesh.texcoords.push_back(Eigen::Vector2d {
-                static_cast<double>(attrib.texcoords[i + 0]),
-                static_cast<double>(attrib.texcoords[i + 1]),
-            });
+        const auto material_id = [&material_ids](const std::string& name) {
+            const auto it = material_ids.find(name);
+            return it != material_ids.end() ? it->second : -1;
+        };
+
+        // usemtl carries across chunk boundaries, so runs are assigned in file order
+        std::map<int, std::vector<ObjTriangleRun>> runs_by_material;
+        int current_material = -1;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            const std::size_t triangle_count = chunks[i].corners.size() / 3;
+            std::size_t first = 0;
+            for (const ObjMaterialSwitch& material_switch : chunks[i].material_switches) {
+                if (material_switch.first_triangle > first) {
+                    runs_by_material[current_material].push_back(ObjTriangleRun {
+                        .chunk = i, .first = first, .last = material_switch.first_triangle});
+                }
+                first = material_switch.first_triangle;
+                current_material = material_id(material_switch.name);
+            }
+            if (triangle_count > first) {
+                runs_by_material[current_material].push_back(
+                    ObjTriangleRun {.chunk = i, .first = first, .last = triangle_count});
+            }
         }
 
-        std::map<int, std::vector<ObjTriangle>> triangles_by_material;
-        for (const tinyobj::shape_t& shape : reader.GetShapes()) {
-            std::size_t index_offset = 0;
-            for (std::size_t face = 0; face < shape.mesh.num_face_vertices.size(); ++face) {
-                const int vertex_count = shape.mesh.num_face_vertices[face];
-                if (vertex_count != 3) {
-                    throw std::runtime_error("only triangulated faces are supported");
+        ObjVertexWelder welder(position_count);
+        for (const auto& [material_index, runs] : runs_by_material) {
+            const auto corners_of = [&chunks](const ObjTriangleRun& run) {
+                const std::vector<ObjCorner>& corners = chunks[run.chunk].corners;
+                return std::span {corners.data() + run.first * 3, (run.last - run.first) * 3};
+            };
+            bool complete_normals = normal_bases.back() > 0;
+            bool complete_texcoords = texcoord_bases.back() > 0;
+            for (const ObjTriangleRun& run : runs) {
+                for (const ObjCorner& corner : corners_of(run)) {
+                    complete_normals = complete_normals && corner.normal != kMissingIndex;
+                    complete_texcoords = complete_texcoords && corner.texcoord != kMissingIndex;
                 }
+            }
 
-                ObjTriangle triangle;
-                for (int corner = 0; corner < 3; ++corner) {
-                    const tinyobj::index_t index = shape.mesh.indices[index_offset + static_cast<std::size_t>(corner)];
-                    if (index.vertex_index < 0) {
-                        throw std::runtime_error("negative obj vertex indices are not supported");
+            TriangleMeshShape mesh;
+            for (const ObjTriangleRun& run : runs) {
+                const std::span<const ObjCorner> corners = corners_of(run);
+                for (std::size_t corner = 0; corner < corners.size(); corner += 3) {
+                    Eigen::Vector3i triangle;
+                    for (int k = 0; k < 3; ++k) {
+                        ObjCorner key = corners[corner + static_cast<std::size_t>(k)];
+                        key.normal = complete_normals ? key.normal : kMissingIndex;
+                        key.texcoord = complete_texcoords ? key.texcoord : kMissingIndex;
+                        triangle[k] = welder.weld(key);
                     }
-                    triangle.positions[corner] = index.vertex_index;
-                    triangle.normals[corner] = index.normal_index;
-                    triangle.texcoords[corner] = index.texcoord_index;
+                    mesh.triangles.push_back(triangle);
                 }
-                index_offset += 3;
-
-                const int material_index =
-                    face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1;
-                triangles_by_material[material_index].push_back(triangle);
             }
-        }
 
-        const std::vector<tinyobj::material_t>& materials = reader.GetMaterials();
-        for (const auto& [material_index, triangles] : triangles_by_material) {
-            TriangleMeshShape mesh = base_mesh;
-            mesh.triangles.reserve(triangles.size());
-            const bool complete_normals = !mesh.normals.empty()
-                && std::all_of(triangles.begin(), triangles.end(), [](const ObjTriangle& triangle) {
-                    return (triangle.normals.array() >= 0).all();
-                });
-            const bool complete_texcoords = !mesh.texcoords.empty()
-                && std::all_of(triangles.begin(), triangles.end(), [](const ObjTriangle& triangle) {
-                    return (triangle.texcoords.array() >= 0).all();
-                });
-            if (complete_normals) {
-                mesh.normal_indices.reserve(triangles.size());
-            } else {
-                mesh.normals.clear();
-            }
-            if (complete_texcoords) {
-                mesh.texcoord_indices.reserve(triangles.size());
-            } else {
-                mesh.texcoords.clear();
-            }
-            for (const ObjTriangle& triangle : triangles) {
-                mesh.triangles.push_back(triangle.positions);
+            const std::vector<ObjCorner> vertices = welder.take_vertices();
+            mesh.positions.resize(vertices.size());
+            mesh.normals.resize(complete_normals ? vertices.size() : 0);
+            mesh.texcoords.resize(complete_texcoords ? vertices.size() : 0);
+            tbb::parallel_for(std::size_t {0}, vertices.size(), [&](std::size_t i) {
+                const ObjCorner& vertex = vertices[i];
+                mesh.positions[i] =
+                    chunk_element(chunks, position_bases, &ObjChunk::positions, vertex.position);
                 if (complete_normals) {
-                    mesh.normal_indices.push_back(triangle.normals);
+                    mesh.normals[i] =
+                        chunk_element(chunks, normal_bases, &ObjChunk::normals, vertex.normal);
                 }
                 if (complete_texcoords) {
-                    mesh.texcoord_indices.push_back(triangle.texcoords);
+                    mesh.texcoords[i] = chunk_element(
+                        chunks, texcoord_bases, &ObjChunk::texcoords, vertex.texcoord);
                 }
+            });
+            if (complete_normals) {
+                mesh.normal_indices = mesh.triangles;
+            }
+            if (complete_texcoords) {
+                mesh.texcoord_indices = mesh.triangles;
             }
+            out.stats.vertex_count += vertices.size();
+            out.stats.triangle_count += mesh.triangles.size();
 
             const tinyobj::material_t* material = nullptr;
             if (material_index >= 0 && static_cast<std::size_t>(material_index) < materials.size()) {
                 material = &materials[static_cast<std::size_t>(material_index)];
             }
 
-            const int shape_index = out.scene_ir.add_shape(mesh);
+            const int shape_index = out.scene_ir.add_shape(std::move(mesh));
             const int scene_material = add_diffuse_material(
                 out.scene_ir, material, material_roots, normalized_obj.parent_path(), out.dependencies, dependency_set);
             out.scene_ir.add_instance(SurfaceInstance {
@@ -237,6 +632,13 @@ ObjImportResult import_obj_mtl(const std::filesystem::path& obj_file) {
             });
         }
 
+        out.stats.merge_ms = elapsed_ms(merge_begin);
+        out.stats.total_ms = elapsed_ms(import_begin);
+        out.stats.megabytes_per_second = out.stats.total_ms > 0.0
+                                             ? static_cast<double>(out.stats.file_bytes) / 1.0e6
+                                                   / (out.stats.total_ms / 1000.0)
+                                             : 0.0;
+        out.stats.peak_rss_bytes = peak_rss_bytes();
         return out;
     } catch (const std::exception& ex) {
         throw std::runtime_error(normalized_obj.string() + ": " + ex.what());
@@ -2,17 +2,37 @@
 
 #include "scene/shared_scene_ir.h"
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <vector>
 
 namespace rt::scene {
 
+struct ObjImportStats {
+    std::uint64_t file_bytes = 0;
+    int chunk_count = 0;
+    std::uint64_t source_position_count = 0;
+    std::uint64_t vertex_count = 0;  // Welded (position, normal, texcoord) tuples over all meshes
+    std::uint64_t triangle_count = 0;
+    double parse_ms = 0.0;
+    double merge_ms = 0.0;
+    double total_ms = 0.0;
+    double megabytes_per_second = 0.0;
+    std::uint64_t peak_rss_bytes = 0;  // Process-wide high-water mark once the import finished
+};
+
 struct ObjImportResult {
     SceneIR scene_ir {};
     std::vector<std::string> dependencies;
+    // Non-fatal MTL parser messages, one per line, each prefixed with its file
+    std::vector<std::string> warnings;
+    ObjImportStats stats {};
 };
 
+// Maps the OBJ file and parses line-aligned chunks in parallel. Each material becomes one
+// indexed TriangleMeshShape whose corners weld on their (position, normal, texcoord) indices, so
+// its normal and texcoord indices equal its triangle indices.
 ObjImportResult import_obj_mtl(const std::filesystem::path& obj_file);
 
 }  // namespace rt::scene
@@ -1,5 +1,6 @@
 #include "scene/realtime_scene_adapter.h"
 
+#include "common/vertex_quantization.h"
 #include "scene/analytic_light_compiler.h"
 #include "scene/openpbr_core_adapter.h"
 #include "scene/scene_ir_validator.h"
@@ -11,6 +12,7 @@
 #include <cmath>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -109,9 +111,10 @@ Eigen::Vector3d transform_point(const Eigen::Matrix4d& transform, const Eigen::V
     return transform.topLeftCorner<3, 3>() * point + transform.topRightCorner<3, 1>();
 }
 
-Eigen::Vector3d transform_normal(const Eigen::Matrix4d& transform, const Eigen::Vector3d& normal) {
-    const Eigen::Matrix3d linear = transform.topLeftCorner<3, 3>();
-    const Eigen::Vector3d transformed = linear.inverse().transpose() * normal;
+// `normal_matrix` is the inverse transpose of the transform's linear part
+Eigen::Vector3d transform_normal(
+    const Eigen::Matrix3d& normal_matrix, const Eigen::Vector3d& normal) {
+    const Eigen::Vector3d transformed = normal_matrix * normal;
     const double length = transformed.norm();
     if (!std::isfinite(length) || length <= 1e-12) {
         throw std::invalid_argument("SceneIR v2 contains a singular or zero-length mesh normal");
@@ -158,10 +161,14 @@ std::size_t primvar_value_index(const ScenePrimvar& primvar, std::size_t domain_
     return static_cast<std::size_t>(primvar.indices[domain_index]);
 }
 
-Eigen::Vector2d sample_vec2_primvar(const ScenePrimvar& primvar, std::size_t face_index,
+// Index of the primvar value that one corner of a face reads
+std::size_t corner_value_index(const ScenePrimvar& primvar, std::size_t face_index,
     std::size_t corner_index, std::size_t point_index) {
-    const std::size_t index = primvar_value_index(primvar,
+    return primvar_value_index(primvar,
         primvar_domain_index(primvar, face_index, corner_index, point_index));
+}
+
+Eigen::Vector2d vec2_primvar_value(const ScenePrimvar& primvar, std::size_t index) {
     return std::visit(
         [&](const auto& values) -> Eigen::Vector2d {
             using Values = std::decay_t<decltype(values)>;
@@ -178,10 +185,7 @@ Eigen::Vector2d sample_vec2_primvar(const ScenePrimvar& primvar, std::size_t fac
         primvar.values);
 }
 
-Eigen::Vector3d sample_vec3_primvar(const ScenePrimvar& primvar, std::size_t face_index,
-    std::size_t corner_index, std::size_t point_index) {
-    const std::size_t index = primvar_value_index(primvar,
-        primvar_domain_index(primvar, face_index, corner_index, point_index));
+Eigen::Vector3d vec3_primvar_value(const ScenePrimvar& primvar, std::size_t index) {
     return std::visit(
         [&](const auto& values) -> Eigen::Vector3d {
             using Values = std::decay_t<decltype(values)>;
@@ -286,7 +290,12 @@ std::vector<int> face_material_indices(const SceneMeshGeometry& mesh, int fallba
     return result;
 }
 
-void add_v2_mesh(rt::SceneDescription& out, const SceneMeshGeometry& mesh,
+// Triangulates a mesh under `world` onto vertex streams indexed like its points. A vertex is a
+// point together with the packed normal and texcoord its corners read, so per-point primvars keep
+// one vertex per point and face-varying or uniform ones split a point only where their values
+// differ. Faces outside every material subset take `fallback_material`, which may be negative to
+// leave the choice to a placing instance.
+rt::IndexedTriangleMesh index_v2_mesh(const SceneMeshGeometry& mesh,
     const Eigen::Matrix4d& world, int fallback_material,
     const std::unordered_map<std::string, int>& material_indices, int prototype_id,
     int instance_id) {
@@ -294,9 +303,88 @@ void add_v2_mesh(rt::SceneDescription& out, const SceneMeshGeometry& mesh,
     const ScenePrimvar* texcoords = find_primvar(mesh, "st", ScenePrimvarRole::texcoord);
     const std::vector<int> materials =
         face_material_indices(mesh, fallback_material, material_indices);
-    const bool reverse_winding = (mesh.orientation == SceneMeshOrientation::left_handed)
-                                 != (world.topLeftCorner<3, 3>().determinant() < 0.0);
+    const Eigen::Matrix3d linear = world.topLeftCorner<3, 3>();
+    const Eigen::Matrix3d normal_matrix = linear.inverse().transpose();
+    const bool reverse_winding =
+        (mesh.orientation == SceneMeshOrientation::left_handed) != (linear.determinant() < 0.0);
+
+    struct VertexKey {
+        std::uint32_t point = 0;
+        std::uint32_t normal = 0;
+        std::uint32_t texcoord = 0;
+
+        bool operator==(const VertexKey&) const = default;
+    };
+    struct VertexKeyHash {
+        std::size_t operator()(const VertexKey& key) const {
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for (const std::uint32_t word : {key.point, key.normal, key.texcoord}) {
+                hash = (hash ^ word) * 0x100000001b3ull;
+            }
+            return static_cast<std::size_t>(hash);
+        }
+    };
+    if (mesh.points.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("SceneIR v2 mesh has more points than 32-bit indices hold");
+    }
+    constexpr std::uint32_t kNoVertex = std::numeric_limits<std::uint32_t>::max();
+    // A point's first vertex is found by index; only the points that split are hashed
+    std::vector<std::uint32_t> point_vertices(mesh.points.size(), kNoVertex);
+    std::vector<VertexKey> vertex_keys;
+    std::unordered_map<VertexKey, std::uint32_t, VertexKeyHash> split_vertices;
 
+    rt::IndexedTriangleMesh out {
+        .acceleration_prototype_id = prototype_id,
+        .acceleration_instance_id = instance_id,
+    };
+    const auto add_vertex = [&](const VertexKey& key) {
+        if (out.positions.size() >= kNoVertex) {
+            throw std::length_error("SceneIR v2 mesh has more vertices than 32-bit indices hold");
+        }
+        out.positions.push_back(transform_point(world, mesh.points[key.point]).cast<float>());
+        if (normals != nullptr) {
+            out.normals.push_back(key.normal);
+        }
+        if (texcoords != nullptr) {
+            out.texcoords.push_back(key.texcoord);
+        }
+        vertex_keys.push_back(key);
+        return static_cast<std::uint32_t>(out.positions.size() - 1);
+    };
+    const auto corner_vertex = [&](std::size_t face, std::size_t corner) {
+        const std::int32_t point = mesh.face_vertex_indices[corner];
+        if (point < 0 || static_cast<std::size_t>(point) >= mesh.points.size()) {
+            throw std::invalid_argument("SceneIR v2 mesh point index is out of range");
+        }
+        VertexKey key {.point = static_cast<std::uint32_t>(point)};
+        if (normals != nullptr) {
+            const Eigen::Vector3d authored = vec3_primvar_value(
+                *normals, corner_value_index(*normals, face, corner, key.point));
+            const Eigen::Vector3f normal = transform_normal(normal_matrix, authored).cast<float>();
+            key.normal = encode_octahedral_normal(normal.x(), normal.y(), normal.z());
+        }
+        if (texcoords != nullptr) {
+            const Eigen::Vector2d texcoord = vec2_primvar_value(
+                *texcoords, corner_value_index(*texcoords, face, corner, key.point));
+            key.texcoord =
+                encode_half2(static_cast<float>(texcoord.x()), static_cast<float>(texcoord.y()));
+        }
+        std::uint32_t& first = point_vertices[key.point];
+        if (first == kNoVertex) {
+            first = add_vertex(key);
+            return first;
+        }
+        if (vertex_keys[first] == key) {
+            return first;
+        }
+        const auto [split, inserted] = split_vertices.try_emplace(key, 0);
+        if (inserted) {
+            split->second = add_vertex(key);
+        }
+        return split->second;
+    };
+
+    out.positions.reserve(mesh.points.size());
     std::size_t face_offset = 0;
     for (std::size_t face = 0; face < mesh.face_vertex_counts.size(); ++face) {
         const std::size_t count = static_cast<std::size_t>(mesh.face_vertex_counts[face]);
@@ -306,42 +394,64 @@ void add_v2_mesh(rt::SceneDescription& out, const SceneMeshGeometry& mesh,
             if (reverse_winding) {
                 std::swap(corners[1], corners[2]);
             }
-            std::array<std::size_t, 3> points {};
-            for (std::size_t i = 0; i < points.size(); ++i) {
-                const std::int32_t point = mesh.face_vertex_indices[corners[i]];
-                if (point < 0 || static_cast<std::size_t>(point) >= mesh.points.size()) {
-                    throw std::invalid_argument("SceneIR v2 mesh point index is out of range");
-                }
-                points[i] = static_cast<std::size_t>(point);
-            }
-
-            rt::TrianglePrimitive triangle {
-                .material_index = materials[face],
-                .p0 = transform_point(world, mesh.points[points[0]]),
-                .p1 = transform_point(world, mesh.points[points[1]]),
-                .p2 = transform_point(world, mesh.points[points[2]]),
-                .acceleration_prototype_id = prototype_id,
-                .acceleration_instance_id = instance_id,
-            };
-            if (normals != nullptr) {
-                triangle.n0 = transform_normal(world,
-                    sample_vec3_primvar(*normals, face, corners[0], points[0]));
-                triangle.n1 = transform_normal(world,
-                    sample_vec3_primvar(*normals, face, corners[1], points[1]));
-                triangle.n2 = transform_normal(world,
-                    sample_vec3_primvar(*normals, face, corners[2], points[2]));
-                triangle.has_vertex_normals = true;
-            }
-            if (texcoords != nullptr) {
-                triangle.uv0 = sample_vec2_primvar(*texcoords, face, corners[0], points[0]);
-                triangle.uv1 = sample_vec2_primvar(*texcoords, face, corners[1], points[1]);
-                triangle.uv2 = sample_vec2_primvar(*texcoords, face, corners[2], points[2]);
-                triangle.has_texcoords = true;
-            }
-            out.add_triangle(triangle);
+            out.triangles.push_back({corner_vertex(face, corners[0]),
+                corner_vertex(face, corners[1]), corner_vertex(face, corners[2])});
+            out.material_indices.push_back(materials[face]);
         }
         face_offset += count;
     }
+    return out;
+}
+
+// Places a legacy mesh's points under `transform`; legacy meshes carry no normals or texcoords
+rt::IndexedTriangleMesh index_legacy_mesh(const TriangleMeshShape& mesh,
+    const Transform& transform, int material, int prototype_id, int instance_id) {
+    rt::IndexedTriangleMesh out {
+        .acceleration_prototype_id = prototype_id,
+        .acceleration_instance_id = instance_id,
+    };
+    out.positions.reserve(mesh.positions.size());
+    for (const Eigen::Vector3d& position : mesh.positions) {
+        out.positions.push_back(transform_point(transform, position).cast<float>());
+    }
+    out.triangles.reserve(mesh.triangles.size());
+    for (const Eigen::Vector3i& triangle : mesh.triangles) {
+        out.triangles.push_back({static_cast<std::uint32_t>(triangle.x()),
+            static_cast<std::uint32_t>(triangle.y()), static_cast<std::uint32_t>(triangle.z())});
+    }
+    out.material_indices.assign(mesh.triangles.size(), material);
+    return out;
+}
+
+bool emissive_v2_material(const rt::MaterialDesc& material) {
+    const auto* openpbr = std::get_if<rt::OpenPbrMaterialDesc>(&material);
+    return openpbr != nullptr && openpbr->compiled.parameters.emission_luminance > 0.0f;
+}
+
+// Instanced triangles are not sampled as lights, so a placement stays baked when any of its faces
+// would emit
+bool v2_mesh_emits(const SceneMeshGeometry& mesh, int material,
+    const std::unordered_map<std::string, int>& material_indices,
+    const std::vector<bool>& emissive_materials) {
+    for (const int face_material : face_material_indices(mesh, material, material_indices)) {
+        if (emissive_materials[static_cast<std::size_t>(face_material)]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+rt::MeshInstance make_v2_mesh_instance(int prototype_index, int material,
+    const Eigen::Matrix4d& world, int prototype_id, int instance_id) {
+    return rt::MeshInstance {
+        .prototype_index = prototype_index,
+        .material_index = material,
+        .linear = world.topLeftCorner<3, 3>(),
+        .translation = world.topRightCorner<3, 1>(),
+        .dynamic = false,
+        .acceleration_prototype_id = prototype_id,
+        .acceleration_instance_id = instance_id,
+    };
 }
 
 void add_v2_sphere(rt::SceneDescription& out, const SceneSphereGeometry& sphere,
@@ -429,17 +539,8 @@ rt::SceneDescription adapt_to_realtime_impl(const SceneIR& scene,
                     add_box_quads(out, instance.material_index, desc, instance.transform,
                         instance.shape_index, instance_id);
                 } else if constexpr (std::is_same_v<T, TriangleMeshShape>) {
-                    for (const Eigen::Vector3i& tri : desc.triangles) {
-                        out.add_triangle(TrianglePrimitive {
-                            .material_index = instance.material_index,
-                            .p0 = transform_point(instance.transform, desc.positions[tri.x()]),
-                            .p1 = transform_point(instance.transform, desc.positions[tri.y()]),
-                            .p2 = transform_point(instance.transform, desc.positions[tri.z()]),
-                            .dynamic = false,
-                            .acceleration_prototype_id = instance.shape_index,
-                            .acceleration_instance_id = instance_id,
-                        });
-                    }
+                    out.add_triangle_mesh(index_legacy_mesh(desc, instance.transform,
+                        instance.material_index, instance.shape_index, instance_id));
                 } else {
                     static_assert(std::is_same_v<T, void>, "unsupported surface shape");
                 }
@@ -520,6 +621,7 @@ rt::SceneDescription adapt_scene_ir_v2_to_realtime(const SceneIRv2& scene_v2) {
     }
 
     std::unordered_map<std::string, int> material_indices;
+    std::vector<bool> emissive_materials;
     for (const ScenePrim& prim : scene_v2.prims()) {
         if (prim.kind != ScenePrimKind::material || !prim.material) {
             continue;
@@ -528,24 +630,45 @@ rt::SceneDescription adapt_scene_ir_v2_to_realtime(const SceneIRv2& scene_v2) {
         if (surface == nullptr) {
             continue;
         }
-        const int index = result.add_material(rt::OpenPbrMaterialDesc {
+        const rt::MaterialDesc material = rt::OpenPbrMaterialDesc {
             .compiled = compile_openpbr_core_material(*surface, scene_v2, texture_indices),
-        });
+        };
+        const int index = result.add_material(material);
         material_indices.emplace(prim.path, index);
+        emissive_materials.resize(static_cast<std::size_t>(index) + 1, false);
+        emissive_materials[static_cast<std::size_t>(index)] = emissive_v2_material(material);
     }
 
+    // Validation guarantees every prim resolves, so the evaluation indexes like prims()
+    const std::vector<ScenePrim>& prims = scene_v2.prims();
     const double time_code = scene_v2.stage_metadata().start_time_code.value_or(0.0);
+    const std::shared_ptr<const SceneHierarchyEvaluation> hierarchy =
+        scene_v2.evaluate_hierarchy(time_code);
+    const auto rendered = [&](std::size_t index) {
+        if (prims[index].kind != ScenePrimKind::surface || hierarchy->visible[index] == 0) {
+            return false;
+        }
+        const ScenePurpose purpose = hierarchy->purposes[index];
+        return purpose != ScenePurpose::proxy && purpose != ScenePurpose::guide;
+    };
+    // Meshes placed more than once are stored once in object space and instanced; a mesh placed
+    // once is baked into world space, which traces without the instance transform.
+    std::unordered_map<std::string, int> placements;
+    for (std::size_t index = 0; index < prims.size(); ++index) {
+        if (!prims[index].prototype_path.empty() && rendered(index)) {
+            ++placements[prims[index].prototype_path];
+        }
+    }
+
     std::unordered_map<std::string, int> acceleration_prototypes;
+    std::unordered_map<std::string, int> mesh_prototypes;
     int next_prototype_id = 0;
     int next_instance_id = 0;
-    for (const ScenePrim& prim : scene_v2.prims()) {
-        if (prim.kind != ScenePrimKind::surface || !compute_scene_visibility(scene_v2, prim.path)) {
-            continue;
-        }
-        const ScenePurpose purpose = compute_scene_purpose(scene_v2, prim.path);
-        if (purpose == ScenePurpose::proxy || purpose == ScenePurpose::guide) {
+    for (std::size_t index = 0; index < prims.size(); ++index) {
+        if (!rendered(index)) {
             continue;
         }
+        const ScenePrim& prim = prims[index];
         const ScenePrim* prototype =
             prim.prototype_path.empty() ? &prim : scene_v2.find_prim(prim.prototype_path);
         if (prototype == nullptr || !prototype->geometry) {
@@ -560,15 +683,32 @@ rt::SceneDescription adapt_scene_ir_v2_to_realtime(const SceneIRv2& scene_v2) {
         const int prototype_id = prototype_it->second;
         const int instance_id = next_instance_id++;
         const int material = resolve_material_index(material_indices, prim.material_path);
-        const Eigen::Matrix4d world = compute_scene_world_transform(scene_v2, prim.path, time_code);
+        const Eigen::Matrix4d& world = hierarchy->world_transforms[index];
         std::visit(
             [&](const auto& geometry) {
                 using T = std::decay_t<decltype(geometry)>;
                 if constexpr (std::is_same_v<T, SceneSphereGeometry>) {
                     add_v2_sphere(result, geometry, world, material, prototype_id, instance_id);
                 } else if constexpr (std::is_same_v<T, SceneMeshGeometry>) {
-                    add_v2_mesh(result, geometry, world, material, material_indices, prototype_id,
-                        instance_id);
+                    const bool shared = !prim.prototype_path.empty()
+                                        && placements.at(prim.prototype_path) > 1
+                                        && !v2_mesh_emits(geometry, material, material_indices,
+                                            emissive_materials);
+                    if (!shared) {
+                        result.add_triangle_mesh(index_v2_mesh(geometry, world, material,
+                            material_indices, prototype_id, instance_id));
+                        return;
+                    }
+                    auto [mesh_it, mesh_inserted] =
+                        mesh_prototypes.emplace(prototype->path, -1);
+                    if (mesh_inserted) {
+                        mesh_it->second = result.add_mesh_prototype(rt::MeshPrototype {
+                            .mesh = index_v2_mesh(geometry, Eigen::Matrix4d::Identity(), -1,
+                                material_indices, prototype_id, -1),
+                        });
+                    }
+                    result.add_mesh_instance(make_v2_mesh_instance(mesh_it->second, material,
+                        world, prototype_id, instance_id));
                 }
             },
             *prototype->geometry);
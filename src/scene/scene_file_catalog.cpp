@@ -105,6 +105,11 @@ const SceneDefinition* SceneFileCatalog::find_scene(std::string_view scene_id) c
     return record != records_.end() ? &record->definition : nullptr;
 }
 
+const fs::path* SceneFileCatalog::find_scene_file(std::string_view scene_id) const {
+    const auto record = find_record(scene_id);
+    return record != records_.end() && !record->is_builtin ? &record->scene_file : nullptr;
+}
+
 const CpuRenderPreset* SceneFileCatalog::find_cpu_render_preset(
     std::string_view scene_id, std::string_view preset_id) const {
     const auto record = find_record(scene_id);
@@ -205,6 +210,22 @@ std::vector<SceneFileCatalog::CatalogRecord>::const_iterator SceneFileCatalog::f
     });
 }
 
+std::optional<SceneFileSummary> find_scene_file_summary(std::string_view scene_id, const fs::path& root) {
+    for (const fs::path& scene_file : collect_scene_files(resolve_scan_root(root))) {
+        SceneDefinition summary;
+        try {
+            summary = load_scene_summary(scene_file);
+        } catch (const std::exception&) {
+            // A broken file is reported by the full load; it cannot hide another scene here.
+            continue;
+        }
+        if (summary.metadata.id == scene_id) {
+            return SceneFileSummary {.scene_file = scene_file, .definition = std::move(summary)};
+        }
+    }
+    return std::nullopt;
+}
+
 SceneFileCatalog& global_scene_file_catalog() {
     static SceneFileCatalog catalog = []() {
         SceneFileCatalog out;
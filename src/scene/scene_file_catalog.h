@@ -4,6 +4,7 @@
 
 #include <filesystem>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -23,6 +24,8 @@ class SceneFileCatalog {
     ReloadStatus reload_scene(std::string_view scene_id);
 
     const SceneDefinition* find_scene(std::string_view scene_id) const;
+    // Null for builtin scenes, which have no file on disk
+    const std::filesystem::path* find_scene_file(std::string_view scene_id) const;
     const CpuRenderPreset* find_cpu_render_preset(std::string_view scene_id, std::string_view preset_id) const;
     const CpuRenderPreset* default_cpu_render_preset(std::string_view scene_id) const;
     const RealtimeViewPreset* find_realtime_view_preset(std::string_view scene_id) const;
@@ -54,4 +57,15 @@ class SceneFileCatalog {
 
 SceneFileCatalog& global_scene_file_catalog();
 
+struct SceneFileSummary {
+    std::filesystem::path scene_file;
+    SceneDefinition definition;
+};
+
+// Finds a file-backed scene from summaries alone, for callers such as a prepared-scene cache
+// lookup that need its file and presets but not the imports a catalog scan performs. Empty for
+// builtin and unknown ids.
+std::optional<SceneFileSummary> find_scene_file_summary(
+    std::string_view scene_id, const std::filesystem::path& root = "assets/scenes");
+
 }  // namespace rt::scene
@@ -4,11 +4,16 @@
 
 #include <Eigen/LU>
 #include <fmt/format.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 #include <algorithm>
 #include <array>
 #include <cmath>
 #include <cctype>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <stdexcept>
 #include <type_traits>
@@ -1044,8 +1049,148 @@ const ScenePrim& require_prim(const SceneIRv2& scene, std::string_view path) {
     return *prim;
 }
 
+// Evaluations kept per scene; interactive tools revisit a handful of time codes at most
+constexpr std::size_t kCachedHierarchyEvaluations = 8;
+// Prims per task when one depth level is composed in parallel
+constexpr std::size_t kHierarchyGrainSize = 256;
+
+struct SceneHierarchyOrder {
+    // Resolved prims, parents before children, grouped by depth
+    std::vector<std::size_t> order;
+    // order[level_offsets[d], level_offsets[d + 1]) holds the prims at depth d
+    std::vector<std::size_t> level_offsets;
+    std::vector<std::uint8_t> resolved;
+};
+
+SceneHierarchyOrder order_scene_hierarchy(const std::vector<std::size_t>& parents) {
+    constexpr std::size_t unknown = std::numeric_limits<std::size_t>::max();
+    constexpr std::size_t unresolved = unknown - 1;
+    const std::size_t count = parents.size();
+    std::vector<std::size_t> depths(count, unknown);
+    std::vector<std::size_t> chain;
+    std::size_t level_count = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        // Climb to the first ancestor whose depth is known, then assign depths on the way back, so
+        // every prim is visited a constant number of times
+        std::size_t current = i;
+        while (current < count && depths[current] == unknown) {
+            chain.push_back(current);
+            current = parents[current];
+        }
+        std::size_t depth = unresolved;
+        if (current == kSceneRootParent) {
+            depth = 0;
+        } else if (current < count && depths[current] != unresolved) {
+            depth = depths[current] + 1;
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depths[*it] = depth;
+            if (depth != unresolved) {
+                level_count = std::max(level_count, depth + 1);
+                ++depth;
+            }
+        }
+        chain.clear();
+    }
+
+    SceneHierarchyOrder hierarchy;
+    hierarchy.resolved.resize(count);
+    hierarchy.level_offsets.assign(level_count + 1, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+        hierarchy.resolved[i] = depths[i] != unresolved ? 1 : 0;
+        if (hierarchy.resolved[i] != 0) {
+            ++hierarchy.level_offsets[depths[i] + 1];
+        }
+    }
+    std::partial_sum(hierarchy.level_offsets.begin(), hierarchy.level_offsets.end(),
+        hierarchy.level_offsets.begin());
+    hierarchy.order.resize(hierarchy.level_offsets.back());
+    std::vector<std::size_t> cursors(hierarchy.level_offsets.begin(),
+        hierarchy.level_offsets.end() - 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (hierarchy.resolved[i] != 0) {
+            hierarchy.order[cursors[depths[i]]++] = i;
+        }
+    }
+    return hierarchy;
+}
+
+std::shared_ptr<const SceneHierarchyEvaluation> compose_scene_hierarchy(
+    const std::vector<ScenePrim>& prims, const std::vector<std::size_t>& parents,
+    const SceneHierarchyOrder& hierarchy, double time_code, SceneTimeInterpolation interpolation) {
+    auto evaluation = std::make_shared<SceneHierarchyEvaluation>();
+    evaluation->time_code = time_code;
+    evaluation->interpolation = interpolation;
+    evaluation->world_transforms.resize(prims.size(), Eigen::Matrix4d::Identity());
+    evaluation->visible.resize(prims.size(), 0);
+    evaluation->purposes.resize(prims.size(), ScenePurpose::default_);
+    evaluation->resolved = hierarchy.resolved;
+
+    const auto compose = [&](std::size_t index) {
+        const ScenePrim& prim = prims[index];
+        const Eigen::Matrix4d local = sample_scene_local_transform(prim, time_code, interpolation);
+        const bool invisible = prim.visibility == SceneVisibility::invisible;
+        const std::size_t parent = parents[index];
+        if (parent == kSceneRootParent) {
+            evaluation->world_transforms[index] = local;
+            evaluation->visible[index] = invisible ? 0 : 1;
+            evaluation->purposes[index] = prim.authored_purpose.value_or(ScenePurpose::default_);
+            return;
+        }
+        evaluation->world_transforms[index] =
+            prim.reset_xform_stack ? local : evaluation->world_transforms[parent] * local;
+        evaluation->visible[index] = invisible ? 0 : evaluation->visible[parent];
+        evaluation->purposes[index] =
+            prim.authored_purpose.value_or(evaluation->purposes[parent]);
+    };
+    // Each level only reads the one above it, so sibling subtrees compose concurrently
+    for (std::size_t level = 0; level + 1 < hierarchy.level_offsets.size(); ++level) {
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(hierarchy.level_offsets[level],
+                hierarchy.level_offsets[level + 1], kHierarchyGrainSize),
+            [&](const tbb::blocked_range<std::size_t>& range) {
+                for (std::size_t position = range.begin(); position != range.end(); ++position) {
+                    compose(hierarchy.order[position]);
+                }
+            });
+    }
+    return evaluation;
+}
+
+// Index of the prim the hierarchy queries report on, or empty for the pseudo-root. Unresolved
+// prims raise the error the parent-path walk meets first.
+std::optional<std::size_t> require_hierarchy_prim(const SceneIRv2& scene,
+    std::string_view prim_path, const SceneHierarchyEvaluation& evaluation) {
+    if (prim_path == "/") {
+        return std::nullopt;
+    }
+    const std::size_t index =
+        static_cast<std::size_t>(&require_prim(scene, prim_path) - scene.prims().data());
+    if (evaluation.resolved[index] == 0) {
+        std::string current_path = parent_scene_prim_path(prim_path);
+        while (current_path != "/") {
+            require_prim(scene, current_path);
+            current_path = parent_scene_prim_path(current_path);
+        }
+        throw std::logic_error("scene prim has no resolved ancestry: " + std::string {prim_path});
+    }
+    return index;
+}
+
+double scene_hierarchy_query_time(const SceneIRv2& scene) {
+    return scene.stage_metadata().start_time_code.value_or(0.0);
+}
+
 } // namespace
 
+struct SceneIRv2::HierarchyCache {
+    std::mutex mutex;
+    std::optional<SceneHierarchyOrder> hierarchy;
+    std::vector<std::shared_ptr<const SceneHierarchyEvaluation>> evaluations;  // Oldest first
+};
+
+SceneIRv2::SceneIRv2() : hierarchy_cache_(std::make_shared<HierarchyCache>()) {}
+
 SceneStageMetadata& SceneIRv2::stage_metadata() {
     return stage_metadata_;
 }
@@ -1056,8 +1201,34 @@ const SceneStageMetadata& SceneIRv2::stage_metadata() const {
 
 std::size_t SceneIRv2::add_prim(ScenePrim prim) {
     const std::size_t index = prims_.size();
-    first_prim_by_path_.try_emplace(prim.path, index);
+    std::size_t parent = kSceneUnresolvedParent;
+    if (is_valid_scene_prim_path(prim.path)) {
+        const std::size_t separator = prim.path.find_last_of('/');
+        if (separator == 0) {
+            parent = kSceneRootParent;
+        } else {
+            std::string parent_path = prim.path.substr(0, separator);
+            const auto found = first_prim_by_path_.find(parent_path);
+            if (found != first_prim_by_path_.end()) {
+                parent = found->second;
+            } else {
+                children_awaiting_parent_[std::move(parent_path)].push_back(index);
+            }
+        }
+    }
+    if (first_prim_by_path_.try_emplace(prim.path, index).second) {
+        const auto waiting = children_awaiting_parent_.find(prim.path);
+        if (waiting != children_awaiting_parent_.end()) {
+            for (const std::size_t child : waiting->second) {
+                parent_indices_[child] = index;
+            }
+            children_awaiting_parent_.erase(waiting);
+        }
+    }
+    parent_indices_.push_back(parent);
     prims_.push_back(std::move(prim));
+    // Copies of this scene may still share the old cache, so replace rather than clear it
+    hierarchy_cache_ = std::make_shared<HierarchyCache>();
     return index;
 }
 
@@ -1073,6 +1244,37 @@ const ScenePrim* SceneIRv2::find_prim(std::string_view path) const {
     return &prims_[found->second];
 }
 
+const std::vector<std::size_t>& SceneIRv2::prim_parents() const {
+    return parent_indices_;
+}
+
+std::shared_ptr<const SceneHierarchyEvaluation> SceneIRv2::evaluate_hierarchy(
+    double time_code) const {
+    const SceneTimeInterpolation interpolation = stage_metadata_.interpolation;
+    if (!hierarchy_cache_) {
+        // Only a moved-from scene has no cache
+        return compose_scene_hierarchy(prims_, parent_indices_,
+            order_scene_hierarchy(parent_indices_), time_code, interpolation);
+    }
+    HierarchyCache& cache = *hierarchy_cache_;
+    const std::lock_guard lock {cache.mutex};
+    for (const std::shared_ptr<const SceneHierarchyEvaluation>& evaluation : cache.evaluations) {
+        if (evaluation->time_code == time_code && evaluation->interpolation == interpolation) {
+            return evaluation;
+        }
+    }
+    if (!cache.hierarchy) {
+        cache.hierarchy = order_scene_hierarchy(parent_indices_);
+    }
+    std::shared_ptr<const SceneHierarchyEvaluation> evaluation = compose_scene_hierarchy(prims_,
+        parent_indices_, *cache.hierarchy, time_code, interpolation);
+    if (cache.evaluations.size() == kCachedHierarchyEvaluations) {
+        cache.evaluations.erase(cache.evaluations.begin());
+    }
+    cache.evaluations.push_back(evaluation);
+    return evaluation;
+}
+
 bool is_valid_scene_prim_path(std::string_view path) {
     if (path.size() < 2 || path.front() != '/' || path.back() == '/') {
         return false;
@@ -1161,14 +1363,14 @@ std::vector<SceneDiagnostic> validate_scene_ir_v2(const SceneIRv2& scene) {
         }
     }
 
-    for (const ScenePrim& prim : scene.prims()) {
+    for (std::size_t prim_index = 0; prim_index < scene.prims().size(); ++prim_index) {
+        const ScenePrim& prim = scene.prims()[prim_index];
         if (!is_valid_scene_prim_path(prim.path)) {
             continue;
         }
-        const std::string parent_path = parent_scene_prim_path(prim.path);
-        if (parent_path != "/" && !prims_by_path.contains(parent_path)) {
+        if (scene.prim_parents()[prim_index] == kSceneUnresolvedParent) {
             diagnostics.push_back({SceneDiagnosticSeverity::error, "prim.parent.missing", prim.path,
-                "parent prim does not exist: " + parent_path});
+                "parent prim does not exist: " + parent_scene_prim_path(prim.path)});
         }
         append_transform_diagnostics(diagnostics, prim.local_to_parent, prim.path);
 
@@ -1526,46 +1728,24 @@ Eigen::Matrix4d sample_scene_local_transform(const ScenePrim& prim, double time_
 
 Eigen::Matrix4d compute_scene_world_transform(const SceneIRv2& scene, std::string_view prim_path,
     double time_code) {
-    std::vector<const ScenePrim*> lineage;
-    std::string current_path {prim_path};
-    while (current_path != "/") {
-        const ScenePrim& prim = require_prim(scene, current_path);
-        lineage.push_back(&prim);
-        current_path = parent_scene_prim_path(current_path);
-    }
-
-    Eigen::Matrix4d world = Eigen::Matrix4d::Identity();
-    for (auto it = lineage.rbegin(); it != lineage.rend(); ++it) {
-        const ScenePrim& prim = **it;
-        const Eigen::Matrix4d local =
-            sample_scene_local_transform(prim, time_code, scene.stage_metadata().interpolation);
-        world = prim.reset_xform_stack ? local : world * local;
-    }
-    return world;
+    const std::shared_ptr<const SceneHierarchyEvaluation> evaluation =
+        scene.evaluate_hierarchy(time_code);
+    const std::optional<std::size_t> index = require_hierarchy_prim(scene, prim_path, *evaluation);
+    return index ? evaluation->world_transforms[*index] : Eigen::Matrix4d::Identity();
 }
 
 bool compute_scene_visibility(const SceneIRv2& scene, std::string_view prim_path) {
-    std::string current_path {prim_path};
-    while (current_path != "/") {
-        const ScenePrim& prim = require_prim(scene, current_path);
-        if (prim.visibility == SceneVisibility::invisible) {
-            return false;
-        }
-        current_path = parent_scene_prim_path(current_path);
-    }
-    return true;
+    const std::shared_ptr<const SceneHierarchyEvaluation> evaluation =
+        scene.evaluate_hierarchy(scene_hierarchy_query_time(scene));
+    const std::optional<std::size_t> index = require_hierarchy_prim(scene, prim_path, *evaluation);
+    return !index || evaluation->visible[*index] != 0;
 }
 
 ScenePurpose compute_scene_purpose(const SceneIRv2& scene, std::string_view prim_path) {
-    std::string current_path {prim_path};
-    while (current_path != "/") {
-        const ScenePrim& prim = require_prim(scene, current_path);
-        if (prim.authored_purpose) {
-            return *prim.authored_purpose;
-        }
-        current_path = parent_scene_prim_path(current_path);
-    }
-    return ScenePurpose::default_;
+    const std::shared_ptr<const SceneHierarchyEvaluation> evaluation =
+        scene.evaluate_hierarchy(scene_hierarchy_query_time(scene));
+    const std::optional<std::size_t> index = require_hierarchy_prim(scene, prim_path, *evaluation);
+    return index ? evaluation->purposes[*index] : ScenePurpose::default_;
 }
 
 double scene_light_exposed_intensity(const SceneLight& light) {
@@ -6,6 +6,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -414,19 +415,49 @@ struct ScenePrim {
     std::optional<std::string> compatibility_source_name;
 };
 
+// Parent links of prims(). Top-level prims point at the pseudo-root; prims with an invalid path or
+// a parent path that no prim has point at kSceneUnresolvedParent.
+inline constexpr std::size_t kSceneRootParent = static_cast<std::size_t>(-1);
+inline constexpr std::size_t kSceneUnresolvedParent = static_cast<std::size_t>(-2);
+
+// Composed hierarchy state of every prim at one time code, indexed like SceneIRv2::prims()
+struct SceneHierarchyEvaluation {
+    double time_code = 0.0;
+    SceneTimeInterpolation interpolation = SceneTimeInterpolation::linear;
+    std::vector<Eigen::Matrix4d> world_transforms;
+    std::vector<std::uint8_t> visible;
+    std::vector<ScenePurpose> purposes;
+    // Zero when the prim or an ancestor has no resolved parent; its other entries are then unset
+    std::vector<std::uint8_t> resolved;
+};
+
 class SceneIRv2 {
 public:
+    SceneIRv2();
+
     SceneStageMetadata& stage_metadata();
     const SceneStageMetadata& stage_metadata() const;
 
     std::size_t add_prim(ScenePrim prim);
     const std::vector<ScenePrim>& prims() const;
     const ScenePrim* find_prim(std::string_view path) const;
+    // Maintained by add_prim, so children may be added before their parents
+    const std::vector<std::size_t>& prim_parents() const;
+
+    // Composes every prim in one pass over a depth-ordered topological order, evaluating each depth
+    // level in parallel. Results are cached per time code and stage interpolation until the next
+    // add_prim; the returned evaluation stays valid after that.
+    std::shared_ptr<const SceneHierarchyEvaluation> evaluate_hierarchy(double time_code) const;
 
 private:
+    struct HierarchyCache;
+
     SceneStageMetadata stage_metadata_;
     std::vector<ScenePrim> prims_;
     std::unordered_map<std::string, std::size_t> first_prim_by_path_;
+    std::vector<std::size_t> parent_indices_;
+    std::unordered_map<std::string, std::vector<std::size_t>> children_awaiting_parent_;
+    std::shared_ptr<HierarchyCache> hierarchy_cache_;
 };
 
 enum class SceneDiagnosticSeverity {
@@ -85,6 +85,7 @@ using ShapeDesc = std::variant<SphereShape, QuadShape, BoxShape, TriangleMeshSha
 
 struct Transform {
     Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+    // Linear part. The CPU adapter instances any invertible matrix, including scale and shear
     Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
 
     static Transform identity();
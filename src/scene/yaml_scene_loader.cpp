@@ -610,7 +610,7 @@ void parse_imports(const YAML::Node& imports_node, const std::filesystem::path&
 }
 
 void load_scene_file(const std::filesystem::path& scene_file, bool require_format_version, bool parse_metadata,
-    SceneDefinition& out, IdTable& texture_ids, IdTable& material_ids, IdTable& shape_ids, IdTable& medium_ids,
+    bool parse_contents, SceneDefinition& out, IdTable& texture_ids, IdTable& material_ids, IdTable& shape_ids, IdTable& medium_ids,
     IdTable& preset_ids, StringSet& dependency_set, StringSet& active_files) {
     const std::filesystem::path normalized_scene = scene_file.lexically_normal();
     try {
@@ -653,18 +653,20 @@ void load_scene_file(const std::filesystem::path& scene_file, bool require_forma
             if (include_path.is_relative()) {
                 include_path = normalized_scene.parent_path() / include_path;
             }
-            load_scene_file(include_path.lexically_normal(), false, false, out, texture_ids, material_ids, shape_ids,
-                medium_ids, preset_ids, dependency_set, active_files);
+            load_scene_file(include_path.lexically_normal(), false, false, parse_contents, out, texture_ids,
+                material_ids, shape_ids, medium_ids, preset_ids, dependency_set, active_files);
         }
 
-        if (scene_node.IsDefined()) {
+        if (parse_contents && scene_node.IsDefined()) {
             parse_textures(scene_node["textures"], normalized_scene.parent_path(), out, texture_ids, dependency_set);
             parse_materials(scene_node["materials"], out.scene_ir, texture_ids, material_ids);
             parse_shapes(scene_node["shapes"], out.scene_ir, shape_ids);
             parse_instances(scene_node["instances"], out.scene_ir, shape_ids, material_ids);
             parse_media(scene_node["media"], out.scene_ir, shape_ids, material_ids, medium_ids);
         }
-        parse_imports(root["imports"], normalized_scene.parent_path(), out, dependency_set);
+        if (parse_contents) {
+            parse_imports(root["imports"], normalized_scene.parent_path(), out, dependency_set);
+        }
         parse_cpu_presets(root["cpu_presets"], out.metadata.id, out.cpu_presets, preset_ids);
         parse_realtime_section(root["realtime"], out.realtime_preset);
 
@@ -693,8 +695,8 @@ SceneDefinition load_scene_definition(const std::filesystem::path& scene_file) {
         IdTable preset_ids;
         StringSet dependency_set;
         StringSet active_files;
-        load_scene_file(scene_file, true, true, out, texture_ids, material_ids, shape_ids, medium_ids, preset_ids,
-            dependency_set, active_files);
+        load_scene_file(scene_file, true, true, true, out, texture_ids, material_ids, shape_ids, medium_ids,
+            preset_ids, dependency_set, active_files);
         out.scene_ir_v2 = compile_scene_definition_v2(out);
         out.metadata.supports_cpu_render = !out.cpu_presets.empty();
         out.metadata.supports_realtime = out.realtime_preset.has_value();
@@ -709,4 +711,29 @@ SceneDefinition load_scene_definition(const std::filesystem::path& scene_file) {
     }
 }
 
+SceneDefinition load_scene_summary(const std::filesystem::path& scene_file) {
+    try {
+        SceneDefinition out;
+        IdTable texture_ids;
+        IdTable material_ids;
+        IdTable shape_ids;
+        IdTable medium_ids;
+        IdTable preset_ids;
+        StringSet dependency_set;
+        StringSet active_files;
+        load_scene_file(scene_file, true, true, false, out, texture_ids, material_ids, shape_ids, medium_ids,
+            preset_ids, dependency_set, active_files);
+        out.metadata.supports_cpu_render = !out.cpu_presets.empty();
+        out.metadata.supports_realtime = out.realtime_preset.has_value();
+        return out;
+    } catch (const YAML::Exception& ex) {
+        throw scene_error(scene_file, ex.what());
+    } catch (const std::exception& ex) {
+        if (has_file_error_prefix(ex.what())) {
+            throw;
+        }
+        throw scene_error(scene_file, ex.what());
+    }
+}
+
 }  // namespace rt::scene
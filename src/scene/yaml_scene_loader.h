@@ -7,5 +7,8 @@
 namespace rt::scene {
 
 SceneDefinition load_scene_definition(const std::filesystem::path& scene_file);
+// Metadata, presets and the realtime view only: scene contents are skipped and nothing is
+// imported, so the result has no scene IR and lists only the YAML files as dependencies.
+SceneDefinition load_scene_summary(const std::filesystem::path& scene_file);
 
 }  // namespace rt::scene
@@ -0,0 +1,158 @@
+#include "common/camera.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/sphere.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+struct AdaptiveFixture {
+    HittableList world;
+    HittableList lights;
+};
+
+AdaptiveFixture make_fixture() {
+    // The left half of the frame sees only the constant background, which converges at once; the
+    // right half sees a diffuse sphere under a small area light, which stays noisy
+    AdaptiveFixture fixture;
+    const auto diffuse = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.7, 0.7, 0.7});
+    const auto emitter = pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {20.0, 20.0, 20.0});
+
+    fixture.world.add(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.6, 0.0, -1.5}, 0.6, diffuse));
+    fixture.world.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {0.5, 1.2, -1.6},
+        Vec3d {0.2, 0.0, 0.0}, Vec3d {0.0, 0.0, 0.2}, emitter));
+    fixture.lights.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {0.5, 1.2, -1.6},
+        Vec3d {0.2, 0.0, 0.0}, Vec3d {0.0, 0.0, 0.2},
+        pro::make_proxy_shared<Material, EmptyMaterial>()));
+    return fixture;
+}
+
+void configure(Camera& cam, const int samples_per_pixel) {
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 24;
+    cam.samples_per_pixel = samples_per_pixel;
+    cam.max_depth = 4;
+    cam.background = {0.2, 0.3, 0.5};
+}
+
+std::int64_t total_samples(const cv::Mat& counts, const int x_begin, const int x_end) {
+    std::int64_t total = 0;
+    for (int y = 0; y < counts.rows; ++y) {
+        for (int x = x_begin; x < x_end; ++x) {
+            total += counts.at<std::int32_t>(y, x);
+        }
+    }
+    return total;
+}
+
+double mean_absolute_difference(const cv::Mat& a, const cv::Mat& b) {
+    double total = 0.0;
+    for (int y = 0; y < a.rows; ++y) {
+        for (int x = 0; x < a.cols; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                total += std::abs(static_cast<double>(a.at<cv::Vec3b>(y, x)[c])
+                                  - static_cast<double>(b.at<cv::Vec3b>(y, x)[c]));
+            }
+        }
+    }
+    return total / (3.0 * static_cast<double>(a.total()));
+}
+
+void test_converged_pixels_stop_early() {
+    AdaptiveFixture fixture = make_fixture();
+    pro::proxy<Hittable> world = &fixture.world;
+    pro::proxy<Hittable> lights = &fixture.lights;
+
+    Camera reference;
+    configure(reference, 64);
+    reference.render(world, lights);
+
+    Camera adaptive;
+    configure(adaptive, 64);
+    adaptive.adaptive.enabled = true;
+    adaptive.adaptive.relative_error = 0.05;
+    adaptive.adaptive.min_samples = 8;
+    adaptive.adaptive.samples_per_pass = 8;
+    adaptive.render(world, lights);
+
+    const cv::Mat& counts = adaptive.accumulation.sample_count;
+    expect_true(!counts.empty() && counts.rows == 24 && counts.cols == 24,
+        "adaptive render produces a sample-count AOV");
+    expect_true(counts.at<std::int32_t>(12, 0) == 8 && counts.at<std::int32_t>(0, 0) == 8,
+        "background pixels stop at the minimum sample count");
+
+    const std::int64_t background_half = total_samples(counts, 0, 6);
+    const std::int64_t sphere_half = total_samples(counts, 12, 24);
+    expect_true(sphere_half > 4 * background_half, "noisy pixels receive more samples");
+    expect_true(adaptive.accumulation.total_sample_count() < 64u * 24u * 24u,
+        "adaptive render spends less than the uniform budget");
+
+    const double difference = mean_absolute_difference(reference.img, adaptive.img);
+    expect_true(difference < 4.0, "adaptive image matches the uniform render up to noise");
+}
+
+void test_unused_budget_moves_to_noisy_pixels() {
+    AdaptiveFixture fixture = make_fixture();
+    pro::proxy<Hittable> world = &fixture.world;
+    pro::proxy<Hittable> lights = &fixture.lights;
+
+    Camera cam;
+    configure(cam, 16);
+    cam.adaptive.enabled = true;
+    cam.adaptive.relative_error = 0.001; // Tight enough that only the background converges
+    cam.adaptive.min_samples = 4;
+    cam.adaptive.samples_per_pass = 4;
+    cam.adaptive.max_samples_per_pixel = 100;
+    cam.render(world, lights);
+
+    const rt::RenderAccumulation& accumulation = cam.accumulation;
+    expect_true(accumulation.target_samples_per_pixel == 100, "sample grid spans the cap");
+    expect_true(accumulation.total_sample_count() == 16u * 24u * 24u,
+        "adaptive render spends exactly the average budget");
+
+    double max_count = 0.0;
+    cv::minMaxLoc(accumulation.sample_count, nullptr, &max_count);
+    expect_true(max_count > 16.0 && max_count <= 100.0,
+        "noisy pixels go past the average budget up to the cap");
+}
+
+void test_default_cap_and_stratified_budget() {
+    AdaptiveFixture fixture = make_fixture();
+    pro::proxy<Hittable> world = &fixture.world;
+    pro::proxy<Hittable> lights = &fixture.lights;
+
+    // 20 samples per pixel stratify as a 4x4 grid, so a uniform render takes 16 per pixel
+    Camera cam;
+    configure(cam, 20);
+    cam.adaptive.enabled = true;
+    cam.adaptive.relative_error = 0.001;
+    cam.adaptive.min_samples = 8; // Enough that the noisy pixels want more than the budget
+    cam.adaptive.samples_per_pass = 4;
+    cam.render(world, lights);
+
+    const rt::RenderAccumulation& accumulation = cam.accumulation;
+    expect_true(accumulation.target_samples_per_pixel == 64,
+        "default cap of four times the samples per pixel stratifies as an 8x8 grid");
+    expect_true(accumulation.total_sample_count() == 16u * 24u * 24u,
+        "budget is the sample count of the uniform stratified grid");
+
+    double max_count = 0.0;
+    cv::minMaxLoc(accumulation.sample_count, nullptr, &max_count);
+    expect_true(max_count > 20.0, "noisy pixels go past the samples per pixel by default");
+}
+
+} // namespace
+
+int main() {
+    test_converged_pixels_stop_early();
+    test_unused_budget_moves_to_noisy_pixels();
+    test_default_cap_and_stratified_budget();
+    return 0;
+}
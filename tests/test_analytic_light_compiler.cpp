@@ -178,6 +178,10 @@ int main() {
         "GPU packed distant cone");
     expect_near(gpu.analytic_lights.back().cdf, 1.0, 1e-6,
         "GPU packed analytic CDF closes exactly");
+    expect_true(gpu.analytic_light_tree.size() == 7 && gpu.analytic_infinite_lights.size() == 2,
+        "GPU preparation builds the light tree over the four finite lights");
+    expect_true(gpu.analytic_lights[3].tree_leaf >= 0 && gpu.analytic_lights[4].tree_leaf == -1,
+        "packed finite lights name their tree leaf and infinite lights none");
 
     rt::scene::SceneLight warm;
     warm.type = rt::scene::SceneLightType::sphere;
@@ -0,0 +1,268 @@
+#include "common/bvh.h"
+#include "common/bvh_builder.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/sphere.h"
+#include "common/triangle.h"
+#include "common/wide_bvh.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<pro::proxy<Hittable>> make_random_spheres(int count, std::uint32_t seed) {
+    std::mt19937 generator {seed};
+    std::uniform_real_distribution<double> position {-10.0, 10.0};
+    std::uniform_real_distribution<double> radius {0.05, 0.6};
+    const auto material = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5});
+
+    std::vector<pro::proxy<Hittable>> objects;
+    for (int i = 0; i < count; ++i) {
+        objects.push_back(pro::make_proxy_shared<Hittable, Sphere>(
+            Vec3d {position(generator), position(generator), position(generator)},
+            radius(generator), material));
+    }
+    return objects;
+}
+
+void expect_layout_is_complete(const rt::FlatBvh& bvh, int primitive_count,
+    const rt::BvhBuildOptions& options, const std::string& label) {
+    expect_true(static_cast<int>(bvh.primitive_indices.size()) == primitive_count,
+        label + " references every primitive");
+    std::vector<int> seen(static_cast<std::size_t>(primitive_count), 0);
+    for (const int index : bvh.primitive_indices) {
+        expect_true(index >= 0 && index < primitive_count, label + " primitive index in range");
+        seen[static_cast<std::size_t>(index)] += 1;
+    }
+    for (const int count : seen) {
+        expect_true(count == 1, label + " references each primitive once");
+    }
+    for (std::size_t i = 0; i < bvh.nodes.size(); ++i) {
+        const rt::BvhFlatNode& node = bvh.nodes[i];
+        if (node.is_leaf()) {
+            expect_true(node.count <= options.max_leaf_size, label + " leaf size bound");
+            continue;
+        }
+        expect_true(node.first > static_cast<int>(i) + 1
+                        && node.first < static_cast<int>(bvh.nodes.size()),
+            label + " right child follows the left subtree");
+    }
+}
+
+void test_build_layout() {
+    std::vector<AABB> bounds;
+    for (int i = 0; i < 10000; ++i) {
+        const Vec3d p {std::sin(i * 0.37) * 50.0, std::cos(i * 0.11) * 20.0, i * 0.01};
+        bounds.push_back(AABB {p, p + Vec3d {0.1, 0.2, 0.3}});
+    }
+
+    const rt::BvhBuildOptions serial {.max_leaf_size = 4, .parallel_threshold = 1 << 30};
+    const rt::BvhBuildOptions parallel {.max_leaf_size = 4, .parallel_threshold = 64};
+    const rt::FlatBvh serial_bvh = rt::build_binned_sah_bvh(bounds, serial);
+    const rt::FlatBvh parallel_bvh = rt::build_binned_sah_bvh(bounds, parallel);
+    expect_layout_is_complete(serial_bvh, 10000, serial, "serial build");
+    expect_layout_is_complete(parallel_bvh, 10000, parallel, "parallel build");
+    expect_true(serial_bvh.primitive_indices == parallel_bvh.primitive_indices,
+        "parallel build matches serial build");
+    expect_true(rt::bvh_sah_cost(serial_bvh) > 0.0, "SAH cost is reported");
+
+    const std::vector<AABB> coincident(37, AABB {Vec3d::Zero(), Vec3d::Ones()});
+    const rt::BvhBuildOptions leaf_of_two {.max_leaf_size = 2};
+    expect_layout_is_complete(rt::build_binned_sah_bvh(coincident, leaf_of_two), 37, leaf_of_two,
+        "coincident centroids");
+
+    expect_true(rt::build_binned_sah_bvh({}).empty(), "empty input yields empty hierarchy");
+}
+
+void test_lbvh_layout() {
+    std::vector<AABB> bounds;
+    for (int i = 0; i < 10000; ++i) {
+        const Vec3d p {std::sin(i * 0.37) * 50.0, std::cos(i * 0.11) * 20.0, i * 0.01};
+        bounds.push_back(AABB {p, p + Vec3d {0.1, 0.2, 0.3}});
+    }
+
+    const rt::BvhBuildOptions serial {.max_leaf_size = 4, .parallel_threshold = 1 << 30};
+    const rt::BvhBuildOptions parallel {.max_leaf_size = 4, .parallel_threshold = 64};
+    const rt::FlatBvh serial_bvh = rt::build_lbvh(bounds, serial);
+    const rt::FlatBvh parallel_bvh = rt::build_lbvh(bounds, parallel);
+    expect_layout_is_complete(serial_bvh, 10000, serial, "serial LBVH");
+    expect_layout_is_complete(parallel_bvh, 10000, parallel, "parallel LBVH");
+    expect_true(serial_bvh.primitive_indices == parallel_bvh.primitive_indices,
+        "parallel LBVH matches serial LBVH");
+
+    bool bounds_nest = true;
+    for (std::size_t i = 0; i < serial_bvh.nodes.size(); ++i) {
+        const rt::BvhFlatNode& node = serial_bvh.nodes[i];
+        if (node.is_leaf()) {
+            continue;
+        }
+        for (const int child : {static_cast<int>(i) + 1, node.first}) {
+            const AABB& child_bbox = serial_bvh.nodes[static_cast<std::size_t>(child)].bbox;
+            for (int axis = 0; axis < 3; ++axis) {
+                bounds_nest = bounds_nest
+                              && node.bbox.axis_interval(axis).min
+                                     <= child_bbox.axis_interval(axis).min
+                              && node.bbox.axis_interval(axis).max
+                                     >= child_bbox.axis_interval(axis).max;
+            }
+        }
+    }
+    expect_true(bounds_nest, "LBVH node bounds contain their children");
+    expect_true(rt::bvh_sah_cost(rt::build_binned_sah_bvh(bounds, serial))
+                    <= rt::bvh_sah_cost(serial_bvh),
+        "binned SAH is at least as good as LBVH under the SAH");
+
+    const std::vector<AABB> coincident(37, AABB {Vec3d::Zero(), Vec3d::Ones()});
+    const rt::BvhBuildOptions leaf_of_two {.max_leaf_size = 2};
+    expect_layout_is_complete(rt::build_lbvh(coincident, leaf_of_two), 37, leaf_of_two,
+        "LBVH coincident centroids");
+    expect_true(rt::build_lbvh({}).empty(), "empty LBVH input yields empty hierarchy");
+}
+
+void test_wide_collapse_layout() {
+    std::vector<AABB> bounds;
+    for (int i = 0; i < 5000; ++i) {
+        const Vec3d p {std::sin(i * 0.53) * 30.0, std::cos(i * 0.17) * 30.0, i * 0.02};
+        bounds.push_back(AABB {p, p + Vec3d {0.3, 0.2, 0.1}});
+    }
+    const rt::FlatBvh binary = rt::build_binned_sah_bvh(bounds);
+
+    for (const int width : {4, 8}) {
+        const std::string label = "BVH" + std::to_string(width);
+        const rt::WideBvh wide = rt::collapse_bvh(binary, rt::BvhBuildOptions {.width = width});
+        expect_true(wide.node_count() < binary.nodes.size() / 2, label + " has fewer nodes");
+
+        std::vector<int> seen(bounds.size(), 0);
+        for (std::size_t node = 0; node < wide.node_count(); ++node) {
+            int used_lanes = 0;
+            for (int lane = 0; lane < width; ++lane) {
+                const std::size_t slot = node * width + lane;
+                const int count = wide.counts[slot];
+                if (count < 0) {
+                    continue;
+                }
+                used_lanes += 1;
+                if (count == 0) {
+                    expect_true(wide.children[slot] > static_cast<int>(node)
+                                    && wide.children[slot] < static_cast<int>(wide.node_count()),
+                        label + " child nodes follow their parent");
+                    continue;
+                }
+                for (int i = wide.children[slot]; i < wide.children[slot] + count; ++i) {
+                    seen[static_cast<std::size_t>(i)] += 1;
+                }
+            }
+            expect_true(used_lanes >= 2, label + " interior nodes are filled");
+        }
+        for (const int count : seen) {
+            expect_true(count == 1, label + " leaves cover each primitive once");
+        }
+    }
+
+    bool threw = false;
+    try {
+        rt::collapse_bvh(binary, rt::BvhBuildOptions {.width = 3});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    expect_true(threw, "unsupported wide BVH width is rejected");
+}
+
+void test_hits_match_linear_scan() {
+    const std::vector<pro::proxy<Hittable>> objects = make_random_spheres(500, 7u);
+    HittableList list;
+    for (const auto& object : objects) {
+        list.add(object);
+    }
+
+    for (const int leaf_size : {1, 4, 16}) {
+        const BVH bvh {objects, rt::BvhBuildOptions {.max_leaf_size = leaf_size}};
+        std::mt19937 generator {leaf_size * 31u};
+        std::uniform_real_distribution<double> unit {-1.0, 1.0};
+        int hits = 0;
+        for (int i = 0; i < 2000; ++i) {
+            const Ray ray {Vec3d {unit(generator), unit(generator), unit(generator)} * 15.0,
+                Vec3d {unit(generator), unit(generator), unit(generator)}};
+            HitRecord expected;
+            HitRecord actual;
+            const bool expected_hit = list.hit(ray, Interval {0.001, infinity}, expected);
+            const bool actual_hit = bvh.hit(ray, Interval {0.001, infinity}, actual);
+            expect_true(expected_hit == actual_hit, "BVH hit agrees with linear scan");
+            if (expected_hit) {
+                expect_near(actual.t, expected.t, 1e-12, "BVH closest hit distance");
+                hits += 1;
+            }
+        }
+        expect_true(hits > 100, "BVH probe rays hit the sphere cloud");
+    }
+}
+
+void test_wide_kernels_match_linear_scan() {
+    const std::vector<pro::proxy<Hittable>> objects = make_random_spheres(400, 13u);
+    HittableList list;
+    for (const auto& object : objects) {
+        list.add(object);
+    }
+
+    // Random rays plus axis-aligned ones, whose zero direction components exercise the clamped
+    // reciprocals of the float box tests
+    std::vector<Ray> rays;
+    std::mt19937 generator {5u};
+    std::uniform_real_distribution<double> unit {-1.0, 1.0};
+    for (int i = 0; i < 1500; ++i) {
+        rays.emplace_back(Vec3d {unit(generator), unit(generator), unit(generator)} * 15.0,
+            Vec3d {unit(generator), unit(generator), unit(generator)});
+    }
+    for (int i = 0; i < 300; ++i) {
+        Vec3d direction = Vec3d::Zero();
+        direction[i % 3] = (i % 2 == 0) ? 1.0 : -1.0;
+        const Vec3d origin = Vec3d {unit(generator), unit(generator), unit(generator)} * 10.0
+                             - 15.0 * direction;
+        rays.emplace_back(origin, direction);
+    }
+
+    for (const int width : {4, 8}) {
+        for (const rt::BvhTraversalKernel kernel : {rt::BvhTraversalKernel::scalar,
+                 rt::BvhTraversalKernel::sse, rt::BvhTraversalKernel::avx2}) {
+            const BVH bvh {objects, rt::BvhBuildOptions {.width = width, .kernel = kernel}};
+            expect_true(bvh.traversal_kernel() == rt::resolve_bvh_traversal_kernel(kernel),
+                "BVH binds the resolved traversal kernel");
+            int hits = 0;
+            for (const Ray& ray : rays) {
+                HitRecord expected;
+                HitRecord actual;
+                const bool expected_hit = list.hit(ray, Interval {0.001, infinity}, expected);
+                const bool actual_hit = bvh.hit(ray, Interval {0.001, infinity}, actual);
+                expect_true(expected_hit == actual_hit, "wide BVH hit agrees with linear scan");
+                if (expected_hit) {
+                    expect_near(actual.t, expected.t, 1e-12, "wide BVH closest hit distance");
+                    hits += 1;
+                }
+            }
+            expect_true(hits > 100, "wide BVH probe rays hit the sphere cloud");
+        }
+    }
+
+    expect_true(rt::resolve_bvh_traversal_kernel(rt::BvhTraversalKernel::scalar)
+                    == rt::BvhTraversalKernel::scalar,
+        "scalar fallback is always available");
+    expect_true(rt::resolve_bvh_traversal_kernel(rt::BvhTraversalKernel::automatic)
+                    != rt::BvhTraversalKernel::automatic,
+        "automatic kernel resolves to a concrete kernel");
+}
+
+} // namespace
+
+int main() {
+    test_build_layout();
+    test_lbvh_layout();
+    test_wide_collapse_layout();
+    test_hits_match_linear_scan();
+    test_wide_kernels_match_linear_scan();
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "common/analytic_light.h"
+#include "common/camera.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/sphere.h"
+#include "realtime/render_profile.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct ManyLightFixture {
+    HittableList world;
+    std::vector<rt::AnalyticLightDesc> analytic_lights;
+};
+
+// A diffuse floor under a grid of small sphere lights whose power varies by two orders of
+// magnitude, so a single light sample per pixel mostly picks lights that barely matter. The
+// lights hang above the view, so only their direct light reaches the image.
+ManyLightFixture make_fixture() {
+    ManyLightFixture fixture;
+    const auto floor = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.7, 0.7, 0.7});
+    fixture.world.add(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, -100.0, -2.0}, 100.0, floor));
+
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 6; ++column) {
+            rt::AnalyticLightDesc light;
+            light.type = rt::AnalyticLightType::sphere;
+            light.position = {-1.5 + 0.6 * column, 1.8 + 0.3 * (row % 2), -1.0 - 0.8 * row};
+            light.radius = 0.03;
+            light.world_area = 4.0 * pi * light.radius * light.radius;
+            const double power = (row * 6 + column) % 7 == 0 ? 200.0 : 2.0;
+            light.radiance = {power, 0.8 * power, 0.6 * power};
+            light.selection_weight = 1.0;
+            fixture.analytic_lights.push_back(light);
+        }
+    }
+    rt::finalize_analytic_light_distribution(fixture.analytic_lights);
+    return fixture;
+}
+
+void configure(Camera& cam, Camera::Integrator integrator, int samples_per_pixel, bool restir) {
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 20; // Not a multiple of the tile size, so rounds cross partial tiles
+    cam.samples_per_pixel = samples_per_pixel;
+    cam.max_depth = 2;
+    cam.vfov = 50.0;
+    cam.background = Vec3d::Zero();
+    cam.lookfrom = {0.0, 1.5, 1.0};
+    cam.lookat = {0.0, 0.0, -2.0};
+    cam.integrator = integrator;
+    cam.restir.enabled = restir;
+    cam.restir.spatial_neighbors = 4;
+}
+
+// Per-pixel linear radiance means of a progressive render
+std::vector<Vec3d> render_mean(ManyLightFixture& fixture, Camera::Integrator integrator,
+    int samples_per_pixel, bool restir, int samples_per_pass) {
+    pro::proxy<Hittable> world = &fixture.world;
+    Camera cam;
+    configure(cam, integrator, samples_per_pixel, restir);
+    Camera::ProgressiveOptions options;
+    options.samples_per_pass = samples_per_pass;
+    expect_true(cam.render_progressive(world, {}, fixture.analytic_lights, options),
+        "progressive render completes");
+
+    std::vector<Vec3d> mean;
+    for (int y = 0; y < cam.accumulation.height(); ++y) {
+        for (int x = 0; x < cam.accumulation.width(); ++x) {
+            const cv::Vec3f& sum = cam.accumulation.radiance_sum.at<cv::Vec3f>(y, x);
+            const double count = cam.accumulation.sample_count.at<std::int32_t>(y, x);
+            mean.push_back(Vec3d {sum[0], sum[1], sum[2]} / count);
+        }
+    }
+    return mean;
+}
+
+double mean_squared_error(const std::vector<Vec3d>& image, const std::vector<Vec3d>& reference) {
+    double sum = 0.0;
+    for (std::size_t pixel = 0; pixel < image.size(); ++pixel) {
+        sum += (image[pixel] - reference[pixel]).squaredNorm();
+    }
+    return sum / static_cast<double>(image.size());
+}
+
+double max_difference(const std::vector<Vec3d>& image, const std::vector<Vec3d>& reference) {
+    double difference = 0.0;
+    for (std::size_t pixel = 0; pixel < image.size(); ++pixel) {
+        difference = std::max(difference, (image[pixel] - reference[pixel]).cwiseAbs().maxCoeff());
+    }
+    return difference;
+}
+
+void test_profile_mapping() {
+    const rt::RenderProfile quality = rt::RenderProfile::quality();
+    expect_true(
+        !Camera::RestirDi::from_profile(quality).enabled, "quality profile leaves ReSTIR off");
+
+    rt::RenderProfile profile = rt::RenderProfile::realtime();
+    profile.restir_initial_candidates = 8;
+    profile.restir_spatial_neighbors = 3;
+    profile.restir_bias_correction = rt::RestirBiasCorrectionMode::off;
+    profile.restir_min_analytic_lights = 4;
+    const Camera::RestirDi restir = Camera::RestirDi::from_profile(profile);
+    expect_true(restir.enabled, "realtime profile turns ReSTIR on");
+    expect_true(restir.initial_candidates == 8 && restir.spatial_neighbors == 3,
+        "candidate and neighbour counts come from the profile");
+    expect_true(restir.bias_correction == rt::RestirBiasCorrectionMode::off
+                    && restir.min_analytic_lights == 4,
+        "bias correction and light threshold come from the profile");
+}
+
+void test_restir_lowers_direct_light_error() {
+    ManyLightFixture fixture = make_fixture();
+    const std::vector<Vec3d> reference =
+        render_mean(fixture, Camera::Integrator::recursive, 1024, false, 1024);
+    const std::vector<Vec3d> plain =
+        render_mean(fixture, Camera::Integrator::recursive, 16, false, 4);
+    const std::vector<Vec3d> restir =
+        render_mean(fixture, Camera::Integrator::recursive, 16, true, 4);
+    expect_true(max_difference(reference, std::vector<Vec3d>(reference.size(), Vec3d::Zero()))
+                    > 0.0,
+        "fixture is lit");
+
+    const double plain_error = mean_squared_error(plain, reference);
+    const double restir_error = mean_squared_error(restir, reference);
+    expect_true(restir_error < 0.5 * plain_error,
+        "ReSTIR halves the error of one light sample per hit at equal sample count");
+}
+
+void test_restir_is_deterministic_across_integrators() {
+    ManyLightFixture fixture = make_fixture();
+    const std::vector<Vec3d> first =
+        render_mean(fixture, Camera::Integrator::recursive, 8, true, 3);
+    const std::vector<Vec3d> second =
+        render_mean(fixture, Camera::Integrator::recursive, 8, true, 3);
+    expect_true(max_difference(first, second) == 0.0,
+        "reservoir reuse does not depend on tile scheduling");
+
+    // Both integrators draw the same candidates and read the same previous round
+    const std::vector<Vec3d> wavefront =
+        render_mean(fixture, Camera::Integrator::wavefront, 8, true, 3);
+    expect_true(max_difference(first, wavefront) <= 1e-4,
+        "wavefront ReSTIR matches the recursive estimator");
+}
+
+void test_few_lights_skip_restir() {
+    // Below min_analytic_lights the camera keeps its single light sample, image for image
+    ManyLightFixture fixture = make_fixture();
+    fixture.analytic_lights.resize(4);
+    rt::finalize_analytic_light_distribution(fixture.analytic_lights);
+    const std::vector<Vec3d> plain =
+        render_mean(fixture, Camera::Integrator::recursive, 4, false, 4);
+    const std::vector<Vec3d> restir =
+        render_mean(fixture, Camera::Integrator::recursive, 4, true, 4);
+    expect_true(max_difference(plain, restir) == 0.0,
+        "ReSTIR stays off below the light threshold");
+}
+
+} // namespace
+
+int main() {
+    test_profile_mapping();
+    test_restir_lowers_direct_light_error();
+    test_restir_is_deterministic_across_integrators();
+    test_few_lights_skip_restir();
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "common/hittable.h"
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/ray.h"
+#include "common/triangle_mesh.h"
+#include "scene/cpu_scene_adapter.h"
+#include "test_support.h"
+
+#include <Eigen/Geometry>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Rotation about a tilted axis, a non-uniform scale and a shear: nothing a yaw can express
+Eigen::Matrix3d make_affine_linear() {
+    const Eigen::Matrix3d rotation =
+        Eigen::AngleAxisd(0.7, Eigen::Vector3d {1.0, 2.0, 0.5}.normalized()).toRotationMatrix();
+    Eigen::Matrix3d scale_shear;
+    scale_shear << 1.5, 0.3, 0.0, //
+        0.0, 0.6, 0.0,            //
+        0.0, 0.0, 2.0;
+    return rotation * scale_shear;
+}
+
+TriangleMeshData make_tetrahedron(const Eigen::Matrix3d& linear, const Vec3d& translation) {
+    TriangleMeshData data;
+    for (const Vec3d& corner : {Vec3d {0.0, 0.0, 0.0}, Vec3d {1.0, 0.0, 0.0},
+             Vec3d {0.0, 1.0, 0.0}, Vec3d {0.0, 0.0, 1.0}}) {
+        data.positions.push_back(linear * corner + translation);
+    }
+    data.triangles = {Eigen::Vector3i {0, 2, 1}, Eigen::Vector3i {0, 1, 3},
+        Eigen::Vector3i {0, 3, 2}, Eigen::Vector3i {1, 2, 3}};
+    return data;
+}
+
+// Deterministic rays from around the object towards points near it
+Ray probe_ray(int index, const Vec3d& target) {
+    const double a = 0.61803398875 * index - std::floor(0.61803398875 * index);
+    const double b = 0.7548776662 * index - std::floor(0.7548776662 * index);
+    const double phi = 2.0 * pi * a;
+    const double z = 2.0 * b - 1.0;
+    const double r = std::sqrt(1.0 - z * z);
+    const Vec3d origin = target + 6.0 * Vec3d {r * std::cos(phi), r * std::sin(phi), z};
+    const Vec3d jitter = 0.8 * Vec3d {b - 0.5, a - 0.5, 0.5 * (a + b) - 0.5};
+    return Ray {origin, target + jitter - origin};
+}
+
+void test_instance_matches_transformed_geometry() {
+    const Eigen::Matrix3d linear = make_affine_linear();
+    const Vec3d translation {0.4, -1.2, 3.0};
+    const pro::proxy<Material> material =
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5});
+
+    const Instance instance {pro::make_proxy_shared<Hittable, TriangleMesh>(
+                                 make_tetrahedron(Eigen::Matrix3d::Identity(), Vec3d::Zero()),
+                                 material),
+        linear, translation};
+    const TriangleMesh baked {make_tetrahedron(linear, translation), material};
+
+    const AABB bounds = instance.bounding_box();
+    const AABB baked_bounds = baked.bounding_box();
+    bool encloses = true;
+    for (int axis = 0; axis < 3; ++axis) {
+        encloses = encloses
+                   && bounds.axis_interval(axis).min <= baked_bounds.axis_interval(axis).min + 1e-9
+                   && bounds.axis_interval(axis).max >= baked_bounds.axis_interval(axis).max - 1e-9;
+    }
+    expect_true(encloses, "instance bounds enclose the placed geometry");
+
+    const Vec3d center = linear * Vec3d {0.25, 0.25, 0.25} + translation;
+    int hits = 0;
+    bool matches = true;
+    for (int i = 0; i < 512; ++i) {
+        const Ray ray = probe_ray(i, center);
+        HitRecord instance_hit;
+        HitRecord baked_hit;
+        const bool found = instance.hit(ray, Interval {0.001, infinity}, instance_hit);
+        if (found != baked.hit(ray, Interval {0.001, infinity}, baked_hit)) {
+            matches = false;
+            continue;
+        }
+        if (!found) {
+            continue;
+        }
+        ++hits;
+        matches = matches && std::abs(instance_hit.t - baked_hit.t) <= 1e-9 * baked_hit.t
+                  && (instance_hit.p - baked_hit.p).norm() <= 1e-9
+                  && (instance_hit.normal - baked_hit.normal).norm() <= 1e-9
+                  && instance_hit.front_face == baked_hit.front_face;
+    }
+    expect_true(hits > 200, "most probe rays hit the tetrahedron");
+    expect_true(matches, "an instanced mesh hits like the same mesh baked into world space");
+}
+
+void test_instanced_light_densities() {
+    // An affine map takes a quad to a quad, so the transformed one is the exact reference
+    const Eigen::Matrix3d linear = make_affine_linear();
+    const Vec3d translation {0.0, 3.0, -1.0};
+    const pro::proxy<Material> emitter =
+        pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {1.0, 1.0, 1.0});
+    const Vec3d corner {-0.5, 0.0, -0.5};
+    const Vec3d edge_u {1.0, 0.0, 0.0};
+    const Vec3d edge_v {0.0, 0.0, 1.0};
+    const Instance instance {
+        pro::make_proxy_shared<Hittable, Quad>(corner, edge_u, edge_v, emitter), linear,
+        translation};
+    const Quad baked {linear * corner + translation, linear * edge_u, linear * edge_v, emitter};
+
+    const Vec3d origin {0.3, -0.5, 0.2};
+    rt::PathSampler sampler {11, 2};
+    bool densities_match = true;
+    bool samples_land = true;
+    for (int i = 0; i < 256; ++i) {
+        const Vec3d direction = instance.random(origin, sampler);
+        const double expected = baked.pdf_value(origin, direction);
+        densities_match = densities_match && expected > 0.0
+                          && std::abs(instance.pdf_value(origin, direction) - expected)
+                                 <= 1e-9 * expected;
+        HitRecord hit;
+        samples_land = samples_land
+                       && baked.hit(Ray {origin, direction}, Interval {0.001, infinity}, hit)
+                       && std::abs(hit.t - 1.0) <= 1e-9;
+    }
+    expect_true(samples_land, "instanced light samples land on the transformed quad");
+    expect_true(densities_match, "instanced light densities account for scale and shear");
+}
+
+void test_adapter_shares_prototypes() {
+    rt::scene::SceneIR scene;
+    const int white =
+        scene.add_texture(rt::scene::ConstantColorTextureDesc {.color = Eigen::Vector3d::Ones()});
+    const int matte = scene.add_material(rt::scene::DiffuseMaterial {.albedo_texture = white});
+    const TriangleMeshData tetrahedron =
+        make_tetrahedron(Eigen::Matrix3d::Identity(), Vec3d::Zero());
+    const int mesh = scene.add_shape(rt::scene::TriangleMeshShape {
+        .positions = tetrahedron.positions,
+        .triangles = tetrahedron.triangles,
+    });
+
+    const Eigen::Matrix3d linear = make_affine_linear();
+    for (int i = 0; i < 64; ++i) {
+        rt::scene::Transform transform;
+        transform.rotation = linear;
+        transform.translation = Eigen::Vector3d {4.0 * (i % 8), 0.0, 4.0 * (i / 8)};
+        scene.add_instance(rt::scene::SurfaceInstance {
+            .shape_index = mesh,
+            .material_index = matte,
+            .transform = transform,
+        });
+    }
+
+    const rt::scene::CpuSceneAdapterResult adapted = rt::scene::adapt_to_cpu(scene);
+    expect_true(adapted.prototype_count == 1, "64 placements of one mesh build one prototype");
+
+    const Vec3d center = linear * Vec3d {0.25, 0.25, 0.25} + Vec3d {12.0, 0.0, 20.0};
+    const Ray ray {center + Vec3d {0.0, 10.0, 0.0}, Vec3d {0.0, -1.0, 0.0}};
+    HitRecord hit;
+    expect_true(adapted.world->hit(ray, Interval {0.001, infinity}, hit),
+        "a sheared, scaled and tilted instance renders on the CPU");
+    expect_true(hit.p.y() < center.y() + 10.0 && hit.normal.dot(ray.direction()) < 0.0,
+        "the instance hit faces the ray");
+
+    rt::scene::SceneIR singular_scene = scene;
+    rt::scene::Transform flat;
+    flat.rotation = Eigen::Vector3d {1.0, 0.0, 1.0}.asDiagonal();
+    singular_scene.add_instance(rt::scene::SurfaceInstance {
+        .shape_index = mesh,
+        .material_index = matte,
+        .transform = flat,
+    });
+    bool rejected = false;
+    try {
+        (void)rt::scene::adapt_to_cpu(singular_scene);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect_true(rejected, "a singular instance transform is rejected");
+}
+
+} // namespace
+
+int main() {
+    test_instance_matches_transformed_geometry();
+    test_instanced_light_densities();
+    test_adapter_shares_prototypes();
+    return 0;
+}
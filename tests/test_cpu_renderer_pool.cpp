@@ -0,0 +1,160 @@
+#include "realtime/camera_rig.h"
+#include "realtime/frame_convention.h"
+#include "realtime/gpu/cpu_renderer_pool.h"
+#include "realtime/render_profile.h"
+#include "realtime/scene_description.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+static_assert(!std::is_copy_constructible_v<rt::CpuRendererPool>);
+static_assert(!std::is_move_constructible_v<rt::CpuRendererPool>);
+
+namespace {
+
+template<typename Fn>
+void expect_throws_with_message(Fn&& fn, const std::string& message, const std::string& label) {
+    bool threw = false;
+    bool matched = false;
+    try {
+        fn();
+    } catch (const std::exception& ex) {
+        threw = true;
+        matched = std::string(ex.what()).find(message) != std::string::npos;
+    } catch (...) { threw = true; }
+    expect_true(threw, label + " threw");
+    expect_true(matched, label + " message");
+}
+
+rt::SceneDescription make_scene() {
+    rt::SceneDescription scene;
+    const int diffuse =
+        scene.add_material(rt::LambertianMaterial {Eigen::Vector3d {0.75, 0.25, 0.2}});
+    const int light =
+        scene.add_material(rt::DiffuseLightMaterial {Eigen::Vector3d {10.0, 10.0, 10.0}});
+    scene.add_sphere(rt::SpherePrimitive {diffuse,
+        rt::legacy_renderer_to_world(Eigen::Vector3d {0.0, 0.0, -1.0}), 0.5, false});
+    scene.add_quad(rt::QuadPrimitive {
+        light,
+        rt::legacy_renderer_to_world(Eigen::Vector3d {-0.75, 1.25, -1.5}),
+        rt::legacy_renderer_to_world(Eigen::Vector3d {1.5, 0.0, 0.0}),
+        rt::legacy_renderer_to_world(Eigen::Vector3d {0.0, 0.0, 1.5}),
+        false,
+    });
+    return scene;
+}
+
+rt::CameraRig make_rig(int camera_count) {
+    rt::CameraRig rig;
+    for (int i = 0; i < camera_count; ++i) {
+        Sophus::SE3d T_bc {};
+        T_bc.translation() = Eigen::Vector3d {0.03 * static_cast<double>(i), 0.0, 0.0};
+        rig.add_pinhole(rt::Pinhole32Params {150.0, 150.0, 16.0, 16.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+            T_bc, 32, 32);
+    }
+    return rig;
+}
+
+void expect_frame_aovs(const rt::CameraRenderResult& result, const std::string& label) {
+    const rt::RadianceFrame& frame = result.profiled.frame;
+    const std::size_t pixel_count = 32U * 32U;
+    expect_true(frame.width == 32 && frame.height == 32, label + " size");
+    expect_true(frame.beauty_rgba.size() == pixel_count * 4U
+                    && frame.normal_rgba.size() == pixel_count * 4U
+                    && frame.albedo_rgba.size() == pixel_count * 4U
+                    && frame.depth.size() == pixel_count,
+        label + " AOV sizes");
+
+    int surface_pixels = 0;
+    for (std::size_t i = 0; i < pixel_count; ++i) {
+        expect_true(std::isfinite(frame.beauty_rgba[i * 4U]) && frame.beauty_rgba[i * 4U] >= 0.0f,
+            label + " finite beauty");
+        expect_near(frame.beauty_rgba[i * 4U + 3U], 1.0, 0.0, label + " beauty alpha");
+        for (std::size_t c = 0; c < 3U; ++c) {
+            const float normal = frame.normal_rgba[i * 4U + c];
+            const float albedo = frame.albedo_rgba[i * 4U + c];
+            expect_true(normal >= 0.0f && normal <= 1.0f, label + " encoded normal range");
+            expect_true(albedo >= 0.0f && albedo <= 1.0f, label + " albedo range");
+        }
+        if (frame.depth[i] > 0.0f) {
+            ++surface_pixels;
+        }
+    }
+    expect_true(surface_pixels > 0, label + " sees the sphere");
+    expect_true(frame.average_luminance > 0.0, label + " is lit");
+    expect_true(result.profiled.timing.render_ms > 0.0f, label + " render timing");
+    expect_near(result.profiled.timing.denoise_ms, 0.0, 0.0, label + " has no denoise pass");
+}
+
+} // namespace
+
+int main() {
+    const rt::PackedScene packed_scene = make_scene().pack();
+    const rt::PackedCameraRig packed_rig = make_rig(4).pack();
+    const rt::RenderProfile profile = rt::RenderProfile::realtime();
+
+    expect_throws_with_message([]() { rt::CpuRendererPool invalid_zero(0); },
+        "renderer_count in [1, 4]", "reject renderer_count below range");
+    expect_throws_with_message([]() { rt::CpuRendererPool invalid_over(5); },
+        "renderer_count in [1, 4]", "reject renderer_count above range");
+
+    rt::CpuRendererPool unprepared(1);
+    expect_throws_with_message([&]() { unprepared.render_frame(packed_rig, profile, 1); },
+        "requires prepare_scene()", "reject rendering before a scene is prepared");
+
+    rt::CpuRendererPool single_pool(1);
+    single_pool.prepare_scene(packed_scene);
+    const std::vector<rt::CameraRenderResult> single_result =
+        single_pool.render_frame(packed_rig, profile, 1);
+    expect_true(single_result.size() == 1 && single_result[0].camera_index == 0,
+        "single-camera pooled ordering");
+    expect_frame_aovs(single_result[0], "single camera");
+
+    rt::CpuRendererPool four_pool(4);
+    four_pool.prepare_scene(packed_scene);
+    const std::vector<rt::CameraRenderResult> four_result =
+        four_pool.render_frame(packed_rig, profile, 4);
+    expect_true(four_result.size() == 4, "four-camera pooled count");
+    for (int i = 0; i < 4; ++i) {
+        const auto idx = static_cast<std::size_t>(i);
+        expect_true(four_result[idx].camera_index == i, "four-camera pooled ordering");
+        expect_frame_aovs(four_result[idx], "camera " + std::to_string(i));
+    }
+    expect_true(four_result[0].profiled.frame.beauty_rgba
+                        == single_result[0].profiled.frame.beauty_rgba
+                    && four_result[0].profiled.frame.depth == single_result[0].profiled.frame.depth,
+        "concurrent cameras render exactly what a single camera renders");
+    expect_true(four_result[0].profiled.frame.depth != four_result[3].profiled.frame.depth,
+        "each camera renders its own view");
+
+    const rt::RendererPoolDiagnostics first_diagnostics = four_pool.diagnostics();
+    expect_true(first_diagnostics.worker_count == 4, "worker count follows renderer_count");
+    expect_true(first_diagnostics.acceleration.kind == rt::AccelerationUpdateKind::rebuild,
+        "first preparation rebuilds acceleration");
+    expect_true(first_diagnostics.acceleration.node_count > 0, "host acceleration is built");
+
+    const std::vector<rt::CameraRenderResult> second_frame =
+        four_pool.render_frame(packed_rig, profile, 4);
+    expect_true(four_pool.diagnostics().task_submission_count
+                    == first_diagnostics.task_submission_count + 4,
+        "one task per camera and frame");
+    expect_true(
+        second_frame[0].profiled.frame.beauty_rgba != four_result[0].profiled.frame.beauty_rgba,
+        "the sample stream advances between frames");
+
+    four_pool.reset_sequence(0);
+    const std::vector<rt::CameraRenderResult> replay =
+        four_pool.render_frame(packed_rig, profile, 4);
+    expect_true(replay[2].profiled.frame.beauty_rgba == four_result[2].profiled.frame.beauty_rgba,
+        "reset_sequence replays the first frame");
+
+    rt::PackedCameraRig mismatched_rig = make_rig(1).pack();
+    expect_throws_with_message([&]() { four_pool.render_frame(mismatched_rig, profile, 2); },
+        "active_cameras exceeds rig.active_count", "reject rig active-count mismatch");
+
+    return 0;
+}
@@ -16,6 +16,7 @@
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <variant>
 
 namespace {
 
@@ -102,6 +103,7 @@ int main() {
         expect_true(adapted.world.has_value(), "adapted world should be non-null");
     }
 
+    rt::PathSampler sampler {0, 0};
     const std::filesystem::path image_texture_path = make_unique_image_texture_fixture_path();
     const std::filesystem::path image_texture_dir = image_texture_path.parent_path();
 
@@ -129,10 +131,11 @@ int main() {
     expect_true(adapted_image_texture.world->hit(image_ray, Interval {0.001, infinity}, image_hit),
         "image texture fixture ray should hit diffuse sphere");
     ScatterRecord image_scatter;
-    expect_true(image_hit.mat->scatter(image_ray, image_hit, image_scatter),
+    expect_true(image_hit.mat->scatter(image_ray, image_hit, image_scatter, sampler),
         "image texture fixture diffuse material should scatter");
     expect_true(!image_scatter.skip_pdf, "image texture fixture scatter should not skip pdf");
-    expect_true(image_scatter.pdf != nullptr, "image texture fixture scatter should provide pdf");
+    expect_true(!std::holds_alternative<std::monostate>(image_scatter.pdf),
+        "image texture fixture scatter should provide pdf");
     expect_vec3_near(image_scatter.attenuation, Vec3d {224.0 / 255.0, 96.0 / 255.0, 32.0 / 255.0}, 1e-6,
         "image texture fixture attenuation should match encoded image color");
     expect_true(image_hit.mat->scattering_pdf(image_ray, image_hit, Ray {image_hit.p, image_hit.normal}) > 0.0,
@@ -151,10 +154,11 @@ int main() {
     expect_true(adapted_perlin.world->hit(perlin_ray, Interval {0.001, infinity}, perlin_hit),
         "perlin_spheres ray should hit diffuse sphere");
     ScatterRecord perlin_scatter;
-    expect_true(perlin_hit.mat->scatter(perlin_ray, perlin_hit, perlin_scatter),
+    expect_true(perlin_hit.mat->scatter(perlin_ray, perlin_hit, perlin_scatter, sampler),
         "perlin_spheres diffuse material should scatter");
     expect_true(!perlin_scatter.skip_pdf, "perlin_spheres diffuse scatter should not skip pdf");
-    expect_true(perlin_scatter.pdf != nullptr, "perlin_spheres diffuse scatter should provide pdf");
+    expect_true(!std::holds_alternative<std::monostate>(perlin_scatter.pdf),
+        "perlin_spheres diffuse scatter should provide pdf");
     expect_true(perlin_hit.mat->scattering_pdf(perlin_ray, perlin_hit, Ray {perlin_hit.p, perlin_hit.normal}) > 0.0,
         "perlin_spheres diffuse scattering pdf should be positive");
 
@@ -168,10 +172,11 @@ int main() {
     expect_true(adapted_checkered.world->hit(checker_ray, Interval {0.001, infinity}, checker_hit),
         "checkered_spheres ray should hit top checker sphere");
     ScatterRecord checker_scatter;
-    expect_true(checker_hit.mat->scatter(checker_ray, checker_hit, checker_scatter),
+    expect_true(checker_hit.mat->scatter(checker_ray, checker_hit, checker_scatter, sampler),
         "checkered_spheres diffuse material should scatter");
     expect_true(!checker_scatter.skip_pdf, "checkered_spheres diffuse scatter should not skip pdf");
-    expect_true(checker_scatter.pdf != nullptr, "checkered_spheres diffuse scatter should provide pdf");
+    expect_true(!std::holds_alternative<std::monostate>(checker_scatter.pdf),
+        "checkered_spheres diffuse scatter should provide pdf");
     expect_vec3_near(checker_scatter.attenuation, Vec3d {0.9, 0.9, 0.9}, 1e-12,
         "checkered_spheres checker attenuation should match odd color branch");
 
@@ -187,7 +192,7 @@ int main() {
     expect_true(adapted_bouncing.world->hit(glass_ray, Interval {0.001, infinity}, glass_hit),
         "bouncing_spheres ray should hit glass hero sphere");
     ScatterRecord glass_scatter;
-    expect_true(glass_hit.mat->scatter(glass_ray, glass_hit, glass_scatter),
+    expect_true(glass_hit.mat->scatter(glass_ray, glass_hit, glass_scatter, sampler),
         "glass hero sphere should scatter");
     expect_true(glass_scatter.skip_pdf, "glass hero sphere scatter should be specular");
     expect_vec3_near(glass_scatter.attenuation, Vec3d {1.0, 1.0, 1.0}, 1e-12,
@@ -198,7 +203,7 @@ int main() {
     expect_true(adapted_bouncing.world->hit(metal_ray, Interval {0.001, infinity}, metal_hit),
         "bouncing_spheres ray should hit metal hero sphere");
     ScatterRecord metal_scatter;
-    expect_true(metal_hit.mat->scatter(metal_ray, metal_hit, metal_scatter),
+    expect_true(metal_hit.mat->scatter(metal_ray, metal_hit, metal_scatter, sampler),
         "metal hero sphere should scatter");
     expect_true(metal_scatter.skip_pdf, "metal hero sphere scatter should be specular");
     expect_vec3_near(metal_scatter.attenuation, Vec3d {0.7, 0.6, 0.5}, 1e-12,
@@ -246,10 +251,11 @@ int main() {
     expect_true(medium_hit.t >= 2.0 && medium_hit.t <= 4.0,
         "dense isotropic medium hit should lie within boundary segment");
     ScatterRecord medium_scatter;
-    expect_true(medium_hit.mat->scatter(medium_ray, medium_hit, medium_scatter),
+    expect_true(medium_hit.mat->scatter(medium_ray, medium_hit, medium_scatter, sampler),
         "dense isotropic medium phase function should scatter");
     expect_true(!medium_scatter.skip_pdf, "isotropic scatter should not skip pdf");
-    expect_true(medium_scatter.pdf != nullptr, "isotropic scatter should provide pdf");
+    expect_true(!std::holds_alternative<std::monostate>(medium_scatter.pdf),
+        "isotropic scatter should provide pdf");
     expect_vec3_near(medium_scatter.attenuation, Vec3d {0.2, 0.4, 0.9}, 1e-12,
         "isotropic scatter attenuation should match configured albedo");
     expect_near(medium_hit.mat->scattering_pdf(medium_ray, medium_hit, Ray {medium_hit.p, Vec3d {1.0, 0.0, 0.0}}),
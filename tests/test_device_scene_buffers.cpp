@@ -6,6 +6,9 @@ int main() {
     prepared.spheres.resize(1);
     prepared.quads.resize(2);
     prepared.triangles.resize(3);
+    prepared.vertex_positions.resize(3);
+    prepared.vertex_attributes.resize(3);
+    prepared.triangle_acceleration_ids.resize(3);
     prepared.media.resize(4);
     prepared.textures.resize(5);
     prepared.image_texels.resize(6);
@@ -21,6 +24,8 @@ int main() {
     expect_true(view.spheres != nullptr, "spheres uploaded");
     expect_true(view.quads != nullptr, "quads uploaded");
     expect_true(view.triangles != nullptr, "triangles uploaded");
+    expect_true(view.vertex_positions != nullptr, "vertex positions uploaded");
+    expect_true(view.vertex_attributes != nullptr, "vertex attributes uploaded");
     expect_true(view.media != nullptr, "media uploaded");
     expect_true(view.textures != nullptr, "textures uploaded");
     expect_true(view.image_texels != nullptr, "image texels uploaded");
@@ -31,6 +36,7 @@ int main() {
     expect_true(view.sphere_count == 1, "sphere count");
     expect_true(view.quad_count == 2, "quad count");
     expect_true(view.triangle_count == 3, "triangle count");
+    expect_true(view.vertex_count == 3, "vertex count");
     expect_true(view.medium_count == 4, "medium count");
     expect_true(view.texture_count == 5, "texture count");
     expect_true(view.image_texel_count == 6, "image texel count");
@@ -45,6 +51,7 @@ int main() {
     expect_true(empty_view.spheres == nullptr, "empty spheres cleared");
     expect_true(empty_view.quads == nullptr, "empty quads cleared");
     expect_true(empty_view.triangles == nullptr, "empty triangles cleared");
+    expect_true(empty_view.vertex_positions == nullptr, "empty vertex positions cleared");
     expect_true(empty_view.media == nullptr, "empty media cleared");
     expect_true(empty_view.textures == nullptr, "empty textures cleared");
     expect_true(empty_view.image_texels == nullptr, "empty image texels cleared");
@@ -3,6 +3,15 @@
 #include "realtime/scene_description.h"
 #include "test_support.h"
 
+#include <Eigen/Geometry>
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
 namespace {
 
 rt::PackedScene make_scene(float second_center_x, bool add_third, float albedo) {
@@ -38,6 +47,326 @@ rt::PackedScene make_scene(float second_center_x, bool add_third, float albedo)
     return scene.pack();
 }
 
+rt::PackedScene make_sphere_cloud(int count) {
+    rt::SceneDescription scene;
+    const int material =
+        scene.add_material(rt::LambertianMaterial {Eigen::Vector3d {0.5, 0.5, 0.5}});
+    for (int i = 0; i < count; ++i) {
+        // Clustered along a curve so that the builders' split choices differ
+        scene.add_sphere(rt::SpherePrimitive {
+            .material_index = material,
+            .center = Eigen::Vector3d {std::sin(i * 0.37) * 20.0, std::cos(i * 0.11) * 5.0,
+                -10.0 - i * 0.01},
+            .radius = 0.05 + 0.1 * static_cast<double>(i % 5),
+            .dynamic = false,
+        });
+    }
+    return scene.pack();
+}
+
+bool contains(const rt::PackedBvhNode& outer, const Eigen::Vector3f& min,
+    const Eigen::Vector3f& max) {
+    return (outer.bounds_min.array() <= min.array()).all()
+           && (outer.bounds_max.array() >= max.array()).all();
+}
+
+void expect_valid_hierarchy(const rt::GpuSceneAcceleration& acceleration,
+    const rt::GpuPreparedScene& scene, const std::string& label) {
+    const std::vector<rt::PackedBvhNode>& nodes = acceleration.nodes();
+    const std::vector<rt::PackedPrimitiveRef>& references = acceleration.references();
+    expect_true(references.size() == scene.spheres.size(), label + " references every sphere");
+
+    std::vector<int> seen(scene.spheres.size(), 0);
+    for (const rt::PackedPrimitiveRef& reference : references) {
+        seen.at(static_cast<std::size_t>(reference.primitive_index)) += 1;
+    }
+    bool each_once = true;
+    for (const int count : seen) {
+        each_once = each_once && count == 1;
+    }
+    expect_true(each_once, label + " references each sphere once");
+
+    bool layout_valid = true;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        const rt::PackedBvhNode& node = nodes[i];
+        if (node.reference_count > 0) {
+            layout_valid = layout_valid && node.reference_count <= 4;
+            for (int r = 0; r < node.reference_count; ++r) {
+                const rt::PackedSphere& sphere = scene.spheres.at(static_cast<std::size_t>(
+                    references.at(static_cast<std::size_t>(node.first_reference + r))
+                        .primitive_index));
+                const Eigen::Vector3f radius = Eigen::Vector3f::Constant(sphere.radius);
+                layout_valid =
+                    layout_valid && contains(node, sphere.center - radius, sphere.center + radius);
+            }
+            continue;
+        }
+        for (const int child : {node.left_child, node.right_child}) {
+            layout_valid = layout_valid && child > static_cast<int>(i)
+                           && child < static_cast<int>(nodes.size());
+            if (layout_valid) {
+                const rt::PackedBvhNode& child_node = nodes[static_cast<std::size_t>(child)];
+                layout_valid =
+                    layout_valid && contains(node, child_node.bounds_min, child_node.bounds_max);
+            }
+        }
+    }
+    expect_true(layout_valid, label + " children follow parents inside their bounds");
+}
+
+void test_build_modes() {
+    const rt::GpuPreparedScene scene = rt::prepare_gpu_scene(make_sphere_cloud(5000));
+
+    rt::GpuSceneAcceleration sah;
+    const rt::AccelerationUpdateStats sah_build = sah.update(scene);
+    expect_true(sah_build.build_mode == rt::AccelerationBuildMode::binned_sah,
+        "binned SAH is the default build mode");
+    expect_true(sah_build.build_ms > 0.0 && sah_build.build_ms <= sah_build.elapsed_ms,
+        "rebuild reports its build time");
+    expect_true(sah_build.sah_cost > 0.0, "rebuild reports its SAH cost");
+    expect_valid_hierarchy(sah, scene, "binned SAH");
+
+    const rt::AccelerationUpdateStats reuse = sah.update(scene);
+    expect_true(reuse.build_ms == 0.0 && reuse.sah_cost == sah_build.sah_cost,
+        "reuse keeps the SAH cost without building");
+
+    rt::GpuSceneAcceleration lbvh;
+    lbvh.set_build_mode(rt::AccelerationBuildMode::lbvh);
+    const rt::AccelerationUpdateStats lbvh_build = lbvh.update(scene);
+    expect_true(lbvh_build.build_mode == rt::AccelerationBuildMode::lbvh, "LBVH mode reported");
+    expect_valid_hierarchy(lbvh, scene, "LBVH");
+    expect_true(sah_build.sah_cost <= lbvh_build.sah_cost,
+        "binned SAH hierarchy is no worse than LBVH under the SAH");
+
+    sah.set_build_mode(rt::AccelerationBuildMode::lbvh);
+    const rt::AccelerationUpdateStats switched = sah.update(scene);
+    expect_true(switched.kind == rt::AccelerationUpdateKind::rebuild,
+        "changing the build mode rebuilds");
+    expect_true(switched.node_count == lbvh_build.node_count
+                    && sah.references().front().primitive_index
+                           == lbvh.references().front().primitive_index,
+        "LBVH rebuild is deterministic");
+}
+
+void test_generation_tracking() {
+    rt::SceneDescription description;
+    const int material =
+        description.add_material(rt::LambertianMaterial {Eigen::Vector3d {0.5, 0.5, 0.5}});
+    for (int i = 0; i < 64; ++i) {
+        description.add_sphere(rt::SpherePrimitive {
+            .material_index = material,
+            .center = Eigen::Vector3d {static_cast<double>(i), 0.0, -3.0},
+            .radius = 0.4,
+            .dynamic = i == 0,
+        });
+    }
+
+    rt::GpuSceneAcceleration acceleration;
+    const rt::GpuPreparedScene initial = rt::prepare_gpu_scene(description.pack());
+    const rt::AccelerationUpdateStats rebuild = acceleration.update(initial);
+    expect_true(rebuild.kind == rt::AccelerationUpdateKind::rebuild && rebuild.hashed_bytes > 0,
+        "first update hashes the scene once");
+
+    const rt::AccelerationUpdateStats reuse = acceleration.update(initial);
+    expect_true(reuse.kind == rt::AccelerationUpdateKind::reuse && reuse.hashed_bytes == 0,
+        "unchanged stamps reuse without reading scene data");
+
+    description.set_material(material, rt::LambertianMaterial {Eigen::Vector3d {0.9, 0.1, 0.1}});
+    const rt::AccelerationUpdateStats update =
+        acceleration.update(rt::prepare_gpu_scene(description.pack()));
+    expect_true(update.kind == rt::AccelerationUpdateKind::update, "material edit updates");
+    expect_true(update.hashed_bytes > 0 && update.hashed_bytes < rebuild.hashed_bytes / 4,
+        "material edit hashes only the material arrays");
+
+    description.set_sphere(0, rt::SpherePrimitive {
+                                  .material_index = material,
+                                  .center = Eigen::Vector3d {0.0, 0.5, -3.0},
+                                  .radius = 0.4,
+                                  .dynamic = true,
+                              });
+    const rt::GpuPreparedScene moved = rt::prepare_gpu_scene(description.pack());
+    const rt::AccelerationUpdateStats refit = acceleration.update(moved);
+    expect_true(refit.kind == rt::AccelerationUpdateKind::refit, "moving a sphere refits");
+    expect_true(refit.hashed_bytes == sizeof(rt::PackedSphere),
+        "per-element stamps limit the hash to the edited sphere");
+
+    // A copy edited elsewhere shares the stamps of its unedited elements
+    rt::SceneDescription fork = description;
+    fork.set_sphere(1, rt::SpherePrimitive {
+                           .material_index = material,
+                           .center = Eigen::Vector3d {1.0, 0.5, -3.0},
+                           .radius = 0.4,
+                       });
+    const rt::AccelerationUpdateStats forked =
+        acceleration.update(rt::prepare_gpu_scene(fork.pack()));
+    expect_true(forked.kind == rt::AccelerationUpdateKind::refit
+                    && forked.hashed_bytes == sizeof(rt::PackedSphere),
+        "switching to an edited copy hashes only the element that differs");
+    acceleration.update(moved);
+
+    // Editing prepared data without clearing its stamp is only caught by the debug cross-check
+    rt::GpuPreparedScene tampered = moved;
+    tampered.spheres.front().radius = 2.0f;
+    expect_true(acceleration.update(tampered).kind == rt::AccelerationUpdateKind::reuse,
+        "stamps are trusted by default");
+    acceleration.set_verify_generations(true);
+    bool threw = false;
+    try {
+        acceleration.update(tampered);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    expect_true(threw, "debug cross-check reports a stale stamp");
+
+    tampered.generations.spheres = 0;
+    expect_true(acceleration.update(tampered).kind == rt::AccelerationUpdateKind::refit,
+        "untracked arrays are compared by content");
+}
+
+rt::MeshPrototype make_tetrahedron() {
+    const Eigen::Vector3d a {0.0, 0.0, 0.0};
+    const Eigen::Vector3d b {1.0, 0.0, 0.0};
+    const Eigen::Vector3d c {0.0, 1.0, 0.0};
+    const Eigen::Vector3d d {0.0, 0.0, 1.0};
+    rt::MeshPrototype prototype;
+    for (const auto& [p0, p1, p2] : {std::tuple {a, c, b}, std::tuple {a, b, d},
+             std::tuple {a, d, c}, std::tuple {b, c, d}}) {
+        prototype.triangles.push_back(rt::TrianglePrimitive {.p0 = p0, .p1 = p1, .p2 = p2});
+    }
+    return prototype;
+}
+
+rt::MeshInstance place_tetrahedron(int prototype, int material, int index,
+    const Eigen::Vector3d& translation) {
+    // Rotated, non-uniformly scaled and sheared, so the instance bounds are not a plain offset
+    const Eigen::Matrix3d rotation =
+        Eigen::AngleAxisd(0.3 * index, Eigen::Vector3d {1.0, 2.0, 0.5}.normalized())
+            .toRotationMatrix();
+    Eigen::Matrix3d scale_shear;
+    scale_shear << 1.5, 0.3, 0.0, //
+        0.0, 0.6, 0.0,            //
+        0.0, 0.0, 2.0;
+    return rt::MeshInstance {
+        .prototype_index = prototype,
+        .material_index = material,
+        .linear = rotation * scale_shear,
+        .translation = translation,
+        .acceleration_prototype_id = 1,
+        .acceleration_instance_id = index + 1,
+    };
+}
+
+// Every instance's placed vertices lie inside the top-level leaf that references it
+bool instances_enclosed(const rt::GpuSceneAcceleration& acceleration,
+    const rt::SceneDescription& description) {
+    bool enclosed = true;
+    for (const rt::PackedBvhNode& node : acceleration.nodes()) {
+        for (int r = 0; r < node.reference_count; ++r) {
+            const rt::PackedPrimitiveRef& reference =
+                acceleration.references().at(static_cast<std::size_t>(node.first_reference + r));
+            if (reference.primitive_type
+                != static_cast<int>(rt::PackedPrimitiveType::mesh_instance)) {
+                continue;
+            }
+            const rt::MeshInstance& instance = description.mesh_instances().at(
+                static_cast<std::size_t>(reference.primitive_index));
+            const rt::MeshPrototype& prototype = description.mesh_prototypes().at(
+                static_cast<std::size_t>(instance.prototype_index));
+            for (const rt::TrianglePrimitive& triangle : prototype.triangles) {
+                for (const Eigen::Vector3d& local : {triangle.p0, triangle.p1, triangle.p2}) {
+                    const Eigen::Vector3f world =
+                        (instance.linear * local + instance.translation).cast<float>();
+                    const Eigen::Vector3f slack = Eigen::Vector3f::Constant(1e-4f);
+                    enclosed = enclosed && contains(node, world + slack, world - slack);
+                }
+            }
+        }
+    }
+    return enclosed;
+}
+
+void test_mesh_instancing() {
+    rt::SceneDescription description;
+    const int material =
+        description.add_material(rt::LambertianMaterial {Eigen::Vector3d {0.5, 0.5, 0.5}});
+    description.add_sphere(rt::SpherePrimitive {
+        .material_index = material,
+        .center = Eigen::Vector3d {0.0, -5.0, 0.0},
+        .radius = 1.0,
+        .dynamic = false,
+        .acceleration_prototype_id = 0,
+        .acceleration_instance_id = 0,
+    });
+    const int tetrahedron = description.add_mesh_prototype(make_tetrahedron());
+    for (int i = 0; i < 16; ++i) {
+        description.add_mesh_instance(place_tetrahedron(tetrahedron, material, i,
+            Eigen::Vector3d {3.0 * (i % 4), 0.0, 3.0 * (i / 4)}));
+    }
+
+    rt::GpuSceneAcceleration acceleration;
+    const rt::AccelerationUpdateStats build =
+        acceleration.update(rt::prepare_gpu_scene(description.pack()));
+    expect_true(build.kind == rt::AccelerationUpdateKind::rebuild, "instanced scene builds");
+    expect_true(build.primitive_reference_count == 17,
+        "the top level references the sphere and each instance once");
+    expect_true(acceleration.bottom_level_references().size() == 4
+                    && acceleration.prototype_roots().size() == 1
+                    && acceleration.prototype_roots().front() == 0,
+        "the prototype's triangles are stored and built once");
+    expect_true(build.bottom_level_node_count >= 1, "bottom-level nodes reported");
+    expect_true(build.prototype_count == 2 && build.instance_count == 17,
+        "instance identities come from the mesh instances");
+    expect_true(build.instanced_primitive_count == 64,
+        "an instance reference stands for every prototype triangle");
+    expect_true(instances_enclosed(acceleration, description),
+        "top-level leaves enclose their transformed instances");
+
+    const std::vector<rt::PackedBvhNode> bottom_level = acceleration.bottom_level_nodes();
+    description.set_mesh_instance(5,
+        place_tetrahedron(tetrahedron, material, 5, Eigen::Vector3d {40.0, 2.0, 0.0}));
+    const rt::AccelerationUpdateStats moved =
+        acceleration.update(rt::prepare_gpu_scene(description.pack()));
+    expect_true(moved.kind == rt::AccelerationUpdateKind::refit,
+        "moving an instance refits the top level");
+    expect_true(moved.node_count == build.node_count, "the refit keeps the top-level topology");
+    const std::vector<rt::PackedBvhNode>& refit_bottom_level = acceleration.bottom_level_nodes();
+    bool bottom_level_kept = bottom_level.size() == refit_bottom_level.size();
+    for (std::size_t i = 0; bottom_level_kept && i < bottom_level.size(); ++i) {
+        bottom_level_kept = bottom_level[i].bounds_min == refit_bottom_level[i].bounds_min
+                            && bottom_level[i].bounds_max == refit_bottom_level[i].bounds_max;
+    }
+    expect_true(bottom_level_kept, "the refit leaves the prototype hierarchy untouched");
+    expect_true(acceleration.nodes().front().bounds_max.x() >= 40.0f,
+        "the root grows around the moved instance");
+    expect_true(instances_enclosed(acceleration, description),
+        "refit leaves enclose their moved instances");
+
+    description.add_mesh_instance(place_tetrahedron(tetrahedron, material, 16,
+        Eigen::Vector3d {-6.0, 0.0, 0.0}));
+    expect_true(acceleration.update(rt::prepare_gpu_scene(description.pack())).kind
+                    == rt::AccelerationUpdateKind::rebuild,
+        "adding an instance rebuilds");
+
+    bool singular_rejected = false;
+    try {
+        rt::MeshInstance flat =
+            place_tetrahedron(tetrahedron, material, 0, Eigen::Vector3d::Zero());
+        flat.linear.col(2).setZero();
+        description.add_mesh_instance(flat);
+    } catch (const std::invalid_argument&) {
+        singular_rejected = true;
+    }
+    expect_true(singular_rejected, "a singular instance transform is rejected");
+    bool unknown_rejected = false;
+    try {
+        description.add_mesh_instance(
+            place_tetrahedron(tetrahedron + 1, material, 0, Eigen::Vector3d::Zero()));
+    } catch (const std::out_of_range&) {
+        unknown_rejected = true;
+    }
+    expect_true(unknown_rejected, "an instance of an unknown prototype is rejected");
+}
+
 } // namespace
 
 int main() {
@@ -81,5 +410,8 @@ int main() {
     expect_true(second_rebuild.instance_count == 3, "rebuild preserves instance identities");
     expect_true(second_rebuild.generation == 4, "second rebuild advances generation");
 
+    test_build_modes();
+    test_generation_tracking();
+    test_mesh_instancing();
     return 0;
 }
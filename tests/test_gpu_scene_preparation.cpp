@@ -112,19 +112,30 @@ int main() {
         "quad edge v");
     expect_true(prepared.quads[0].material_index == light, "quad material");
 
-    expect_vec3f_near(prepared.triangles[0].p0, Eigen::Vector3f {1.0f, 0.0f, 0.0f}, 1e-6f,
-        "triangle p0");
-    expect_vec3f_near(prepared.triangles[0].p1, Eigen::Vector3f {0.0f, 1.0f, 0.0f}, 1e-6f,
-        "triangle p1");
-    expect_vec3f_near(prepared.triangles[0].p2, Eigen::Vector3f {0.0f, 0.0f, 1.0f}, 1e-6f,
-        "triangle p2");
-    expect_vec3f_near(prepared.triangles[0].n1, Eigen::Vector3f {0.0f, 1.0f, 0.0f}, 1e-6f,
-        "triangle n1");
-    expect_true(prepared.triangles[0].has_vertex_normals == 1, "triangle normals flag");
-    expect_true(prepared.triangles[0].has_texcoords == 1, "triangle texcoords flag");
-    expect_near(prepared.triangles[0].uv1.x(), 1.0, 1e-6, "triangle uv1 x");
-    expect_near(prepared.triangles[0].uv2.y(), 1.0, 1e-6, "triangle uv2 y");
-    expect_true(prepared.triangles[0].material_index == metal, "triangle material");
+    const rt::PackedTriangle& triangle = prepared.triangles[0];
+    expect_true(prepared.vertex_positions.size() == 3, "triangle vertex count");
+    expect_true(prepared.vertex_attributes.size() == 3, "triangle attribute count");
+    expect_vec3f_near(prepared.vertex_positions[triangle.vertex0],
+        Eigen::Vector3f {1.0f, 0.0f, 0.0f}, 1e-6f, "triangle p0");
+    expect_vec3f_near(prepared.vertex_positions[triangle.vertex1],
+        Eigen::Vector3f {0.0f, 1.0f, 0.0f}, 1e-6f, "triangle p1");
+    expect_vec3f_near(prepared.vertex_positions[triangle.vertex2],
+        Eigen::Vector3f {0.0f, 0.0f, 1.0f}, 1e-6f, "triangle p2");
+    Eigen::Vector3f n1;
+    rt::decode_octahedral_normal(
+        prepared.vertex_attributes[triangle.vertex1].normal, n1.x(), n1.y(), n1.z());
+    expect_vec3f_near(n1, Eigen::Vector3f {0.0f, 1.0f, 0.0f}, 1e-4f, "triangle n1");
+    expect_true((triangle.flags & rt::kTriangleHasVertexNormals) != 0, "triangle normals flag");
+    expect_true((triangle.flags & rt::kTriangleHasTexcoords) != 0, "triangle texcoords flag");
+    float uv1_x = 0.0f;
+    float uv1_y = 0.0f;
+    float uv2_x = 0.0f;
+    float uv2_y = 0.0f;
+    rt::decode_half2(prepared.vertex_attributes[triangle.vertex1].texcoord, uv1_x, uv1_y);
+    rt::decode_half2(prepared.vertex_attributes[triangle.vertex2].texcoord, uv2_x, uv2_y);
+    expect_near(uv1_x, 1.0, 1e-6, "triangle uv1 x");
+    expect_near(uv2_y, 1.0, 1e-6, "triangle uv2 y");
+    expect_true(triangle.material_index == metal, "triangle material");
 
     expect_vec3f_near(prepared.media[0].local_center_or_min, Eigen::Vector3f {-1.0f, -2.0f, -3.0f},
         1e-6f, "medium min");
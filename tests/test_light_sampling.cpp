@@ -1,3 +1,4 @@
+#include "common/alias_table.h"
 #include "common/cpu_analytic_light.h"
 #include "common/light_sampling.h"
 #include "common/hittable.h"
@@ -7,24 +8,17 @@
 #include <array>
 #include <cmath>
 #include <numbers>
+#include <vector>
 
 namespace {
 
-struct ConstantPdf {
-    double density = 0.0;
-    Vec3d direction = Vec3d::UnitZ();
-
-    double value(const Vec3d&) const { return density; }
-    Vec3d generate() const { return direction; }
-};
-
 struct SamplingProbe {
     bool hit(const Ray&, const Interval&, HitRecord&) const { return false; }
     AABB bounding_box() const { return AABB {Vec3d {-1.0, -1.0, -1.0}, Vec3d::Ones()}; }
     double pdf_value(const Vec3d& origin, const Vec3d& direction) const {
         return 10.0 + origin.x() + 2.0 * origin.z() + 3.0 * direction.x() + 5.0 * direction.z();
     }
-    Vec3d random(const Vec3d&) const { return {1.0, 2.0, 3.0}; }
+    Vec3d random(const Vec3d&, rt::PathSampler&) const { return {1.0, 2.0, 3.0}; }
 };
 
 } // namespace
@@ -156,13 +150,15 @@ int main() {
     const pro::proxy<Hittable> probe_proxy = pro::make_proxy_shared<Hittable, SamplingProbe>(probe);
     const Vec3d origin {4.0, 2.0, 1.0};
     const Vec3d direction {-2.0, 1.0, -3.0};
+    rt::PathSampler sampler {0, 0};
 
     const Vec3d offset {1.5, -0.5, 2.0};
     const Translate translated {probe_proxy, offset};
     expect_near(translated.pdf_value(origin, direction),
         probe.pdf_value(origin - offset, direction), 1e-12,
         "translated light evaluates its PDF in object space");
-    expect_vec3_near(translated.random(origin), probe.random(origin - offset), 1e-12,
+    expect_vec3_near(translated.random(origin, sampler),
+        probe.random(origin - offset, sampler), 1e-12,
         "translated light samples an object-space direction");
 
     const RotateY rotated {probe_proxy, 90.0};
@@ -171,27 +167,31 @@ int main() {
     expect_near(rotated.pdf_value(origin, direction),
         probe.pdf_value(local_origin, local_direction), 1e-12,
         "rotated light evaluates its PDF in object space");
-    expect_vec3_near(rotated.random(origin), Vec3d {3.0, 2.0, -1.0}, 1e-12,
+    expect_vec3_near(rotated.random(origin, sampler), Vec3d {3.0, 2.0, -1.0}, 1e-12,
         "rotated light maps sampled directions back to world space");
 
-    const pro::proxy<PDF> bsdf_pdf =
-        pro::make_proxy_shared<PDF, ConstantPdf>(ConstantPdf {.density = 0.2});
-    const pro::proxy<PDF> geometry_and_environment =
+    const CosinePDF cosine_pdf {Vec3d {-1.0, 0.5, -2.0}};
+    const ScatterPdf bsdf_pdf = cosine_pdf;
+    const double bsdf_density = cosine_pdf.value(direction);
+    const LightMisPdf geometry_and_environment =
         make_light_mis_pdf(bsdf_pdf, probe_proxy, origin, true);
     const double geometry_pdf = probe.pdf_value(origin, direction);
     const double environment_pdf = 1.0 / (4.0 * std::numbers::pi);
-    expect_near(geometry_and_environment->value(direction),
-        0.5 * 0.2 + 0.5 * (0.5 * geometry_pdf + 0.5 * environment_pdf), 1e-12,
+    expect_near(geometry_and_environment.value(direction),
+        0.5 * bsdf_density + 0.5 * (0.5 * geometry_pdf + 0.5 * environment_pdf), 1e-12,
         "CPU BSDF, geometry, and environment mixture reports its sampling PDF");
 
     const pro::proxy<Hittable> no_geometry;
-    const pro::proxy<PDF> environment_only =
-        make_light_mis_pdf(bsdf_pdf, no_geometry, origin, true);
-    expect_near(environment_only->value(direction), 0.5 * 0.2 + 0.5 * environment_pdf, 1e-12,
-        "CPU environment mixture stays normalized without geometry lights");
-    const pro::proxy<PDF> bsdf_only = make_light_mis_pdf(bsdf_pdf, no_geometry, origin, false);
-    expect_near(bsdf_only->value(direction), 0.2, 1e-12,
+    const LightMisPdf environment_only = make_light_mis_pdf(bsdf_pdf, no_geometry, origin, true);
+    expect_near(environment_only.value(direction), 0.5 * bsdf_density + 0.5 * environment_pdf,
+        1e-12, "CPU environment mixture stays normalized without geometry lights");
+    const LightMisPdf bsdf_only = make_light_mis_pdf(bsdf_pdf, no_geometry, origin, false);
+    expect_near(bsdf_only.value(direction), bsdf_density, 1e-12,
         "black-environment no-light path preserves the BSDF PDF exactly");
+    rt::PathSampler mixture_sampler {3, 7};
+    rt::PathSampler bsdf_sampler {3, 7};
+    expect_vec3_near(bsdf_only.generate(mixture_sampler), cosine_pdf.generate(bsdf_sampler), 0.0,
+        "the BSDF-only mixture draws exactly the BSDF's direction");
 
     float w0 = 0.0f;
     float w1 = 0.0f;
@@ -199,5 +199,57 @@ int main() {
     rt::sample_uniform_triangle(0.36f, 0.25f, w0, w1, w2);
     expect_near(w0 + w1 + w2, 1.0, 1e-6, "triangle barycentrics normalize");
     expect_true(w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f, "triangle barycentrics are non-negative");
+
+    const std::array<double, 5> weights {1.0, 0.0, 3.0, 4.0, 2.0};
+    const std::vector<rt::AliasTableEntry> table = rt::build_alias_table(weights);
+    std::array<double, 5> alias_mass {};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        alias_mass[i] += table[i].probability / 5.0;
+        alias_mass[static_cast<std::size_t>(table[i].alias)] += (1.0 - table[i].probability) / 5.0;
+    }
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+        expect_near(alias_mass[i], weights[i] / 10.0, 1e-12, "alias table reproduces the weights");
+    }
+
+    std::array<rt::PackedLight, 5> alias_lights {};
+    for (std::size_t i = 0; i < alias_lights.size(); ++i) {
+        alias_lights[i].selection_pdf = static_cast<float>(weights[i] / 10.0);
+        alias_lights[i].alias_probability = static_cast<float>(table[i].probability);
+        alias_lights[i].alias = table[i].alias;
+    }
+    constexpr int kStrata = 100000;
+    std::array<int, 5> counts {};
+    for (int s = 0; s < kStrata; ++s) {
+        const float u = (static_cast<float>(s) + 0.5f) / kStrata;
+        ++counts[static_cast<std::size_t>(rt::sample_packed_light(alias_lights.data(), 5, u))];
+    }
+    expect_true(counts[1] == 0, "alias selection never picks a zero-weight light");
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+        expect_near(static_cast<double>(counts[i]) / kStrata, weights[i] / 10.0, 1e-3,
+            "stratified alias selection follows the weights");
+    }
+    expect_true(rt::sample_packed_light(alias_lights.data(), 5, 1.0f) != 1,
+        "alias selection clamps the upper boundary");
+
+    std::vector<rt::AnalyticLightDesc> distant_pair(2);
+    for (rt::AnalyticLightDesc& light : distant_pair) {
+        light.type = rt::AnalyticLightType::distant;
+        light.radiance = Eigen::Vector3d::Ones();
+        light.delta = true;
+    }
+    distant_pair[0].selection_weight = 1.0;
+    distant_pair[1].selection_weight = 3.0;
+    rt::finalize_analytic_light_distribution(distant_pair);
+    expect_true(distant_pair[0].alias >= 0 && distant_pair[1].alias >= 0,
+        "finalized analytic lights carry an alias table");
+    const rt::CpuAnalyticLightSampler alias_sampler {distant_pair};
+    int second = 0;
+    for (int s = 0; s < 1000; ++s) {
+        const double u = (s + 0.5) / 1000.0;
+        const rt::CpuAnalyticLightSample sample =
+            alias_sampler.sample(Eigen::Vector3d::Zero(), u, 0.5, 0.5);
+        second += sample.valid && std::abs(sample.pdf - 0.75) < 1e-12 ? 1 : 0;
+    }
+    expect_near(second / 1000.0, 0.75, 2e-3, "CPU sampler selects through the alias table");
     return 0;
 }
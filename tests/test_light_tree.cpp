@@ -0,0 +1,265 @@
+#include "common/analytic_light_tree.h"
+#include "common/common.h"
+#include "common/cpu_analytic_light.h"
+#include "common/interval.h"
+#include "common/ray.h"
+#include "test_support.h"
+
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+namespace {
+
+rt::AnalyticLightDesc make_sphere(const Eigen::Vector3d& position, double radius, double power) {
+    rt::AnalyticLightDesc light;
+    light.type = rt::AnalyticLightType::sphere;
+    light.position = position;
+    light.radius = radius;
+    light.radiance = Eigen::Vector3d::Ones();
+    light.world_area = 4.0 * std::numbers::pi * radius * radius;
+    light.selection_weight = power;
+    return light;
+}
+
+// Unit rect at position facing +z
+rt::AnalyticLightDesc make_rect(const Eigen::Vector3d& position, double power) {
+    rt::AnalyticLightDesc light;
+    light.type = rt::AnalyticLightType::rect;
+    light.position = position;
+    light.local_to_world_linear.col(1) = -Eigen::Vector3d::UnitY();
+    light.radiance = Eigen::Vector3d::Ones();
+    light.world_area = 1.0;
+    light.selection_weight = power;
+    return light;
+}
+
+rt::PackedLightVector3 to_point(const Eigen::Vector3d& point) {
+    return {static_cast<float>(point.x()), static_cast<float>(point.y()),
+        static_cast<float>(point.z())};
+}
+
+// 10x10x5 spheres and 10x10 rects above them, plus a dome
+std::vector<rt::AnalyticLightDesc> make_city() {
+    std::vector<rt::AnalyticLightDesc> lights;
+    for (int z = 0; z < 5; ++z) {
+        for (int y = 0; y < 10; ++y) {
+            for (int x = 0; x < 10; ++x) {
+                lights.push_back(make_sphere(Eigen::Vector3d {3.0 * x, 3.0 * y, -3.0 * z}, 0.25,
+                    1.0 + 0.1 * ((x + 2 * y + 3 * z) % 7)));
+            }
+        }
+    }
+    for (int y = 0; y < 10; ++y) {
+        for (int x = 0; x < 10; ++x) {
+            lights.push_back(make_rect(Eigen::Vector3d {3.0 * x + 1.5, 3.0 * y + 1.5, 2.0}, 2.0));
+        }
+    }
+    rt::AnalyticLightDesc dome;
+    dome.type = rt::AnalyticLightType::dome;
+    dome.radiance = Eigen::Vector3d::Constant(0.1);
+    dome.selection_weight = 50.0;
+    lights.push_back(dome);
+    rt::finalize_analytic_light_distribution(lights);
+    return lights;
+}
+
+void test_tree_structure() {
+    const std::vector<rt::AnalyticLightDesc> lights = make_city();
+    const rt::AnalyticLightTree tree = rt::build_analytic_light_tree(lights);
+    const std::size_t finite = lights.size() - 1;
+    expect_true(tree.nodes.size() == 2 * finite - 1, "one leaf per finite light");
+    expect_true(tree.infinite.size() == 1 && tree.infinite[0].light_index == 600,
+        "the dome stays out of the tree");
+    expect_true(tree.light_leaves.back() == -1, "infinite lights have no leaf");
+
+    bool leaves_match = true;
+    int max_depth = 0;
+    for (std::size_t i = 0; i < finite; ++i) {
+        const int leaf = tree.light_leaves[i];
+        leaves_match = leaves_match && leaf >= 0
+                       && tree.nodes[leaf].light_index == static_cast<int>(i)
+                       && tree.nodes[leaf].second_child < 0;
+        int depth = 0;
+        for (int node = leaf; tree.nodes[node].parent >= 0; node = tree.nodes[node].parent) {
+            ++depth;
+        }
+        max_depth = std::max(max_depth, depth);
+    }
+    expect_true(leaves_match, "every finite light owns exactly its leaf");
+    expect_true(max_depth <= rt::kLightTreeMaxDepth, "tree depth fits the traversal stacks");
+
+    bool bounds_nest = true;
+    bool power_adds_up = true;
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const rt::LightTreeNode& node = tree.nodes[i];
+        if (node.second_child < 0) {
+            continue;
+        }
+        for (const int child : {static_cast<int>(i) + 1, node.second_child}) {
+            const rt::LightTreeNode& inner = tree.nodes[child];
+            bounds_nest = bounds_nest && inner.parent == static_cast<int>(i)
+                          && inner.bounds_min.x >= node.bounds_min.x
+                          && inner.bounds_max.x <= node.bounds_max.x
+                          && inner.bounds_min.z >= node.bounds_min.z
+                          && inner.bounds_max.z <= node.bounds_max.z;
+        }
+        power_adds_up = power_adds_up
+                        && std::abs(node.power - tree.nodes[i + 1].power
+                                    - tree.nodes[node.second_child].power)
+                               <= 1e-5f * node.power;
+    }
+    expect_true(bounds_nest, "child bounds nest inside their parent");
+    expect_true(power_adds_up, "node power is the sum of its children");
+    expect_near(tree.nodes[0].power, 1.0 - lights.back().selection_pdf, 1e-5,
+        "the root carries the finite lights' share of the distribution");
+}
+
+void test_selection_probabilities() {
+    const std::vector<rt::AnalyticLightDesc> lights = make_city();
+    const rt::CpuAnalyticLightSampler sampler {lights};
+    const rt::AnalyticLightTree& tree = sampler.tree();
+    const int node_count = static_cast<int>(tree.nodes.size());
+
+    // Below the rects a node's cone can reach the point while none of its rects does; that share
+    // of the traversal fails instead of picking a light that cannot contribute.
+    double below_total = 0.0;
+    for (int i = 0; i < static_cast<int>(lights.size()); ++i) {
+        below_total += sampler.selection_pdf(i, Eigen::Vector3d {1.0, 2.0, 0.5});
+    }
+    expect_true(below_total < 1.0, "unreachable subtrees lose their share below the rects");
+    expect_near(sampler.selection_pdf(550, Eigen::Vector3d {1.0, 2.0, 0.5}), 0.0, 0.0,
+        "rects facing away are never chosen");
+
+    for (const Eigen::Vector3d& point : {Eigen::Vector3d {1.0, 2.0, 3.0},
+             Eigen::Vector3d {40.0, -5.0, 9.0}, Eigen::Vector3d {14.0, 14.0, -20.0}}) {
+        double total = 0.0;
+        for (int i = 0; i < static_cast<int>(lights.size()); ++i) {
+            total += sampler.selection_pdf(i, point);
+        }
+        expect_near(total, 1.0, 1e-4, "selection probabilities at a point sum to one");
+
+        bool pmf_matches = true;
+        for (int s = 0; s < 256; ++s) {
+            float pmf = 0.0f;
+            const float u = (static_cast<float>(s) + 0.5f) / 256.0f;
+            const int light = rt::sample_light_tree(tree.nodes.data(), node_count, to_point(point),
+                u, pmf);
+            const float expected = rt::light_tree_pmf(tree.nodes.data(), node_count,
+                tree.light_leaves[static_cast<std::size_t>(light)], to_point(point));
+            pmf_matches = pmf_matches && light >= 0 && std::abs(pmf - expected) <= 1e-5f * expected;
+        }
+        expect_true(pmf_matches, "traversal and leaf-to-root PMFs agree");
+    }
+
+    // Stratified selection frequencies follow the reported probabilities
+    const Eigen::Vector3d point {4.0, 4.0, 3.0};
+    constexpr int kStrata = 200000;
+    std::vector<int> counts(lights.size(), 0);
+    for (int s = 0; s < kStrata; ++s) {
+        const float u = (static_cast<float>(s) + 0.5f) / kStrata;
+        const int light = rt::sample_light_hierarchy(tree.nodes.data(), node_count,
+            tree.infinite.data(), static_cast<int>(tree.infinite.size()), to_point(point), u);
+        if (light >= 0) {
+            ++counts[static_cast<std::size_t>(light)];
+        }
+    }
+    double worst_error = 0.0;
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        const double expected = sampler.selection_pdf(static_cast<int>(i), point);
+        worst_error = std::max(worst_error,
+            std::abs(static_cast<double>(counts[i]) / kStrata - expected));
+    }
+    expect_true(worst_error < 1e-3, "stratified selection frequencies match selection_pdf");
+    expect_near(static_cast<double>(counts.back()) / kStrata, lights.back().selection_pdf, 1e-4,
+        "the dome keeps its global selection probability");
+}
+
+void test_importance_prefers_nearby_lights() {
+    std::vector<rt::AnalyticLightDesc> lights {
+        make_sphere(Eigen::Vector3d {1.0, 0.0, 0.0}, 0.1, 1.0),
+        make_sphere(Eigen::Vector3d {-20.0, 0.0, 0.0}, 0.1, 1.0),
+        make_rect(Eigen::Vector3d {0.0, 5.0, 2.0}, 1.0),
+    };
+    rt::finalize_analytic_light_distribution(lights);
+    const rt::CpuAnalyticLightSampler sampler {lights};
+    const Eigen::Vector3d point = Eigen::Vector3d::Zero();
+    expect_true(sampler.selection_pdf(0, point) > 50.0 * sampler.selection_pdf(1, point),
+        "an equally bright light twenty times closer is chosen far more often");
+    expect_near(sampler.selection_pdf(2, point), 0.0, 0.0,
+        "a one-sided rect facing away from the point is never chosen");
+    expect_true(sampler.selection_pdf(2, Eigen::Vector3d {0.0, 5.0, 4.0}) > 0.0,
+        "the same rect is chosen from in front");
+}
+
+void test_intersection_matches_brute_force() {
+    const std::vector<rt::AnalyticLightDesc> lights = make_city();
+    const rt::CpuAnalyticLightSampler sampler {lights};
+
+    int hits = 0;
+    bool matches = true;
+    for (int i = 0; i < 2000; ++i) {
+        const double a = 0.61803398875 * i - std::floor(0.61803398875 * i);
+        const double b = 0.7548776662 * i - std::floor(0.7548776662 * i);
+        const Eigen::Vector3d origin {-5.0 + 40.0 * a, -5.0 + 40.0 * b, 8.0};
+        const Eigen::Vector3d target {30.0 * b, 30.0 * a, -12.0 * a};
+        const Ray ray {origin, target - origin};
+
+        double expected_t = infinity;
+        int expected_light = -1;
+        for (std::size_t j = 0; j < lights.size(); ++j) {
+            const rt::CpuAnalyticLightSampler single {{lights[j]}};
+            rt::CpuAnalyticLightHit single_hit;
+            if (single.intersect(ray, Interval {0.001, expected_t}, single_hit)) {
+                expected_t = single_hit.t;
+                expected_light = static_cast<int>(j);
+            }
+        }
+        rt::CpuAnalyticLightHit hit;
+        const bool found = sampler.intersect(ray, Interval {0.001, infinity}, hit);
+        matches = matches && found == (expected_light >= 0)
+                  && (!found || (hit.light_index == expected_light
+                                    && std::abs(hit.t - expected_t) < 1e-9));
+        hits += found ? 1 : 0;
+    }
+    expect_true(hits > 50, "the probe rays hit some lights");
+    expect_true(matches, "tree traversal finds the same closest light as a linear scan");
+}
+
+void test_mis_pdfs_stay_consistent() {
+    const std::vector<rt::AnalyticLightDesc> lights = make_city();
+    const rt::CpuAnalyticLightSampler sampler {lights};
+    const Eigen::Vector3d point {7.0, 8.0, -1.5};
+
+    int checked = 0;
+    bool consistent = true;
+    for (int s = 0; s < 512; ++s) {
+        const double u = (s + 0.5) / 512.0;
+        const rt::CpuAnalyticLightSample sample = sampler.sample(point, u, 0.3, 0.6);
+        if (!sample.valid || sample.infinite || sample.delta) {
+            continue;
+        }
+        rt::CpuAnalyticLightHit hit;
+        if (!sampler.intersect(Ray {point, sample.direction}, Interval {1e-6, infinity}, hit)
+            || std::abs(hit.t - sample.distance) > 1e-6) {
+            continue;
+        }
+        const double pdf = sampler.pdf_for_hit(hit, point, sample.direction);
+        consistent = consistent && std::abs(pdf - sample.pdf) <= 1e-9 * sample.pdf;
+        ++checked;
+    }
+    expect_true(checked > 100, "most light samples reach their light unobstructed");
+    expect_true(consistent, "light sampling and BSDF-hit PDFs match through the tree");
+}
+
+} // namespace
+
+int main() {
+    test_tree_structure();
+    test_selection_probabilities();
+    test_importance_prefers_nearby_lights();
+    test_intersection_matches_brute_force();
+    test_mis_pdfs_stay_consistent();
+    return 0;
+}
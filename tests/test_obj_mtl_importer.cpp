@@ -2,9 +2,12 @@
 
 #include "test_support.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -51,9 +54,12 @@ void test_obj_importer_creates_triangle_mesh_and_material() {
     expect_true(std::holds_alternative<rt::scene::TriangleMeshShape>(imported.scene_ir.shapes().front()), "mesh type");
     const auto& mesh =
         std::get<rt::scene::TriangleMeshShape>(imported.scene_ir.shapes().front());
-    expect_true(mesh.normals.size() == 1, "obj normal values preserved");
-    expect_true(mesh.normal_indices == std::vector<Eigen::Vector3i>({{0, 0, 0}}),
-        "obj normal indices preserved");
+    expect_true(mesh.normals.size() == 3
+                    && std::all_of(mesh.normals.begin(), mesh.normals.end(),
+                        [](const Eigen::Vector3d& normal) { return normal == Eigen::Vector3d::UnitZ(); }),
+        "obj normal values preserved per welded vertex");
+    expect_true(mesh.normal_indices == std::vector<Eigen::Vector3i>({{0, 1, 2}}),
+        "obj normal indices follow the welded vertices");
     expect_true(mesh.texcoords.size() == 3, "obj texcoord values preserved");
     expect_true(mesh.texcoord_indices == std::vector<Eigen::Vector3i>({{0, 1, 2}}),
         "obj texcoord indices preserved");
@@ -93,6 +99,86 @@ void test_obj_importer_rebases_map_kd_relative_to_mtl() {
         "texture dependency");
 }
 
+// Spans several parse chunks, switches material mid-file and mixes absolute and negative indices
+void test_obj_importer_welds_across_chunks() {
+    constexpr int kSide = 600;
+    constexpr int kSplitRow = 299;
+    const fs::path root = fs::temp_directory_path() / "obj_mtl_importer_chunks";
+    fs::remove_all(root);
+    const fs::path obj_file = root / "grid.obj";
+    write_text_file(root / "grid.mtl", "newmtl near\nKd 1 0 0\nnewmtl far\nKd 0 0 1\n");
+
+    std::ostringstream obj;
+    obj << "mtllib grid.mtl\n";
+    for (int z = 0; z < kSide; ++z) {
+        for (int x = 0; x < kSide; ++x) {
+            obj << "v " << x << " 0 " << z << "\nvt " << x << " " << z << "\n";
+        }
+    }
+    constexpr int kVertexCount = kSide * kSide;
+    obj << "usemtl near\n";
+    for (int z = 0; z + 1 < kSide; ++z) {
+        if (z == kSplitRow) {
+            obj << "usemtl far\n";
+        }
+        for (int x = 0; x + 1 < kSide; ++x) {
+            const int corners[4] {z * kSide + x + 1, (z + 1) * kSide + x + 1, (z + 1) * kSide + x + 2,
+                z * kSide + x + 2};
+            obj << "f";
+            for (const int corner : corners) {
+                const int index = (x + z) % 2 == 0 ? corner : corner - kVertexCount - 1;
+                obj << " " << index << "/" << index;
+            }
+            obj << "\n";
+        }
+    }
+    write_text_file(obj_file, obj.str());
+
+    const rt::scene::ObjImportResult imported = rt::scene::import_obj_mtl(obj_file);
+    expect_true(imported.stats.chunk_count > 1, "the file is parsed in several chunks");
+    expect_true(imported.stats.triangle_count == 2U * (kSide - 1) * (kSide - 1), "quads are fanned");
+    expect_true(imported.scene_ir.shapes().size() == 2, "one mesh per material");
+    const int row_counts[2] {kSplitRow, kSide - 1 - kSplitRow};
+    for (int i = 0; i < 2; ++i) {
+        const auto& mesh = std::get<rt::scene::TriangleMeshShape>(imported.scene_ir.shapes()[i]);
+        expect_true(mesh.positions.size() == static_cast<std::size_t>((row_counts[i] + 1) * kSide),
+            "shared grid corners weld into one vertex");
+        expect_true(mesh.texcoord_indices == mesh.triangles && mesh.normals.empty(),
+            "texcoords follow the welded vertices");
+        double area = 0.0;
+        for (const Eigen::Vector3i& triangle : mesh.triangles) {
+            const Eigen::Vector3d& p0 = mesh.positions[triangle[0]];
+            area += 0.5 * (mesh.positions[triangle[1]] - p0).cross(mesh.positions[triangle[2]] - p0).norm();
+        }
+        expect_near(area, static_cast<double>(row_counts[i] * (kSide - 1)), 1e-6,
+            "absolute and negative indices cover the material's rows exactly");
+        bool texcoords_match = true;
+        for (std::size_t v = 0; v < mesh.positions.size(); ++v) {
+            texcoords_match = texcoords_match && mesh.texcoords[v].x() == mesh.positions[v].x()
+                              && mesh.texcoords[v].y() == mesh.positions[v].z();
+        }
+        expect_true(texcoords_match, "welded texcoords stay paired with their positions");
+    }
+    expect_true(imported.stats.vertex_count == static_cast<std::uint64_t>((kSide + 1) * kSide),
+        "only the split row is shared between materials");
+    expect_true(imported.stats.megabytes_per_second > 0.0 && imported.stats.peak_rss_bytes > 0,
+        "throughput and peak memory are reported");
+}
+
+void test_obj_importer_reports_failing_line() {
+    const fs::path root = fs::temp_directory_path() / "obj_mtl_importer_bad_line";
+    fs::remove_all(root);
+    const fs::path obj_file = root / "bad.obj";
+    write_text_file(obj_file, "v 0 0 0\n# comment\nv 1 zero 0\nv 0 1 0\nf 1 2 3\n");
+
+    const std::string error = require_error([&]() { (void)rt::scene::import_obj_mtl(obj_file); });
+    expect_true(error.find("line 3: invalid number 'zero'") != std::string::npos, "parse error line");
+
+    write_text_file(obj_file, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n");
+    const std::string range_error = require_error([&]() { (void)rt::scene::import_obj_mtl(obj_file); });
+    expect_true(range_error.find("out of range") != std::string::npos, "index range error");
+}
+
 void test_obj_importer_errors_are_prefixed_with_obj_path() {
     const fs::path root = fs::temp_directory_path() / "obj_mtl_importer_missing_obj";
     fs::remove_all(root);
@@ -103,11 +189,31 @@ void test_obj_importer_errors_are_prefixed_with_obj_path() {
     expect_true(error.rfind(expected_prefix, 0) == 0, "obj error prefix");
 }
 
+void test_obj_importer_reports_mtl_warnings() {
+    const fs::path root = fs::temp_directory_path() / "obj_mtl_importer_mtl_warning";
+    fs::remove_all(root);
+    const fs::path obj_file = root / "triangle.obj";
+    const fs::path mtl_file = root / "triangle.mtl";
+    write_text_file(
+        obj_file, "mtllib triangle.mtl\nv 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl glass\nf 1 2 3\n");
+    write_text_file(mtl_file, "newmtl glass\nKd 0.5 0.5 0.5\nd 0.5\nTr 0.5\n");
+
+    const rt::scene::ObjImportResult imported = rt::scene::import_obj_mtl(obj_file);
+    expect_true(imported.warnings.size() == 1, "one mtl warning");
+    const std::string expected_prefix = mtl_file.lexically_normal().string() + ": ";
+    expect_true(imported.warnings.front().rfind(expected_prefix, 0) == 0, "mtl warning prefix");
+    expect_true(imported.warnings.front().find("`d` and `Tr`") != std::string::npos,
+        "mtl warning text");
+}
+
 }  // namespace
 
 int main() {
     test_obj_importer_creates_triangle_mesh_and_material();
     test_obj_importer_rebases_map_kd_relative_to_mtl();
+    test_obj_importer_welds_across_chunks();
+    test_obj_importer_reports_failing_line();
     test_obj_importer_errors_are_prefixed_with_obj_path();
+    test_obj_importer_reports_mtl_warnings();
     return 0;
 }
@@ -251,6 +251,23 @@ int main() {
         "shared-scene equi render keeps authored dimensions");
     expect_true(cv::norm(shared_pinhole, shared_equi, cv::NORM_L1) > 0.0,
         "shared-scene preset path honors camera model changes");
+
+    // Authored scenes light through emissive geometry only, so ReSTIR DI finds no analytic
+    // lights to resample and both render paths keep the plain image
+    rt::OfflineRenderOptions restir_options;
+    restir_options.restir.enabled = true;
+    restir_options.restir.min_analytic_lights = 0;
+    const cv::Mat plain = rt::render_shared_scene("phase2_shared_pinhole", 4);
+    const cv::Mat restir = rt::render_shared_scene("phase2_shared_pinhole", 4, restir_options);
+    expect_true(cv::norm(plain, restir, cv::NORM_L1) == 0.0,
+        "ReSTIR DI leaves a scene without analytic lights unchanged");
+    rt::ProgressiveRenderOptions restir_progressive;
+    restir_progressive.samples_per_pass = 1;
+    const rt::ProgressiveRenderResult restir_passes = rt::render_shared_scene_progressive(
+        "phase2_shared_pinhole", 4, restir_options, restir_progressive);
+    expect_true(restir_passes.completed, "progressive ReSTIR DI render completes");
+    expect_true(restir_passes.image.cols == 64 && restir_passes.image.rows == 48,
+        "progressive ReSTIR DI render keeps authored dimensions");
     rt::scene::global_scene_file_catalog().scan_directory("assets/scenes");
     return 0;
 }
@@ -542,7 +542,7 @@ void test_imported_scalar_image(const std::filesystem::path& fixture) {
         "ND_image_float compiles into the scalar binding table");
     const int roughness_index = with_image.scalar_textures.specular_roughness.texture_index;
     const double sampled_roughness = textures[static_cast<std::size_t>(roughness_index)]
-                                         ->value(0.5, 0.5, Vec3d::Zero())
+                                         ->value(0.5, 0.5, Vec3d::Zero(), 0.0)
                                          .x();
     expect_near(sampled_roughness, 0.6, 1.0 / 255.0,
         "CPU proxy reads the raw scalar image channel");
@@ -597,7 +597,9 @@ int main(int argc, char** argv) {
         "CPU OpenPBR reference ray hits the sphere");
     const Vec3d emitted = hit.mat->emitted(primary, hit, hit.u, hit.v, hit.p);
     ScatterRecord scatter;
-    expect_true(hit.mat->scatter(primary, hit, scatter), "CPU OpenPBR reference material scatters");
+    rt::PathSampler sampler {0, 0};
+    expect_true(hit.mat->scatter(primary, hit, scatter, sampler),
+        "CPU OpenPBR reference material scatters");
     expect_true(scatter.skip_pdf, "CPU OpenPBR core owns the sampled direction and weight");
     const rt::OpenPbrVec3 decoded_base = rt::openpbr_source_to_linear({0.5f, 0.25f, 0.75f},
         rt::OpenPbrSourceColorSpace::srgb_texture);
@@ -699,9 +701,11 @@ int main(int argc, char** argv) {
     entry_hit.v = 0.0;
     entry_hit.set_face_normal(entering_ray, Vec3d {0.0, 0.0, 1.0});
     ScatterRecord entry_scatter;
+    rt::PathSampler subsurface_sampler {0, 0};
     bool entered = false;
     for (int attempt = 0; attempt < 128 && !entered; ++attempt) {
-        entered = subsurface_material.scatter(entering_ray, entry_hit, entry_scatter)
+        entered = subsurface_material.scatter(
+                      entering_ray, entry_hit, entry_scatter, subsurface_sampler)
                   && entry_scatter.skip_pdf_ray.subsurface_medium().active != 0;
     }
     expect_true(entered, "CPU OpenPBR production material enters random-walk medium state");
@@ -712,7 +716,7 @@ int main(int argc, char** argv) {
         rt::OpenPbrCompiledMaterial {.parameters = subsurface_parameters}, {}};
     ScatterRecord wrong_owner_scatter;
     expect_true(!other_subsurface_material.scatter(entry_scatter.skip_pdf_ray, entry_hit,
-                    wrong_owner_scatter),
+                    wrong_owner_scatter, subsurface_sampler),
         "CPU random walk cannot cross a different OpenPBR material boundary");
 
     const Ray exiting_ray {Vec3d::Zero(), Vec3d {0.0, 0.0, 1.0}, 0.0,
@@ -726,7 +730,8 @@ int main(int argc, char** argv) {
     ScatterRecord exit_scatter;
     bool exited = false;
     for (int attempt = 0; attempt < 128 && !exited; ++attempt) {
-        exited = subsurface_material.scatter(exiting_ray, exit_hit, exit_scatter)
+        exited = subsurface_material.scatter(
+                     exiting_ray, exit_hit, exit_scatter, subsurface_sampler)
                  && exit_scatter.skip_pdf_ray.subsurface_medium().active == 0;
     }
     expect_true(exited, "CPU OpenPBR production material exits random-walk medium state");
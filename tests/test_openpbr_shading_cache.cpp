@@ -0,0 +1,105 @@
+#include "common/material.h"
+#include "common/ray.h"
+#include "test_support.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Solid color that counts its lookups
+struct CountingTexture {
+    Vec3d color;
+    std::shared_ptr<int> lookups;
+
+    Vec3d value(double, double, const Vec3d&, double) const {
+        ++*lookups;
+        return color;
+    }
+};
+
+struct ShadingResults {
+    Vec3d emitted = Vec3d::Zero();
+    Vec3d attenuation = Vec3d::Zero();
+    double scattering_pdf = 0.0;
+    Vec3d direct = Vec3d::Zero();
+    double direct_pdf = 0.0;
+};
+
+// The queries an integrator makes at one hit: emission, a light sample, scattering and the pdf of
+// the sampled direction
+ShadingResults shade(const pro::proxy<Material>& material, HitRecord hit_rec) {
+    const Ray ray_in {Vec3d {0.3, 0.2, 1.0}, Vec3d {-0.3, -0.2, -1.0}};
+    rt::PathSampler sampler {5, 1};
+    ShadingResults results;
+    results.emitted = material->emitted(ray_in, hit_rec, hit_rec.u, hit_rec.v, hit_rec.p);
+    results.direct = material->evaluate_direct(
+        ray_in, hit_rec, Vec3d {0.2, -0.1, 1.0}.normalized(), results.direct_pdf);
+    ScatterRecord scatter_rec;
+    expect_true(material->scatter(ray_in, hit_rec, scatter_rec, sampler),
+        "the OpenPBR surface scatters");
+    results.attenuation = scatter_rec.attenuation;
+    results.scattering_pdf = material->scattering_pdf(ray_in, hit_rec, scatter_rec.skip_pdf_ray);
+    return results;
+}
+
+void test_textures_are_evaluated_once_per_hit() {
+    const auto lookups = std::make_shared<int>(0);
+    const std::vector<pro::proxy<Texture>> textures {
+        pro::make_proxy_shared<Texture, CountingTexture>(
+            CountingTexture {Vec3d {0.6, 0.3, 0.2}, lookups}),
+        pro::make_proxy_shared<Texture, CountingTexture>(
+            CountingTexture {Vec3d {0.4, 0.4, 0.4}, lookups}),
+        pro::make_proxy_shared<Texture, CountingTexture>(
+            CountingTexture {Vec3d {2.0, 1.0, 0.5}, lookups}),
+    };
+    rt::OpenPbrCompiledMaterial compiled;
+    compiled.parameters.emission_luminance = 1.0f;
+    compiled.color_textures.base_color.texture_index = 0;
+    compiled.scalar_textures.specular_roughness.texture_index = 1;
+    compiled.color_textures.emission_color.texture_index = 2;
+    const pro::proxy<Material> material =
+        pro::make_proxy_shared<Material, OpenPbrSurfaceMaterial>(compiled, textures);
+
+    HitRecord hit_rec;
+    hit_rec.p = Vec3d::Zero();
+    hit_rec.normal = Vec3d::UnitZ();
+    hit_rec.mat = material;
+    hit_rec.t = 1.0;
+    hit_rec.u = 0.25;
+    hit_rec.v = 0.75;
+    hit_rec.front_face = true;
+
+    const ShadingResults uncached = shade(material, hit_rec);
+    const int uncached_lookups = *lookups;
+
+    *lookups = 0;
+    ShadingPoint shading;
+    hit_rec.shading = &shading;
+    const ShadingResults cached = shade(material, hit_rec);
+    expect_true(*lookups == 3, "each bound texture is read once per hit with a shading point");
+    expect_true(uncached_lookups == 1 + 3 * 3, "without one every query reads its textures again");
+    expect_true(shading.material != nullptr, "the shading point records its material");
+
+    expect_vec3_near(cached.emitted, uncached.emitted, 0.0, "cached emission");
+    expect_vec3_near(cached.attenuation, uncached.attenuation, 0.0, "cached scattering weight");
+    expect_near(cached.scattering_pdf, uncached.scattering_pdf, 0.0, "cached scattering pdf");
+    expect_vec3_near(cached.direct, uncached.direct, 0.0, "cached direct-light response");
+    expect_near(cached.direct_pdf, uncached.direct_pdf, 0.0, "cached direct-light pdf");
+    expect_vec3_near(cached.emitted, Vec3d {2.0, 1.0, 0.5}, 1e-6, "textured emission");
+
+    // A fresh shading point for the next intersection sees that hit's inputs
+    *lookups = 0;
+    ShadingPoint next_shading;
+    hit_rec.shading = &next_shading;
+    hit_rec.u = 0.5;
+    shade(material, hit_rec);
+    expect_true(*lookups == 3, "a new intersection evaluates its textures again");
+}
+
+} // namespace
+
+int main() {
+    test_textures_are_evaluated_once_per_hit();
+    return 0;
+}
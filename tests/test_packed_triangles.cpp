@@ -0,0 +1,293 @@
+#include "common/vertex_quantization.h"
+#include "realtime/gpu/packed_scene_preparation.h"
+#include "realtime/scene_description.h"
+#include "test_support.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// The unindexed layout stored three float positions, normals and texcoords per triangle
+constexpr std::size_t kUnindexedTriangleBytes = 128;
+
+void test_normal_round_trip() {
+    float worst_error = 0.0f;
+    for (int i = 0; i < 4096; ++i) {
+        const double a = 0.61803398875 * i - std::floor(0.61803398875 * i);
+        const double z = 2.0 * (i + 0.5) / 4096.0 - 1.0;
+        const double r = std::sqrt(1.0 - z * z);
+        const double phi = 2.0 * std::numbers::pi * a;
+        const Eigen::Vector3f normal =
+            Eigen::Vector3d {r * std::cos(phi), r * std::sin(phi), z}.cast<float>();
+        Eigen::Vector3f decoded;
+        rt::decode_octahedral_normal(
+            rt::encode_octahedral_normal(normal.x(), normal.y(), normal.z()), decoded.x(),
+            decoded.y(), decoded.z());
+        worst_error = std::max(worst_error, (decoded - normal).norm());
+    }
+    expect_true(worst_error < 1e-4f, "octahedral normals keep a tenth of a milliradian");
+
+    for (const Eigen::Vector3f& axis : {Eigen::Vector3f {1.0f, 0.0f, 0.0f},
+             Eigen::Vector3f {0.0f, -1.0f, 0.0f}, Eigen::Vector3f {0.0f, 0.0f, 1.0f},
+             Eigen::Vector3f {0.0f, 0.0f, -1.0f}}) {
+        Eigen::Vector3f decoded;
+        rt::decode_octahedral_normal(rt::encode_octahedral_normal(axis.x(), axis.y(), axis.z()),
+            decoded.x(), decoded.y(), decoded.z());
+        expect_true((decoded - axis).norm() < 1e-6f, "axis normals decode exactly");
+    }
+}
+
+void test_half_round_trip() {
+    for (const float exact : {0.0f, 1.0f, -2.5f, 0.125f, 65504.0f, 6.103515625e-5f}) {
+        expect_true(rt::half_bits_to_float(rt::float_to_half_bits(exact)) == exact,
+            "representable values survive the half conversion");
+    }
+    expect_true(rt::float_to_half_bits(-0.0f) == 0x8000u, "negative zero keeps its sign");
+    expect_true(rt::half_bits_to_float(rt::float_to_half_bits(5.9604645e-8f)) == 5.9604645e-8f,
+        "the smallest subnormal survives");
+    expect_true(rt::half_bits_to_float(rt::float_to_half_bits(1e6f))
+                    == std::numeric_limits<float>::infinity(),
+        "overflow rounds to infinity");
+    expect_true(std::isnan(rt::half_bits_to_float(
+                    rt::float_to_half_bits(std::numeric_limits<float>::quiet_NaN()))),
+        "NaN stays NaN");
+    expect_true(rt::float_to_half_bits(1.0f + 1.0f / 2048.0f) == rt::float_to_half_bits(1.0f),
+        "ties round to even");
+
+    float worst_error = 0.0f;
+    for (int i = 0; i <= 10000; ++i) {
+        const float value = static_cast<float>(i) / 10000.0f;
+        float u = 0.0f;
+        float v = 0.0f;
+        rt::decode_half2(rt::encode_half2(value, 1.0f - value), u, v);
+        worst_error = std::max({worst_error, std::abs(u - value), std::abs(v - (1.0f - value))});
+    }
+    expect_true(worst_error <= 1.0f / 4096.0f, "unit-range texcoords keep about 12 bits");
+}
+
+// A height-field grid with smooth normals and unit-range texcoords, submitted as a triangle soup
+rt::SceneDescription make_grid_scene(int cells) {
+    rt::SceneDescription scene;
+    const int material =
+        scene.add_material(rt::LambertianMaterial {.albedo = Eigen::Vector3d::Constant(0.5)});
+    const auto vertex = [cells](int x, int z) {
+        const double u = static_cast<double>(x) / cells;
+        const double v = static_cast<double>(z) / cells;
+        const double height = 0.2 * std::sin(4.0 * u) * std::cos(3.0 * v);
+        const Eigen::Vector3d normal =
+            Eigen::Vector3d {-0.8 * std::cos(4.0 * u) * std::cos(3.0 * v), 1.0,
+                0.6 * std::sin(4.0 * u) * std::sin(3.0 * v)}
+                .normalized();
+        return std::tuple {Eigen::Vector3d {u, height, v}, normal, Eigen::Vector2d {u, v}};
+    };
+    for (int z = 0; z < cells; ++z) {
+        for (int x = 0; x < cells; ++x) {
+            const auto [p00, n00, uv00] = vertex(x, z);
+            const auto [p10, n10, uv10] = vertex(x + 1, z);
+            const auto [p01, n01, uv01] = vertex(x, z + 1);
+            const auto [p11, n11, uv11] = vertex(x + 1, z + 1);
+            for (const auto& [p0, p1, p2, n0, n1, n2, uv0, uv1, uv2] :
+                {std::tuple {p00, p01, p10, n00, n01, n10, uv00, uv01, uv10},
+                    std::tuple {p10, p01, p11, n10, n01, n11, uv10, uv01, uv11}}) {
+                scene.add_triangle(rt::TrianglePrimitive {
+                    .material_index = material,
+                    .p0 = p0,
+                    .p1 = p1,
+                    .p2 = p2,
+                    .n0 = n0,
+                    .n1 = n1,
+                    .n2 = n2,
+                    .uv0 = uv0,
+                    .uv1 = uv1,
+                    .uv2 = uv2,
+                    .has_vertex_normals = true,
+                    .has_texcoords = true,
+                });
+            }
+        }
+    }
+    return scene;
+}
+
+void test_grid_welds_shared_vertices() {
+    constexpr int kCells = 48;
+    const rt::SceneDescription scene = make_grid_scene(kCells);
+    const rt::GpuPreparedScene prepared = rt::prepare_gpu_scene(scene.pack());
+
+    const std::size_t triangle_count = 2 * kCells * kCells;
+    expect_true(prepared.triangles.size() == triangle_count, "every triangle is kept");
+    expect_true(prepared.vertex_positions.size() == std::size_t {kCells + 1} * (kCells + 1),
+        "corners shared by neighbouring triangles weld into one vertex");
+    expect_true(prepared.vertex_attributes.size() == prepared.vertex_positions.size(),
+        "attributes run parallel to positions");
+    expect_true(sizeof(rt::PackedTriangle) == 20, "an indexed triangle takes 20 bytes");
+    expect_true(sizeof(rt::PackedVertexAttributes) == 8, "a vertex's attributes take 8 bytes");
+
+    const std::size_t indexed_bytes =
+        prepared.triangles.size() * sizeof(rt::PackedTriangle)
+        + prepared.vertex_positions.size() * sizeof(Eigen::Vector3f)
+        + prepared.vertex_attributes.size() * sizeof(rt::PackedVertexAttributes);
+    const double reduction =
+        static_cast<double>(triangle_count * kUnindexedTriangleBytes) / indexed_bytes;
+    expect_true(reduction >= 4.0, "the indexed layout uploads at least four times less");
+
+    bool faithful = true;
+    const std::vector<rt::TrianglePrimitive>& source = scene.triangles();
+    for (std::size_t i = 0; i < source.size(); ++i) {
+        const rt::PackedTriangle& triangle = prepared.triangles[i];
+        const std::uint32_t corners[3] {triangle.vertex0, triangle.vertex1, triangle.vertex2};
+        const Eigen::Vector3d points[3] {source[i].p0, source[i].p1, source[i].p2};
+        const Eigen::Vector3d normals[3] {source[i].n0, source[i].n1, source[i].n2};
+        const Eigen::Vector2d texcoords[3] {source[i].uv0, source[i].uv1, source[i].uv2};
+        for (int corner = 0; corner < 3; ++corner) {
+            const rt::PackedVertexAttributes& attributes =
+                prepared.vertex_attributes[corners[corner]];
+            Eigen::Vector3f normal;
+            rt::decode_octahedral_normal(attributes.normal, normal.x(), normal.y(), normal.z());
+            float u = 0.0f;
+            float v = 0.0f;
+            rt::decode_half2(attributes.texcoord, u, v);
+            faithful = faithful
+                       && prepared.vertex_positions[corners[corner]]
+                              == points[corner].cast<float>()
+                       && (normal.cast<double>() - normals[corner]).norm() < 1e-4
+                       && std::abs(u - texcoords[corner].x()) <= 1.0 / 4096.0
+                       && std::abs(v - texcoords[corner].y()) <= 1.0 / 4096.0;
+        }
+    }
+    expect_true(faithful, "indexed corners reproduce the submitted vertices");
+}
+
+void test_seams_and_flags() {
+    rt::SceneDescription scene;
+    const int material =
+        scene.add_material(rt::LambertianMaterial {.albedo = Eigen::Vector3d::Constant(0.5)});
+    const Eigen::Vector3d a {0.0, 0.0, 0.0};
+    const Eigen::Vector3d b {1.0, 0.0, 0.0};
+    const Eigen::Vector3d c {0.0, 1.0, 0.0};
+    const Eigen::Vector3d d {1.0, 1.0, 0.0};
+    // Two triangles on either side of a texture seam along b-c
+    scene.add_triangle(rt::TrianglePrimitive {.material_index = material,
+        .p0 = a,
+        .p1 = b,
+        .p2 = c,
+        .uv0 = Eigen::Vector2d {0.0, 0.0},
+        .uv1 = Eigen::Vector2d {1.0, 0.0},
+        .uv2 = Eigen::Vector2d {0.0, 1.0},
+        .has_texcoords = true});
+    scene.add_triangle(rt::TrianglePrimitive {.material_index = material,
+        .p0 = b,
+        .p1 = d,
+        .p2 = c,
+        .uv0 = Eigen::Vector2d {0.5, 0.0},
+        .uv1 = Eigen::Vector2d {1.0, 1.0},
+        .uv2 = Eigen::Vector2d {0.0, 0.5},
+        .has_texcoords = true});
+    // A degenerate normal drops the triangle back to its geometric normal
+    scene.add_triangle(rt::TrianglePrimitive {.material_index = material,
+        .p0 = a,
+        .p1 = -b,
+        .p2 = -c,
+        .n0 = Eigen::Vector3d::UnitZ(),
+        .n1 = Eigen::Vector3d::Zero(),
+        .n2 = Eigen::Vector3d::UnitZ(),
+        .has_vertex_normals = true});
+
+    const rt::GpuPreparedScene prepared = rt::prepare_gpu_scene(scene.pack());
+    expect_true(prepared.vertex_positions.size() == 8,
+        "corners on either side of a texture seam stay separate vertices");
+    expect_true(prepared.triangles[0].vertex1 != prepared.triangles[1].vertex0,
+        "a texture seam keeps both sides");
+    expect_true(prepared.triangles[1].flags == rt::kTriangleHasTexcoords, "texcoord flag");
+    expect_true(prepared.triangles[2].flags == 0, "an unusable vertex normal is dropped");
+    expect_true(prepared.triangle_acceleration_ids.size() == 3,
+        "every triangle keeps its acceleration ids");
+}
+
+// A unit quad on two triangles, indexed the way an importer hands it over
+rt::IndexedTriangleMesh make_indexed_quad(int material) {
+    const std::uint32_t up = rt::encode_octahedral_normal(0.0f, 0.0f, 1.0f);
+    return rt::IndexedTriangleMesh {
+        .positions = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f}},
+        .normals = {up, up, up, up},
+        .texcoords = {rt::encode_half2(0.0f, 0.0f), rt::encode_half2(1.0f, 0.0f),
+            rt::encode_half2(1.0f, 1.0f), rt::encode_half2(0.0f, 1.0f)},
+        .triangles = {{0, 1, 2}, {0, 2, 3}},
+        .material_indices = {material, material},
+        .acceleration_prototype_id = 4,
+        .acceleration_instance_id = 7,
+    };
+}
+
+void test_indexed_meshes_copy_their_streams() {
+    rt::SceneDescription scene;
+    const int material =
+        scene.add_material(rt::LambertianMaterial {.albedo = Eigen::Vector3d::Constant(0.5)});
+    scene.add_triangle(rt::TrianglePrimitive {.material_index = material,
+        .p0 = Eigen::Vector3d {0.0, 0.0, 2.0},
+        .p1 = Eigen::Vector3d {1.0, 0.0, 2.0},
+        .p2 = Eigen::Vector3d {0.0, 1.0, 2.0}});
+    scene.add_triangle_mesh(make_indexed_quad(material));
+    scene.add_mesh_prototype(rt::MeshPrototype {.mesh = make_indexed_quad(-1)});
+
+    const rt::PackedScene packed = scene.pack();
+    expect_true(packed.triangle_count == 3, "the triangle count includes indexed meshes");
+    const rt::GpuPreparedScene prepared = rt::prepare_gpu_scene(packed);
+    expect_true(prepared.triangles.size() == 3, "indexed mesh triangles follow the soup");
+    expect_true(prepared.vertex_positions.size() == 7 && prepared.vertex_attributes.size() == 7,
+        "an indexed mesh adds its own vertices");
+    const rt::PackedTriangle& second = prepared.triangles[2];
+    expect_true(second.vertex0 == 3 && second.vertex1 == 5 && second.vertex2 == 6,
+        "indexed mesh triangles are offset past the soup's vertices");
+    expect_true(second.flags == (rt::kTriangleHasVertexNormals | rt::kTriangleHasTexcoords),
+        "indexed mesh streams set the attribute flags");
+    float u = 0.0f;
+    float v = 0.0f;
+    rt::decode_half2(prepared.vertex_attributes[6].texcoord, u, v);
+    expect_true(u == 0.0f && v == 1.0f, "indexed mesh attributes are copied as packed");
+    expect_true(prepared.triangle_acceleration_ids[2].prototype_id == 4
+                    && prepared.triangle_acceleration_ids[2].instance_id == 7,
+        "indexed mesh triangles keep the mesh's acceleration ids");
+    const std::vector<std::uint64_t>& stamps = prepared.generations.triangle_elements;
+    expect_true(stamps.size() == 3 && stamps[1] == stamps[2] && stamps[1] != stamps[0],
+        "indexed mesh triangles carry their mesh's stamp");
+
+    expect_true(prepared.mesh_prototypes.size() == 1
+                    && prepared.mesh_prototypes[0].triangle_count == 2,
+        "a prototype's indexed mesh counts toward its triangles");
+    expect_true(prepared.prototype_vertex_positions.size() == 4
+                    && prepared.prototype_triangles[1].material_index == -1,
+        "a prototype's indexed mesh is copied into the prototype streams");
+
+    rt::IndexedTriangleMesh broken = make_indexed_quad(material);
+    broken.triangles[1][2] = 4;
+    bool rejected = false;
+    try {
+        scene.add_triangle_mesh(broken);
+    } catch (const std::out_of_range&) {
+        rejected = true;
+    }
+    expect_true(rejected, "an indexed mesh with an out-of-range vertex is rejected");
+}
+
+} // namespace
+
+int main() {
+    test_normal_round_trip();
+    test_half_round_trip();
+    test_grid_welds_shared_vertices();
+    test_seams_and_flags();
+    test_indexed_meshes_copy_their_streams();
+    return 0;
+}
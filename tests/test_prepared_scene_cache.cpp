@@ -0,0 +1,197 @@
+#include "realtime/gpu/packed_scene_preparation.h"
+#include "realtime/gpu/prepared_scene_cache.h"
+#include "realtime/scene_description.h"
+#include "test_support.h"
+
+#include <Eigen/Core>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void write_text(const fs::path& path, const std::string& text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+}
+
+// A scene file with one dependency in a subdirectory, as the YAML loader would report it
+rt::PreparedSceneSource make_source_tree(const fs::path& root) {
+    write_text(root / "scene.yaml", "format_version: 1\nscene: {}\n");
+    write_text(root / "meshes" / "grid.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+    return rt::PreparedSceneSource {
+        .scene_file = root / "scene.yaml",
+        .dependencies = {(root / "scene.yaml").string(), (root / "meshes" / "grid.obj").string()},
+    };
+}
+
+rt::SceneDescription make_scene() {
+    rt::SceneDescription scene;
+    const int matte =
+        scene.add_material(rt::LambertianMaterial {.albedo = Eigen::Vector3d::Constant(0.5)});
+    const int lamp =
+        scene.add_material(rt::DiffuseLightMaterial {.emission = Eigen::Vector3d::Constant(4.0)});
+    scene.add_sphere(rt::SpherePrimitive {matte, Eigen::Vector3d {0.0, 1.0, 0.0}, 1.0, false});
+    scene.add_quad(rt::QuadPrimitive {lamp, Eigen::Vector3d {-1.0, 3.0, -1.0},
+        Eigen::Vector3d {2.0, 0.0, 0.0}, Eigen::Vector3d {0.0, 0.0, 2.0}, false});
+    for (int i = 0; i < 16; ++i) {
+        const Eigen::Vector3d corner {0.25 * i, 0.0, 0.0};
+        scene.add_triangle(rt::TrianglePrimitive {
+            .material_index = matte,
+            .p0 = corner,
+            .p1 = corner + Eigen::Vector3d {0.25, 0.0, 0.0},
+            .p2 = corner + Eigen::Vector3d {0.0, 0.0, 0.25},
+        });
+    }
+    return scene;
+}
+
+template<typename Scene>
+std::vector<std::span<const std::byte>> prepared_bytes(const Scene& scene) {
+    std::vector<std::span<const std::byte>> arrays;
+    rt::visit_prepared_arrays(scene,
+        [&arrays](const auto& array) { arrays.push_back(std::as_bytes(std::span {array})); });
+    return arrays;
+}
+
+bool same_prepared_arrays(const rt::GpuPreparedSceneView& a, const rt::GpuPreparedSceneView& b) {
+    const std::vector<std::span<const std::byte>> left = prepared_bytes(a);
+    const std::vector<std::span<const std::byte>> right = prepared_bytes(b);
+    bool same = left.size() == right.size() && a.background == b.background;
+    for (std::size_t i = 0; same && i < left.size(); ++i) {
+        same = left[i].size() == right[i].size()
+               && (left[i].empty()
+                   || std::memcmp(left[i].data(), right[i].data(), left[i].size()) == 0);
+    }
+    return same;
+}
+
+// Moves a file's modification time without touching its contents or size
+void touch(const fs::path& path) {
+    fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds {2});
+}
+
+void test_cache_round_trip() {
+    const fs::path root = fs::temp_directory_path() / "prepared_scene_cache_round_trip";
+    fs::remove_all(root);
+    const rt::PreparedSceneSource source = make_source_tree(root);
+    const rt::PackedScene packed = make_scene().pack();
+
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "a scene without a cache misses");
+    const rt::GpuPreparedScene prepared = rt::prepare_and_cache_gpu_scene(packed, source);
+    expect_true(fs::exists(root / "scene.rtcache"), "the cache is written next to the scene");
+    expect_true(!prepared.lights.empty() && !prepared.vertex_positions.empty(),
+        "the scene exercises lights and vertex streams");
+
+    const rt::GpuPreparedSceneView owned = prepared;
+    expect_true(owned.generations == &prepared.generations
+                    && owned.triangles.data() == prepared.triangles.data(),
+        "an owned preparation views its own arrays and generations");
+
+    std::optional<rt::MappedPreparedScene> mapped =
+        rt::MappedPreparedScene::open(source.scene_file);
+    expect_true(mapped.has_value(), "an unchanged source hits");
+    const rt::GpuPreparedSceneView& view = mapped->view();
+    expect_true(same_prepared_arrays(view, owned),
+        "cached arrays match the preparation that wrote them");
+    expect_true(view.generations == nullptr, "a mapped view carries no generations");
+    expect_true(mapped->mapped_bytes() == fs::file_size(root / "scene.rtcache"),
+        "the whole file is mapped");
+    expect_true(reinterpret_cast<std::uintptr_t>(view.triangles.data()) % 64 == 0,
+        "sections are aligned");
+
+    const rt::PackedTriangle* triangles = view.triangles.data();
+    const rt::MappedPreparedScene moved = std::move(*mapped);
+    expect_true(moved.view().triangles.data() == triangles,
+        "moving the mapping keeps the spans in place");
+}
+
+void test_stamps_follow_sources() {
+    const fs::path root = fs::temp_directory_path() / "prepared_scene_cache_stamps";
+    const fs::path moved = fs::temp_directory_path() / "prepared_scene_cache_stamps_moved";
+    fs::remove_all(root);
+    fs::remove_all(moved);
+    const rt::PreparedSceneSource source = make_source_tree(root);
+    rt::write_prepared_scene_cache(source, rt::prepare_gpu_scene(make_scene().pack()));
+    expect_true(rt::MappedPreparedScene::open(source.scene_file).has_value(), "a fresh file opens");
+
+    // The tree and its cache move together; copies keep their stamps
+    fs::copy(root, moved, fs::copy_options::recursive);
+    for (const char* file : {"scene.yaml", "meshes/grid.obj"}) {
+        fs::last_write_time(moved / file, fs::last_write_time(root / file));
+    }
+    expect_true(rt::MappedPreparedScene::open(moved / "scene.yaml").has_value(),
+        "a relocated scene tree keeps its cache");
+
+    touch(root / "meshes" / "grid.obj");
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "a dependency with a new modification time is stale");
+
+    write_text(moved / "meshes" / "grid.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n# edit\n");
+    fs::last_write_time(moved / "meshes" / "grid.obj",
+        fs::last_write_time(root / "meshes" / "grid.obj") - std::chrono::seconds {2});
+    expect_true(!rt::MappedPreparedScene::open(moved / "scene.yaml").has_value(),
+        "a dependency with a new size is stale");
+
+    rt::write_prepared_scene_cache(source, rt::prepare_gpu_scene(make_scene().pack()));
+    touch(source.scene_file);
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "an edited scene file is stale");
+
+    rt::write_prepared_scene_cache(source, rt::prepare_gpu_scene(make_scene().pack()));
+    fs::remove(root / "meshes" / "grid.obj");
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "a missing dependency is stale");
+}
+
+void test_rejects_damaged_files() {
+    const fs::path root = fs::temp_directory_path() / "prepared_scene_cache_damage";
+    fs::remove_all(root);
+    const rt::PreparedSceneSource source = make_source_tree(root);
+    const fs::path cache = rt::prepared_scene_cache_path(source.scene_file);
+    rt::write_prepared_scene_cache(source, rt::prepare_gpu_scene(make_scene().pack()));
+    expect_true(cache == root / "scene.rtcache", "the cache path follows the scene file");
+
+    fs::resize_file(cache, fs::file_size(cache) - 8);
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "a truncated file is rejected");
+
+    write_text(cache, std::string(4096, '\0'));
+    expect_true(!rt::MappedPreparedScene::open(source.scene_file).has_value(),
+        "a file without the header is rejected");
+
+    rt::PreparedSceneSource missing = source;
+    missing.dependencies.push_back((root / "absent.png").string());
+    bool threw = false;
+    try {
+        rt::write_prepared_scene_cache(missing, rt::prepare_gpu_scene(make_scene().pack()));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    expect_true(threw, "a source that cannot be stamped is not cached");
+    const rt::GpuPreparedScene prepared =
+        rt::prepare_and_cache_gpu_scene(make_scene().pack(), missing);
+    expect_true(prepared.spheres.size() == 1, "a failed cache write still prepares the scene");
+}
+
+} // namespace
+
+int main() {
+    test_cache_round_trip();
+    test_stamps_follow_sources();
+    test_rejects_damaged_files();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "common/camera.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/render_accumulation.h"
+#include "common/sphere.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+struct ProgressiveFixture {
+    HittableList world;
+    HittableList lights;
+};
+
+ProgressiveFixture make_fixture() {
+    ProgressiveFixture fixture;
+    const auto diffuse = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.7, 0.3, 0.2});
+    const auto glass = pro::make_proxy_shared<Material, Dielectric>(1.5);
+    const auto emitter = pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {6.0, 6.0, 6.0});
+
+    fixture.world.add(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {-0.4, 0.0, -1.6}, 0.4, diffuse));
+    fixture.world.add(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.4, 0.0, -1.6}, 0.4, glass));
+    fixture.world.add(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, -100.4, -1.6}, 100.0, diffuse));
+    fixture.world.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {-0.75, 1.25, -2.2},
+        Vec3d {1.5, 0.0, 0.0}, Vec3d {0.0, 0.0, 1.0}, emitter));
+    fixture.lights.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {-0.75, 1.25, -2.2},
+        Vec3d {1.5, 0.0, 0.0}, Vec3d {0.0, 0.0, 1.0},
+        pro::make_proxy_shared<Material, EmptyMaterial>()));
+    return fixture;
+}
+
+void configure(Camera& cam, const Camera::Integrator integrator) {
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 24;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 6;
+    cam.background = {0.05, 0.05, 0.1};
+    cam.integrator = integrator;
+}
+
+void expect_images_match(const cv::Mat& expected, const cv::Mat& actual, const char* message) {
+    // Float accumulation rounds the per-pixel sums differently from the one-shot double sum
+    expect_true(!expected.empty() && expected.size() == actual.size()
+                    && cv::norm(expected, actual, cv::NORM_INF) <= 1.0,
+        message);
+}
+
+void test_progressive_passes_match_one_shot_render() {
+    ProgressiveFixture fixture = make_fixture();
+    pro::proxy<Hittable> world = &fixture.world;
+    pro::proxy<Hittable> lights = &fixture.lights;
+
+    for (const Camera::Integrator integrator :
+        {Camera::Integrator::recursive, Camera::Integrator::wavefront}) {
+        Camera one_shot;
+        configure(one_shot, integrator);
+        one_shot.render(world, lights);
+
+        Camera progressive;
+        configure(progressive, integrator);
+        int passes = 0;
+        Camera::ProgressiveOptions options;
+        options.samples_per_pass = 5; // Does not divide the grid, so the last pass is partial
+        options.on_pass = [&passes](const rt::RenderAccumulation&) { ++passes; };
+        expect_true(progressive.render_progressive(world, lights, {}, options),
+            "progressive render completes without a deadline");
+        expect_true(passes == 4, "progressive render runs ceil(16 / 5) passes");
+        expect_true(progressive.accumulation.min_sample_count() == 16,
+            "every pixel receives the full sample grid");
+        expect_images_match(
+            one_shot.img, progressive.img, "progressive passes reproduce the one-shot image");
+    }
+}
+
+void test_checkpoint_round_trip() {
+    rt::RenderAccumulation accumulation = rt::make_render_accumulation(3, 2, 9, 42);
+    accumulation.label = "unit";
+    accumulation.radiance_sum.at<cv::Vec3f>(1, 2) = cv::Vec3f(1.5f, 2.5f, 3.5f);
+    accumulation.luminance_square_sum.at<float>(1, 2) = 4.25f;
+    accumulation.sample_count.at<std::int32_t>(1, 2) = 7;
+
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "test_progressive_render_round_trip.rtaccum";
+    rt::save_render_checkpoint(path, accumulation);
+    const rt::RenderAccumulation loaded = rt::load_render_checkpoint(path);
+    std::filesystem::remove(path);
+
+    expect_true(loaded.label == "unit" && loaded.seed == 42 && loaded.width() == 3
+                    && loaded.height() == 2 && loaded.target_samples_per_pixel == 9,
+        "checkpoint header round-trips");
+    expect_true(loaded.radiance_sum.at<cv::Vec3f>(1, 2) == cv::Vec3f(1.5f, 2.5f, 3.5f)
+                    && loaded.luminance_square_sum.at<float>(1, 2) == 4.25f
+                    && loaded.sample_count.at<std::int32_t>(1, 2) == 7
+                    && loaded.min_sample_count() == 0,
+        "checkpoint sums and counts round-trip");
+
+    bool threw = false;
+    try {
+        rt::load_render_checkpoint(path);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    expect_true(threw, "loading a missing checkpoint throws");
+}
+
+void test_resume_after_deadline_matches_uninterrupted_render() {
+    ProgressiveFixture fixture = make_fixture();
+    pro::proxy<Hittable> world = &fixture.world;
+    pro::proxy<Hittable> lights = &fixture.lights;
+
+    Camera reference;
+    configure(reference, Camera::Integrator::recursive);
+    reference.render(world, lights);
+
+    // A deadline in the past stops before the first pass, leaving an empty accumulation
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "test_progressive_render_resume.rtaccum";
+    Camera interrupted;
+    configure(interrupted, Camera::Integrator::recursive);
+    Camera::ProgressiveOptions stopped;
+    stopped.samples_per_pass = 4;
+    stopped.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    expect_true(!interrupted.render_progressive(world, lights, {}, stopped),
+        "render reports incomplete when the deadline has passed");
+    expect_true(interrupted.accumulation.min_sample_count() == 0, "no samples after the deadline");
+
+    // One pass, checkpointed, then resumed by a fresh camera
+    Camera::ProgressiveOptions one_pass;
+    one_pass.samples_per_pass = 4;
+    one_pass.on_pass = [&](const rt::RenderAccumulation& accumulation) {
+        rt::save_render_checkpoint(path, accumulation);
+        one_pass.deadline = std::chrono::steady_clock::now();
+    };
+    expect_true(!interrupted.render_progressive(world, lights, {}, one_pass),
+        "first pass leaves the render incomplete");
+    expect_true(interrupted.accumulation.min_sample_count() == 4, "first pass adds four samples");
+
+    Camera resumed;
+    configure(resumed, Camera::Integrator::wavefront);
+    resumed.accumulation = rt::load_render_checkpoint(path);
+    std::filesystem::remove(path);
+    expect_true(resumed.render_progressive(world, lights, {}, Camera::ProgressiveOptions {}),
+        "resumed render completes");
+    expect_images_match(
+        reference.img, resumed.img, "resumed render matches the uninterrupted render");
+
+    Camera mismatched;
+    configure(mismatched, Camera::Integrator::recursive);
+    mismatched.samples_per_pixel = 25;
+    mismatched.accumulation = resumed.accumulation;
+    bool threw = false;
+    try {
+        mismatched.render_progressive(world, lights, {}, Camera::ProgressiveOptions {});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    expect_true(threw, "resuming with a different sample grid throws");
+}
+
+} // namespace
+
+int main() {
+    test_progressive_passes_match_one_shot_render();
+    test_checkpoint_round_trip();
+    test_resume_after_deadline_matches_uninterrupted_render();
+    return 0;
+}
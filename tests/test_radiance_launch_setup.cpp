@@ -3,15 +3,7 @@
 #include "test_support.h"
 
 int main() {
-    rt::PackedScene scene;
-    scene.background = Eigen::Vector3d {0.1, 0.2, 0.3};
-    scene.spheres.resize(2);
-    scene.quads.resize(3);
-    scene.triangles.resize(4);
-    scene.media.resize(5);
-    scene.textures.resize(6);
-    scene.materials.resize(7);
-    scene.analytic_lights.resize(10);
+    const Eigen::Vector3f background {0.1f, 0.2f, 0.3f};
 
     rt::DeviceSceneView scene_view {};
     scene_view.spheres = reinterpret_cast<rt::PackedSphere*>(0x10);
@@ -21,7 +13,14 @@ int main() {
     scene_view.textures = reinterpret_cast<rt::PackedTexture*>(0x50);
     scene_view.image_texels = reinterpret_cast<Eigen::Vector3f*>(0x60);
     scene_view.materials = reinterpret_cast<rt::MaterialSample*>(0x70);
+    scene_view.sphere_count = 2;
+    scene_view.quad_count = 3;
+    scene_view.triangle_count = 4;
+    scene_view.medium_count = 5;
+    scene_view.texture_count = 6;
+    scene_view.material_count = 7;
     scene_view.image_texel_count = 8;
+    scene_view.analytic_light_count = 10;
 
     rt::PackedCameraRig rig;
     rig.active_count = 1;
@@ -71,8 +70,8 @@ int main() {
     history_state.prev_basis_y[1] = 1.0;
     history_state.prev_basis_z[2] = 1.0;
 
-    const rt::LaunchParams params = rt::make_radiance_launch_params(scene, scene_view, rig, profile,
-        0, 42, frame, history_state);
+    const rt::LaunchParams params = rt::make_radiance_launch_params(background, scene_view, rig,
+        profile, 0, 42, frame, history_state);
 
     expect_true(params.width == 64, "width from camera");
     expect_true(params.height == 48, "height from camera");
@@ -92,9 +91,9 @@ int main() {
                     == static_cast<int>(rt::RestirBiasCorrectionMode::basic),
         "ReSTIR BASIC bias correction mode");
     expect_true(params.restir_min_analytic_lights == 10, "ReSTIR many-light threshold");
-    rt::PackedScene sparse_scene = scene;
-    sparse_scene.analytic_lights.resize(9);
-    const rt::LaunchParams sparse_params = rt::make_radiance_launch_params(sparse_scene, scene_view,
+    rt::DeviceSceneView sparse_view = scene_view;
+    sparse_view.analytic_light_count = 9;
+    const rt::LaunchParams sparse_params = rt::make_radiance_launch_params(background, sparse_view,
         rig, profile, 0, 42, frame, history_state);
     expect_true(sparse_params.restir_di_enabled == 0,
         "ReSTIR stays off below the configured many-light threshold");
@@ -140,8 +139,8 @@ int main() {
     expect_near(next_history.prev_basis_z[2], 1.0, 1e-12, "next prev basis z");
 
     rt::LaunchHistoryState empty_history {};
-    const rt::LaunchParams first_params = rt::make_radiance_launch_params(scene, scene_view, rig,
-        profile, 0, 7, frame, empty_history);
+    const rt::LaunchParams first_params = rt::make_radiance_launch_params(background, scene_view,
+        rig, profile, 0, 7, frame, empty_history);
     const rt::LaunchHistoryState first_next = rt::capture_launch_history(first_params);
     expect_true(first_next.history_length == 1, "first history length becomes one");
 
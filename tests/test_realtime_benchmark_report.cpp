@@ -52,6 +52,9 @@ int main() {
         .launch_parameter_upload_count = 8,
         .acceleration_update_kind = "rebuild",
         .acceleration_update_ms = 0.25,
+        .acceleration_build_mode = "binned_sah",
+        .acceleration_build_ms = 0.125,
+        .acceleration_sah_cost = 3.5,
         .acceleration_node_count = 7,
         .acceleration_reference_count = 8,
         .acceleration_prototype_count = 3,
@@ -231,6 +234,9 @@ int main() {
         "json persistent launch parameter allocations");
     expect_true(json_text.find("\"acceleration_update_kind\": \"rebuild\"") != std::string::npos,
         "json acceleration lifecycle kind");
+    expect_true(json_text.find("\"acceleration_build_mode\": \"binned_sah\"") != std::string::npos
+                    && json_text.find("\"acceleration_sah_cost\": 3.5") != std::string::npos,
+        "json acceleration build quality");
     expect_true(json_text.find("\"nvidia_driver_version\": \"595.71.05\"") != std::string::npos,
         "json NVIDIA driver version");
     expect_true(json_text.find("\"pipeline_ms\"") != std::string::npos, "json pipeline timing");
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <stdexcept>
 
 namespace {
 
@@ -54,5 +55,31 @@ int main() {
         "camera 0 resumes accumulation after jump");
     expect_true(after_jump.frames[1].history_length == 2,
         "camera 1 resumes accumulation after jump");
+
+    rt::RealtimePipeline cpu_pipeline(rt::RealtimeBackend::cpu, 2);
+    const rt::RealtimeFrameSet cpu_first =
+        cpu_pipeline.render_profiled_smoke_frame(2, rt::RenderProfile::balanced());
+    expect_true(cpu_first.frames.size() == 2, "cpu backend renders two cameras");
+    expect_true(cpu_first.frames[1].history_length == 1, "cpu camera 1 history starts at 1");
+    expect_true(cpu_first.frames[0].radiance.average_luminance > 0.01,
+        "cpu camera 0 radiance should be non-black");
+    const rt::RealtimeFrameSet cpu_second =
+        cpu_pipeline.render_profiled_smoke_frame(2, rt::RenderProfile::balanced());
+    expect_true(cpu_second.frames[0].history_length == 2, "cpu camera 0 accumulates");
+    const rt::RealtimeFrameSet cpu_reset =
+        cpu_pipeline.render_profiled_smoke_frame_with_pose_jump(2, rt::RenderProfile::balanced());
+    expect_true(cpu_reset.frames[0].history_length == 1, "cpu camera 0 reset");
+
+    bool too_many_cameras = false;
+    try {
+        cpu_pipeline.render_profiled_smoke_frame(3, rt::RenderProfile::balanced());
+    } catch (const std::runtime_error&) {
+        too_many_cameras = true;
+    }
+    expect_true(too_many_cameras, "cpu backend rejects more cameras than renderers");
+    rt::RealtimePipeline sized_pipeline(rt::RealtimeBackend::cpu);
+    const rt::RealtimeFrameSet sized =
+        sized_pipeline.render_profiled_smoke_frame(4, rt::RenderProfile::balanced());
+    expect_true(sized.frames.size() == 4, "default cpu backend renders every camera");
     return 0;
 }
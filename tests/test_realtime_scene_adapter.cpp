@@ -1,3 +1,4 @@
+#include "common/vertex_quantization.h"
 #include "scene/realtime_scene_adapter.h"
 #include "scene/shared_scene_builders.h"
 #include "test_support.h"
@@ -5,6 +6,7 @@
 #include <Eigen/Geometry>
 
 #include <type_traits>
+#include <utility>
 
 int main() {
     rt::scene::SceneIR triangle_scene;
@@ -25,8 +27,10 @@ int main() {
         rt::scene::SurfaceInstance {.shape_index = mesh, .material_index = matte});
 
     const rt::SceneDescription adapted_triangle = rt::scene::adapt_to_realtime(triangle_scene);
-    expect_true(adapted_triangle.triangles().size() == 1,
-        "realtime adapter emits triangle primitive");
+    expect_true(adapted_triangle.triangle_meshes().size() == 1
+                    && adapted_triangle.triangle_meshes()[0].triangles.size() == 1
+                    && adapted_triangle.triangle_meshes()[0].positions.size() == 3,
+        "realtime adapter emits an indexed triangle mesh");
 
     const rt::scene::SceneIR cornell_smoke = rt::scene::build_scene("cornell_smoke");
     const rt::SceneDescription adapted = rt::scene::adapt_to_realtime(cornell_smoke);
@@ -120,14 +124,126 @@ int main() {
     expect_true(packed_v2.texture_count == 1, "native v2 texture table");
     expect_true(packed_v2.material_count == 2, "native v2 material table");
     expect_true(packed_v2.triangle_count == 2, "native v2 mesh triangulation");
-    expect_true(packed_v2.triangles[0].material_index == 0, "native v2 fallback subset material");
-    expect_true(packed_v2.triangles[1].material_index == 1, "native v2 second subset material");
-    expect_near(packed_v2.triangles[0].p0.x(), 2.0, 1e-9, "native v2 world transform");
-    expect_true(packed_v2.triangles[0].has_vertex_normals, "native v2 vertex normals");
-    expect_true(packed_v2.triangles[0].has_texcoords, "native v2 texcoords");
-    expect_near(packed_v2.triangles[0].uv2.y(), 1.0, 1e-9, "native v2 face-varying uv");
+    expect_true(packed_v2.triangle_mesh_count == 1 && packed_v2.triangles.empty(),
+        "native v2 mesh stays indexed");
+    const rt::IndexedTriangleMesh& baked = packed_v2.triangle_meshes[0];
+    expect_true(baked.material_indices[0] == 0, "native v2 fallback subset material");
+    expect_true(baked.material_indices[1] == 1, "native v2 second subset material");
+    expect_near(baked.positions[baked.triangles[0][0]].x(), 2.0, 1e-6,
+        "native v2 world transform");
+    expect_true(baked.normals.size() == baked.positions.size(), "native v2 vertex normals");
+    expect_true(baked.texcoords.size() == baked.positions.size(), "native v2 texcoords");
+    expect_true(baked.positions.size() == 4,
+        "face-varying corners that agree share their point's vertex");
+    float u = 0.0f;
+    float v = 0.0f;
+    rt::decode_half2(baked.texcoords[baked.triangles[0][2]], u, v);
+    expect_near(v, 1.0, 1e-6, "native v2 face-varying uv");
+
+    // A texture seam through point 0 splits only that point
+    rt::scene::SceneIRv2 seam_v2 = scene_v2;
+    seam_v2.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Prototypes/Seamed",
+        .kind = rt::scene::ScenePrimKind::geometry_prototype,
+        .geometry =
+            rt::scene::SceneMeshGeometry {
+                .points = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}},
+                .face_vertex_counts = {3, 3},
+                .face_vertex_indices = {0, 1, 2, 0, 2, 3},
+                .primvars =
+                    {
+                        rt::scene::ScenePrimvar {
+                            .name = "st",
+                            .interpolation = rt::scene::ScenePrimvarInterpolation::face_varying,
+                            .role = rt::scene::ScenePrimvarRole::texcoord,
+                            .values =
+                                std::vector<Eigen::Vector2f> {{0.0f, 0.0f}, {1.0f, 0.0f},
+                                    {1.0f, 1.0f}, {0.5f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}},
+                        },
+                    },
+            },
+    });
+    seam_v2.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Seamed",
+        .kind = rt::scene::ScenePrimKind::surface,
+        .prototype_path = "/World/Prototypes/Seamed",
+        .material_path = "/World/Blue",
+    });
+    const rt::PackedScene packed_seam = rt::scene::adapt_scene_ir_v2_to_realtime(seam_v2).pack();
+    const rt::IndexedTriangleMesh& seamed = packed_seam.triangle_meshes.at(1);
+    expect_true(seamed.positions.size() == 5, "a face-varying seam splits its point");
+    expect_true(seamed.triangles[0][0] != seamed.triangles[1][0]
+                    && seamed.triangles[0][2] == seamed.triangles[1][1],
+        "corners that agree across the seam still share a vertex");
+
     const auto& blue_material = std::get<rt::OpenPbrMaterialDesc>(packed_v2.materials[0]);
     expect_true(blue_material.compiled.color_textures.base_color.texture_index == 0,
         "native v2 connected OpenPBR texture binding");
+
+    // A second placement of the panel makes it a shared prototype; an emissive mesh placed twice
+    // stays baked so that its triangles remain lights
+    rt::scene::SceneIRv2 shared_v2 = scene_v2;
+    rt::scene::SceneOpenPbrSurface glow;
+    glow.emission_luminance = 4.0;
+    shared_v2.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Glow",
+        .kind = rt::scene::ScenePrimKind::material,
+        .material = rt::scene::SceneMaterial {glow},
+    });
+    shared_v2.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Prototypes/Lamp",
+        .kind = rt::scene::ScenePrimKind::geometry_prototype,
+        .geometry =
+            rt::scene::SceneMeshGeometry {
+                .points = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}},
+                .face_vertex_counts = {3},
+                .face_vertex_indices = {0, 1, 2},
+            },
+    });
+    Eigen::Matrix4d turned = Eigen::Matrix4d::Identity();
+    turned.topLeftCorner<3, 3>() =
+        Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitY()).toRotationMatrix();
+    turned(1, 3) = 3.0;
+    shared_v2.add_prim(rt::scene::ScenePrim {
+        .path = "/World/PanelCopy",
+        .kind = rt::scene::ScenePrimKind::surface,
+        .local_to_parent = turned,
+        .prototype_path = "/World/Prototypes/Panel",
+        .material_path = "/World/Metal",
+    });
+    for (const auto& [path, placement] :
+        {std::pair {"/World/LampA", translated}, std::pair {"/World/LampB", turned}}) {
+        shared_v2.add_prim(rt::scene::ScenePrim {
+            .path = path,
+            .kind = rt::scene::ScenePrimKind::surface,
+            .local_to_parent = placement,
+            .prototype_path = "/World/Prototypes/Lamp",
+            .material_path = "/World/Glow",
+        });
+    }
+    const rt::PackedScene packed_shared =
+        rt::scene::adapt_scene_ir_v2_to_realtime(shared_v2).pack();
+    expect_true(packed_shared.mesh_prototype_count == 1, "shared panel stored once");
+    expect_true(packed_shared.mesh_instance_count == 2, "each panel placement is an instance");
+    expect_true(packed_shared.triangle_count == 2, "emissive lamps stay baked");
+    const rt::MeshPrototype& panel = packed_shared.mesh_prototypes.front();
+    expect_true(panel.mesh.triangles.size() == 2, "prototype keeps the panel triangulation");
+    expect_near(panel.mesh.positions[panel.mesh.triangles[0][1]].x(), 1.0, 1e-6,
+        "prototype triangles stay in object space");
+    expect_true(panel.mesh.material_indices[1] == 1, "prototype keeps subset materials");
+    expect_true(!panel.mesh.normals.empty() && !panel.mesh.texcoords.empty(),
+        "prototype keeps primvars");
+    const rt::MeshInstance& copy = packed_shared.mesh_instances[1];
+    expect_near(packed_shared.mesh_instances[0].translation.x(), 2.0, 1e-9,
+        "first placement translation");
+    expect_true(copy.material_index == 1 && copy.prototype_index == 0,
+        "second placement brings its own material");
+    expect_near((copy.linear - turned.topLeftCorner<3, 3>()).norm(), 0.0, 1e-12,
+        "second placement keeps its rotation");
+    expect_true(copy.acceleration_prototype_id == packed_shared.mesh_instances[0]
+                                                     .acceleration_prototype_id
+                    && copy.acceleration_instance_id
+                           != packed_shared.mesh_instances[0].acceleration_instance_id,
+        "placements share a prototype identity");
     return 0;
 }
@@ -0,0 +1,103 @@
+#include "common/camera.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/russian_roulette.h"
+#include "common/sphere.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// A closed diffuse room with a lamp, seen from inside: no path escapes, so without roulette a
+// path ends only on the lamp or at max_depth
+HittableList make_room() {
+    HittableList room;
+    const auto walls = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.8, 0.7, 0.5});
+    const auto emitter = pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {4.0, 4.0, 4.0});
+    room.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, 0.0, 0.0}, 3.0, walls));
+    room.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, -2.0, 0.0}, 0.8, emitter));
+    return room;
+}
+
+// Mean linear radiance over the image, from the float accumulation rather than the 8-bit image
+Vec3d render_mean(HittableList& room, Camera::Integrator integrator, int rr_start_bounce,
+    int max_depth) {
+    pro::proxy<Hittable> world = &room;
+
+    Camera cam;
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 16;
+    cam.samples_per_pixel = 256;
+    cam.max_depth = max_depth;
+    cam.lookfrom = {0.0, 0.0, 1.0};
+    cam.lookat = {0.0, 0.5, -1.0};
+    cam.integrator = integrator;
+    cam.rr_start_bounce = rr_start_bounce;
+
+    Camera::ProgressiveOptions options;
+    options.samples_per_pass = 256;
+    cam.render_progressive(world, {}, {}, options);
+    Vec3d sum = Vec3d::Zero();
+    double count = 0.0;
+    for (int y = 0; y < cam.accumulation.height(); ++y) {
+        for (int x = 0; x < cam.accumulation.width(); ++x) {
+            const cv::Vec3f& pixel = cam.accumulation.radiance_sum.at<cv::Vec3f>(y, x);
+            sum += Vec3d {pixel[0], pixel[1], pixel[2]};
+            count += cam.accumulation.sample_count.at<std::int32_t>(y, x);
+        }
+    }
+    return sum / count;
+}
+
+void test_survival_policy() {
+    expect_true(!rt::russian_roulette_applies(2, 3), "roulette waits for its start bounce");
+    expect_true(rt::russian_roulette_applies(3, 3), "roulette starts at its start bounce");
+    expect_true(rt::russian_roulette_applies(0, 0), "a zero start bounce covers camera hits");
+    expect_true(!rt::russian_roulette_applies(40, -1), "a negative start bounce disables it");
+
+    expect_near(rt::russian_roulette_survival_probability(0.4), 0.4, 0.0,
+        "survival follows the largest throughput component");
+    expect_near(rt::russian_roulette_survival_probability(1e-6), 0.05, 0.0,
+        "dim paths keep a minimum chance to survive");
+    expect_near(rt::russian_roulette_survival_probability(3.0), 0.95, 0.0,
+        "bright paths are still subject to roulette");
+    expect_near(rt::russian_roulette_survival_probability(0.5f), 0.5f, 0.0,
+        "the GPU's single-precision policy agrees");
+}
+
+void test_roulette_is_unbiased() {
+    // Every bounce draws from its own stream, so the renders share each path up to where roulette
+    // ends it and differ by far less than independent estimates would
+    HittableList room = make_room();
+    const Vec3d full = render_mean(room, Camera::Integrator::recursive, -1, 50);
+    const Vec3d roulette = render_mean(room, Camera::Integrator::recursive, 0, 50);
+    expect_true(full.x() > 0.5, "the room is lit");
+    expect_near(roulette.x() / full.x(), 1.0, 0.03, "roulette keeps the mean radiance");
+    expect_near(roulette.z() / full.z(), 1.0, 0.03, "roulette keeps the mean in every channel");
+
+    const Vec3d wavefront = render_mean(room, Camera::Integrator::wavefront, 0, 50);
+    expect_vec3_near(wavefront, roulette, 1e-4 * roulette.x(),
+        "both integrators make the same roulette decisions");
+}
+
+void test_deep_paths_need_no_stack() {
+    // A depth limit far beyond any call stack: roulette ends every path long before it
+    HittableList room = make_room();
+    const Vec3d reference = render_mean(room, Camera::Integrator::recursive, 3, 50);
+    const Vec3d deep = render_mean(room, Camera::Integrator::recursive, 3, 1 << 24);
+    expect_true(std::isfinite(deep.x()) && deep.x() > 0.0, "deep paths finish");
+    expect_near(deep.x() / reference.x(), 1.0, 0.01, "the depth limit no longer matters");
+}
+
+} // namespace
+
+int main() {
+    test_survival_policy();
+    test_roulette_is_unbiased();
+    test_deep_paths_need_no_stack();
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "common/camera.h"
+#include "common/constant_medium.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/sampler.h"
+#include "common/sphere.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+#include <tbb/global_control.h>
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+void test_philox_known_answers() {
+    // Reference vectors published with Random123's philox4x32-10
+    const rt::PhiloxCounter zero = rt::philox4x32({0u, 0u, 0u, 0u}, {0u, 0u});
+    expect_true(zero == rt::PhiloxCounter {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u},
+        "philox zero counter and key");
+    const rt::PhiloxCounter ones = rt::philox4x32(
+        {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu});
+    expect_true(ones == rt::PhiloxCounter {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu},
+        "philox all-ones counter and key");
+    const rt::PhiloxCounter pi_digits =
+        rt::philox4x32({0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u},
+            {0xa4093822u, 0x299f31d0u});
+    expect_true(
+        pi_digits == rt::PhiloxCounter {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u},
+        "philox pi-digit counter and key");
+}
+
+void test_path_sampler_is_addressable() {
+    rt::PathSampler first {17u, 3u, 42u};
+    rt::PathSampler second {17u, 3u, 42u};
+    first.start_bounce(2);
+    second.start_bounce(2);
+    expect_true(first.next_1d() == second.next_1d(), "same key reproduces the same draw");
+
+    // Restarting a bounce rewinds its dimensions, so a vertex replays independently of history
+    const double replayed_dimension = first.next_1d();
+    first.start_bounce(2);
+    first.next_1d();
+    expect_true(first.next_1d() == replayed_dimension, "bounce restart replays dimensions");
+
+    rt::PathSampler other_pixel {18u, 3u, 42u};
+    rt::PathSampler other_sample {17u, 4u, 42u};
+    rt::PathSampler other_seed {17u, 3u, 43u};
+    rt::PathSampler reference {17u, 3u, 42u};
+    const double value = reference.next_1d();
+    expect_true(other_pixel.next_1d() != value, "pixel index selects a distinct stream");
+    expect_true(other_sample.next_1d() != value, "sample index selects a distinct stream");
+    expect_true(other_seed.next_1d() != value, "seed selects a distinct stream");
+
+    rt::PathSampler sampler {5u, 0u};
+    double sum = 0.0;
+    std::array<int, 4> int_histogram {};
+    constexpr int kDrawCount = 40000;
+    for (int i = 0; i < kDrawCount; ++i) {
+        const Eigen::Vector2d u = sampler.next_2d();
+        expect_true(u.x() >= 0.0 && u.x() < 1.0 && u.y() >= 0.0 && u.y() < 1.0,
+            "2D draw stays in the unit square");
+        sum += u.x() + u.y();
+        const int index = sampler.next_int(0, 3);
+        expect_true(index >= 0 && index <= 3, "integer draw stays in range");
+        int_histogram[static_cast<std::size_t>(index)] += 1;
+    }
+    expect_near(sum / (2.0 * kDrawCount), 0.5, 0.01, "uniform draws have mean one half");
+    for (const int count : int_histogram) {
+        expect_near(static_cast<double>(count) / kDrawCount, 0.25, 0.02,
+            "integer draws are uniform");
+    }
+}
+
+void test_medium_draws_from_path_sampler() {
+    // Free-flight distances come from the stream of the path vertex the ray leaves, so the seed
+    // and sample index decorrelate them while the same vertex replays the same distance
+    const auto boundary = pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, 0.0, -3.0}, 1.0,
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5}));
+    const ConstantMedium medium {boundary, 10.0, Vec3d {0.8, 0.8, 0.8}};
+    const auto free_flight = [&medium](const rt::PathSampler* sampler) {
+        Ray ray {Vec3d::Zero(), Vec3d {0.0, 0.0, -1.0}};
+        ray.set_sampler(sampler);
+        HitRecord hit_rec;
+        return medium.hit(ray, Interval {0.001, infinity}, hit_rec) ? hit_rec.t : infinity;
+    };
+
+    const rt::PathSampler reference {7u, 0u, 42u};
+    const rt::PathSampler same_vertex {7u, 0u, 42u};
+    const rt::PathSampler other_seed {7u, 0u, 43u};
+    const rt::PathSampler other_sample {7u, 1u, 42u};
+    expect_true(free_flight(&reference) == free_flight(&same_vertex),
+        "same vertex replays the free-flight distance");
+    expect_true(free_flight(&reference) != free_flight(&other_seed),
+        "seed changes the free-flight distance");
+    expect_true(free_flight(&reference) != free_flight(&other_sample),
+        "sample index changes the free-flight distance");
+    expect_true(free_flight(nullptr) == free_flight(nullptr),
+        "a ray off any path still draws a stable distance");
+
+    // Depth past the boundary entry is exponential with mean 1 / density
+    constexpr int kSampleCount = 20000;
+    double depth_sum = 0.0;
+    for (int sample = 0; sample < kSampleCount; ++sample) {
+        const rt::PathSampler sampler {3u, static_cast<std::uint32_t>(sample), 11u};
+        depth_sum += free_flight(&sampler) - 2.0;
+    }
+    expect_near(depth_sum / kSampleCount, 0.1, 0.005, "free-flight depth has mean 1 / density");
+}
+
+cv::Mat render_with_threads(int thread_count) {
+    tbb::global_control render_threads(tbb::global_control::max_allowed_parallelism, thread_count);
+
+    HittableList world;
+    HittableList lights;
+    const auto diffuse = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.7, 0.3, 0.2});
+    const auto metal = pro::make_proxy_shared<Material, Metal>(Vec3d {0.8, 0.8, 0.8}, 0.3);
+    const auto glass = pro::make_proxy_shared<Material, Dielectric>(1.5);
+    const auto light = pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {8.0, 8.0, 8.0});
+
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {-0.6, 0.0, -1.5}, 0.4, diffuse));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, 0.0, -1.5}, 0.4, glass));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.6, 0.0, -1.5}, 0.4, metal));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, -100.4, -1.5}, 100.0,
+        diffuse));
+    world.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {-0.75, 1.25, -2.0},
+        Vec3d {1.5, 0.0, 0.0}, Vec3d {0.0, 0.0, 1.0}, light));
+    lights.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {-0.75, 1.25, -2.0},
+        Vec3d {1.5, 0.0, 0.0}, Vec3d {0.0, 0.0, 1.0},
+        pro::make_proxy_shared<Material, EmptyMaterial>()));
+
+    pro::proxy<Hittable> world_as_hittable = &world;
+    pro::proxy<Hittable> lights_as_hittable = &lights;
+
+    Camera cam;
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 24;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 6;
+    cam.background = {0.1, 0.1, 0.15};
+    cam.defocus_angle = 2.0;
+    cam.focus_dist = 1.5;
+    cam.render(world_as_hittable, lights_as_hittable);
+    return cam.img.clone();
+}
+
+void test_render_is_independent_of_thread_count() {
+    const cv::Mat serial = render_with_threads(1);
+    const cv::Mat parallel = render_with_threads(4);
+    expect_true(!serial.empty() && serial.size() == parallel.size(), "renders have equal size");
+    expect_true(cv::norm(serial, parallel, cv::NORM_INF) == 0.0,
+        "render is bit-identical for one and four threads");
+    expect_true(cv::countNonZero(serial.reshape(1)) > 0, "reproducibility fixture is lit");
+}
+
+} // namespace
+
+int main() {
+    test_philox_known_answers();
+    test_path_sampler_is_addressable();
+    test_medium_draws_from_path_sampler();
+    test_render_is_independent_of_thread_count();
+    return 0;
+}
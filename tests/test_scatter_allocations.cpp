@@ -0,0 +1,240 @@
+#include "common/camera.h"
+#include "common/constant_medium.h"
+#include "common/cpu_analytic_light.h"
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/pdf.h"
+#include "common/quad.h"
+#include "common/sphere.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+
+// Only allocations made while a test has counting switched on, on its own thread, are counted:
+// fixtures, warm-up and the test harness may allocate freely
+thread_local bool counting_allocations = false;
+thread_local std::uint64_t heap_allocations = 0;
+
+template<typename Body>
+std::uint64_t count_allocations(Body&& body) {
+    heap_allocations = 0;
+    counting_allocations = true;
+    body();
+    counting_allocations = false;
+    return heap_allocations;
+}
+
+struct BounceTotals {
+    int scattered = 0;
+    double pdf_sum = 0.0;
+};
+
+HitRecord make_hit(const pro::proxy<Material>& material) {
+    HitRecord hit_rec;
+    hit_rec.p = Vec3d {0.0, 0.0, 0.0};
+    hit_rec.normal = Vec3d {0.0, 1.0, 0.0};
+    hit_rec.mat = material;
+    hit_rec.t = 1.0;
+    hit_rec.u = 0.5;
+    hit_rec.v = 0.5;
+    hit_rec.front_face = true;
+    return hit_rec;
+}
+
+// The per-bounce part of the CPU estimators: scatter, then either follow the specular ray or
+// build the light mixture, draw a direction and evaluate its density
+BounceTotals run_bounces(const HitRecord& hit_rec, const pro::proxy<Hittable>& lights,
+    bool sample_environment, int bounce_count) {
+    const Ray ray_in {Vec3d {0.0, 1.0, -1.0}, Vec3d {0.0, -1.0, 1.0}};
+    BounceTotals totals;
+    for (int bounce = 0; bounce < bounce_count; ++bounce) {
+        rt::PathSampler sampler {static_cast<std::uint32_t>(bounce), 0};
+        ScatterRecord scatter_rec;
+        if (!hit_rec.mat->scatter(ray_in, hit_rec, scatter_rec, sampler)) {
+            continue;
+        }
+        if (scatter_rec.skip_pdf) {
+            // Specular rays carry no density; count the ones that leave in some direction
+            totals.pdf_sum += scatter_rec.skip_pdf_ray.direction().squaredNorm() > 0.0 ? 1.0 : 0.0;
+        } else {
+            const LightMisPdf sampling_pdf =
+                make_light_mis_pdf(scatter_rec.pdf, lights, hit_rec.p, sample_environment);
+            const Vec3d direction = sampling_pdf.generate(sampler);
+            totals.pdf_sum += sampling_pdf.value(direction);
+        }
+        ++totals.scattered;
+    }
+    return totals;
+}
+
+pro::proxy<Material> make_openpbr() {
+    rt::OpenPbrCoreMaterial parameters;
+    parameters.base_color = {0.6f, 0.4f, 0.3f};
+    parameters.specular_roughness = 0.4f;
+    parameters.coat_weight = 0.5f;
+    parameters.coat_roughness = 0.1f;
+    return pro::make_proxy_shared<Material, OpenPbrSurfaceMaterial>(
+        rt::OpenPbrCompiledMaterial {.parameters = parameters},
+        std::vector<pro::proxy<Texture>> {});
+}
+
+void test_bounces_do_not_allocate() {
+    const pro::proxy<Material> light_material =
+        pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {4.0, 4.0, 4.0});
+    const pro::proxy<Hittable> lights = pro::make_proxy_shared<Hittable, HittableList>(
+        pro::make_proxy_shared<Hittable, Quad>(Vec3d {-1.0, 3.0, -1.0}, Vec3d {2.0, 0.0, 0.0},
+            Vec3d {0.0, 0.0, 2.0}, light_material));
+    const pro::proxy<Hittable> no_lights;
+    const std::vector<pro::proxy<Material>> materials {
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5}),
+        pro::make_proxy_shared<Material, Isotropic>(Vec3d {0.8, 0.8, 0.8}),
+        pro::make_proxy_shared<Material, Metal>(Vec3d {0.9, 0.8, 0.7}, 0.3),
+        pro::make_proxy_shared<Material, Dielectric>(1.5),
+        make_openpbr(),
+    };
+
+    for (const pro::proxy<Material>& material : materials) {
+        const HitRecord hit_rec = make_hit(material);
+        BounceTotals lit;
+        BounceTotals unlit;
+        BounceTotals environment;
+        const std::uint64_t allocations = count_allocations([&] {
+            lit = run_bounces(hit_rec, lights, true, 1024);
+            unlit = run_bounces(hit_rec, no_lights, false, 1024);
+            environment = run_bounces(hit_rec, no_lights, true, 1024);
+        });
+        expect_true(lit.scattered > 0 && unlit.scattered > 0 && environment.scattered > 0,
+            "every material scatters");
+        expect_true(lit.pdf_sum > 0.0 && unlit.pdf_sum > 0.0 && environment.pdf_sum > 0.0,
+            "sampled directions have positive density");
+        expect_true(allocations == 0,
+            "scattering and light, environment and BSDF mixtures make no heap allocations");
+    }
+}
+
+void test_paths_do_not_allocate() {
+    // Every material kind, a medium, an emissive quad and an analytic light in one scene, so
+    // paths run through each branch of the bounce loop
+    HittableList world;
+    const pro::proxy<Material> light_material =
+        pro::make_proxy_shared<Material, DiffuseLight>(Vec3d {6.0, 6.0, 6.0});
+    const pro::proxy<Hittable> light = pro::make_proxy_shared<Hittable, Quad>(
+        Vec3d {-1.0, 2.9, -3.0}, Vec3d {2.0, 0.0, 0.0}, Vec3d {0.0, 0.0, 2.0}, light_material);
+    world.add(light);
+    world.add(pro::make_proxy_shared<Hittable, Quad>(Vec3d {-5.0, -1.0, -8.0},
+        Vec3d {10.0, 0.0, 0.0}, Vec3d {0.0, 0.0, 10.0},
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.7, 0.7, 0.7})));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {-1.5, 0.0, -2.5}, 0.6,
+        pro::make_proxy_shared<Material, Metal>(Vec3d {0.9, 0.8, 0.7}, 0.2)));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, 0.0, -2.0}, 0.6,
+        pro::make_proxy_shared<Material, Dielectric>(1.5)));
+    world.add(pro::make_proxy_shared<Hittable, Sphere>(Vec3d {1.5, 0.0, -2.5}, 0.6,
+        make_openpbr()));
+    world.add(pro::make_proxy_shared<Hittable, ConstantMedium>(
+        pro::make_proxy_shared<Hittable, Sphere>(Vec3d {0.0, 1.2, -3.5}, 0.7,
+            pro::make_proxy_shared<Material, Lambertion>(Vec3d::Ones())),
+        2.0, Vec3d {0.8, 0.8, 0.8}));
+    const pro::proxy<Hittable> world_proxy = &world;
+    const pro::proxy<Hittable> lights = pro::make_proxy_shared<Hittable, HittableList>(light);
+
+    rt::AnalyticLightDesc sphere_light;
+    sphere_light.type = rt::AnalyticLightType::sphere;
+    sphere_light.position = {2.0, 2.5, -1.0};
+    sphere_light.radius = 0.2;
+    sphere_light.world_area = 4.0 * pi * sphere_light.radius * sphere_light.radius;
+    sphere_light.radiance = {20.0, 18.0, 15.0};
+    sphere_light.selection_weight = 1.0;
+    std::vector<rt::AnalyticLightDesc> analytic_descs {sphere_light};
+    rt::finalize_analytic_light_distribution(analytic_descs);
+    const rt::CpuAnalyticLightSampler analytic_lights {analytic_descs};
+
+    Camera cam;
+    cam.max_depth = 12;
+    cam.background = Vec3d {0.1, 0.1, 0.15};
+
+    constexpr int kPaths = 2048;
+    const auto trace = [&](int first_path, int path_count) {
+        Vec3d sum = Vec3d::Zero();
+        for (int path = first_path; path < first_path + path_count; ++path) {
+            rt::PathSampler sampler {static_cast<std::uint32_t>(path), 0};
+            const double x = (path % 64) / 32.0 - 1.0;
+            const double y = (path / 64 % 32) / 32.0 - 0.5;
+            const Ray ray {Vec3d {0.0, 0.5, 2.0}, Vec3d {x, y, -2.0}};
+            sum += cam.ray_color(
+                ray, world_proxy, lights, &analytic_lights, static_cast<std::uint32_t>(path),
+                sampler);
+        }
+        return sum;
+    };
+
+    // One-time lazy initialization, such as function-local tables, is not a per-path cost
+    trace(0, 64);
+    Vec3d radiance = Vec3d::Zero();
+    const std::uint64_t allocations = count_allocations([&] { radiance = trace(64, kPaths); });
+    expect_true(radiance.allFinite() && radiance.minCoeff() > 0.0, "paths gather light");
+    expect_true(allocations == 0, "full camera paths make no heap allocations");
+}
+
+void test_scatter_pdfs_are_values() {
+    HitRecord hit_rec;
+    hit_rec.p = Vec3d::Zero();
+    hit_rec.normal = Vec3d {0.0, 0.0, 1.0};
+    hit_rec.u = 0.0;
+    hit_rec.v = 0.0;
+    hit_rec.front_face = true;
+    const Ray ray_in {Vec3d {0.0, 0.0, 1.0}, Vec3d {0.0, 0.0, -1.0}};
+    rt::PathSampler sampler {0, 0};
+
+    ScatterRecord diffuse_scatter;
+    expect_true(Lambertion {Vec3d {0.5, 0.5, 0.5}}.scatter(
+                    ray_in, hit_rec, diffuse_scatter, sampler),
+        "lambertian scatters");
+    expect_true(std::holds_alternative<CosinePDF>(diffuse_scatter.pdf),
+        "lambertian samples the cosine lobe");
+    expect_near(pdf_value(diffuse_scatter.pdf, Vec3d {0.0, 0.0, 1.0}), 1.0 / pi, 1e-12,
+        "cosine density along the normal");
+
+    ScatterRecord volume_scatter;
+    expect_true(Isotropic {Vec3d {0.5, 0.5, 0.5}}.scatter(ray_in, hit_rec, volume_scatter, sampler),
+        "isotropic scatters");
+    expect_true(std::holds_alternative<SpherePDF>(volume_scatter.pdf),
+        "isotropic samples the sphere");
+    expect_near(pdf_value(volume_scatter.pdf, Vec3d {1.0, 0.0, 0.0}), 1.0 / (4.0 * pi), 1e-12,
+        "isotropic phase density");
+
+    ScatterRecord metal_scatter;
+    Metal {Vec3d {0.9, 0.9, 0.9}, 0.0}.scatter(ray_in, hit_rec, metal_scatter, sampler);
+    expect_true(std::holds_alternative<std::monostate>(metal_scatter.pdf),
+        "specular materials leave the density empty");
+    expect_near(pdf_value(metal_scatter.pdf, Vec3d {0.0, 0.0, 1.0}), 0.0, 0.0,
+        "an empty density evaluates to zero");
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (counting_allocations) {
+        ++heap_allocations;
+    }
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+int main() {
+    test_bounces_do_not_allocate();
+    test_paths_do_not_allocate();
+    test_scatter_pdfs_are_values();
+    return 0;
+}
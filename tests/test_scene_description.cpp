@@ -3,6 +3,8 @@
 #include "realtime/scene_description.h"
 #include "test_support.h"
 
+#include <stdexcept>
+
 int main() {
     const rt::RenderProfile profile = rt::RenderProfile::realtime_default();
     expect_near(static_cast<double>(profile.samples_per_pixel), 2.0, 1e-12, "default spp");
@@ -31,5 +33,33 @@ int main() {
     expect_near(static_cast<double>(packed.sphere_count), 1.0, 1e-12, "sphere count");
     expect_near(static_cast<double>(packed.quad_count), 1.0, 1e-12, "quad count");
     expect_near(static_cast<double>(packed.triangle_count), 1.0, 1e-12, "triangle count");
+
+    const rt::SceneGenerations before = scene.generations();
+    expect_true(before.spheres != 0 && before.materials != 0 && before.media == 0,
+        "mutators stamp the arrays they touch");
+    expect_true(packed.generations.spheres == before.spheres, "pack carries the stamps");
+
+    scene.set_sphere(0, rt::SpherePrimitive {0, Eigen::Vector3d {0.0, 1.0, -3.0}, 1.0, true});
+    expect_true(scene.generations().spheres > before.spheres, "set_sphere restamps spheres");
+    expect_true(scene.generations().quads == before.quads
+                    && scene.generations().materials == before.materials,
+        "untouched arrays keep their stamps");
+
+    scene.set_material(0, rt::DiffuseLightMaterial {Eigen::Vector3d {4.0, 4.0, 4.0}});
+    expect_true(scene.generations().materials > before.materials
+                    && scene.generations().textures > before.textures,
+        "normalizing a material into a new constant texture restamps both arrays");
+
+    const rt::SceneDescription copy = scene;
+    expect_true(copy.generations().spheres == scene.generations().spheres,
+        "copies share stamps with their source");
+
+    bool threw = false;
+    try {
+        scene.set_quad(3, rt::QuadPrimitive {});
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    expect_true(threw, "editing a missing primitive throws");
     return 0;
 }
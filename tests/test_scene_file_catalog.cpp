@@ -289,6 +289,39 @@ scene:
     expect_true(catalog.find_scene("final_room") != nullptr, "builtin fallback preserved after failed scan");
 }
 
+void test_summary_finds_scene_files_without_importing() {
+    const fs::path root = fs::temp_directory_path() / "scene_file_catalog_summary";
+    fs::remove_all(root);
+
+    // The OBJ does not exist: a summary that imported it would fail
+    write_text_file(root / "imported" / "scene.yaml", R"(format_version: 1
+scene:
+  id: summary_scene
+  label: Summary Scene
+  background: [0.25, 0.5, 0.75]
+imports:
+  missing:
+    type: obj_mtl
+    obj: models/missing.obj
+)");
+    write_text_file(root / "broken" / "scene.yaml", R"(format_version: 1
+scene: nope
+)");
+
+    const auto summary = rt::scene::find_scene_file_summary("summary_scene", root);
+    expect_true(summary.has_value(), "summary finds the scene past a broken sibling");
+    expect_true(summary->scene_file == (root / "imported" / "scene.yaml").lexically_normal(),
+        "summary names the scene file");
+    expect_true(summary->definition.metadata.label == "Summary Scene", "summary reads metadata");
+    expect_true(summary->definition.scene_ir.shapes().empty(), "summary imports nothing");
+    expect_true(!rt::scene::find_scene_file_summary("final_room", root).has_value(),
+        "builtin scenes have no file summary");
+
+    const auto shipped = rt::scene::find_scene_file_summary("imported_obj_smoke");
+    expect_true(shipped.has_value() && shipped->definition.realtime_preset.has_value(),
+        "summary reads the realtime preset of a shipped scene");
+}
+
 }  // namespace
 
 int main() {
@@ -296,5 +329,6 @@ int main() {
     test_reload_scene_picks_up_file_changes();
     test_rescan_discovers_new_scene_files();
     test_failed_scan_preserves_existing_builtin_fallback();
+    test_summary_finds_scene_files_without_importing();
     return 0;
 }
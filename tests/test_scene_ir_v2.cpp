@@ -3,6 +3,7 @@
 
 #include <Eigen/Core>
 
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -337,6 +338,123 @@ void test_stage_hierarchy_and_sampling() {
     expect_near(held(0, 3), 0.0, 1e-12, "held transform sample");
 }
 
+void test_batched_hierarchy_evaluation() {
+    rt::scene::SceneIRv2 scene;
+    scene.stage_metadata().start_time_code = 0.0;
+    // Children arrive before their parents, as importers that walk unordered layers emit them
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Group/Child",
+        .local_to_parent = translated(0.0, 0.0, 3.0),
+    });
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Group",
+        .local_to_parent = translated(0.0, 2.0, 0.0),
+        .visibility = rt::scene::SceneVisibility::invisible,
+        .authored_purpose = rt::scene::ScenePurpose::guide,
+    });
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/World",
+        .local_to_parent = translated(1.0, 0.0, 0.0),
+    });
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Animated",
+        .transform_samples =
+            {
+                {.time_code = 0.0, .local_to_parent = translated(0.0, 0.0, 0.0)},
+                {.time_code = 10.0, .local_to_parent = translated(10.0, 0.0, 0.0)},
+            },
+    });
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/World/Animated/Reset",
+        .local_to_parent = translated(0.0, 4.0, 0.0),
+        .reset_xform_stack = true,
+    });
+    scene.add_prim(rt::scene::ScenePrim {.path = "/Orphan/Child"});
+
+    const std::vector<std::size_t>& parents = scene.prim_parents();
+    expect_true(parents.size() == 6 && parents[0] == 1 && parents[1] == 2
+                    && parents[2] == rt::scene::kSceneRootParent && parents[3] == 2
+                    && parents[4] == 3 && parents[5] == rt::scene::kSceneUnresolvedParent,
+        "parent indices resolve regardless of insertion order");
+
+    const auto evaluation = scene.evaluate_hierarchy(5.0);
+    expect_true(evaluation->resolved[0] != 0 && evaluation->resolved[5] == 0,
+        "only prims with a complete ancestry resolve");
+    expect_vec3_near(evaluation->world_transforms[0].block<3, 1>(0, 3),
+        Eigen::Vector3d {1.0, 2.0, 3.0}, 1e-12, "batched world transform");
+    expect_vec3_near(evaluation->world_transforms[3].block<3, 1>(0, 3),
+        Eigen::Vector3d {6.0, 0.0, 0.0}, 1e-12, "batched animated sample");
+    expect_vec3_near(evaluation->world_transforms[4].block<3, 1>(0, 3),
+        Eigen::Vector3d {0.0, 4.0, 0.0}, 1e-12, "batched reset transform stack");
+    expect_true(evaluation->visible[0] == 0 && evaluation->visible[4] != 0,
+        "an invisible ancestor hides its descendants");
+    expect_true(evaluation->purposes[0] == rt::scene::ScenePurpose::guide
+                    && evaluation->purposes[4] == rt::scene::ScenePurpose::default_,
+        "batched purpose inheritance");
+    for (std::size_t i = 0; i < 5; ++i) {
+        const std::string& path = scene.prims()[i].path;
+        expect_true(rt::scene::compute_scene_world_transform(scene, path, 5.0)
+                        .isApprox(evaluation->world_transforms[i]),
+            "per-prim world transform matches the batch");
+        expect_true(
+            rt::scene::compute_scene_visibility(scene, path) == (evaluation->visible[i] != 0),
+            "per-prim visibility matches the batch");
+        expect_true(rt::scene::compute_scene_purpose(scene, path) == evaluation->purposes[i],
+            "per-prim purpose matches the batch");
+    }
+
+    expect_true(scene.evaluate_hierarchy(5.0) == evaluation, "evaluations are cached per time code");
+    expect_true(scene.evaluate_hierarchy(0.0) != evaluation, "other time codes evaluate again");
+    scene.add_prim(rt::scene::ScenePrim {
+        .path = "/Orphan",
+        .local_to_parent = translated(0.0, 0.0, -1.0),
+    });
+    const auto grown = scene.evaluate_hierarchy(5.0);
+    expect_true(grown != evaluation && evaluation->world_transforms.size() == 6,
+        "adding a prim invalidates the cache without touching earlier results");
+    expect_true(scene.prim_parents()[5] == 6 && grown->resolved[5] != 0,
+        "a late parent resolves its waiting children");
+    expect_vec3_near(grown->world_transforms[5].block<3, 1>(0, 3),
+        Eigen::Vector3d {0.0, 0.0, -1.0}, 1e-12, "late parent transform");
+
+    try {
+        (void) rt::scene::compute_scene_world_transform(scene, "/Missing", 0.0);
+        throw std::runtime_error("missing prim was evaluated");
+    } catch (const std::out_of_range&) {
+    }
+    rt::scene::SceneIRv2 orphaned;
+    orphaned.add_prim(rt::scene::ScenePrim {.path = "/Lost/Child"});
+    try {
+        (void) rt::scene::compute_scene_visibility(orphaned, "/Lost/Child");
+        throw std::runtime_error("prim with a missing ancestor was evaluated");
+    } catch (const std::out_of_range&) {
+    }
+}
+
+void test_deep_hierarchy_evaluation() {
+    // A chain this deep made the per-prim path walks quadratic
+    constexpr int depth = 4000;
+    std::vector<std::string> paths(depth);
+    std::string path;
+    for (int i = 0; i < depth; ++i) {
+        path += "/P" + std::to_string(i);
+        paths[static_cast<std::size_t>(i)] = path;
+    }
+    rt::scene::SceneIRv2 scene;
+    for (auto it = paths.rbegin(); it != paths.rend(); ++it) {
+        scene.add_prim(rt::scene::ScenePrim {
+            .path = *it,
+            .local_to_parent = translated(1.0, 0.0, 0.0),
+        });
+    }
+    const auto evaluation = scene.evaluate_hierarchy(0.0);
+    expect_near(evaluation->world_transforms.front()(0, 3), static_cast<double>(depth), 1e-9,
+        "deepest prim composes the whole chain");
+    expect_near(evaluation->world_transforms.back()(0, 3), 1.0, 1e-12, "root of the chain");
+    expect_near(rt::scene::compute_scene_world_transform(scene, paths.back(), 0.0)(0, 3),
+        static_cast<double>(depth), 1e-9, "per-prim query reads the batch");
+}
+
 void test_mesh_geometry_contract() {
     const rt::scene::SceneIRv2 scene = scene_with_mesh(valid_mesh_geometry());
     const std::vector<rt::scene::SceneDiagnostic> diagnostics =
@@ -986,6 +1104,8 @@ void test_legacy_material_compatibility_diagnostics() {
 
 int main() {
     test_stage_hierarchy_and_sampling();
+    test_batched_hierarchy_evaluation();
+    test_deep_hierarchy_evaluation();
     test_mesh_geometry_contract();
     test_camera_contract();
     test_asset_reference_contract();
@@ -0,0 +1,138 @@
+#include "common/texture_cache.h"
+#include "test_support.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_fixture_dir() {
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "test_texture_cache_fixtures";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+void write_fixture(const std::filesystem::path& path, const cv::Vec3b& bgr) {
+    cv::Mat image(2, 3, CV_8UC3);
+    for (int y = 0; y < image.rows; ++y) {
+        for (int x = 0; x < image.cols; ++x) {
+            image.at<cv::Vec3b>(y, x) = bgr;
+        }
+    }
+    expect_true(cv::imwrite(path.string(), image), "texture fixture should be written");
+}
+
+void test_files_decode_once() {
+    const std::filesystem::path dir = make_fixture_dir();
+    const std::filesystem::path first = dir / "first.png";
+    const std::filesystem::path same_bytes = dir / "same_bytes.png";
+    const std::filesystem::path other = dir / "other.png";
+    write_fixture(first, cv::Vec3b {32, 96, 224});
+    std::filesystem::copy_file(first, same_bytes);
+    write_fixture(other, cv::Vec3b {10, 20, 30});
+
+    rt::TextureCache cache;
+    const rt::DecodedTextureHandle texture = cache.load(first.string());
+    expect_true(texture != nullptr && texture->width() == 3 && texture->height() == 2,
+        "fixture decodes");
+    const std::uint8_t* texel = texture->texel(2, 1);
+    expect_true(texel[0] == 224 && texel[1] == 96 && texel[2] == 32, "texels are stored as RGB");
+    expect_true(rt::DecodedTexture::unit_value(255) == 1.0f
+                    && rt::DecodedTexture::unit_value(0) == 0.0f,
+        "unit values span [0, 1]");
+
+    expect_true(cache.load(first.string()) == texture, "same path shares the decoded copy");
+    expect_true(cache.load(same_bytes.string()) == texture,
+        "same contents under another name share the decoded copy");
+    expect_true(cache.load(other.string()) != texture, "different contents decode separately");
+    expect_true(cache.load((dir / "missing.png").string()) == nullptr, "missing file yields null");
+
+    const rt::TextureCacheStats stats = cache.stats();
+    expect_true(stats.lookups == 5 && stats.hits == 2 && stats.decodes == 2 && stats.failures == 1,
+        "counters track hits, decodes and failures");
+    expect_true(texture->byte_size() >= 2u * 3u * 3u, "the mip pyramid holds every base texel");
+    expect_true(stats.texture_count == 2 && stats.resident_bytes == 2u * texture->byte_size(),
+        "one 8-bit copy per distinct content is resident");
+    expect_true(stats.hit_rate() > 0.39 && stats.hit_rate() < 0.41, "hit rate is hits / lookups");
+
+    cache.clear();
+    expect_true(cache.stats().resident_bytes == 0, "clear releases the decoded copies");
+    expect_true(texture->width() == 3, "handles outlive the cache entry");
+    std::filesystem::remove_all(dir);
+}
+
+void test_parallel_load_preserves_order() {
+    const std::filesystem::path dir = make_fixture_dir();
+    std::vector<std::string> paths;
+    for (int i = 0; i < 16; ++i) {
+        const std::filesystem::path path = dir / ("fixture_" + std::to_string(i % 4) + ".png");
+        if (i < 4) {
+            write_fixture(path, cv::Vec3b {static_cast<std::uint8_t>(i * 40), 0, 0});
+        }
+        paths.push_back(path.string());
+    }
+
+    rt::TextureCache cache;
+    const std::vector<rt::DecodedTextureHandle> textures = cache.load_all(paths);
+    bool ordered = textures.size() == paths.size();
+    for (std::size_t i = 0; ordered && i < textures.size(); ++i) {
+        ordered = textures[i] != nullptr && textures[i] == textures[i % 4]
+                  && textures[i]->texel(0, 0)[2] == static_cast<std::uint8_t>((i % 4) * 40);
+    }
+    expect_true(ordered, "parallel load returns handles in input order");
+
+    const rt::TextureCacheStats stats = cache.stats();
+    expect_true(stats.texture_count == 4 && stats.lookups == 16 && stats.hits + stats.decodes == 16,
+        "parallel load keeps one copy per file");
+    std::filesystem::remove_all(dir);
+}
+
+void test_capacity_evicts_least_recently_used() {
+    const std::filesystem::path dir = make_fixture_dir();
+    const std::filesystem::path first = dir / "first.png";
+    const std::filesystem::path second = dir / "second.png";
+    const std::filesystem::path third = dir / "third.png";
+    write_fixture(first, cv::Vec3b {1, 2, 3});
+    write_fixture(second, cv::Vec3b {4, 5, 6});
+    write_fixture(third, cv::Vec3b {7, 8, 9});
+
+    rt::TextureCache cache;
+    const std::uint64_t texture_bytes = cache.load(first.string())->byte_size();
+    cache.set_capacity_bytes(2 * texture_bytes);
+    cache.load(second.string());
+    cache.load(first.string()); // Now the most recently used
+    cache.load(third.string());
+    rt::TextureCacheStats stats = cache.stats();
+    expect_true(stats.texture_count == 2 && stats.resident_bytes == 2 * texture_bytes
+                    && stats.evictions == 1,
+        "the cache stays within its capacity");
+
+    cache.load(first.string());
+    expect_true(cache.stats().decodes == 3, "the recently used texture stayed resident");
+    cache.load(second.string());
+    expect_true(cache.stats().decodes == 4, "the least recently used texture was released");
+
+    // A texture still referenced outside the cache is shared again rather than decoded twice
+    const rt::DecodedTextureHandle held = cache.load(third.string());
+    cache.set_capacity_bytes(0);
+    stats = cache.stats();
+    expect_true(stats.texture_count == 0 && stats.resident_bytes == 0,
+        "a zero capacity releases every texture");
+    expect_true(cache.load(third.string()) == held && cache.stats().decodes == stats.decodes,
+        "a live handle is found again after eviction");
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    test_files_decode_once();
+    test_parallel_load_preserves_order();
+    test_capacity_evicts_least_recently_used();
+    return 0;
+}
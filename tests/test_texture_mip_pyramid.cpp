@@ -0,0 +1,161 @@
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/texture.h"
+#include "common/texture_mip_pyramid.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+std::vector<std::uint8_t> make_gradient(int width, int height) {
+    std::vector<std::uint8_t> rgb(static_cast<std::size_t>(3 * width * height));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            std::uint8_t* texel = rgb.data() + 3 * (y * width + x);
+            texel[0] = static_cast<std::uint8_t>(x * 12);
+            texel[1] = static_cast<std::uint8_t>(y * 20);
+            texel[2] = static_cast<std::uint8_t>((x + y) % 2 == 0 ? 255 : 0);
+        }
+    }
+    return rgb;
+}
+
+void test_levels_and_tiles() {
+    constexpr int kWidth = 20;
+    constexpr int kHeight = 12;
+    const std::vector<std::uint8_t> rgb = make_gradient(kWidth, kHeight);
+    const rt::TextureMipPyramid pyramid {kWidth, kHeight, rgb.data(), 3 * kWidth};
+
+    expect_true(pyramid.level_count() == 5, "20x12 reduces through 10x6, 5x3 and 2x1 to 1x1");
+    expect_true(pyramid.width(2) == 5 && pyramid.height(2) == 3 && pyramid.width(4) == 1
+                    && pyramid.height(4) == 1,
+        "level sizes halve and stop at one texel");
+
+    bool base_matches = true;
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            const std::uint8_t* expected = rgb.data() + 3 * (y * kWidth + x);
+            const std::uint8_t* stored = pyramid.texel(0, x, y);
+            base_matches = base_matches && stored[0] == expected[0] && stored[1] == expected[1]
+                           && stored[2] == expected[2];
+        }
+    }
+    expect_true(base_matches, "tiled level 0 holds every source texel");
+    expect_true(pyramid.texel(0, 9, 0) - pyramid.texel(0, 0, 1) > 3 * kWidth,
+        "texels eight columns apart live in different tiles");
+
+    const std::uint8_t* reduced = pyramid.texel(1, 3, 2);
+    expect_true(reduced[0] == 78 && reduced[1] == 90 && reduced[2] == 128,
+        "each coarser texel is the rounded 2x2 average");
+}
+
+void test_filtered_lookups() {
+    constexpr int kWidth = 20;
+    constexpr int kHeight = 12;
+    const std::vector<std::uint8_t> rgb = make_gradient(kWidth, kHeight);
+    const rt::TextureMipPyramid pyramid {kWidth, kHeight, rgb.data(), 3 * kWidth};
+
+    const Eigen::Vector3f center = pyramid.sample(3.5 / kWidth, 2.5 / kHeight, 0.0);
+    expect_near(center.x(), 36.0 / 255.0, 1e-6, "a texel center returns that texel");
+    expect_near(center.y(), 40.0 / 255.0, 1e-6, "a texel center returns that texel");
+
+    const Eigen::Vector3f between = pyramid.sample(4.0 / kWidth, 2.5 / kHeight, 0.0);
+    expect_near(between.x(), 42.0 / 255.0, 1e-6, "bilinear weights neighbouring texels");
+    expect_near(between.z(), 127.5 / 255.0, 1e-6, "bilinear weights neighbouring texels");
+
+    expect_near(pyramid.level_of_detail(0.0), 0.0, 0.0, "a point footprint uses level 0");
+    expect_near(pyramid.level_of_detail(4.0 / kWidth), 2.0, 1e-6,
+        "a four-texel footprint uses level 2");
+    expect_near(pyramid.level_of_detail(10.0), 4.0, 0.0, "wide footprints clamp to the last level");
+
+    const Eigen::Vector3f coarse = pyramid.sample(3.5 / kWidth, 2.5 / kHeight, 10.0);
+    const std::uint8_t* last = pyramid.texel(4, 0, 0);
+    expect_near(coarse.z(), last[2] / 255.0, 1e-6, "wide footprints read the 1x1 level");
+
+    const Eigen::Vector3f blended = pyramid.sample(0.5, 0.5, std::exp2(2.5) / kWidth);
+    const Eigen::Vector3f fine = pyramid.bilinear(2, 0.5, 0.5);
+    const Eigen::Vector3f next = pyramid.bilinear(3, 0.5, 0.5);
+    expect_near(blended.x(), 0.5 * (fine.x() + next.x()), 1e-5,
+        "fractional levels blend the two nearest levels");
+}
+
+void test_ray_cone_selects_coarser_level() {
+    // One-texel checkerboard: point samples see black or white, wide footprints see grey
+    constexpr int kSize = 64;
+    std::vector<std::uint8_t> rgb(3 * kSize * kSize);
+    for (int y = 0; y < kSize; ++y) {
+        for (int x = 0; x < kSize; ++x) {
+            const std::uint8_t value = (x + y) % 2 == 0 ? 255 : 0;
+            std::fill_n(rgb.data() + 3 * (y * kSize + x), 3, value);
+        }
+    }
+    auto decoded = std::make_shared<rt::DecodedTexture>();
+    decoded->mips = rt::TextureMipPyramid {kSize, kSize, rgb.data(), 3 * kSize};
+    const ImageTexture texture {decoded};
+
+    const Quad quad {Vec3d {-1.0, -1.0, -2.0}, Vec3d {2.0, 0.0, 0.0}, Vec3d {0.0, 2.0, 0.0},
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5})};
+    const double u = 0.5 / kSize;
+    const double v = 1.0 - 0.5 / kSize;
+    const Vec3d target {-1.0 + 2.0 * u, -1.0 + 2.0 * v, -2.0};
+
+    HitRecord point_hit;
+    expect_true(quad.hit(Ray {Vec3d::Zero(), target}, Interval {0.001, infinity}, point_hit),
+        "point ray hits the quad");
+    expect_near(point_hit.texture_footprint, 0.0, 0.0, "rays without a cone have no footprint");
+    expect_near(texture.value(point_hit.u, point_hit.v, point_hit.p, point_hit.texture_footprint)
+                    .x(),
+        1.0, 1e-6, "point sampling resolves single texels");
+    // Nearest-texel lookups returned 1 or 0 here; the bilinear lookup blends the two texels
+    expect_near(texture.value(1.0 / kSize, v, Vec3d::Zero(), 0.0).x(), 0.5, 1e-6,
+        "point lookups between texel centers are bilinear");
+
+    Ray cone_ray {Vec3d::Zero(), target};
+    cone_ray.set_cone(RayCone {.width = 0.0, .spread = 0.05});
+    HitRecord cone_hit;
+    expect_true(quad.hit(cone_ray, Interval {0.001, infinity}, cone_hit), "cone ray hits the quad");
+    const double distance = target.norm();
+    const double cosine = 2.0 / distance;
+    expect_near(cone_hit.texture_footprint, 0.05 * distance / cosine / 2.0, 1e-9,
+        "footprint is the cone width over the incidence cosine in uv units");
+    expect_near(texture.value(cone_hit.u, cone_hit.v, cone_hit.p, cone_hit.texture_footprint).x(),
+        0.5, 0.01, "a wide cone filters the checkerboard to grey");
+}
+
+void test_lobe_roughness_sets_cone_spread() {
+    // Only rough lobes widen the cone: a glossy metal keeps its reflections sharp
+    const Quad quad {Vec3d {-1.0, -1.0, -2.0}, Vec3d {2.0, 0.0, 0.0}, Vec3d {0.0, 2.0, 0.0},
+        pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5})};
+    const Ray ray {Vec3d::Zero(), Vec3d {0.1, 0.2, -2.0}};
+    HitRecord hit;
+    expect_true(quad.hit(ray, Interval {0.001, infinity}, hit), "ray hits the quad");
+
+    rt::PathSampler sampler {0, 0};
+    const auto lobe_roughness = [&](const pro::proxy<Material>& material) {
+        ScatterRecord scatter;
+        expect_true(material->scatter(ray, hit, scatter, sampler), "material scatters");
+        return scatter.lobe_roughness;
+    };
+    expect_near(lobe_roughness(pro::make_proxy_shared<Material, Lambertion>(Vec3d::Ones())), 1.0,
+        0.0, "diffuse lobes are fully rough");
+    expect_near(lobe_roughness(pro::make_proxy_shared<Material, Metal>(Vec3d::Ones(), 0.25)), 0.5,
+        1e-12, "metal fuzz is the GGX alpha of its lobe");
+    expect_near(lobe_roughness(pro::make_proxy_shared<Material, Metal>(Vec3d::Ones(), 0.0)), 0.0,
+        0.0, "mirrors keep the cone spread");
+    expect_near(lobe_roughness(pro::make_proxy_shared<Material, Dielectric>(1.5)), 0.0, 0.0,
+        "refraction keeps the cone spread");
+}
+
+} // namespace
+
+int main() {
+    test_levels_and_tiles();
+    test_filtered_lookups();
+    test_ray_cone_selects_coarser_level();
+    test_lobe_roughness_sets_cone_spread();
+    return 0;
+}
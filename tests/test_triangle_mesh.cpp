@@ -0,0 +1,190 @@
+#include "common/hittable_list.h"
+#include "common/material.h"
+#include "common/quad.h"
+#include "common/triangle.h"
+#include "common/triangle_mesh.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+TriangleMeshData make_height_field(int resolution) {
+    // A bumpy grid, so rays cross the surface several times and hit many distinct triangles
+    TriangleMeshData mesh;
+    for (int j = 0; j <= resolution; ++j) {
+        for (int i = 0; i <= resolution; ++i) {
+            const double x = -2.0 + 4.0 * i / resolution;
+            const double z = -2.0 + 4.0 * j / resolution;
+            mesh.positions.push_back(Vec3d {x, 0.3 * std::sin(3.0 * x) * std::cos(2.0 * z), z});
+        }
+    }
+    const int stride = resolution + 1;
+    for (int j = 0; j < resolution; ++j) {
+        for (int i = 0; i < resolution; ++i) {
+            const int v00 = j * stride + i;
+            mesh.triangles.push_back(Eigen::Vector3i {v00, v00 + stride, v00 + 1});
+            mesh.triangles.push_back(Eigen::Vector3i {v00 + 1, v00 + stride, v00 + stride + 1});
+        }
+    }
+    return mesh;
+}
+
+void test_hits_match_triangle_list() {
+    const auto material = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5});
+    const TriangleMeshData data = make_height_field(24);
+
+    HittableList reference;
+    for (const Eigen::Vector3i& tri : data.triangles) {
+        reference.add(pro::make_proxy_shared<Hittable, Triangle>(data.positions[tri.x()],
+            data.positions[tri.y()], data.positions[tri.z()], material));
+    }
+    const TriangleMesh mesh {data, material};
+    expect_true(mesh.triangle_count() == data.triangles.size(), "mesh keeps every triangle");
+
+    std::mt19937 generator {11u};
+    std::uniform_real_distribution<double> unit {-1.0, 1.0};
+    int hits = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const Ray ray {Vec3d {2.5 * unit(generator), 1.5 + unit(generator), 2.5 * unit(generator)},
+            Vec3d {unit(generator), -1.0, unit(generator)}};
+        HitRecord expected;
+        HitRecord actual;
+        const bool expected_hit = reference.hit(ray, Interval {0.001, infinity}, expected);
+        const bool actual_hit = mesh.hit(ray, Interval {0.001, infinity}, actual);
+        expect_true(expected_hit == actual_hit, "mesh hit agrees with per-triangle scan");
+        if (expected_hit) {
+            expect_near(actual.t, expected.t, 1e-12, "mesh closest hit distance");
+            expect_vec3_near(actual.normal, expected.normal, 1e-9, "mesh flat normal");
+            expect_true(actual.front_face == expected.front_face, "mesh face orientation");
+            hits += 1;
+        }
+    }
+    expect_true(hits > 500, "probe rays hit the height field");
+}
+
+void test_single_precision_matches_reference() {
+    const auto material = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5});
+    const TriangleMeshData data = make_height_field(24);
+    const TriangleMesh reference {data, material};
+    const TriangleMeshF mesh {data, material};
+    expect_true(mesh.vertex_count() == data.positions.size(), "float mesh keeps every vertex");
+    expect_near(mesh.total_area(), reference.total_area(), 1e-5 * reference.total_area(),
+        "float mesh area");
+
+    std::mt19937 generator {23u};
+    std::uniform_real_distribution<double> unit {-1.0, 1.0};
+    int hits = 0;
+    int disagreements = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const Ray ray {Vec3d {2.5 * unit(generator), 1.5 + unit(generator), 2.5 * unit(generator)},
+            Vec3d {unit(generator), -1.0, unit(generator)}};
+        HitRecord expected;
+        HitRecord actual;
+        const bool expected_hit = reference.hit(ray, Interval {0.001, infinity}, expected);
+        const bool actual_hit = mesh.hit(ray, Interval {0.001, infinity}, actual);
+        if (expected_hit != actual_hit) {
+            // Rays through a shared edge may land on either side once vertices are rounded
+            ++disagreements;
+            continue;
+        }
+        if (expected_hit) {
+            expect_near(actual.t, expected.t, 1e-5 * expected.t, "float mesh hit distance");
+            expect_vec3_near(actual.p, expected.p, 1e-5, "float mesh hit point");
+            expect_true(actual.front_face == expected.front_face, "float mesh face orientation");
+            hits += 1;
+        }
+    }
+    expect_true(hits > 500, "probe rays hit the float height field");
+    expect_true(disagreements <= 4, "float and double meshes agree on nearly every ray");
+}
+
+void test_interpolates_vertex_attributes() {
+    const auto material = pro::make_proxy_shared<Material, Lambertion>(Vec3d {0.5, 0.5, 0.5});
+    const Vec3d tilted = Vec3d {1.0, 0.0, 1.0}.normalized();
+
+    // Per-vertex normals and face-varying texcoords on a unit right triangle in the z = 0 plane
+    const TriangleMesh mesh {
+        TriangleMeshData {
+            .positions = {Vec3d {0.0, 0.0, 0.0}, Vec3d {1.0, 0.0, 0.0}, Vec3d {0.0, 1.0, 0.0}},
+            .triangles = {Eigen::Vector3i {0, 1, 2}},
+            .normals = {Vec3d::UnitZ(), tilted, Vec3d::UnitZ()},
+            .texcoords = {Eigen::Vector2d {0.5, 0.5}, Eigen::Vector2d {0.25, 0.0},
+                Eigen::Vector2d {1.0, 0.0}, Eigen::Vector2d {0.0, 1.0}},
+            .texcoord_indices = {Eigen::Vector3i {1, 2, 3}},
+        },
+        material};
+
+    HitRecord hit;
+    const Ray front {Vec3d {0.5, 0.25, 1.0}, Vec3d {0.0, 0.0, -1.0}};
+    expect_true(mesh.hit(front, Interval {0.001, infinity}, hit), "attribute ray hits the mesh");
+    expect_true(hit.front_face, "ray against the winding normal hits the front face");
+
+    // Barycentrics at (0.5, 0.25) are (0.25, 0.5, 0.25)
+    const Vec3d expected_normal = (0.5 * Vec3d::UnitZ() + 0.5 * tilted).normalized();
+    expect_vec3_near(hit.normal, expected_normal, 1e-12, "interpolated shading normal");
+    expect_near(hit.u, 0.25 * 0.25 + 0.5 * 1.0, 1e-12, "interpolated u");
+    expect_near(hit.v, 0.25 * 1.0, 1e-12, "interpolated v");
+
+    const Ray back {Vec3d {0.5, 0.25, -1.0}, Vec3d {0.0, 0.0, 1.0}};
+    expect_true(mesh.hit(back, Interval {0.001, infinity}, hit), "back ray hits the mesh");
+    expect_true(!hit.front_face, "ray along the winding normal hits the back face");
+    expect_vec3_near(hit.normal, -expected_normal, 1e-12, "back face flips the shading normal");
+}
+
+void test_area_sampling_matches_quad_light() {
+    const auto material = pro::make_proxy_shared<Material, EmptyMaterial>();
+    const Vec3d q {-1.0, 2.0, -1.0};
+    const Vec3d u {2.0, 0.0, 0.0};
+    const Vec3d v {0.0, 0.0, 2.0};
+    const Quad quad {q, u, v, material};
+    const TriangleMesh mesh {
+        TriangleMeshData {
+            .positions = {q, q + u, q + u + v, q + v},
+            .triangles = {Eigen::Vector3i {0, 1, 2}, Eigen::Vector3i {0, 2, 3}},
+        },
+        material};
+    expect_near(mesh.total_area(), 4.0, 1e-12, "mesh reports its area");
+
+    const Vec3d origin {0.2, 0.0, 0.1};
+    rt::PathSampler sampler {0, 0};
+    for (int i = 0; i < 64; ++i) {
+        const Vec3d direction = mesh.random(origin, sampler);
+        expect_near((origin + direction).y(), 2.0, 1e-12, "sampled point lies on the mesh");
+        expect_near(mesh.pdf_value(origin, direction), quad.pdf_value(origin, direction), 1e-9,
+            "mesh light pdf matches the equivalent quad");
+    }
+    expect_near(mesh.pdf_value(origin, Vec3d {0.0, -1.0, 0.0}), 0.0, 0.0,
+        "directions missing the mesh have zero pdf");
+}
+
+void test_rejects_out_of_range_indices() {
+    const auto material = pro::make_proxy_shared<Material, EmptyMaterial>();
+    bool threw = false;
+    try {
+        const TriangleMesh mesh {
+            TriangleMeshData {
+                .positions = {Vec3d::Zero(), Vec3d::UnitX(), Vec3d::UnitY()},
+                .triangles = {Eigen::Vector3i {0, 1, 3}},
+            },
+            material};
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    expect_true(threw, "vertex index past the position array is rejected");
+}
+
+} // namespace
+
+int main() {
+    test_hits_match_triangle_list();
+    test_single_precision_matches_reference();
+    test_interpolates_vertex_attributes();
+    test_area_sampling_matches_quad_light();
+    test_rejects_out_of_range_indices();
+    return 0;
+}
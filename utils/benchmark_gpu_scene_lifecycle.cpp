@@ -74,6 +74,34 @@ void require_kind(const rt::AccelerationUpdateStats& stats, rt::AccelerationUpda
     }
 }
 
+struct BuildModeSummary {
+    TimingSummary build;
+    double sah_cost = 0.0;
+    int node_count = 0;
+};
+
+// Alternates between two topologies so that every prepare is a full rebuild.
+BuildModeSummary measure_build_mode(rt::AccelerationBuildMode mode, const rt::PackedScene& base,
+    const rt::PackedScene& topology_change) {
+    rt::SharedGpuSceneState state;
+    state.set_acceleration_build_mode(mode);
+    require_kind(state.prepare(base), rt::AccelerationUpdateKind::rebuild, "warmup mode rebuild");
+    std::vector<double> build_ms;
+    rt::AccelerationUpdateStats representative {};
+    for (int iteration = 0; iteration < kIterations; ++iteration) {
+        require_kind(state.prepare(topology_change), rt::AccelerationUpdateKind::rebuild,
+            "mode topology rebuild");
+        representative = state.prepare(base);
+        require_kind(representative, rt::AccelerationUpdateKind::rebuild, "mode base rebuild");
+        build_ms.push_back(representative.build_ms);
+    }
+    return BuildModeSummary {
+        .build = summarize(build_ms),
+        .sah_cost = representative.sah_cost,
+        .node_count = representative.node_count,
+    };
+}
+
 void write_summary(std::ofstream& output, std::string_view name, const TimingSummary& summary,
     bool trailing_comma) {
     output << "    \"" << name << "\": {\"avg_ms\": " << summary.avg_ms
@@ -81,6 +109,15 @@ void write_summary(std::ofstream& output, std::string_view name, const TimingSum
            << (trailing_comma ? "," : "") << "\n";
 }
 
+void write_build_mode(std::ofstream& output, rt::AccelerationBuildMode mode,
+    const BuildModeSummary& summary, bool trailing_comma) {
+    output << "    \"" << rt::acceleration_build_mode_name(mode)
+           << "\": {\"build_avg_ms\": " << summary.build.avg_ms
+           << ", \"build_p95_ms\": " << summary.build.p95_ms
+           << ", \"sah_cost\": " << summary.sah_cost << ", \"node_count\": " << summary.node_count
+           << "}" << (trailing_comma ? "," : "") << "\n";
+}
+
 } // namespace
 
 int main(int argc, const char* argv[]) {
@@ -138,6 +175,11 @@ int main(int argc, const char* argv[]) {
         throw std::runtime_error("instancing diagnostics did not preserve prototype reuse");
     }
 
+    const BuildModeSummary binned_sah =
+        measure_build_mode(rt::AccelerationBuildMode::binned_sah, base, topology_change);
+    const BuildModeSummary lbvh =
+        measure_build_mode(rt::AccelerationBuildMode::lbvh, base, topology_change);
+
     const std::filesystem::path output_path = argv[1];
     std::filesystem::create_directories(output_path.parent_path());
     std::ofstream output(output_path);
@@ -156,7 +198,15 @@ int main(int argc, const char* argv[]) {
     output << "    \"prototype_count\": " << representative_rebuild.prototype_count << ",\n";
     output << "    \"instance_count\": " << representative_rebuild.instance_count << ",\n";
     output << "    \"instanced_primitive_count\": "
-           << representative_rebuild.instanced_primitive_count << "\n";
+           << representative_rebuild.instanced_primitive_count << ",\n";
+    output << "    \"build_mode\": \""
+           << rt::acceleration_build_mode_name(representative_rebuild.build_mode) << "\",\n";
+    output << "    \"build_ms\": " << representative_rebuild.build_ms << ",\n";
+    output << "    \"sah_cost\": " << representative_rebuild.sah_cost << "\n";
+    output << "  },\n";
+    output << "  \"build_modes\": {\n";
+    write_build_mode(output, rt::AccelerationBuildMode::binned_sah, binned_sah, true);
+    write_build_mode(output, rt::AccelerationBuildMode::lbvh, lbvh, false);
     output << "  },\n";
     output << "  \"timings\": {\n";
     write_summary(output, "rebuild", summarize(rebuild_ms), true);
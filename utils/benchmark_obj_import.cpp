@@ -0,0 +1,33 @@
+#include "scene/obj_mtl_importer.h"
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <exception>
+
+int main(int argc, const char* argv[]) {
+    if (argc != 2) {
+        fmt::print(stderr, "usage: benchmark_obj_import OBJ_FILE\n");
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const rt::scene::ObjImportResult imported = rt::scene::import_obj_mtl(argv[1]);
+        const rt::scene::ObjImportStats& stats = imported.stats;
+        fmt::print("file_bytes: {}\n", stats.file_bytes);
+        fmt::print("chunks: {}\n", stats.chunk_count);
+        fmt::print("meshes: {}\n", imported.scene_ir.shapes().size());
+        fmt::print("triangles: {}\n", stats.triangle_count);
+        fmt::print("source_positions: {}\n", stats.source_position_count);
+        fmt::print("welded_vertices: {}\n", stats.vertex_count);
+        fmt::print("parse_ms: {:.1f}\n", stats.parse_ms);
+        fmt::print("merge_ms: {:.1f}\n", stats.merge_ms);
+        fmt::print("total_ms: {:.1f}\n", stats.total_ms);
+        fmt::print("throughput_mb_per_s: {:.1f}\n", stats.megabytes_per_second);
+        fmt::print("peak_rss_mib: {:.1f}\n", static_cast<double>(stats.peak_rss_bytes) / (1024.0 * 1024.0));
+    } catch (const std::exception& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,12 +3,15 @@
 #include "realtime/build_provenance.h"
 #include "realtime/camera_rig.h"
 #include "realtime/display_transfer.h"
+#include "realtime/gpu/cpu_renderer_pool.h"
 #include "realtime/gpu/renderer_pool.h"
 #include "realtime/profiling/benchmark_report.h"
+#include "realtime/realtime_pipeline.h"
 #include "realtime/render_profile.h"
 #include "realtime/realtime_scene_factory.h"
 #include "realtime/scene_catalog.h"
 #include "realtime/scene_description.h"
+#include "scene/scene_file_catalog.h"
 
 #include <argparse/argparse.hpp>
 #include <cuda_runtime_api.h>
@@ -27,11 +30,13 @@
 #include <fstream>
 #include <iomanip>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <sys/utsname.h>
+#include <utility>
 #include <vector>
 
 #ifndef RT_BUILD_CONFIGURATION
@@ -59,7 +64,20 @@ struct GpuMemorySnapshot {
     std::uint64_t used_bytes = 0;
 };
 
-GpuMemorySnapshot query_gpu_memory() {
+std::optional<rt::RealtimeBackend> backend_from_name(const std::string& name) {
+    if (name == "optix") {
+        return rt::RealtimeBackend::optix;
+    }
+    if (name == "cpu") {
+        return rt::RealtimeBackend::cpu;
+    }
+    return std::nullopt;
+}
+
+GpuMemorySnapshot query_gpu_memory(rt::RealtimeBackend backend) {
+    if (backend == rt::RealtimeBackend::cpu) {
+        return GpuMemorySnapshot {};
+    }
     std::size_t free_bytes = 0;
     std::size_t total_bytes = 0;
     check_cuda(cudaMemGetInfo(&free_bytes, &total_bytes), "cudaMemGetInfo");
@@ -102,11 +120,24 @@ std::string utc_timestamp() {
     return out.str();
 }
 
-rt::profiling::RunEnvironment collect_environment() {
+rt::profiling::RunEnvironment collect_environment(rt::RealtimeBackend backend) {
     utsname host {};
     if (uname(&host) != 0) {
         throw std::runtime_error("uname failed while collecting benchmark provenance");
     }
+    if (backend == rt::RealtimeBackend::cpu) {
+        return rt::profiling::RunEnvironment {
+            .operating_system = fmt::format("{} {}", host.sysname, host.release),
+            .architecture = host.machine,
+            .gpu_device = -1,
+            .gpu_name = "none (cpu backend)",
+            .compute_capability = "unavailable",
+            .nvidia_driver_version = "unavailable",
+            .cuda_driver_api_version_text = "unavailable",
+            .cuda_runtime_version_text = "unavailable",
+            .optix_version_text = "unavailable",
+        };
+    }
 
     int device = 0;
     int driver_version = 0;
@@ -142,7 +173,27 @@ rt::SceneDescription make_scene(const std::string& scene_name) {
     return rt::make_realtime_scene(scene_name);
 }
 
-rt::CameraRig make_rig(const std::string& scene_name, int camera_count) {
+// A cache miss loads the scene in full anyway, and only the full definition lists the files its
+// imports read
+std::optional<rt::PreparedSceneSource> find_prepared_scene_source(const std::string& scene_name,
+    const std::optional<rt::scene::SceneFileSummary>& scene_file) {
+    const rt::scene::SceneDefinition* definition =
+        rt::scene::global_scene_file_catalog().find_scene(scene_name);
+    if (!scene_file.has_value() || definition == nullptr) {
+        return std::nullopt;
+    }
+    return rt::PreparedSceneSource {
+        .scene_file = scene_file->scene_file,
+        .dependencies = definition->dependencies,
+    };
+}
+
+rt::CameraRig make_rig(const std::string& scene_name, int camera_count,
+    const std::optional<rt::scene::SceneFileSummary>& scene_file) {
+    if (scene_file.has_value()) {
+        return rt::camera_rig_for_preset(*scene_file->definition.realtime_preset, camera_count,
+            kDefaultWidth, kDefaultHeight);
+    }
     return rt::default_camera_rig_for_scene(scene_name, camera_count, kDefaultWidth,
         kDefaultHeight);
 }
@@ -172,6 +223,56 @@ void write_frame_image(const std::filesystem::path& output_dir, int frame_index,
     }
 }
 
+// Dispatches the pool contract to the selected backend; both pools are non-movable.
+class FrameRenderer {
+public:
+    FrameRenderer(rt::RealtimeBackend backend, int camera_count) {
+        if (backend == rt::RealtimeBackend::cpu) {
+            cpu_ = std::make_unique<rt::CpuRendererPool>(camera_count);
+        } else {
+            optix_ = std::make_unique<rt::RendererPool>(camera_count);
+        }
+    }
+
+    void prepare_scene(const rt::PackedScene& scene, const rt::PreparedSceneSource* source) {
+        if (cpu_) {
+            cpu_->prepare_scene(scene, source);
+        } else {
+            optix_->prepare_scene(scene, source);
+        }
+    }
+
+    void prepare_scene(rt::MappedPreparedScene mapped) {
+        if (cpu_) {
+            cpu_->prepare_scene(std::move(mapped));
+        } else {
+            optix_->prepare_scene(mapped);
+        }
+    }
+
+    void reset_sequence(std::uint32_t sample_stream) {
+        if (cpu_) {
+            cpu_->reset_sequence(sample_stream);
+        } else {
+            optix_->reset_sequence(sample_stream);
+        }
+    }
+
+    std::vector<rt::CameraRenderResult> render_frame(const rt::PackedCameraRig& rig,
+        const rt::RenderProfile& profile, int active_cameras) {
+        return cpu_ ? cpu_->render_frame(rig, profile, active_cameras)
+                    : optix_->render_frame(rig, profile, active_cameras);
+    }
+
+    rt::RendererPoolDiagnostics diagnostics() const {
+        return cpu_ ? cpu_->diagnostics() : optix_->diagnostics();
+    }
+
+private:
+    std::unique_ptr<rt::RendererPool> optix_;
+    std::unique_ptr<rt::CpuRendererPool> cpu_;
+};
+
 struct PostprocessResult {
     int camera_index = 0;
     float render_ms = 0.0f;
@@ -193,7 +294,9 @@ int main(int argc, const char* argv[]) {
     std::string output_dir = "build/realtime-smoke";
     std::string scene_name = "smoke";
     std::string profile_arg;
+    std::string backend_name = "optix";
     bool skip_image_write = false;
+    bool no_scene_cache = false;
 
     rt::RenderProfile profile = rt::RenderProfile::realtime_default();
     std::string profile_name = rt::render_profile_name(profile);
@@ -230,11 +333,20 @@ int main(int argc, const char* argv[]) {
     program.add_argument("--profile")
         .help("render profile: quality|balanced|realtime")
         .store_into(profile_arg);
+    program.add_argument("--backend")
+        .help("renderer backend: optix|cpu")
+        .default_value(backend_name)
+        .store_into(backend_name);
     program.add_argument("--skip-image-write")
         .help("benchmark mode: skip PNG writes and keep image_write_ms at zero")
         .default_value(false)
         .implicit_value(true)
         .store_into(skip_image_write);
+    program.add_argument("--no-scene-cache")
+        .help("prepare the scene from scratch instead of reading or writing its .rtcache file")
+        .default_value(false)
+        .implicit_value(true)
+        .store_into(no_scene_cache);
 
     try {
         program.parse_args(argc, argv);
@@ -263,11 +375,23 @@ int main(int argc, const char* argv[]) {
         fmt::print(stderr, "--seed + --warmup-frames + --frames exceeds uint32 sample streams\n");
         return EXIT_FAILURE;
     }
-    if (!is_supported_realtime_scene(scene_name)) {
+    // File-backed scenes reuse their prepared arrays across runs; builtins have nothing to key
+    // on. The summary names the file and its camera preset without importing anything, so a
+    // cache hit never loads the scene.
+    const std::optional<rt::scene::SceneFileSummary> scene_file =
+        no_scene_cache ? std::nullopt : rt::scene::find_scene_file_summary(scene_name);
+    if (scene_file.has_value() ? !scene_file->definition.metadata.supports_realtime
+                               : !is_supported_realtime_scene(scene_name)) {
         fmt::print(stderr, "--scene must reference a registered realtime scene\n");
         return EXIT_FAILURE;
     }
 
+    const std::optional<rt::RealtimeBackend> backend = backend_from_name(backend_name);
+    if (!backend.has_value()) {
+        fmt::print(stderr, "--backend must be one of: optix, cpu\n");
+        return EXIT_FAILURE;
+    }
+
     if (!profile_arg.empty()) {
         const std::optional<rt::RenderProfile> resolved_profile =
             rt::render_profile_from_name(profile_arg);
@@ -278,18 +402,31 @@ int main(int argc, const char* argv[]) {
         profile = *resolved_profile;
         profile_name = profile_arg;
     }
+    if (*backend == rt::RealtimeBackend::cpu) {
+        // The CPU backend has no denoiser; report the frames as what they are
+        profile.enable_denoise = false;
+    }
 
     const std::filesystem::path output_path = output_dir;
     std::filesystem::create_directories(output_path);
 
-    const rt::profiling::RunEnvironment environment = collect_environment();
-    const GpuMemorySnapshot baseline_memory = query_gpu_memory();
-    const rt::PackedScene packed_scene = make_scene(scene_name).pack();
-    const rt::PackedCameraRig packed_rig = make_rig(scene_name, camera_count).pack();
-    rt::RendererPool renderer_pool(camera_count);
-    renderer_pool.prepare_scene(packed_scene);
+    const rt::profiling::RunEnvironment environment = collect_environment(*backend);
+    const GpuMemorySnapshot baseline_memory = query_gpu_memory(*backend);
+    const rt::PackedCameraRig packed_rig = make_rig(scene_name, camera_count, scene_file).pack();
+    FrameRenderer renderer_pool(*backend, camera_count);
+    std::optional<rt::MappedPreparedScene> cached_scene =
+        scene_file.has_value() ? rt::MappedPreparedScene::open(scene_file->scene_file)
+                               : std::nullopt;
+    if (cached_scene.has_value()) {
+        renderer_pool.prepare_scene(std::move(*cached_scene));
+    } else {
+        const rt::PackedScene packed_scene = make_scene(scene_name).pack();
+        const std::optional<rt::PreparedSceneSource> scene_source =
+            find_prepared_scene_source(scene_name, scene_file);
+        renderer_pool.prepare_scene(packed_scene, scene_source ? &*scene_source : nullptr);
+    }
     renderer_pool.reset_sequence(static_cast<std::uint32_t>(random_seed));
-    const GpuMemorySnapshot prepared_memory = query_gpu_memory();
+    const GpuMemorySnapshot prepared_memory = query_gpu_memory(*backend);
     std::uint64_t peak_used_gpu_memory =
         std::max(baseline_memory.used_bytes, prepared_memory.used_bytes);
 
@@ -305,6 +442,9 @@ int main(int argc, const char* argv[]) {
         .cxx_compiler = RT_CXX_COMPILER,
     };
     report.environment = environment;
+    if (*backend == rt::RealtimeBackend::cpu) {
+        report.gpu_memory.scope = "none";
+    }
     report.gpu_memory.total_bytes = baseline_memory.total_bytes;
     report.gpu_memory.baseline_used_bytes = baseline_memory.used_bytes;
     report.gpu_memory.prepared_used_bytes = prepared_memory.used_bytes;
@@ -327,7 +467,7 @@ int main(int argc, const char* argv[]) {
         std::vector<rt::CameraRenderResult> warmup_results =
             renderer_pool.render_frame(packed_rig, profile, camera_count);
         const auto warmup_end = std::chrono::steady_clock::now();
-        const GpuMemorySnapshot warmup_memory = query_gpu_memory();
+        const GpuMemorySnapshot warmup_memory = query_gpu_memory(*backend);
         peak_used_gpu_memory = std::max(peak_used_gpu_memory, warmup_memory.used_bytes);
         const double warmup_ms =
             std::chrono::duration<double, std::milli>(warmup_end - warmup_begin).count();
@@ -417,7 +557,7 @@ int main(int argc, const char* argv[]) {
             frame_record.frame_ms - frame_record.pipeline_ms - frame_record.image_write_ms);
         frame_record.fps = 1000.0 / frame_record.frame_ms;
         report.frames.push_back(frame_record);
-        const GpuMemorySnapshot frame_memory = query_gpu_memory();
+        const GpuMemorySnapshot frame_memory = query_gpu_memory(*backend);
         peak_used_gpu_memory = std::max(peak_used_gpu_memory, frame_memory.used_bytes);
 
         fmt::print(
@@ -434,7 +574,7 @@ int main(int argc, const char* argv[]) {
             frame_record.host_overhead_ms, frame_record.frame_ms);
     }
 
-    const GpuMemorySnapshot final_memory = query_gpu_memory();
+    const GpuMemorySnapshot final_memory = query_gpu_memory(*backend);
     peak_used_gpu_memory = std::max(peak_used_gpu_memory, final_memory.used_bytes);
     report.gpu_memory.peak_used_bytes = peak_used_gpu_memory;
     report.gpu_memory.peak_delta_bytes = peak_used_gpu_memory >= baseline_memory.used_bytes
@@ -451,6 +591,10 @@ int main(int argc, const char* argv[]) {
         .acceleration_update_kind =
             std::string(rt::acceleration_update_kind_name(pool_diagnostics.acceleration.kind)),
         .acceleration_update_ms = pool_diagnostics.acceleration.elapsed_ms,
+        .acceleration_build_mode =
+            std::string(rt::acceleration_build_mode_name(pool_diagnostics.acceleration.build_mode)),
+        .acceleration_build_ms = pool_diagnostics.acceleration.build_ms,
+        .acceleration_sah_cost = pool_diagnostics.acceleration.sah_cost,
         .acceleration_node_count = pool_diagnostics.acceleration.node_count,
         .acceleration_reference_count = pool_diagnostics.acceleration.primitive_reference_count,
         .acceleration_prototype_count = pool_diagnostics.acceleration.prototype_count,
@@ -482,10 +626,11 @@ int main(int argc, const char* argv[]) {
         "max_bounces={} denoise={} avg_frame_ms={:.3f} avg_denoise_ms={:.3f} "
         "p95_frame_ms={:.3f} p99_frame_ms={:.3f} fps={:.2f} peak_gpu_memory_mib={:.2f} "
         "peak_gpu_memory_delta_mib={:.2f} workers={}/{} launch_param_allocations={} "
-        "launch_param_uploads={} as_update={} as_update_ms={:.3f} as_nodes={} as_refs={} "
+        "launch_param_uploads={} as_update={} as_update_ms={:.3f} as_build={} as_build_ms={:.3f} "
+        "as_sah_cost={:.3f} as_nodes={} as_refs={} "
         "as_prototypes={} as_instances={} instanced_primitives={} "
         "artifacts=benchmark_frames.csv,benchmark_summary.json,benchmark_manifest.json "
-        "output_dir={}\n",
+        "backend={} output_dir={}\n",
         profile_name, warmup_frames, frames, random_seed, camera_count, kDefaultWidth,
         kDefaultHeight, profile.samples_per_pixel, profile.max_bounces,
         profile.enable_denoise ? "true" : "false", avg_frame_ms, avg_denoise_ms, p95_frame_ms,
@@ -494,9 +639,13 @@ int main(int argc, const char* argv[]) {
         pool_diagnostics.launch_parameter_allocation_count,
         pool_diagnostics.launch_parameter_upload_count,
         rt::acceleration_update_kind_name(pool_diagnostics.acceleration.kind),
-        pool_diagnostics.acceleration.elapsed_ms, pool_diagnostics.acceleration.node_count,
+        pool_diagnostics.acceleration.elapsed_ms,
+        rt::acceleration_build_mode_name(pool_diagnostics.acceleration.build_mode),
+        pool_diagnostics.acceleration.build_ms, pool_diagnostics.acceleration.sah_cost,
+        pool_diagnostics.acceleration.node_count,
         pool_diagnostics.acceleration.primitive_reference_count,
         pool_diagnostics.acceleration.prototype_count, pool_diagnostics.acceleration.instance_count,
-        pool_diagnostics.acceleration.instanced_primitive_count, output_path.string());
+        pool_diagnostics.acceleration.instanced_primitive_count, backend_name,
+        output_path.string());
     return EXIT_SUCCESS;
 }
@@ -8,6 +8,7 @@
 #include <fmt/ostream.h>
 #include <opencv2/opencv.hpp>
 
+#include <chrono>
 #include <cstdlib>
 #include <exception>
 #include <string>
@@ -27,6 +28,21 @@ int main(int argc, const char* argv[]) {
 
     std::string output_image_format = "png";
     std::string scene_to_render = "cornell_box";
+    std::string integrator = "recursive";
+    std::string precision = "double";
+    int rr_start_bounce = rt::kDefaultRussianRouletteStartBounce;
+    int samples_per_pass = 16;
+    std::string checkpoint_path;
+    double time_budget_seconds = 0.0;
+    bool progressive = false;
+    bool resume = false;
+    double adaptive_error = 0.0;
+    int adaptive_min_samples = 16;
+    int adaptive_max_samples = 0;
+    bool restir_di = false;
+    int restir_candidates = 4;
+    int restir_spatial_neighbors = 1;
+    int restir_min_lights = 16;
 
     argparse::ArgumentParser program("use_core", version_string);
     program.add_argument("--output_image_format")
@@ -37,6 +53,70 @@ int main(int argc, const char* argv[]) {
         .help("Registered offline scene id")
         .default_value(scene_to_render)
         .store_into(scene_to_render);
+    program.add_argument("--integrator")
+        .help("CPU path integrator: recursive or wavefront")
+        .default_value(integrator)
+        .store_into(integrator);
+    program.add_argument("--precision")
+        .help("Triangle mesh vertex precision: double (reference) or float; shading stays double")
+        .default_value(precision)
+        .store_into(precision);
+    program.add_argument("--rr-start-bounce")
+        .help("First bounce that may end a path by Russian roulette; negative disables it")
+        .default_value(rr_start_bounce)
+        .store_into(rr_start_bounce);
+    program.add_argument("--progressive")
+        .help("Render in passes into a float accumulation buffer")
+        .default_value(false)
+        .implicit_value(true)
+        .store_into(progressive);
+    program.add_argument("--samples-per-pass")
+        .help("Samples added to every pixel per progressive pass")
+        .default_value(samples_per_pass)
+        .store_into(samples_per_pass);
+    program.add_argument("--checkpoint")
+        .help("Progressive checkpoint file, rewritten after every pass")
+        .default_value(checkpoint_path)
+        .store_into(checkpoint_path);
+    program.add_argument("--resume")
+        .help("Continue from --checkpoint when the file exists")
+        .default_value(false)
+        .implicit_value(true)
+        .store_into(resume);
+    program.add_argument("--time-budget")
+        .help("Stop a progressive render after this many seconds; 0 disables the limit")
+        .default_value(time_budget_seconds)
+        .store_into(time_budget_seconds);
+    program.add_argument("--adaptive-error")
+        .help("Stop sampling a pixel once its relative error falls below this; 0 disables")
+        .default_value(adaptive_error)
+        .store_into(adaptive_error);
+    program.add_argument("--adaptive-min-spp")
+        .help("Samples every pixel takes before adaptive sampling may stop it")
+        .default_value(adaptive_min_samples)
+        .store_into(adaptive_min_samples);
+    program.add_argument("--adaptive-max-spp")
+        .help("Per-pixel sample cap under adaptive sampling; 0 allows four times the scene's "
+              "samples per pixel")
+        .default_value(adaptive_max_samples)
+        .store_into(adaptive_max_samples);
+    program.add_argument("--restir-di")
+        .help("Resample the scene's analytic lights at primary hits with ReSTIR DI")
+        .default_value(false)
+        .implicit_value(true)
+        .store_into(restir_di);
+    program.add_argument("--restir-candidates")
+        .help("Light candidates each primary hit draws per sample under ReSTIR DI")
+        .default_value(restir_candidates)
+        .store_into(restir_candidates);
+    program.add_argument("--restir-spatial-neighbors")
+        .help("Neighbouring pixels whose reservoirs ReSTIR DI reuses, up to 8")
+        .default_value(restir_spatial_neighbors)
+        .store_into(restir_spatial_neighbors);
+    program.add_argument("--restir-min-lights")
+        .help("Fewest analytic lights for which ReSTIR DI replaces one light sample per hit")
+        .default_value(restir_min_lights)
+        .store_into(restir_min_lights);
 
     try {
         program.parse_args(argc, argv);
@@ -51,14 +131,117 @@ int main(int argc, const char* argv[]) {
         return EXIT_FAILURE;
     }
 
+    rt::OfflineRenderOptions render_options;
+    if (integrator == "wavefront") {
+        render_options.integrator = rt::OfflineIntegrator::wavefront;
+    } else if (integrator != "recursive") {
+        fmt::print(stderr, "--integrator must be recursive or wavefront\n");
+        return EXIT_FAILURE;
+    }
+    if (precision == "float") {
+        render_options.single_precision_geometry = true;
+    } else if (precision != "double") {
+        fmt::print(stderr, "--precision must be double or float\n");
+        return EXIT_FAILURE;
+    }
+    render_options.rr_start_bounce = rr_start_bounce;
+
+    if (adaptive_error < 0.0 || adaptive_min_samples <= 0 || adaptive_max_samples < 0) {
+        fmt::print(stderr, "adaptive sampling options must not be negative\n");
+        return EXIT_FAILURE;
+    }
+    if (adaptive_error > 0.0) {
+        render_options.adaptive.enabled = true;
+        render_options.adaptive.relative_error = adaptive_error;
+        render_options.adaptive.min_samples = adaptive_min_samples;
+        render_options.adaptive.max_samples_per_pixel = adaptive_max_samples;
+    }
+
+    if (restir_candidates <= 0 || restir_spatial_neighbors < 0 || restir_spatial_neighbors > 8
+        || restir_min_lights < 0) {
+        fmt::print(stderr,
+            "--restir-candidates must be positive, --restir-spatial-neighbors within 0..8 and "
+            "--restir-min-lights not negative\n");
+        return EXIT_FAILURE;
+    }
+    render_options.restir.enabled = restir_di;
+    render_options.restir.initial_candidates = restir_candidates;
+    render_options.restir.spatial_neighbors = restir_spatial_neighbors;
+    render_options.restir.min_analytic_lights = restir_min_lights;
+
+    // Adaptive renders report a sample-count AOV, which the progressive path returns
+    progressive = progressive || !checkpoint_path.empty() || time_budget_seconds > 0.0
+                  || render_options.adaptive.enabled;
+    if (samples_per_pass <= 0) {
+        fmt::print(stderr, "--samples-per-pass must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (time_budget_seconds < 0.0) {
+        fmt::print(stderr, "--time-budget must not be negative\n");
+        return EXIT_FAILURE;
+    }
+    if (resume && checkpoint_path.empty()) {
+        fmt::print(stderr, "--resume requires --checkpoint\n");
+        return EXIT_FAILURE;
+    }
+
     fmt::print("scene to render: {}\n", scene_to_render);
     fmt::print("output_image_format: {}\n", output_image_format);
+    fmt::print("integrator: {}\n", integrator);
+    fmt::print("precision: {}\n", precision);
+    fmt::print("russian roulette from bounce: {}\n", rr_start_bounce);
+    fmt::print("restir di: {}\n", restir_di ? "on" : "off");
+
+    cv::Mat image;
+    cv::Mat sample_counts;
+    bool completed = true;
+    if (progressive) {
+        rt::ProgressiveRenderOptions progressive_options;
+        progressive_options.samples_per_pass = samples_per_pass;
+        progressive_options.checkpoint_path = checkpoint_path;
+        progressive_options.resume = resume;
+        if (time_budget_seconds > 0.0) {
+            progressive_options.time_budget = std::chrono::duration<double>(time_budget_seconds);
+        }
+        const rt::ProgressiveRenderResult result = rt::render_shared_scene_progressive(
+            scene_to_render, 0, render_options, progressive_options);
+        fmt::print("progressive samples per pixel: {}/{}\n", result.min_samples_per_pixel,
+            result.target_samples_per_pixel);
+        image = result.image;
+        sample_counts = result.sample_counts;
+        completed = result.completed;
+    } else {
+        image = rt::render_shared_scene(scene_to_render, 0, render_options);
+    }
 
-    const cv::Mat image = rt::render_shared_scene(scene_to_render, 0);
     const std::string output_path = fmt::format("{}.{}", scene_to_render, output_image_format);
     if (!cv::imwrite(output_path, image)) {
         fmt::print(stderr, "failed to write {}\n", output_path);
         return EXIT_FAILURE;
     }
+    if (render_options.adaptive.enabled && !sample_counts.empty()) {
+        double max_count = 0.0;
+        cv::minMaxLoc(sample_counts, nullptr, &max_count);
+        fmt::print("adaptive samples per pixel: mean {:.1f}, max {}\n", cv::mean(sample_counts)[0],
+            static_cast<int>(max_count));
+
+        // Sample-count AOV, scaled so the most sampled pixel is white
+        cv::Mat sample_count_image;
+        sample_counts.convertTo(
+            sample_count_image, CV_8UC1, max_count > 0.0 ? 255.0 / max_count : 0.0);
+        const std::string aov_path = fmt::format("{}_spp.{}", scene_to_render, output_image_format);
+        if (!cv::imwrite(aov_path, sample_count_image)) {
+            fmt::print(stderr, "failed to write {}\n", aov_path);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!completed) {
+        if (checkpoint_path.empty()) {
+            fmt::print("time budget reached; pass --checkpoint to keep partial progress\n");
+        } else {
+            fmt::print("time budget reached; continue with --checkpoint {} --resume\n",
+                checkpoint_path);
+        }
+    }
     return EXIT_SUCCESS;
 }